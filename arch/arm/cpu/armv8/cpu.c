@@ -14,6 +14,7 @@
 #include <command.h>
 #include <cpu_func.h>
 #include <irq_func.h>
+#include <worker.h>
 #include <asm/cache.h>
 #include <asm/system.h>
 #include <asm/secure.h>
@@ -44,6 +45,9 @@ int cleanup_before_linux(void)
 	 * disable interrupt and turn off caches etc ...
 	 */
 
+	/* The OS expects the secondary cores to be off */
+	worker_stop();
+
 	board_cleanup_before_linux();
 
 	disable_interrupts();
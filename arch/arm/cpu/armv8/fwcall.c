@@ -130,3 +130,40 @@ void __noreturn psci_system_off(void)
 	while (1)
 		;
 }
+
+static unsigned long invoke_psci_fn(unsigned long function_id,
+				    unsigned long arg0, unsigned long arg1,
+				    unsigned long arg2)
+{
+	struct pt_regs regs;
+
+	regs.regs[0] = function_id;
+	regs.regs[1] = arg0;
+	regs.regs[2] = arg1;
+	regs.regs[3] = arg2;
+	if (use_smc_for_psci)
+		smc_call(&regs);
+	else
+		hvc_call(&regs);
+
+	return regs.regs[0];
+}
+
+s32 psci_fw_cpu_on(u64 mpidr, ulong entry, ulong context_id)
+{
+	return invoke_psci_fn(ARM_PSCI_0_2_FN64_CPU_ON, mpidr, entry,
+			      context_id);
+}
+
+void __noreturn psci_fw_cpu_off(void)
+{
+	invoke_psci_fn(ARM_PSCI_0_2_FN_CPU_OFF, 0, 0, 0);
+
+	while (1)
+		;
+}
+
+s32 psci_fw_affinity_info(u64 mpidr)
+{
+	return invoke_psci_fn(ARM_PSCI_0_2_FN64_AFFINITY_INFO, mpidr, 0, 0);
+}
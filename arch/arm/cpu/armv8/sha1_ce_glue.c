@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 block function using the ARMv8 Crypto Extensions
+ */
+
+#include <common.h>
+#include <u-boot/sha1.h>
+#include <asm/armv8/crypto.h>
+
+void sha1_armv8_ce_process(u32 state[5], const u8 *src, u32 blocks);
+
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks)
+{
+	u32 state[5];
+	int i;
+
+	if (!blocks)
+		return;
+
+	if (!armv8_ce_has_sha1()) {
+		sha1_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	/* sha1_context keeps the state in unsigned long words */
+	for (i = 0; i < 5; i++)
+		state[i] = ctx->state[i];
+	sha1_armv8_ce_process(state, data, blocks);
+	for (i = 0; i < 5; i++)
+		ctx->state[i] = state[i];
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 block function using the ARMv8 Crypto Extensions
+ */
+
+#include <common.h>
+#include <u-boot/sha256.h>
+#include <asm/armv8/crypto.h>
+
+void sha256_armv8_ce_process(u32 state[8], const u8 *src, u32 blocks);
+
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (!armv8_ce_has_sha256()) {
+		sha256_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha256_armv8_ce_process(ctx->state, data, blocks);
+}
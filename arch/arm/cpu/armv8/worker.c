@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Worker core for ARMv8, started and stopped with PSCI
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <malloc.h>
+#include <time.h>
+#include <worker.h>
+#include <asm/barriers.h>
+#include <asm/armv8/mmu.h>
+#include <asm/global_data.h>
+#include <asm/psci.h>
+#include <asm/system.h>
+#include <linux/bug.h>
+#include <linux/sizes.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define WORKER_STACK_SIZE	SZ_16K
+#define WORKER_OFF_TIMEOUT_MS	100
+
+/* Read by worker_entry with the MMU off; keep the layout in step */
+struct worker_cpu {
+	u64 ttbr;
+	u64 tcr;
+	u64 mair;
+	u64 sp;
+	u64 gd;
+} __aligned(CONFIG_SYS_CACHELINE_SIZE);
+
+static struct worker_cpu worker_cpu;
+static void *worker_stack;
+
+void worker_entry(void);
+
+void __noreturn worker_cpu_main(void)
+{
+	worker_main();
+	psci_fw_cpu_off();
+}
+
+int worker_arch_start(void)
+{
+	int el = current_el();
+	s32 ret;
+
+	BUILD_BUG_ON(offsetof(struct worker_cpu, tcr) != 8 ||
+		     offsetof(struct worker_cpu, mair) != 16 ||
+		     offsetof(struct worker_cpu, sp) != 24 ||
+		     offsetof(struct worker_cpu, gd) != 32);
+
+	/* Without caches the two cores would not see each other's writes */
+	if (!dcache_status())
+		return -EPERM;
+	if (!worker_stack) {
+		worker_stack = memalign(16, WORKER_STACK_SIZE);
+		if (!worker_stack)
+			return -ENOMEM;
+	}
+
+	worker_cpu.ttbr = gd->arch.tlb_addr;
+	worker_cpu.tcr = get_tcr(el, NULL, NULL);
+	worker_cpu.mair = MEMORY_ATTRIBUTES;
+	worker_cpu.sp = (ulong)worker_stack + WORKER_STACK_SIZE;
+	worker_cpu.gd = (ulong)gd;
+	flush_dcache_range((ulong)&worker_cpu,
+			   (ulong)&worker_cpu + sizeof(worker_cpu));
+
+	ret = psci_fw_cpu_on(CONFIG_CPU_WORKER_MPIDR, (ulong)worker_entry,
+			     (ulong)&worker_cpu);
+	if (ret) {
+		debug("%s: CPU_ON failed (err=%d)\n", __func__, ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+void worker_arch_stop(void)
+{
+	ulong start = get_timer(0);
+
+	while (psci_fw_affinity_info(CONFIG_CPU_WORKER_MPIDR) !=
+	       PSCI_AFFINITY_LEVEL_OFF) {
+		if (get_timer(start) > WORKER_OFF_TIMEOUT_MS) {
+			printf("Worker core did not power off\n");
+			break;
+		}
+	}
+}
+
+void worker_arch_kick(void)
+{
+	dsb();
+	asm volatile("sev" : : : "memory");
+}
+
+void worker_arch_wait(void)
+{
+	asm volatile("wfe" : : : "memory");
+}
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * ARMv8 Cryptography Extensions feature detection
+ */
+
+#ifndef _ASM_ARMV8_CRYPTO_H_
+#define _ASM_ARMV8_CRYPTO_H_
+
+#include <linux/types.h>
+
+/* ID_AA64ISAR0_EL1 fields */
+#define ID_AA64ISAR0_AES_SHIFT		4
+#define ID_AA64ISAR0_SHA1_SHIFT		8
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+#define ID_AA64ISAR0_FIELD_MASK		0xf
+
+static inline u64 read_id_aa64isar0(void)
+{
+	u64 val;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (val));
+
+	return val;
+}
+
+static inline bool armv8_ce_has_sha1(void)
+{
+	return (read_id_aa64isar0() >> ID_AA64ISAR0_SHA1_SHIFT) &
+		ID_AA64ISAR0_FIELD_MASK;
+}
+
+static inline bool armv8_ce_has_sha256(void)
+{
+	return (read_id_aa64isar0() >> ID_AA64ISAR0_SHA2_SHIFT) &
+		ID_AA64ISAR0_FIELD_MASK;
+}
+
+#endif /* _ASM_ARMV8_CRYPTO_H_ */
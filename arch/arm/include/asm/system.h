@@ -258,6 +258,19 @@ void __noreturn psci_system_reset(void);
 void __noreturn psci_system_reset2(u32 reset_level, u32 cookie);
 void __noreturn psci_system_off(void);
 
+/*
+ * Start, stop and query a core through the PSCI firmware
+ *
+ * @mpidr:      MPIDR of the target core
+ * @entry:      physical address the core starts at, with its MMU off
+ * @context_id: passed to the core in x0
+ * @return PSCI return code (ARM_PSCI_RET_...), or for
+ *         psci_fw_affinity_info() the state (PSCI_AFFINITY_LEVEL_...)
+ */
+s32 psci_fw_cpu_on(u64 mpidr, ulong entry, ulong context_id);
+void __noreturn psci_fw_cpu_off(void);
+s32 psci_fw_affinity_info(u64 mpidr);
+
 #ifdef CONFIG_ARMV8_PSCI
 extern char __secure_start[];
 extern char __secure_end[];
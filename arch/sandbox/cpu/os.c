@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -271,6 +272,20 @@ uint64_t __attribute__((no_instrument_function)) os_get_nsec(void)
 #endif
 }
 
+int os_thread_create(void *(*func)(void *arg), void *arg)
+{
+	pthread_t thread;
+	pthread_attr_t attr;
+	int ret;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, func, arg);
+	pthread_attr_destroy(&attr);
+
+	return ret ? -ret : 0;
+}
+
 static char *short_opts;
 static struct option *long_opts;
 
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Worker core for sandbox, modelled with a host thread
+ */
+
+#include <common.h>
+#include <os.h>
+#include <worker.h>
+
+static void *sandbox_worker_thread(void *arg)
+{
+	worker_main();
+
+	return NULL;
+}
+
+int worker_arch_start(void)
+{
+	return os_thread_create(sandbox_worker_thread, NULL);
+}
+
+void worker_arch_stop(void)
+{
+}
+
+void worker_arch_kick(void)
+{
+}
+
+void worker_arch_wait(void)
+{
+	os_usleep(10);
+}
@@ -80,6 +80,8 @@ typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
  * recv_packet_buffer - buffers of the packet returned as received
  * recv_packet_length - lengths of the packet returned as received
  * recv_packets - number of packets returned
+ * batch - hand received packets over with recv_batch()
+ * batched - number of packets handed over by recv_batch()
  * tx_handler - function to generate responses to sent packets
  * priv - a pointer to some structure a test may want to keep track of
  */
@@ -90,6 +92,8 @@ struct eth_sandbox_priv {
 	uchar * recv_packet_buffer[PKTBUFSRX];
 	int recv_packet_length[PKTBUFSRX];
 	int recv_packets;
+	bool batch;
+	int batched;
 	sandbox_eth_tx_hand_f *tx_handler;
 	void *priv;
 };
@@ -108,4 +112,11 @@ void sandbox_eth_set_tx_handler(int index, sandbox_eth_tx_hand_f *handler);
  */
 void sandbox_eth_set_priv(int index, void *priv);
 
+/*
+ * Hand received packets over in batches, through recv_batch()
+ *
+ * batch - true to use recv_batch(), false to use recv()
+ */
+void sandbox_eth_set_batch(int index, bool batch);
+
 #endif /* __ETH_H */
@@ -244,4 +244,52 @@ uint sandbox_pci_read_bar(u32 barval, int type, uint size);
  */
 void sandbox_set_enable_memio(bool enable);
 
+/**
+ * ma35d1_crypto_emul_sha_transfers() - Get the number of SHA DMA transfers
+ *
+ * @return number of transfers the MA35D1 HMAC engine model has run
+ */
+uint ma35d1_crypto_emul_sha_transfers(void);
+
+/**
+ * sandbox_nand_get_time() - Get the virtual clock of a simulated NAND chip
+ *
+ * @dev: NAND device
+ * @return time in ns spent on the bus and waiting for the chip
+ */
+u64 sandbox_nand_get_time(struct udevice *dev);
+
+/**
+ * sandbox_spi_get_dirmap_reads() - Get the number of direct-mapped reads
+ *
+ * @bus: SPI bus
+ * @return number of reads the bus has served through a direct mapping
+ */
+uint sandbox_spi_get_dirmap_reads(struct udevice *bus);
+
+/**
+ * sandbox_spi_nand_get_time() - Get the virtual clock of an emulated SPI NAND
+ *
+ * @dev: SPI NAND device
+ * @return time in ns spent on the bus and waiting for the chip
+ */
+u64 sandbox_spi_nand_get_time(struct udevice *dev);
+
+/**
+ * sandbox_mmc_get_time() - Get the virtual clock of an emulated eMMC
+ *
+ * @dev: MMC device
+ * @return time in ns spent on the bus and waiting for the device
+ */
+u64 sandbox_mmc_get_time(struct udevice *dev);
+
+/**
+ * sandbox_mmc_get_cqe_tasks() - Get statistics of the command queue engine
+ *
+ * @dev: MMC device
+ * @max_queuedp: returns the largest number of tasks queued at once
+ * @return number of tasks run by the command queue engine
+ */
+uint sandbox_mmc_get_cqe_tasks(struct udevice *dev, uint *max_queuedp);
+
 #endif
@@ -18,11 +18,23 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
+	       "readahead blocks: %u\n"
+	       "writes cached: %u\n"
+	       "writebacks: %u\n"
+	       "blocks written back: %u\n"
 	       "entries: %u\n"
-	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "dirty: %u\n"
+	       "size: 0x%lx\n"
+	       "max blocks/read: %u\n"
+	       "max entries: %u\n"
+	       "max size: 0x%lx\n"
+	       "max readahead: %u\n",
+	       stats.hits, stats.misses, stats.evictions, stats.readahead,
+	       stats.writes, stats.writebacks, stats.written,
+	       stats.entries, stats.dirty, stats.size,
+	       stats.max_blocks_per_entry, stats.max_entries, stats.max_size,
+	       stats.max_readahead);
 	return 0;
 }
 
@@ -35,15 +47,50 @@ static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
+	if (blkcache_configure(blocks_per_entry, max_entries)) {
+		printf("failed to write back the cache\n");
+		return CMD_RET_FAILURE;
+	}
 	printf("changed to max of %u entries of %u blocks each\n",
 	       max_entries, blocks_per_entry);
 	return 0;
 }
 
+static int blkc_size(struct cmd_tbl *cmdtp, int flag,
+		     int argc, char *const argv[])
+{
+	unsigned readahead;
+	ulong max_size;
+	if (argc != 2 && argc != 3)
+		return CMD_RET_USAGE;
+
+	max_size = simple_strtoul(argv[1], 0, 0);
+	readahead = argc == 3 ? simple_strtoul(argv[2], 0, 0) :
+		    CONFIG_BLOCK_CACHE_READAHEAD;
+	if (blkcache_configure_size(max_size, readahead)) {
+		printf("failed to write back the cache\n");
+		return CMD_RET_FAILURE;
+	}
+	printf("changed to max of 0x%lx bytes, readahead of %u blocks\n",
+	       max_size, readahead);
+	return 0;
+}
+
+static int blkc_flush(struct cmd_tbl *cmdtp, int flag,
+		      int argc, char *const argv[])
+{
+	if (blkcache_flush_all()) {
+		printf("failed to write back the cache\n");
+		return CMD_RET_FAILURE;
+	}
+	return 0;
+}
+
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(size, 3, 0, blkc_size, "", ""),
+	U_BOOT_CMD_MKENT(flush, 0, 0, blkc_flush, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,8 +127,14 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
 	"blkcache configure blocks entries\n"
+	"    - cache up to 'entries' reads of up to 'blocks' blocks each,\n"
+	"      0 entries to only limit the size\n"
+	"blkcache size size [readahead]\n"
+	"    - keep up to 'size' bytes of blocks in the cache, and read ahead\n"
+	"      of sequential reads by up to 'readahead' blocks\n"
+	"blkcache flush - write back the blocks kept in the cache\n"
 );
@@ -887,6 +887,40 @@ static int do_mmc_setdsr(struct cmd_tbl *cmdtp, int flag,
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(MMC_STATS)
+static int do_mmc_stats(struct cmd_tbl *cmdtp, int flag,
+			int argc, char *const argv[])
+{
+	struct mmc_stats *stats;
+	struct mmc *mmc;
+
+	if (argc > 2 || (argc == 2 && strcmp(argv[1], "reset")))
+		return CMD_RET_USAGE;
+
+	mmc = find_mmc_device(curr_device);
+	if (!mmc) {
+		printf("no mmc device at slot %x\n", curr_device);
+		return CMD_RET_FAILURE;
+	}
+	stats = &mmc->stats;
+	if (argc == 2) {
+		memset(stats, '\0', sizeof(*stats));
+		return CMD_RET_SUCCESS;
+	}
+
+	printf("Reads:  %lu commands, %lu blocks\n", stats->read_cmds,
+	       stats->read_blocks);
+	printf("Writes: %lu commands, %lu blocks\n", stats->write_cmds,
+	       stats->write_blocks);
+	printf("Multiple-block transfers:\n");
+	printf("  CMD23:      %lu\n", stats->set_block_count);
+	printf("  auto-CMD23: %lu\n", stats->auto_cmd23);
+	printf("  CMD12:      %lu\n", stats->stop_transmission);
+
+	return CMD_RET_SUCCESS;
+}
+#endif
+
 #ifdef CONFIG_CMD_BKOPS_ENABLE
 static int do_mmc_bkops_enable(struct cmd_tbl *cmdtp, int flag,
 			       int argc, char *const argv[])
@@ -960,6 +994,9 @@ static struct cmd_tbl cmd_mmc[] = {
 	U_BOOT_CMD_MKENT(rpmb, CONFIG_SYS_MAXARGS, 1, do_mmcrpmb, "", ""),
 #endif
 	U_BOOT_CMD_MKENT(setdsr, 2, 0, do_mmc_setdsr, "", ""),
+#if CONFIG_IS_ENABLED(MMC_STATS)
+	U_BOOT_CMD_MKENT(stats, 2, 1, do_mmc_stats, "", ""),
+#endif
 #ifdef CONFIG_CMD_BKOPS_ENABLE
 	U_BOOT_CMD_MKENT(bkops-enable, 2, 0, do_mmc_bkops_enable, "", ""),
 #endif
@@ -1034,6 +1071,9 @@ U_BOOT_CMD(
 	"mmc rpmb counter - read the value of the write counter\n"
 #endif
 	"mmc setdsr <value> - set DSR register value\n"
+#if CONFIG_IS_ENABLED(MMC_STATS)
+	"mmc stats [reset] - show or reset the transfer statistics\n"
+#endif
 #ifdef CONFIG_CMD_BKOPS_ENABLE
 	"mmc bkops-enable <dev> - enable background operations handshake on device\n"
 	"   WARNING: This is a write-once setting.\n"
@@ -6,6 +6,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <blk.h>
 #include <bootstage.h>
 #include <cpu_func.h>
 #include <env.h>
@@ -289,12 +290,22 @@ int bootm_find_images(int flag, int argc, char *const argv[])
 static int bootm_find_other(struct cmd_tbl *cmdtp, int flag, int argc,
 			    char *const argv[])
 {
+	int ret;
+
 	if (((images.os.type == IH_TYPE_KERNEL) ||
 	     (images.os.type == IH_TYPE_KERNEL_NOLOAD) ||
 	     (images.os.type == IH_TYPE_MULTI)) &&
 	    (images.os.os == IH_OS_LINUX ||
-		 images.os.os == IH_OS_VXWORKS))
-		return bootm_find_images(flag, argc, argv);
+		 images.os.os == IH_OS_VXWORKS)) {
+		/*
+		 * The ramdisk can be finished on the worker core while the
+		 * OS is loaded, see bootm_wait_ramdisk()
+		 */
+		images.rd_worker = 1;
+		ret = bootm_find_images(flag, argc, argv);
+		images.rd_worker = 0;
+		return ret;
+	}
 
 	return 0;
 }
@@ -341,6 +352,21 @@ static int handle_decomp_error(int comp_type, size_t uncomp_size, int ret)
 #endif
 
 #ifndef USE_HOSTCC
+/*
+ * Collect the ramdisk left to the worker core by bootm_find_other(). This is
+ * done once the OS is loaded, so that the two overlap, or before anything
+ * else might use the ramdisk.
+ */
+static int bootm_wait_ramdisk(void)
+{
+	if (fit_image_load_wait()) {
+		puts("Ramdisk image is corrupt or invalid\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 {
 	image_info_t os = images->os;
@@ -353,18 +379,21 @@ static int bootm_load_os(bootm_headers_t *images, int boot_progress)
 	ulong flush_start = ALIGN_DOWN(load, ARCH_DMA_MINALIGN);
 	bool no_overlap;
 	void *load_buf, *image_buf;
-	int err;
+	int err, rd_err;
 
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
 	err = image_decomp(os.comp, load, os.image_start, os.type,
 			   load_buf, image_buf, image_len,
 			   CONFIG_SYS_BOOTM_LEN, &load_end);
+	rd_err = bootm_wait_ramdisk();
 	if (err) {
 		err = handle_decomp_error(os.comp, load_end - load, err);
 		bootstage_error(BOOTSTAGE_ID_DECOMP_IMAGE);
 		return err;
 	}
+	if (rd_err)
+		return rd_err;
 
 	flush_cache(flush_start, ALIGN(load_end, ARCH_DMA_MINALIGN) - flush_start);
 
@@ -527,7 +556,7 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 {
 	boot_os_fn *boot_fn;
 	ulong iflag = 0;
-	int ret = 0, need_boot_fn;
+	int ret = 0, rd_ret, need_boot_fn;
 
 	images->state |= states;
 
@@ -554,6 +583,17 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 			ret = 0;
 	}
 
+	/*
+	 * Every later state may use the ramdisk. On error, do not leave the
+	 * worker core using it either.
+	 */
+	if (ret || (states & ~(BOOTM_STATE_START | BOOTM_STATE_FINDOS |
+			       BOOTM_STATE_FINDOTHER | BOOTM_STATE_LOADOS))) {
+		rd_ret = bootm_wait_ramdisk();
+		if (!ret)
+			ret = rd_ret;
+	}
+
 	/* Relocate the ramdisk */
 #ifdef CONFIG_SYS_BOOT_RAMDISK_HIGH
 	if (!ret && (states & BOOTM_STATE_RAMDISK)) {
@@ -624,9 +664,13 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 	}
 
 	/* Now run the OS! We hope this doesn't return */
-	if (!ret && (states & BOOTM_STATE_OS_GO))
+	if (!ret && (states & BOOTM_STATE_OS_GO)) {
+		/* Nothing written to the disks may be left behind */
+		if (blkcache_flush_all())
+			log_err("Cannot write back the block cache\n");
 		ret = boot_selected_os(argc, argv, BOOTM_STATE_OS_GO,
 				images, boot_fn);
+	}
 
 	/* Deal with any fallout */
 err:
@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Hash FIT sub-images while the FIT is being loaded
+ *
+ * Loaders (fs_read(), the block layer, TFTP and NFS) report each chunk of
+ * data as it lands in memory. Once the FDT part of a FIT has arrived, a
+ * progressive hash is started for every hash node of every image, and each
+ * one is fed as soon as the data it covers is in memory, while it is still
+ * in the cache. The digests are then handed to fit_image_check_hash() so
+ * that bootm does not need a second pass over the images.
+ *
+ * Chunks outside the load window or beyond what has arrived so far are
+ * ignored; whatever was not reported is hashed when the load completes.
+ * Any data reported over an image drops its digest, but changes made by
+ * other means ('mw', 'cp', ...) are not seen. So nothing is hashed when the
+ * control FDT holds verified-boot keys: the digests would then stand in
+ * for the data that the FIT signatures vouch for.
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <fit_stream.h>
+#include <hash.h>
+#include <image.h>
+#include <log.h>
+#include <watchdog.h>
+#include <linux/libfdt.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define FIT_STREAM_MAX_HASHES	16
+
+/* A hash node being computed */
+struct fit_stream_hash {
+	struct hash_algo *algo;
+	void *ctx;
+	ulong start;		/* offset of the image data in the window */
+	ulong size;
+	ulong done;		/* bytes hashed so far */
+};
+
+/* A digest computed while loading, waiting for fit_image_check_hash() */
+struct fit_stream_result {
+	const void *data;
+	ulong size;
+	struct hash_algo *algo;
+	u8 value[HASH_MAX_DIGEST_SIZE];
+};
+
+static struct {
+	u8 *base;		/* start of the load window, NULL if idle */
+	ulong max_size;
+	ulong landed;		/* bytes present from the start of the window */
+	bool parsed;
+	int count;
+	struct fit_stream_hash hash[FIT_STREAM_MAX_HASHES];
+} stream;
+
+static struct fit_stream_result results[FIT_STREAM_MAX_HASHES];
+static int num_results;
+
+static void fit_stream_stop(void)
+{
+	u8 value[HASH_MAX_DIGEST_SIZE];
+	int i;
+
+	/* hash_finish() is the only way to free a context */
+	for (i = 0; i < stream.count; i++) {
+		struct fit_stream_hash *hash = &stream.hash[i];
+
+		if (hash->ctx)
+			hash->algo->hash_finish(hash->algo, hash->ctx, value,
+						sizeof(value));
+	}
+	stream.count = 0;
+	stream.base = NULL;
+}
+
+static void fit_stream_drop(int i)
+{
+	results[i] = results[--num_results];
+}
+
+/* Drop the digests of images which overlap [start, end) */
+static void fit_stream_drop_range(ulong start, ulong end)
+{
+	int i;
+
+	for (i = num_results - 1; i >= 0; i--) {
+		ulong data = (ulong)results[i].data;
+
+		if (data < end && data + results[i].size > start)
+			fit_stream_drop(i);
+	}
+}
+
+/* Check whether FIT images have to be verified against signatures */
+static bool fit_stream_verified_boot(void)
+{
+	if (!CONFIG_IS_ENABLED(FIT_SIGNATURE) || !gd_fdt_blob())
+		return false;
+
+	return fdt_subnode_offset(gd_fdt_blob(), 0, FIT_SIG_NODENAME) >= 0;
+}
+
+static void fit_stream_add_result(struct fit_stream_hash *hash)
+{
+	struct fit_stream_result *res;
+
+	if (num_results == FIT_STREAM_MAX_HASHES)
+		fit_stream_drop(0);
+	res = &results[num_results];
+	if (hash->algo->hash_finish(hash->algo, hash->ctx, res->value,
+				    sizeof(res->value)))
+		return;
+	res->data = stream.base + hash->start;
+	res->size = hash->size;
+	res->algo = hash->algo;
+	num_results++;
+}
+
+/* Set up a hash for each hash node of @image, return -ENOSPC if full */
+static int fit_stream_add_image(const void *fit, int image)
+{
+	struct fit_stream_hash *hash;
+	const void *data;
+	size_t size;
+	char *name;
+	int noffset;
+
+	if (fit_image_get_data_and_size(fit, image, &data, &size))
+		return 0;
+	if ((u8 *)data < stream.base ||
+	    (u8 *)data - stream.base + size > stream.max_size)
+		return 0;
+
+	fdt_for_each_subnode(noffset, fit, image) {
+		name = (char *)fit_get_name(fit, noffset, NULL);
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &name))
+			continue;
+		/* crc32 is stored big-endian, unlike the hash_algo output */
+		if (strncmp(name, "sha", 3))
+			continue;
+		if (stream.count == FIT_STREAM_MAX_HASHES)
+			return -ENOSPC;
+
+		hash = &stream.hash[stream.count];
+		if (hash_lookup_algo(name, &hash->algo) ||
+		    hash->algo->hash_init(hash->algo, &hash->ctx))
+			continue;
+		hash->start = (u8 *)data - stream.base;
+		hash->size = size;
+		hash->done = 0;
+		stream.count++;
+	}
+
+	return 0;
+}
+
+/*
+ * Look for a FIT at the start of the window. Return true if there is
+ * something to hash, false if not or if more data is needed first.
+ */
+static bool fit_stream_parse(void)
+{
+	const void *fit = stream.base;
+	int images, noffset;
+
+	if (stream.landed < sizeof(struct fdt_header))
+		return false;
+	if (fdt_magic(fit) != FDT_MAGIC ||
+	    fdt_totalsize(fit) > stream.max_size) {
+		fit_stream_stop();
+		return false;
+	}
+	if (stream.landed < fdt_totalsize(fit))
+		return false;
+
+	stream.parsed = true;
+	images = fdt_check_header(fit) ? -1 :
+		 fdt_path_offset(fit, FIT_IMAGES_PATH);
+	if (images >= 0) {
+		fdt_for_each_subnode(noffset, fit, images) {
+			if (fit_stream_add_image(fit, noffset))
+				break;
+		}
+	}
+	if (!stream.count) {
+		fit_stream_stop();
+		return false;
+	}
+	debug("%s: hashing %d image(s) while loading\n", __func__,
+	      stream.count);
+
+	return true;
+}
+
+/* Feed everything that has arrived to the hashes waiting for it */
+static void fit_stream_feed(void)
+{
+	int i;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_HASH, "hash");
+	for (i = 0; i < stream.count; i++) {
+		struct fit_stream_hash *hash = &stream.hash[i];
+		ulong end = min(hash->start + hash->size, stream.landed);
+
+		while (hash->ctx && hash->start + hash->done < end) {
+			ulong len = min(end - hash->start - hash->done,
+					(ulong)hash->algo->chunk_size);
+			bool last = hash->done + len == hash->size;
+
+			if (hash->algo->hash_update(hash->algo, hash->ctx,
+						    stream.base + hash->start +
+						    hash->done, len, last)) {
+				/* the context is gone, bootm will hash it */
+				hash->ctx = NULL;
+				break;
+			}
+			hash->done += len;
+			if (last) {
+				fit_stream_add_result(hash);
+				hash->ctx = NULL;
+			}
+			WATCHDOG_RESET();
+		}
+	}
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_HASH);
+}
+
+static void fit_stream_advance(ulong landed)
+{
+	stream.landed = landed;
+	if (!stream.parsed && !fit_stream_parse())
+		return;
+	fit_stream_feed();
+}
+
+void fit_stream_begin(void *buf, ulong max_size)
+{
+	fit_stream_stop();
+	if (!max_size)
+		max_size = ULONG_MAX - (ulong)buf;
+
+	/* The new load may overwrite images hashed earlier */
+	fit_stream_drop_range((ulong)buf, (ulong)buf + max_size);
+	if (fit_stream_verified_boot())
+		return;
+
+	stream.base = buf;
+	stream.max_size = max_size;
+	stream.landed = 0;
+	stream.parsed = false;
+}
+
+void fit_stream_data(const void *buf, ulong len)
+{
+	ulong off, end;
+
+	/* The images the data lands on are not what was hashed any more */
+	if (num_results)
+		fit_stream_drop_range((ulong)buf, (ulong)buf + len);
+	if (!stream.base || (u8 *)buf < stream.base)
+		return;
+	off = (u8 *)buf - stream.base;
+	if (off > stream.landed || off + len > stream.max_size)
+		return;
+	end = off + len;
+	if (end > stream.landed)
+		fit_stream_advance(end);
+}
+
+void fit_stream_end(ulong size)
+{
+	if (!stream.base)
+		return;
+	if (size > stream.max_size)
+		size = stream.max_size;
+	if (size > stream.landed)
+		fit_stream_advance(size);
+	/* Images that did not fit in the load are left to bootm */
+	fit_stream_stop();
+}
+
+void fit_stream_abort(void)
+{
+	fit_stream_stop();
+}
+
+int fit_stream_get_hash(const void *data, ulong size, const char *algo,
+			uint8_t *value, int *value_len)
+{
+	int i;
+
+	for (i = 0; i < num_results; i++) {
+		struct fit_stream_result *res = &results[i];
+
+		if (res->data != data || res->size != size ||
+		    strcmp(res->algo->name, algo))
+			continue;
+		memcpy(value, res->value, res->algo->digest_size);
+		*value_len = res->algo->digest_size;
+		fit_stream_drop(i);
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
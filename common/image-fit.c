@@ -22,12 +22,14 @@
 #include <mapmem.h>
 #include <asm/io.h>
 #include <malloc.h>
+#include <worker.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
 
 #include <bootm.h>
 #include <image.h>
 #include <bootstage.h>
+#include <fit_stream.h>
 #include <u-boot/crc.h>
 #include <u-boot/md5.h>
 #include <u-boot/sha1.h>
@@ -1193,6 +1195,19 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
+#if !defined(USE_HOSTCC) && defined(CONFIG_SHA_HW_ACCEL) && \
+	((!defined(CONFIG_SPL_BUILD) && defined(CONFIG_HASH)) || \
+	 (defined(CONFIG_SPL_BUILD) && defined(CONFIG_SPL_HASH_SUPPORT)))
+	struct hash_algo *hash;
+
+	/* Let the hash layer pick the accelerated SHA implementation */
+	if (!strncmp(algo, "sha", 3) && !hash_lookup_algo(algo, &hash)) {
+		hash->hash_func_ws(data, data_len, value, hash->chunk_size);
+		*value_len = hash->digest_size;
+		return 0;
+	}
+#endif
+
 	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
 		*((uint32_t *)value) = crc32_wd(0, data, data_len,
 							CHUNKSZ_CRC32);
@@ -1216,15 +1231,39 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/* Compare a digest with the value of hash node @noffset */
+static int fit_image_hash_compare(const void *fit, int noffset,
+				  const uint8_t *value, int value_len,
+				  char **err_msgp)
+{
+	uint8_t *fit_value;
+	int fit_value_len;
+
+	if (fit_image_hash_get_value(fit, noffset, &fit_value,
+				     &fit_value_len)) {
+		*err_msgp = "Can't get hash value property";
+		return -1;
+	}
+
+	if (value_len != fit_value_len) {
+		*err_msgp = "Bad hash value len";
+		return -1;
+	} else if (memcmp(value, fit_value, value_len) != 0) {
+		*err_msgp = "Bad hash value";
+		return -1;
+	}
+
+	return 0;
+}
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
 	uint8_t value[FIT_MAX_HASH_LEN];
 	int value_len;
 	char *algo;
-	uint8_t *fit_value;
-	int fit_value_len;
 	int ignore;
+	int ret;
 
 	*err_msgp = NULL;
 
@@ -1242,26 +1281,19 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		}
 	}
 
-	if (fit_image_hash_get_value(fit, noffset, &fit_value,
-				     &fit_value_len)) {
-		*err_msgp = "Can't get hash value property";
-		return -1;
-	}
-
-	if (calculate_hash(data, size, algo, value, &value_len)) {
-		*err_msgp = "Unsupported hash algorithm";
-		return -1;
-	}
-
-	if (value_len != fit_value_len) {
-		*err_msgp = "Bad hash value len";
-		return -1;
-	} else if (memcmp(value, fit_value, value_len) != 0) {
-		*err_msgp = "Bad hash value";
-		return -1;
+	/* The image may have been hashed already while it was loaded */
+	if (fit_stream_get_hash(data, size, algo, value, &value_len)) {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_HASH, "hash");
+		ret = calculate_hash(data, size, algo, value, &value_len);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_HASH);
+		if (ret) {
+			*err_msgp = "Unsupported hash algorithm";
+			return -1;
+		}
 	}
 
-	return 0;
+	return fit_image_hash_compare(fit, noffset, value, value_len,
+				      err_msgp);
 }
 
 int fit_image_verify_with_data(const void *fit, int image_noffset,
@@ -1793,17 +1825,256 @@ int fit_conf_get_prop_node(const void *fit, int noffset,
 	return fit_conf_get_prop_node_index(fit, noffset, prop_name, 0);
 }
 
-static int fit_image_select(const void *fit, int rd_noffset, int verify)
+#if CONFIG_IS_ENABLED(CPU_WORKER) && !defined(USE_HOSTCC)
+/* Most hash nodes of an image which are checked on the worker core */
+#define FIT_WORKER_HASHES	2
+
+/*
+ * A ramdisk which is being checked and copied to its load address on the
+ * worker core while bootm loads the OS, see fit_image_load_wait()
+ */
+static struct {
+	const void *fit;
+	int image_noffset;
+	struct worker_hash_job hash[FIT_WORKER_HASHES];
+	int hash_noffset[FIT_WORKER_HASHES];
+	int hash_count;
+	struct worker_decomp_job copy;
+	bool copying;
+	bool queued;		/* jobs submitted and not waited for yet */
+} fit_worker;
+
+/*
+ * Wait for all the jobs, which use the image data, and return the result of
+ * the copy
+ */
+static int fit_image_worker_finish(void)
+{
+	int ret = 0;
+	int i;
+
+	fit_worker.queued = false;
+	if (fit_worker.copying)
+		ret = worker_wait(&fit_worker.copy.job);
+	for (i = 0; i < fit_worker.hash_count; i++)
+		worker_wait(&fit_worker.hash[i].job);
+
+	return ret;
+}
+
+/* Decide whether the image being loaded is left to the worker core */
+static bool fit_image_worker_begin(bootm_headers_t *images, const void *fit,
+				   int image_noffset, int image_type)
+{
+	/* Decryption and post-processing change the data after the check */
+	if (!images->rd_worker || image_type != IH_TYPE_RAMDISK ||
+	    IS_ENABLED(CONFIG_FIT_CIPHER) ||
+	    IS_ENABLED(CONFIG_FIT_IMAGE_POST_PROCESS))
+		return false;
+
+	/* Nothing should be left from an earlier load, but be sure */
+	fit_image_load_wait();
+	fit_worker.fit = fit;
+	fit_worker.image_noffset = image_noffset;
+	fit_worker.hash_count = 0;
+	fit_worker.copying = false;
+
+	return true;
+}
+
+/*
+ * Set up @hj to check hash node @noffset on the worker core. Returns false if
+ * the node is left to fit_image_check_hash(), e.g. because it is ignored or
+ * uses an algorithm which the worker does not have.
+ */
+static bool fit_image_hash_to_worker(const void *fit, int noffset,
+				     const void *data, size_t size,
+				     struct worker_hash_job *hj)
+{
+	char *algo;
+	int ignore;
+
+	if (fit_image_hash_get_algo(fit, noffset, &algo))
+		return false;
+	if (IMAGE_ENABLE_IGNORE &&
+	    !fit_image_hash_get_ignore(fit, noffset, &ignore) && ignore)
+		return false;
+
+	/* A digest computed while the image was loaded needs no work */
+	if (!fit_stream_get_hash(data, size, algo, hj->value,
+				 &hj->value_len)) {
+		hj->job.ret = 0;
+		hj->job.done = 1;
+		return true;
+	}
+	if (worker_hash_init(hj, algo, data, size))
+		return false;
+	worker_submit(&hj->job);
+
+	return true;
+}
+
+/*
+ * Start verifying an image, handing its SHA hash nodes to the worker core
+ * and checking any others here. Returns 1 if some hashes are left to
+ * fit_image_load_wait(), 0 if all are good, -EAGAIN if the image must be
+ * checked with fit_image_verify() instead or -EACCES if it is bad.
+ */
+static int fit_image_verify_start(const void *fit, int image_noffset)
+{
+	struct worker_hash_job *hj;
+	char *err_msg = "";
+	const void *data;
+	int noffset = 0;
+	int verify_all;
+	size_t size;
+
+	if (fit_image_get_data_and_size(fit, image_noffset, &data, &size))
+		return -EAGAIN;
+
+	/* Checking a signature hashes the data here anyway */
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		if (!strncmp(fit_get_name(fit, noffset, NULL),
+			     FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME)))
+			return -EAGAIN;
+	}
+
+	/* With no signature nodes, this only fails if one is required */
+	noffset = 0;
+	if (FIT_IMAGE_ENABLE_VERIFY &&
+	    fit_image_verify_required_sigs(fit, image_noffset, data, size,
+					   gd_fdt_blob(), &verify_all)) {
+		err_msg = "Unable to verify required signature";
+		goto error;
+	}
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		if (strncmp(fit_get_name(fit, noffset, NULL),
+			    FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		hj = &fit_worker.hash[fit_worker.hash_count];
+		if (fit_worker.hash_count < FIT_WORKER_HASHES &&
+		    fit_image_hash_to_worker(fit, noffset, data, size, hj)) {
+			fit_worker.hash_noffset[fit_worker.hash_count++] =
+				noffset;
+			fit_worker.queued = true;
+			continue;
+		}
+		if (fit_image_check_hash(fit, noffset, data, size, &err_msg))
+			goto error;
+		puts("+ ");
+	}
+
+	if (noffset == -FDT_ERR_TRUNCATED || noffset == -FDT_ERR_BADSTRUCTURE) {
+		err_msg = "Corrupted or truncated tree";
+		goto error;
+	}
+
+	return fit_worker.hash_count ? 1 : 0;
+
+error:
+	fit_image_worker_finish();
+	printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+	       err_msg, fit_get_name(fit, noffset, NULL),
+	       fit_get_name(fit, image_noffset, NULL));
+	return -EACCES;
+}
+
+/* Copy the image data to its load address on the worker core */
+static void fit_image_copy_start(void *dst, const void *src, ulong len)
+{
+	worker_decomp_init(&fit_worker.copy, IH_COMP_NONE, dst, len, src, len);
+	worker_submit(&fit_worker.copy.job);
+	fit_worker.copying = true;
+	fit_worker.queued = true;
+}
+
+int fit_image_load_wait(void)
+{
+	const void *fit = fit_worker.fit;
+	struct worker_hash_job *hj;
+	char *err_msg = "";
+	int noffset = 0;
+	char *algo;
+	int ret;
+	int i;
+
+	if (!fit_worker.queued)
+		return 0;
+
+	ret = fit_image_worker_finish();
+	if (ret) {
+		printf("Cannot load '%s' (err=%d)\n",
+		       fit_get_name(fit, fit_worker.image_noffset, NULL), ret);
+		return ret;
+	}
+	if (!fit_worker.hash_count)
+		return 0;
+
+	printf("   Verifying Hash Integrity of '%s' ... ",
+	       fit_get_name(fit, fit_worker.image_noffset, NULL));
+	for (i = 0; i < fit_worker.hash_count; i++) {
+		hj = &fit_worker.hash[i];
+		noffset = fit_worker.hash_noffset[i];
+		fit_image_hash_get_algo(fit, noffset, &algo);
+		printf("%s", algo);
+		if (hj->job.ret) {
+			err_msg = "Unsupported hash algorithm";
+			goto error;
+		}
+		if (fit_image_hash_compare(fit, noffset, hj->value,
+					   hj->value_len, &err_msg))
+			goto error;
+		puts("+ ");
+	}
+	puts("OK\n");
+
+	return 0;
+
+error:
+	printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+	       err_msg, fit_get_name(fit, noffset, NULL),
+	       fit_get_name(fit, fit_worker.image_noffset, NULL));
+	puts("Bad Data Hash\n");
+	return -EACCES;
+}
+#else
+static inline bool fit_image_worker_begin(bootm_headers_t *images,
+					  const void *fit, int image_noffset,
+					  int image_type)
+{
+	return false;
+}
+
+static inline int fit_image_verify_start(const void *fit, int image_noffset)
+{
+	return -EAGAIN;
+}
+
+static inline void fit_image_copy_start(void *dst, const void *src,
+					ulong len)
+{
+}
+#endif /* CPU_WORKER */
+
+static int fit_image_select(const void *fit, int rd_noffset, int verify,
+			    bool worker)
 {
+	int ret;
+
 	fit_image_print(fit, rd_noffset, "   ");
 
 	if (verify) {
 		puts("   Verifying Hash Integrity ... ");
-		if (!fit_image_verify(fit, rd_noffset)) {
+		ret = worker ? fit_image_verify_start(fit, rd_noffset) :
+			       -EAGAIN;
+		if (ret == -EAGAIN)
+			ret = fit_image_verify(fit, rd_noffset) ? 0 : -EACCES;
+		if (ret < 0) {
 			puts("Bad Data Hash\n");
 			return -EACCES;
 		}
-		puts("OK\n");
+		puts(ret ? "pending\n" : "OK\n");
 	}
 
 	return 0;
@@ -1889,6 +2160,7 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	uint8_t os_arch;
 #endif
 	const char *prop_name;
+	bool worker;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -1960,7 +2232,9 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/* A ramdisk can be checked and copied while bootm loads the OS */
+	worker = fit_image_worker_begin(images, fit, noffset, image_type);
+	ret = fit_image_select(fit, noffset, images->verify, worker);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -2098,7 +2372,10 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		len = load_end - load;
 	} else if (load != data) {
 		loadbuf = map_sysmem(load, len);
-		memcpy(loadbuf, buf, len);
+		if (worker)
+			fit_image_copy_start(loadbuf, buf, len);
+		else
+			memcpy(loadbuf, buf, len);
 	}
 
 	if (image_type == IH_TYPE_RAMDISK && comp != IH_COMP_NONE)
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Run self-contained jobs on a secondary CPU core
+ *
+ * Jobs are passed to the worker through a single-producer, single-consumer
+ * ring: only the CPU running U-Boot adds jobs and only the worker takes them,
+ * so no lock is needed. Each side owns one index and publishes it with a
+ * release store after the slot it covers has been written or read.
+ */
+
+#include <common.h>
+#include <image.h>
+#include <log.h>
+#include <lz4.h>
+#include <worker.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+
+#define WORKER_MBOX_SIZE	8	/* must be a power of two */
+
+static struct {
+	struct worker_job *slot[WORKER_MBOX_SIZE];
+	u32 head;		/* next slot to fill, written by U-Boot */
+	u32 tail;		/* next slot to run, written by the worker */
+	u32 stop;		/* set by U-Boot to make the worker return */
+	u32 running;		/* cleared by the worker when it returns */
+} mbox;
+
+static bool started;
+
+static inline u32 load_acquire(u32 *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(u32 *p, u32 val)
+{
+	__atomic_store_n(p, val, __ATOMIC_RELEASE);
+}
+
+static void worker_run(struct worker_job *job)
+{
+	job->ret = job->run(job);
+	store_release(&job->done, 1);
+}
+
+void worker_main(void)
+{
+	u32 tail = mbox.tail;
+
+	while (1) {
+		if (tail == load_acquire(&mbox.head)) {
+			if (load_acquire(&mbox.stop))
+				break;
+			worker_arch_wait();
+			continue;
+		}
+		worker_run(mbox.slot[tail % WORKER_MBOX_SIZE]);
+		store_release(&mbox.tail, ++tail);
+		/* U-Boot may be waiting for this job */
+		worker_arch_kick();
+	}
+	store_release(&mbox.running, 0);
+	worker_arch_kick();
+}
+
+static bool worker_start(void)
+{
+	int ret;
+
+	if (started)
+		return true;
+	mbox.stop = 0;
+	mbox.running = 1;
+	ret = worker_arch_start();
+	if (ret) {
+		debug("%s: cannot start worker (err=%d)\n", __func__, ret);
+		return false;
+	}
+	started = true;
+
+	return true;
+}
+
+void worker_submit(struct worker_job *job)
+{
+	u32 head = mbox.head;
+
+	job->done = 0;
+	if (!worker_start() ||
+	    head - load_acquire(&mbox.tail) == WORKER_MBOX_SIZE) {
+		worker_run(job);
+		return;
+	}
+	mbox.slot[head % WORKER_MBOX_SIZE] = job;
+	store_release(&mbox.head, head + 1);
+	worker_arch_kick();
+}
+
+int worker_wait(struct worker_job *job)
+{
+	while (!load_acquire(&job->done))
+		worker_arch_wait();
+
+	return job->ret;
+}
+
+void worker_stop(void)
+{
+	if (!started)
+		return;
+	store_release(&mbox.stop, 1);
+	worker_arch_kick();
+	while (load_acquire(&mbox.running))
+		worker_arch_wait();
+	worker_arch_stop();
+	started = false;
+}
+
+enum {
+	WORKER_HASH_SHA1,
+	WORKER_HASH_SHA256,
+	WORKER_HASH_SHA512,
+};
+
+/*
+ * The hash is done in one go with the software functions: the hash_algo
+ * wrappers may use a crypto driver or reset the watchdog
+ */
+static int worker_hash_run(struct worker_job *job)
+{
+	struct worker_hash_job *hj = container_of(job, struct worker_hash_job,
+						  job);
+	union {
+		sha1_context sha1;
+		sha256_context sha256;
+#ifdef CONFIG_SHA512
+		sha512_context sha512;
+#endif
+	} ctx;
+	const u8 *buf = hj->buf;
+	ulong left, len;
+
+	switch (hj->algo) {
+	case WORKER_HASH_SHA1:
+		sha1_starts(&ctx.sha1);
+		break;
+	case WORKER_HASH_SHA256:
+		sha256_starts(&ctx.sha256);
+		break;
+#ifdef CONFIG_SHA512
+	case WORKER_HASH_SHA512:
+		sha512_starts(&ctx.sha512);
+		break;
+#endif
+	default:
+		return -EPROTONOSUPPORT;
+	}
+
+	/* The update functions take a 32-bit length */
+	for (left = hj->len; left; left -= len, buf += len) {
+		len = min(left, (ulong)SZ_1G);
+		switch (hj->algo) {
+		case WORKER_HASH_SHA1:
+			sha1_update(&ctx.sha1, buf, len);
+			break;
+		case WORKER_HASH_SHA256:
+			sha256_update(&ctx.sha256, buf, len);
+			break;
+#ifdef CONFIG_SHA512
+		case WORKER_HASH_SHA512:
+			sha512_update(&ctx.sha512, buf, len);
+			break;
+#endif
+		}
+	}
+
+	switch (hj->algo) {
+	case WORKER_HASH_SHA1:
+		sha1_finish(&ctx.sha1, hj->value);
+		break;
+	case WORKER_HASH_SHA256:
+		sha256_finish(&ctx.sha256, hj->value);
+		break;
+#ifdef CONFIG_SHA512
+	case WORKER_HASH_SHA512:
+		sha512_finish(&ctx.sha512, hj->value);
+		break;
+#endif
+	}
+
+	return 0;
+}
+
+int worker_hash_init(struct worker_hash_job *hj, const char *algo_name,
+		     const void *buf, ulong len)
+{
+	if (CONFIG_IS_ENABLED(SHA1) && !strcmp(algo_name, "sha1")) {
+		hj->algo = WORKER_HASH_SHA1;
+		hj->value_len = SHA1_SUM_LEN;
+	} else if (CONFIG_IS_ENABLED(SHA256) && !strcmp(algo_name, "sha256")) {
+		hj->algo = WORKER_HASH_SHA256;
+		hj->value_len = SHA256_SUM_LEN;
+#ifdef CONFIG_SHA512
+	} else if (!strcmp(algo_name, "sha512")) {
+		hj->algo = WORKER_HASH_SHA512;
+		hj->value_len = SHA512_SUM_LEN;
+#endif
+	} else {
+		return -EPROTONOSUPPORT;
+	}
+	hj->job.run = worker_hash_run;
+	hj->buf = buf;
+	hj->len = len;
+
+	return 0;
+}
+
+static int worker_decomp_run(struct worker_job *job)
+{
+	struct worker_decomp_job *dj = container_of(job,
+						    struct worker_decomp_job,
+						    job);
+	size_t size = dj->unc_len;
+
+	switch (dj->comp) {
+	case IH_COMP_NONE:
+		if (dj->len > dj->unc_len)
+			return -ENOBUFS;
+		memmove(dj->load, dj->buf, dj->len);
+		dj->load_len = dj->len;
+		return 0;
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4: {
+		int ret;
+
+		ret = ulz4fn(dj->buf, dj->len, dj->load, &size);
+		dj->load_len = size;
+		return ret;
+	}
+#endif
+	default:
+		return -ENOSYS;
+	}
+}
+
+int worker_decomp_init(struct worker_decomp_job *dj, int comp, void *load,
+		       ulong unc_len, const void *buf, ulong len)
+{
+	switch (comp) {
+	case IH_COMP_NONE:
+#ifdef CONFIG_LZ4
+	case IH_COMP_LZ4:
+#endif
+		break;
+	default:
+		return -ENOSYS;
+	}
+	dj->job.run = worker_decomp_run;
+	dj->comp = comp;
+	dj->buf = buf;
+	dj->len = len;
+	dj->load = load;
+	dj->unc_len = unc_len;
+	dj->load_len = 0;
+
+	return 0;
+}
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <fit_stream.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
@@ -430,23 +431,115 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/*
+ * Read @blkcnt blocks and up to @ra more after them into a bounce buffer,
+ * caching them all. Returns 0 if @buffer was filled, -ve otherwise.
+ */
+static int blk_dread_ahead(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt, lbaint_t ra, void *buffer)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_read;
+	void *bounce;
+
+	if (start + blkcnt > block_dev->lba)
+		return -EINVAL;
+	ra = min(ra, block_dev->lba - start - blkcnt);
+	if (!ra)
+		return -EINVAL;
+
+	bounce = malloc((blkcnt + ra) * block_dev->blksz);
+	if (!bounce)
+		return -ENOMEM;
+	blks_read = ops->read(dev, start, blkcnt + ra, bounce);
+	if (blks_read != blkcnt + ra) {
+		free(bounce);
+		return -EIO;
+	}
+	blkcache_fill(block_dev->if_type, block_dev->devnum, start,
+		      blkcnt + ra, block_dev->blksz, bounce);
+	memcpy(buffer, bounce, blkcnt * block_dev->blksz);
+	free(bounce);
+
+	return 0;
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
 	ulong blks_read;
+	lbaint_t ra;
 
 	if (!ops->read)
 		return -ENOSYS;
 
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
+			  start, blkcnt, block_dev->blksz, buffer)) {
+		fit_stream_data(buffer, blkcnt * block_dev->blksz);
 		return blkcnt;
+	}
+	ra = blkcache_readahead(block_dev->if_type, block_dev->devnum);
+	if (ra && !blk_dread_ahead(block_dev, start, blkcnt, ra, buffer)) {
+		fit_stream_data(buffer, blkcnt * block_dev->blksz);
+		return blkcnt;
+	}
+
 	blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
+	if (IS_ERR_VALUE(blks_read))
+		return blks_read;
+	fit_stream_data(buffer, blks_read * block_dev->blksz);
+
+	return blks_read;
+}
+
+unsigned long blk_dread_sg(struct blk_desc *block_dev, lbaint_t start,
+			   const struct blk_sg *sg, uint count)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_read, total = 0;
+	uint i;
+	int ret;
+
+	if (!ops->read_sg) {
+		for (i = 0; i < count; i++) {
+			blks_read = blk_dread(block_dev, start, sg[i].blkcnt,
+					      sg[i].buf);
+			if (IS_ERR_VALUE(blks_read))
+				return blks_read;
+			total += blks_read;
+			if (blks_read != sg[i].blkcnt)
+				break;
+			start += blks_read;
+		}
+
+		return total;
+	}
+
+	/* The driver reads the device itself, so write back what it would miss */
+	for (i = 0; i < count; i++)
+		total += sg[i].blkcnt;
+	ret = blkcache_flush_range(block_dev->if_type, block_dev->devnum,
+				   start, total);
+	if (ret)
+		return ret;
+
+	blks_read = ops->read_sg(dev, start, sg, count);
+	if (IS_ERR_VALUE(blks_read))
+		return blks_read;
+
+	for (i = 0, total = 0; i < count && total < blks_read; i++) {
+		fit_stream_data(sg[i].buf,
+				min_t(lbaint_t, sg[i].blkcnt, blks_read - total) *
+				block_dev->blksz);
+		total += sg[i].blkcnt;
+	}
 
 	return blks_read;
 }
@@ -456,10 +549,20 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->write)
 		return -ENOSYS;
 
+	ret = blkcache_write(block_dev->if_type, block_dev->devnum, start,
+			     blkcnt, block_dev->blksz, buffer);
+	if (ret)
+		return ret < 0 ? ret : blkcnt;
+
+	/* Older data kept in the cache must not overwrite these blocks later */
+	ret = blkcache_flush(block_dev->if_type, block_dev->devnum);
+	if (ret)
+		return ret;
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
 	return ops->write(dev, start, blkcnt, buffer);
 }
@@ -469,10 +572,14 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 {
 	struct udevice *dev = block_dev->bdev;
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops->erase)
 		return -ENOSYS;
 
+	ret = blkcache_flush(block_dev->if_type, block_dev->devnum);
+	if (ret)
+		return ret;
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
 	return ops->erase(dev, start, blkcnt);
 }
@@ -3,23 +3,61 @@
  * Copyright (C) Nelson Integration, LLC 2016
  * Author: Eric Nelson<eric@nelint.com>
  *
+ * Blocks are cached one by one in a hash table, and dropped in LRU order
+ * once the memory budget of the cache is used up. Small reads which follow
+ * on from an earlier one are tracked as streams, so that a filesystem
+ * walking an inode table while it keeps going back to the same group
+ * descriptor is still seen to read sequentially. A miss in a stream asks
+ * the device to read ahead by a window which grows with the stream.
+ *
+ * With CONFIG_BLOCK_CACHE_WRITEBACK, small writes to the device which a
+ * filesystem is open on are kept as dirty blocks and written back later,
+ * with adjacent blocks merged into one write. Writes made outside of such a
+ * session, by 'mmc write', saveenv or a USB gadget, go straight to the device.
+ * Filesystems mark the points their writes must not be reordered across
+ * with blkcache_barrier(): each barrier starts a new epoch, and the epochs
+ * reach the disk one after the other.
  */
 #include <common.h>
 #include <blk.h>
+#include <dm.h>
 #include <log.h>
 #include <malloc.h>
 #include <part.h>
+#include <sort.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/log2.h>
+
+#define BLKCACHE_MIN_BUCKETS	64
+#define BLKCACHE_MIN_READAHEAD	8
+#define BLKCACHE_STREAMS	8
 
 struct block_cache_node {
+	struct hlist_node hn;
 	struct list_head lh;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
+	lbaint_t blknr;
 	unsigned long blksz;
-	char *cache;
+	bool dirty;
+	ulong epoch;
+	char cache[];
+};
+
+/**
+ * struct block_cache_stream - Sequential reads of a device
+ *
+ * @iftype:	IF_TYPE_x of the device
+ * @devnum:	device number, -1 if the slot is unused
+ * @next:	block following the last read of the stream
+ * @window:	blocks read ahead on the last miss of the stream
+ */
+struct block_cache_stream {
+	int iftype;
+	int devnum;
+	lbaint_t next;
+	lbaint_t window;
 };
 
 #ifndef CONFIG_M68K
@@ -28,9 +66,25 @@ static LIST_HEAD(block_cache);
 static struct list_head block_cache;
 #endif
 
+static struct hlist_head *block_cache_hash;
+static uint block_cache_buckets;
+
+static struct block_cache_stream streams[BLKCACHE_STREAMS] = {
+	[0 ... BLKCACHE_STREAMS - 1] = { .devnum = -1 },
+};
+static uint stream_victim;
+/* stream of the last miss, whose window is to be read ahead */
+static struct block_cache_stream *last_miss;
+/* epoch of the blocks written now, bumped by each barrier */
+static ulong cache_epoch;
+/* device whose small writes are kept in the cache, -1 if none */
+static int writeback_iftype;
+static int writeback_devnum = -1;
+
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_size = CONFIG_BLOCK_CACHE_SIZE,
+	.max_readahead = CONFIG_BLOCK_CACHE_READAHEAD,
 };
 
 #ifdef CONFIG_M68K
@@ -42,145 +96,569 @@ int blkcache_init(void)
 }
 #endif
 
+static ulong node_size(unsigned long blksz)
+{
+	return sizeof(struct block_cache_node) + blksz;
+}
+
+/* Most bytes the cache may hold in blocks of @blksz */
+static ulong cache_limit(unsigned long blksz)
+{
+	ulong limit = _stats.max_size;
+
+	if (_stats.max_entries)
+		limit = min(limit, (ulong)_stats.max_entries *
+			    _stats.max_blocks_per_entry * node_size(blksz));
+
+	return limit;
+}
+
+static struct hlist_head *cache_bucket(int iftype, int devnum, lbaint_t blknr)
+{
+	u32 key = (u32)blknr ^ (u32)((u64)blknr >> 32) ^ devnum << 20 ^
+		  iftype << 26;
+
+	/* Fibonacci hashing spreads runs of blocks over the buckets */
+	return &block_cache_hash[(key * 0x9e3779b9) >>
+				 (32 - ilog2(block_cache_buckets))];
+}
+
 static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+					   lbaint_t blknr)
 {
 	struct block_cache_node *node;
+	struct hlist_node *pos;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
-			if (block_cache.next != &node->lh) {
-				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
-			}
+	hlist_for_each_entry(node, pos, cache_bucket(iftype, devnum, blknr), hn)
+		if (node->blknr == blknr && node->devnum == devnum &&
+		    node->iftype == iftype)
 			return node;
-		}
+
+	return NULL;
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	if (node->dirty) {
+		log_err("Dropping unwritten block " LBAF "\n", node->blknr);
+		_stats.dirty--;
+	}
+	hlist_del(&node->hn);
+	list_del(&node->lh);
+	_stats.entries--;
+	_stats.size -= node_size(node->blksz);
+	free(node);
+}
+
+static void cache_drop_all(void)
+{
+	while (!list_empty(&block_cache))
+		cache_drop(list_first_entry(&block_cache,
+					    struct block_cache_node, lh));
+}
+
+/* Allocate the hash table the first time it is needed */
+static int cache_setup(unsigned long blksz)
+{
+	ulong buckets;
+	uint i;
+
+	if (block_cache_hash)
+		return 0;
+
+	buckets = max_t(ulong, cache_limit(blksz) / node_size(blksz),
+			BLKCACHE_MIN_BUCKETS);
+	buckets = roundup_pow_of_two(buckets);
+	block_cache_hash = malloc(buckets * sizeof(*block_cache_hash));
+	if (!block_cache_hash)
+		return -ENOMEM;
+	for (i = 0; i < buckets; i++)
+		INIT_HLIST_HEAD(&block_cache_hash[i]);
+	block_cache_buckets = buckets;
+
+	return 0;
+}
+
+static int cache_compare(const void *a, const void *b)
+{
+	const struct block_cache_node *na = *(struct block_cache_node **)a;
+	const struct block_cache_node *nb = *(struct block_cache_node **)b;
+
+	if (na->epoch != nb->epoch)
+		return na->epoch < nb->epoch ? -1 : 1;
+	if (na->blknr != nb->blknr)
+		return na->blknr < nb->blknr ? -1 : 1;
+
 	return 0;
 }
 
+/* Write a run of adjacent dirty blocks to their device */
+static int cache_write_back(struct block_cache_node **run, uint count)
+{
+	struct block_cache_node *node = run[0];
+	unsigned long blksz = node->blksz;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	ulong written;
+	char *buf;
+	uint i;
+
+	desc = blk_get_devnum_by_type(node->iftype, node->devnum);
+	if (!desc)
+		return -ENODEV;
+	dev = desc->bdev;
+
+	buf = node->cache;
+	if (count > 1) {
+		buf = malloc(count * blksz);
+		if (!buf)
+			return -ENOMEM;
+		for (i = 0; i < count; i++)
+			memcpy(buf + i * blksz, run[i]->cache, blksz);
+	}
+
+	debug("write back: start " LBAF ", count %u\n", node->blknr, count);
+	written = blk_get_ops(dev)->write(dev, node->blknr, count, buf);
+	if (count > 1)
+		free(buf);
+	if (written != count)
+		return -EIO;
+
+	for (i = 0; i < count; i++)
+		run[i]->dirty = false;
+	_stats.dirty -= count;
+	_stats.writebacks++;
+	_stats.written += count;
+
+	return 0;
+}
+
+/*
+ * Write back the dirty blocks of a device which were written before @epoch,
+ * an epoch after the other, merging adjacent blocks within each epoch
+ */
+static int cache_flush(int iftype, int devnum, ulong epoch)
+{
+	struct block_cache_node **dirty, *node;
+	uint count = 0, i, run;
+	int ret = 0;
+
+	if (!_stats.dirty)
+		return 0;
+
+	dirty = malloc(_stats.dirty * sizeof(*dirty));
+	if (!dirty)
+		return -ENOMEM;
+	list_for_each_entry(node, &block_cache, lh) {
+		if (node->dirty && node->epoch < epoch &&
+		    node->devnum == devnum && node->iftype == iftype)
+			dirty[count++] = node;
+	}
+	qsort(dirty, count, sizeof(*dirty), cache_compare);
+
+	for (i = 0; i < count; i += run) {
+		for (run = 1; i + run < count; run++) {
+			node = dirty[i + run];
+			if (node->epoch != dirty[i]->epoch ||
+			    node->blknr != dirty[i]->blknr + run ||
+			    node->blksz != dirty[i]->blksz)
+				break;
+		}
+		ret = cache_write_back(dirty + i, run);
+		if (ret)
+			break;
+	}
+	free(dirty);
+
+	return ret;
+}
+
+/* Check whether a range of blocks holds data not written back yet */
+static bool cache_dirty_in(int iftype, int devnum, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct block_cache_node *node;
+
+	if (!_stats.dirty)
+		return false;
+
+	list_for_each_entry(node, &block_cache, lh) {
+		if (node->dirty && node->blknr >= start &&
+		    node->blknr - start < blkcnt &&
+		    node->devnum == devnum && node->iftype == iftype)
+			return true;
+	}
+
+	return false;
+}
+
+int blkcache_flush_range(int iftype, int devnum, lbaint_t start,
+			 lbaint_t blkcnt)
+{
+	if (!cache_dirty_in(iftype, devnum, start, blkcnt))
+		return 0;
+
+	return cache_flush(iftype, devnum, ULONG_MAX);
+}
+
+/* Add a clean block to the cache, making room for it */
+static struct block_cache_node *cache_insert(int iftype, int devnum,
+					     lbaint_t blknr,
+					     unsigned long blksz)
+{
+	struct block_cache_node *node;
+
+	while (_stats.size + node_size(blksz) > cache_limit(blksz)) {
+		/* pop LRU, writing back its device if it is dirty */
+		node = list_last_entry(&block_cache,
+				       struct block_cache_node, lh);
+		if (node->dirty)
+			cache_flush(node->iftype, node->devnum, ULONG_MAX);
+		/* never lose a block which could not be written back */
+		if (node->dirty)
+			return NULL;
+		debug("drop: block " LBAF "\n", node->blknr);
+		cache_drop(node);
+		_stats.evictions++;
+	}
+
+	node = malloc(node_size(blksz));
+	if (!node)
+		return NULL;
+	node->iftype = iftype;
+	node->devnum = devnum;
+	node->blknr = blknr;
+	node->blksz = blksz;
+	node->dirty = false;
+	hlist_add_head(&node->hn, cache_bucket(iftype, devnum, blknr));
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+	_stats.size += node_size(blksz);
+
+	return node;
+}
+
+/* Find the stream which the read at @start continues, if any */
+static struct block_cache_stream *stream_find(int iftype, int devnum,
+					      lbaint_t start)
+{
+	struct block_cache_stream *stream;
+	int i;
+
+	for (i = 0; i < BLKCACHE_STREAMS; i++) {
+		stream = &streams[i];
+		if (stream->next == start && stream->devnum == devnum &&
+		    stream->iftype == iftype)
+			return stream;
+	}
+
+	return NULL;
+}
+
+static struct block_cache_stream *stream_new(int iftype, int devnum)
+{
+	struct block_cache_stream *stream;
+
+	/* Reuse the slots in turn */
+	stream = &streams[stream_victim++ % BLKCACHE_STREAMS];
+	stream->iftype = iftype;
+	stream->devnum = devnum;
+	stream->window = 0;
+
+	return stream;
+}
+
+static struct block_cache_stream *stream_last_miss(int iftype, int devnum)
+{
+	if (last_miss && last_miss->devnum == devnum &&
+	    last_miss->iftype == iftype)
+		return last_miss;
+
+	return NULL;
+}
+
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+	struct block_cache_stream *stream;
+	struct block_cache_node *node;
+	lbaint_t i;
+
+	last_miss = NULL;
+
+	/* don't look up big stuff */
+	if (blkcnt > _stats.max_blocks_per_entry) {
+		if (blkcache_flush_range(iftype, devnum, start, blkcnt))
+			log_err("Cannot write back blocks of device %d\n",
+				devnum);
+		return 0;
+	}
+
+	for (i = 0; block_cache_hash && i < blkcnt; i++) {
+		node = cache_find(iftype, devnum, start + i);
+		if (!node || node->blksz != blksz)
+			break;
+		memcpy(buffer + i * blksz, node->cache, blksz);
+		/* maintain MRU ordering */
+		list_move(&node->lh, &block_cache);
+	}
+
+	stream = stream_find(iftype, devnum, start);
+	if (i == blkcnt) {
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
 		++_stats.hits;
+		if (stream)
+			stream->next = start + blkcnt;
 		return 1;
 	}
 
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 	++_stats.misses;
+	if (blkcache_flush_range(iftype, devnum, start, blkcnt))
+		log_err("Cannot write back blocks of device %d\n", devnum);
+
+	/* Double the window while the stream keeps on missing */
+	if (stream && _stats.max_readahead) {
+		stream->window = clamp_t(lbaint_t, stream->window * 2,
+					 min_t(lbaint_t, BLKCACHE_MIN_READAHEAD,
+					       _stats.max_readahead),
+					 _stats.max_readahead);
+	} else {
+		stream = stream_new(iftype, devnum);
+	}
+	stream->next = start + blkcnt;
+	last_miss = stream;
+
 	return 0;
 }
 
+lbaint_t blkcache_readahead(int iftype, int devnum)
+{
+	struct block_cache_stream *stream = stream_last_miss(iftype, devnum);
+
+	return stream ? stream->window : 0;
+}
+
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
+	struct block_cache_stream *stream = stream_last_miss(iftype, devnum);
 	struct block_cache_node *node;
+	lbaint_t i;
 
-	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	/* don't cache big stuff, other than what was read ahead */
+	if (blkcnt > _stats.max_blocks_per_entry +
+		     (stream ? stream->window : 0))
 		return;
 
-	if (_stats.max_entries == 0)
+	/* Anything past the end of the last miss was read ahead */
+	if (stream && start < stream->next && start + blkcnt > stream->next)
+		_stats.readahead += start + blkcnt - stream->next;
+
+	if (node_size(blksz) > cache_limit(blksz) || cache_setup(blksz))
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
+	debug("fill: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+
+	for (i = 0; i < blkcnt; i++, buffer += blksz) {
+		node = cache_find(iftype, devnum, start + i);
+		if (node && node->blksz != blksz) {
+			cache_drop(node);
+			node = NULL;
 		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
+		if (!node) {
+			node = cache_insert(iftype, devnum, start + i, blksz);
+			if (!node)
+				return;
+		} else if (node->dirty) {
+			/* what was read ahead is older than what was written */
+			continue;
+		}
+		memcpy(node->cache, buffer, blksz);
+		list_move(&node->lh, &block_cache);
 	}
+}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
+int blkcache_write(int iftype, int devnum,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer)
+{
+	struct block_cache_node *node;
+	lbaint_t i;
+	int ret;
+
+	/* big writes, and those outside a session, go straight to the device */
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE_WRITEBACK) ||
+	    devnum != writeback_devnum || iftype != writeback_iftype ||
+	    blkcnt > _stats.max_blocks_per_entry ||
+	    blkcnt * node_size(blksz) > cache_limit(blksz) / 2 ||
+	    cache_setup(blksz))
+		return 0;
+
+	/* Blocks dirtied before a barrier must reach the disk first */
+	for (i = 0; i < blkcnt; i++) {
+		node = cache_find(iftype, devnum, start + i);
+		if (node && node->dirty && node->epoch != cache_epoch) {
+			ret = cache_flush(iftype, devnum, cache_epoch);
+			if (ret)
+				return ret;
+			break;
 		}
 	}
 
-	debug("fill: start " LBAF ", count " LBAFU "\n",
+	debug("write: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	for (i = 0; i < blkcnt; i++, buffer += blksz) {
+		node = cache_find(iftype, devnum, start + i);
+		if (node && node->blksz != blksz) {
+			cache_drop(node);
+			node = NULL;
+		}
+		if (!node)
+			node = cache_insert(iftype, devnum, start + i, blksz);
+		if (!node)
+			return -EIO;
+		memcpy(node->cache, buffer, blksz);
+		if (!node->dirty) {
+			node->dirty = true;
+			_stats.dirty++;
+		}
+		node->epoch = cache_epoch;
+		list_move(&node->lh, &block_cache);
+	}
+	_stats.writes++;
+
+	/* Keep at least half of the cache for clean blocks */
+	if (_stats.dirty * node_size(blksz) > cache_limit(blksz) / 2) {
+		ret = cache_flush(iftype, devnum, ULONG_MAX);
+		if (ret)
+			return ret;
+	}
+
+	return 1;
 }
 
-void blkcache_invalidate(int iftype, int devnum)
+void blkcache_barrier(void)
+{
+	if (_stats.dirty)
+		cache_epoch++;
+}
+
+int blkcache_flush(int iftype, int devnum)
+{
+	return cache_flush(iftype, devnum, ULONG_MAX);
+}
+
+void blkcache_writeback_begin(int iftype, int devnum)
+{
+	writeback_iftype = iftype;
+	writeback_devnum = devnum;
+}
+
+int blkcache_writeback_end(void)
+{
+	int ret;
+
+	if (writeback_devnum == -1)
+		return 0;
+	ret = cache_flush(writeback_iftype, writeback_devnum, ULONG_MAX);
+	writeback_devnum = -1;
+
+	return ret;
+}
+
+int blkcache_flush_all(void)
 {
-	struct list_head *entry, *n;
 	struct block_cache_node *node;
+	int ret;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
+	while (_stats.dirty) {
+		list_for_each_entry(node, &block_cache, lh) {
+			if (node->dirty)
+				break;
 		}
+		ret = cache_flush(node->iftype, node->devnum, ULONG_MAX);
+		if (ret)
+			return ret;
 	}
+
+	return 0;
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_invalidate(int iftype, int devnum)
+{
+	struct block_cache_node *node, *n;
+
+	if (cache_flush(iftype, devnum, ULONG_MAX))
+		log_err("Cannot write back blocks of device %d\n", devnum);
+
+	/* what could not be written back is kept for a later flush */
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
+		if ((node->iftype == iftype) &&
+		    (node->devnum == devnum) && !node->dirty)
+			cache_drop(node);
+	}
+}
+
+/* Write back and drop the cache, so that it is set up again */
+static int cache_reset(void)
+{
+	if (blkcache_flush_all())
+		return -EIO;
+	cache_drop_all();
+	free(block_cache_hash);
+	block_cache_hash = NULL;
+
+	return 0;
+}
+
+static void cache_clear_stats(void)
+{
+	_stats.hits = 0;
+	_stats.misses = 0;
+	_stats.evictions = 0;
+	_stats.readahead = 0;
+	_stats.writes = 0;
+	_stats.writebacks = 0;
+	_stats.written = 0;
+}
+
+int blkcache_configure(unsigned blocks, unsigned entries)
 {
-	struct block_cache_node *node;
 	if ((blocks != _stats.max_blocks_per_entry) ||
 	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+		/* invalidate cache, and size the hash table again */
+		if (cache_reset())
+			return -EIO;
 	}
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+	cache_clear_stats();
 
-	_stats.hits = 0;
-	_stats.misses = 0;
+	return 0;
+}
+
+int blkcache_configure_size(ulong size, unsigned readahead)
+{
+	if (size != _stats.max_size && cache_reset())
+		return -EIO;
+
+	_stats.max_size = size;
+	_stats.max_readahead = readahead;
+	cache_clear_stats();
+
+	return 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
-	_stats.hits = 0;
-	_stats.misses = 0;
+	cache_clear_stats();
 }
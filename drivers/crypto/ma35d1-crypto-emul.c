@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox model of the MA35D1 HMAC/SHA engine
+ *
+ * Only what the SHA driver uses is modelled: DMA mode with DMAFIRST,
+ * DMALAST and the FBIN/FBOUT feedback buffer. A transfer completes as soon
+ * as START is written. The layout of the feedback buffer is private to this
+ * model.
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <mapmem.h>
+#include <asm/test.h>
+#include <asm/unaligned.h>
+#include <linux/bug.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+
+#include "ma35d1-crypto.h"
+
+#define EMUL_NUM_REGS	(0x600 / 4)
+
+struct ma35d1_sha_emul_state {
+	u32	opmode;
+	union {
+		sha1_context	sha1;
+		sha256_context	sha256;
+#ifdef CONFIG_SHA512
+		sha512_context	sha512;
+#endif
+	} u;
+};
+
+static struct {
+	u32	regs[EMUL_NUM_REGS];
+	struct ma35d1_sha_emul_state sha;
+	uint	sha_transfers;
+} emul;
+
+static u32 *emul_reg(u32 off)
+{
+	return &emul.regs[(off / 4) % EMUL_NUM_REGS];
+}
+
+static int emul_sha_block_size(u32 opmode)
+{
+	switch (opmode) {
+	case SHA_OPMODE_SHA1:
+	case SHA_OPMODE_SHA224:
+	case SHA_OPMODE_SHA256:
+		return 64;
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		return 128;
+#endif
+	default:
+		return 0;
+	}
+}
+
+static void emul_sha_starts(struct ma35d1_sha_emul_state *st, u32 opmode)
+{
+	st->opmode = opmode;
+	switch (opmode) {
+	case SHA_OPMODE_SHA1:
+		sha1_starts(&st->u.sha1);
+		break;
+	case SHA_OPMODE_SHA224:
+		sha224_starts(&st->u.sha256);
+		break;
+	case SHA_OPMODE_SHA256:
+		sha256_starts(&st->u.sha256);
+		break;
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		sha512_starts(&st->u.sha512);
+		break;
+#endif
+	}
+}
+
+static void emul_sha_update(struct ma35d1_sha_emul_state *st, const u8 *buf,
+			    u32 len)
+{
+	switch (st->opmode) {
+	case SHA_OPMODE_SHA1:
+		sha1_update(&st->u.sha1, buf, len);
+		break;
+	case SHA_OPMODE_SHA224:
+	case SHA_OPMODE_SHA256:
+		sha256_update(&st->u.sha256, buf, len);
+		break;
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		sha512_update(&st->u.sha512, buf, len);
+		break;
+#endif
+	}
+}
+
+static int emul_sha_finish(struct ma35d1_sha_emul_state *st, u8 *out)
+{
+	switch (st->opmode) {
+	case SHA_OPMODE_SHA1:
+		sha1_finish(&st->u.sha1, out);
+		return SHA1_SUM_LEN;
+	case SHA_OPMODE_SHA224:
+		sha224_finish(&st->u.sha256, out);
+		return SHA224_SUM_LEN;
+	case SHA_OPMODE_SHA256:
+		sha256_finish(&st->u.sha256, out);
+		return SHA256_SUM_LEN;
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		sha512_finish(&st->u.sha512, out);
+		return SHA512_SUM_LEN;
+#endif
+	}
+
+	return 0;
+}
+
+/* Run the DMA transfer described by HMAC_CTL @ctl, return false on error */
+static bool emul_sha_run(u32 ctl)
+{
+	struct ma35d1_sha_emul_state *st = &emul.sha;
+	u32 opmode = ctl & HMAC_CTL_OPMODE_MASK;
+	u32 len = *emul_reg(HMAC_DMACNT);
+	int bs = emul_sha_block_size(opmode);
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	void *fdbck, *buf;
+	int i, size;
+
+	BUILD_BUG_ON(sizeof(*st) > SHA_FDBCK_SIZE);
+	emul.sha_transfers++;
+	if (!(ctl & HMAC_CTL_DMAEN) || !bs)
+		return false;
+	/* Only the last transfer may end with a partial block */
+	if (!(ctl & HMAC_CTL_DMALAST) && len % bs)
+		return false;
+
+	fdbck = map_sysmem(*emul_reg(HMAC_FBADDR), SHA_FDBCK_SIZE);
+	if (ctl & HMAC_CTL_DMAFIRST)
+		emul_sha_starts(st, opmode);
+	else if (ctl & HMAC_CTL_FBIN)
+		memcpy(st, fdbck, sizeof(*st));
+	if (st->opmode != opmode) {
+		unmap_sysmem(fdbck);
+		return false;
+	}
+
+	buf = map_sysmem(*emul_reg(HMAC_SADDR), len);
+	emul_sha_update(st, buf, len);
+	unmap_sysmem(buf);
+
+	if (ctl & HMAC_CTL_DMALAST) {
+		size = emul_sha_finish(st, digest);
+		for (i = 0; i < size / 4; i++)
+			*emul_reg(HMAC_DGST(i)) =
+				get_unaligned_le32(digest + i * 4);
+	} else if (ctl & HMAC_CTL_FBOUT) {
+		memcpy(fdbck, st, sizeof(*st));
+	}
+	unmap_sysmem(fdbck);
+
+	return true;
+}
+
+uint ma35d1_crypto_emul_sha_transfers(void)
+{
+	return emul.sha_transfers;
+}
+
+u32 ma35d1_crypto_emul_read(u32 off)
+{
+	return *emul_reg(off);
+}
+
+void ma35d1_crypto_emul_write(u32 val, u32 off)
+{
+	switch (off) {
+	case INTSTS:
+		/* write one to clear */
+		*emul_reg(off) &= ~val;
+		break;
+	case HMAC_CTL:
+		*emul_reg(off) = val & ~HMAC_CTL_START;
+		if (val & HMAC_CTL_START)
+			*emul_reg(INTSTS) |= emul_sha_run(val) ?
+				INTSTS_HMACIF : INTSTS_HMACEIF;
+		break;
+	default:
+		*emul_reg(off) = val;
+		break;
+	}
+}
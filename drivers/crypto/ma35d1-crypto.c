@@ -5,10 +5,23 @@
  */
 
 #include <common.h>
+#include <cpu_func.h>
 #include <dm.h>
+#include <hash.h>
+#include <hw_sha.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
+#include <time.h>
+#include <watchdog.h>
+#include <asm/cache.h>
 #include <asm/io.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/sizes.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
 
 #include <dt-bindings/clock/ma35d1-clk.h>
 #include <syscon.h>
@@ -26,12 +39,20 @@ static struct ma35d1_crypto_priv  _ma35d1_crypto;
 
 static inline void nu_write_reg(u32 val, u32 off)
 {
+#ifdef CONFIG_SANDBOX
+	ma35d1_crypto_emul_write(val, off);
+#else
 	writel(val, _ma35d1_crypto.reg_base + off);
+#endif
 }
 
 static inline uint32_t nu_read_reg(u32 off)
 {
+#ifdef CONFIG_SANDBOX
+	return ma35d1_crypto_emul_read(off);
+#else
 	return readl(_ma35d1_crypto.reg_base + off);
+#endif
 }
 
 /**
@@ -94,16 +115,404 @@ int ma35d1_aes_decrypt(u32 keynum, u32 src_addr,
 	return 0;
 }
 
+#ifdef CONFIG_MA35D1_CRYPTO_SHA
+/* Longest time a single HMAC DMA transfer may take */
+#define MA35D1_SHA_TIMEOUT_MS	1000
+/* Staging buffer for unaligned input and the tail of each update */
+#define MA35D1_SHA_BUF_SIZE	SZ_4K
+
+struct ma35d1_sha_mode {
+	const char	*name;
+	u32		opmode;
+	u32		block_size;
+	u32		digest_size;
+};
+
+static const struct ma35d1_sha_mode ma35d1_sha_modes[] = {
+#ifdef CONFIG_SHA1
+	{ "sha1",   SHA_OPMODE_SHA1,   64,  SHA1_SUM_LEN },
+#endif
+#ifdef CONFIG_SHA256
+	{ "sha224", SHA_OPMODE_SHA224, 64,  SHA224_SUM_LEN },
+	{ "sha256", SHA_OPMODE_SHA256, 64,  SHA256_SUM_LEN },
+#endif
+#ifdef CONFIG_SHA512
+	{ "sha512", SHA_OPMODE_SHA512, 128, SHA512_SUM_LEN },
+#endif
+};
+
+/*
+ * Progressive hashing context. The engine keeps no state between DMA
+ * transfers: every transfer but the first reloads the intermediate digest
+ * from @fdbck (FBIN) and every transfer but the last stores it back (FBOUT),
+ * so several contexts may be in use at the same time.
+ *
+ * Input is fed straight from the caller's buffer whenever it is word
+ * aligned. The tail of each update (at least one byte, so that the final
+ * transfer is never empty) and unaligned input are staged in @buf.
+ */
+struct ma35d1_sha_ctx {
+	u8	buf[MA35D1_SHA_BUF_SIZE] __aligned(ARCH_DMA_MINALIGN);
+	u8	fdbck[ALIGN(SHA_FDBCK_SIZE, ARCH_DMA_MINALIGN)]
+		__aligned(ARCH_DMA_MINALIGN);
+	const struct ma35d1_sha_mode *mode;
+	u32	buf_len;
+	bool	started;	/* at least one transfer has completed */
+	bool	sw;		/* no engine, hash in software */
+	union {
+#ifdef CONFIG_SHA1
+		sha1_context	sha1;
+#endif
+#ifdef CONFIG_SHA256
+		sha256_context	sha256;
+#endif
+#ifdef CONFIG_SHA512
+		sha512_context	sha512;
+#endif
+	} sw_ctx;
+};
+
+static const struct ma35d1_sha_mode *ma35d1_sha_find_mode(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ma35d1_sha_modes); i++) {
+		if (!strcmp(name, ma35d1_sha_modes[i].name))
+			return &ma35d1_sha_modes[i];
+	}
+
+	return NULL;
+}
+
+static void ma35d1_sha_sw_starts(struct ma35d1_sha_ctx *ctx)
+{
+	switch (ctx->mode->opmode) {
+#ifdef CONFIG_SHA1
+	case SHA_OPMODE_SHA1:
+		sha1_starts(&ctx->sw_ctx.sha1);
+		break;
+#endif
+#ifdef CONFIG_SHA256
+	case SHA_OPMODE_SHA224:
+		sha224_starts(&ctx->sw_ctx.sha256);
+		break;
+	case SHA_OPMODE_SHA256:
+		sha256_starts(&ctx->sw_ctx.sha256);
+		break;
+#endif
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		sha512_starts(&ctx->sw_ctx.sha512);
+		break;
+#endif
+	}
+}
+
+static void ma35d1_sha_sw_update(struct ma35d1_sha_ctx *ctx, const u8 *data,
+				 u32 len)
+{
+	switch (ctx->mode->opmode) {
+#ifdef CONFIG_SHA1
+	case SHA_OPMODE_SHA1:
+		sha1_update(&ctx->sw_ctx.sha1, data, len);
+		break;
+#endif
+#ifdef CONFIG_SHA256
+	case SHA_OPMODE_SHA224:
+	case SHA_OPMODE_SHA256:
+		sha256_update(&ctx->sw_ctx.sha256, data, len);
+		break;
+#endif
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		sha512_update(&ctx->sw_ctx.sha512, data, len);
+		break;
+#endif
+	}
+}
+
+static void ma35d1_sha_sw_finish(struct ma35d1_sha_ctx *ctx, u8 *out)
+{
+	switch (ctx->mode->opmode) {
+#ifdef CONFIG_SHA1
+	case SHA_OPMODE_SHA1:
+		sha1_finish(&ctx->sw_ctx.sha1, out);
+		break;
+#endif
+#ifdef CONFIG_SHA256
+	case SHA_OPMODE_SHA224:
+		sha224_finish(&ctx->sw_ctx.sha256, out);
+		break;
+	case SHA_OPMODE_SHA256:
+		sha256_finish(&ctx->sw_ctx.sha256, out);
+		break;
+#endif
+#ifdef CONFIG_SHA512
+	case SHA_OPMODE_SHA512:
+		sha512_finish(&ctx->sw_ctx.sha512, out);
+		break;
+#endif
+	}
+}
+
+static void ma35d1_sha_flush(const void *buf, u32 len)
+{
+	ulong start = (ulong)buf;
+
+	flush_dcache_range(rounddown(start, ARCH_DMA_MINALIGN),
+			   roundup(start + len, ARCH_DMA_MINALIGN));
+}
+
+/*
+ * Hash @len bytes at @data in one DMA transfer and wait for it to finish.
+ * This busy-waits on the interrupt status; nothing else runs meanwhile.
+ */
+static int ma35d1_sha_dma(struct ma35d1_sha_ctx *ctx, const void *data,
+			  u32 len, bool last)
+{
+	ulong start;
+	u32 ctl, sts;
+
+	ctl = ctx->mode->opmode | HMAC_CTL_INSWAP | HMAC_CTL_OUTSWAP |
+	      HMAC_CTL_DMAEN | HMAC_CTL_START;
+	ctl |= ctx->started ? HMAC_CTL_FBIN : HMAC_CTL_DMAFIRST;
+	ctl |= last ? HMAC_CTL_DMALAST : HMAC_CTL_FBOUT;
+
+	ma35d1_sha_flush(data, len);
+	ma35d1_sha_flush(ctx->fdbck, sizeof(ctx->fdbck));
+
+	nu_write_reg(INTSTS_HMACIF | INTSTS_HMACEIF, INTSTS);
+	nu_write_reg((u32)map_to_sysmem(data), HMAC_SADDR);
+	nu_write_reg(len, HMAC_DMACNT);
+	nu_write_reg((u32)map_to_sysmem(ctx->fdbck), HMAC_FBADDR);
+	nu_write_reg(ctl, HMAC_CTL);
+
+	start = get_timer(0);
+	while (!((sts = nu_read_reg(INTSTS)) &
+		 (INTSTS_HMACIF | INTSTS_HMACEIF))) {
+		if (get_timer(start) > MA35D1_SHA_TIMEOUT_MS) {
+			nu_write_reg(HMAC_CTL_STOP, HMAC_CTL);
+			debug("%s: HMAC DMA timeout\n", __func__);
+			return -ETIMEDOUT;
+		}
+	}
+	nu_write_reg(INTSTS_HMACIF | INTSTS_HMACEIF, INTSTS);
+	if (sts & INTSTS_HMACEIF) {
+		debug("%s: HMAC DMA error, status %x\n", __func__,
+		      nu_read_reg(HMAC_STS));
+		return -EIO;
+	}
+
+	if (!last)
+		invalidate_dcache_range((ulong)ctx->fdbck,
+					(ulong)ctx->fdbck + sizeof(ctx->fdbck));
+	ctx->started = true;
+	WATCHDOG_RESET();
+
+	return 0;
+}
+
+static struct ma35d1_sha_ctx *ma35d1_sha_new(const struct ma35d1_sha_mode *mode)
+{
+	struct ma35d1_sha_ctx *ctx;
+
+	ctx = memalign(ARCH_DMA_MINALIGN, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	ctx->mode = mode;
+	ctx->buf_len = 0;
+	ctx->started = false;
+	ctx->sw = !_ma35d1_crypto.reg_base;
+	if (ctx->sw)
+		ma35d1_sha_sw_starts(ctx);
+
+	return ctx;
+}
+
+static int ma35d1_sha_update(struct ma35d1_sha_ctx *ctx, const u8 *data,
+			     u32 len)
+{
+	u32 bs = ctx->mode->block_size;
+	u32 n;
+	int ret;
+
+	if (ctx->sw) {
+		ma35d1_sha_sw_update(ctx, data, len);
+		return 0;
+	}
+
+	while (len) {
+		/* Whole blocks go straight from the caller's buffer */
+		if (!ctx->buf_len && IS_ALIGNED((ulong)data, 4) && len > bs) {
+			n = rounddown(len - 1, bs);
+			ret = ma35d1_sha_dma(ctx, data, n, false);
+			if (ret)
+				return ret;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		n = min_t(u32, len, MA35D1_SHA_BUF_SIZE - ctx->buf_len);
+		memcpy(ctx->buf + ctx->buf_len, data, n);
+		ctx->buf_len += n;
+		data += n;
+		len -= n;
+
+		/* A full buffer is only kept back if it may be the last one */
+		if (ctx->buf_len == MA35D1_SHA_BUF_SIZE && len) {
+			ret = ma35d1_sha_dma(ctx, ctx->buf, MA35D1_SHA_BUF_SIZE,
+					     false);
+			if (ret)
+				return ret;
+			ctx->buf_len = 0;
+		}
+	}
+
+	return 0;
+}
+
+static int ma35d1_sha_final(struct ma35d1_sha_ctx *ctx, u8 *out)
+{
+	int i, ret;
+
+	/* The engine cannot hash an empty message */
+	if (!ctx->sw && !ctx->started && !ctx->buf_len) {
+		ma35d1_sha_sw_starts(ctx);
+		ctx->sw = true;
+	}
+	if (ctx->sw) {
+		ma35d1_sha_sw_finish(ctx, out);
+		return 0;
+	}
+
+	ret = ma35d1_sha_dma(ctx, ctx->buf, ctx->buf_len, true);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ctx->mode->digest_size / 4; i++)
+		put_unaligned_le32(nu_read_reg(HMAC_DGST(i)), out + i * 4);
+
+	return 0;
+}
+
+int hw_sha_init(struct hash_algo *algo, void **ctxp)
+{
+	const struct ma35d1_sha_mode *mode;
+	struct ma35d1_sha_ctx *ctx;
+
+	mode = ma35d1_sha_find_mode(algo->name);
+	if (!mode)
+		return -EPROTONOSUPPORT;
+
+	ctx = ma35d1_sha_new(mode);
+	if (!ctx)
+		return -ENOMEM;
+	*ctxp = ctx;
+
+	return 0;
+}
+
+int hw_sha_update(struct hash_algo *algo, void *ctx, const void *buf,
+		  unsigned int size, int is_last)
+{
+	int ret;
+
+	ret = ma35d1_sha_update(ctx, buf, size);
+	if (ret)
+		free(ctx);
+
+	return ret;
+}
+
+int hw_sha_finish(struct hash_algo *algo, void *ctx, void *dest_buf,
+		  int size)
+{
+	struct ma35d1_sha_ctx *sha = ctx;
+	int ret;
+
+	if (size < sha->mode->digest_size)
+		ret = -ENOSPC;
+	else
+		ret = ma35d1_sha_final(sha, dest_buf);
+	free(ctx);
+
+	return ret;
+}
+
+/* One-shot hash, falling back to software if the engine fails */
+static void ma35d1_sha_csum(const char *name, const uchar *in, uint len,
+			    uchar *out)
+{
+	struct ma35d1_sha_ctx *ctx;
+	int ret;
+
+	ctx = ma35d1_sha_new(ma35d1_sha_find_mode(name));
+	if (!ctx) {
+		printf("MA35D1 SHA: out of memory\n");
+		return;
+	}
+
+	ret = ma35d1_sha_update(ctx, in, len);
+	if (!ret)
+		ret = ma35d1_sha_final(ctx, out);
+	if (ret) {
+		printf("MA35D1 SHA: engine error %d, using software\n", ret);
+		ctx->sw = true;
+		ma35d1_sha_sw_starts(ctx);
+		ma35d1_sha_sw_update(ctx, in, len);
+		ma35d1_sha_sw_finish(ctx, out);
+	}
+	free(ctx);
+}
+
+#ifdef CONFIG_SHA1
+void hw_sha1(const uchar *in_addr, uint buflen, uchar *out_addr,
+	     uint chunk_size)
+{
+	ma35d1_sha_csum("sha1", in_addr, buflen, out_addr);
+}
+#endif
+
+#ifdef CONFIG_SHA256
+void hw_sha256(const uchar *in_addr, uint buflen, uchar *out_addr,
+	       uint chunk_size)
+{
+	ma35d1_sha_csum("sha256", in_addr, buflen, out_addr);
+}
+#endif
+
+#ifdef CONFIG_SHA224_HW_ACCEL
+void hw_sha224(const uchar *in_addr, uint buflen, uchar *out_addr,
+	       uint chunk_size)
+{
+	ma35d1_sha_csum("sha224", in_addr, buflen, out_addr);
+}
+#endif
+
+#ifdef CONFIG_SHA512_HW_ACCEL
+void hw_sha512(const uchar *in_addr, uint buflen, uchar *out_addr,
+	       uint chunk_size)
+{
+	ma35d1_sha_csum("sha512", in_addr, buflen, out_addr);
+}
+#endif
+#endif /* CONFIG_MA35D1_CRYPTO_SHA */
+
 static int ma35d1_crypto_bind(struct udevice *dev)
 {
+	fdt_addr_t addr;
+
 	/*
 	 * Get the base address for Crypto from the device node
 	 */
-	_ma35d1_crypto.reg_base = (void *)devfdt_get_addr(dev);
-	if (_ma35d1_crypto.reg_base == (void *)FDT_ADDR_T_NONE) {
+	addr = dev_read_addr(dev);
+	if (addr == FDT_ADDR_T_NONE) {
 		printf("Can't get the CRYPTO register base address\n");
 		return -ENXIO;
 	}
+	_ma35d1_crypto.reg_base = (void *)(uintptr_t)addr;
 	return 0;
 }
 
@@ -284,4 +284,13 @@ enum {
 	CURVE_GF_2M,
 };
 
+#ifdef CONFIG_SANDBOX
+/*
+ * Register model of the HMAC/SHA engine, used in place of MMIO accesses
+ * when the driver runs on sandbox
+ */
+u32 ma35d1_crypto_emul_read(u32 off);
+void ma35d1_crypto_emul_write(u32 val, u32 off);
+#endif
+
 #endif /* MA35D1_CRYPTO_H */
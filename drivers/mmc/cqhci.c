@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * eMMC Command Queue Host Controller Interface (CQHCI)
+ *
+ * The engine is only used for data tasks and is polled: U-Boot has no
+ * interrupts, and direct commands go through the host controller while the
+ * engine is disabled.
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <cqhci.h>
+#include <log.h>
+#include <malloc.h>
+#include <mmc.h>
+#include <time.h>
+#include <asm/cache.h>
+#include <asm/unaligned.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+
+#define CQHCI_TIMEOUT_MS	1000
+
+static u8 *cqhci_task_desc(struct cqhci_host *cq_host, uint slot)
+{
+	return cq_host->desc_base + slot * cq_host->slot_sz;
+}
+
+static u8 *cqhci_trans_desc(struct cqhci_host *cq_host, uint slot)
+{
+	return cq_host->trans_desc_base +
+	       slot * cq_host->max_segs * cq_host->trans_desc_len;
+}
+
+static void cqhci_set_addr(u8 *desc, dma_addr_t addr, bool dma64)
+{
+	if (dma64)
+		put_unaligned_le64(addr, desc);
+	else
+		put_unaligned_le32(addr, desc);
+}
+
+/* Point the link descriptor of each slot at the transfer descriptors */
+static void cqhci_setup_links(struct cqhci_host *cq_host)
+{
+	uint slot;
+	u8 *link;
+
+	for (slot = 0; slot < CQHCI_NUM_SLOTS; slot++) {
+		link = cqhci_task_desc(cq_host, slot) + cq_host->task_desc_len;
+		memset(link, '\0', cq_host->link_desc_len);
+		put_unaligned_le32(CQHCI_VALID(1) | CQHCI_ACT(CQHCI_ACT_LINK),
+				   link);
+		cqhci_set_addr(link + 4,
+			       (dma_addr_t)cqhci_trans_desc(cq_host, slot),
+			       cq_host->dma64);
+	}
+}
+
+int cqhci_init(struct cqhci_host *cq_host, struct mmc *mmc, bool dma64)
+{
+	size_t desc_size, trans_size;
+
+	cq_host->mmc = mmc;
+	cq_host->dma64 = dma64;
+	cq_host->task_desc_len = dma64 ? 16 : 8;
+	cq_host->link_desc_len = dma64 ? 16 : 8;
+	cq_host->trans_desc_len = dma64 ? 16 : 8;
+	cq_host->slot_sz = cq_host->task_desc_len + cq_host->link_desc_len;
+	cq_host->max_segs = DIV_ROUND_UP(MMC_CQE_MAX_BLOCKS * MMC_MAX_BLOCK_LEN,
+					 CQHCI_MAX_SEG_LEN);
+
+	desc_size = CQHCI_NUM_SLOTS * cq_host->slot_sz;
+	trans_size = CQHCI_NUM_SLOTS * cq_host->max_segs *
+		     cq_host->trans_desc_len;
+	cq_host->desc_base = memalign(ARCH_DMA_MINALIGN,
+				      ALIGN(desc_size, ARCH_DMA_MINALIGN));
+	cq_host->trans_desc_base = memalign(ARCH_DMA_MINALIGN,
+					    ALIGN(trans_size,
+						  ARCH_DMA_MINALIGN));
+	if (!cq_host->desc_base || !cq_host->trans_desc_base) {
+		free(cq_host->desc_base);
+		free(cq_host->trans_desc_base);
+		return -ENOMEM;
+	}
+	memset(cq_host->desc_base, '\0', desc_size);
+	cqhci_setup_links(cq_host);
+
+	return 0;
+}
+
+static int cqhci_wait_ctl(struct cqhci_host *cq_host, u32 mask, u32 val)
+{
+	ulong start = get_timer(0);
+
+	while ((cqhci_readl(cq_host, CQHCI_CTL) & mask) != val) {
+		if (get_timer(start) > CQHCI_TIMEOUT_MS)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+int cqhci_enable(struct cqhci_host *cq_host, bool enable)
+{
+	u32 cfg;
+	int ret;
+
+	if (enable == cq_host->enabled)
+		return 0;
+
+	cfg = cqhci_readl(cq_host, CQHCI_CFG);
+	if (!enable) {
+		/* Halt the engine before giving the bus back */
+		cqhci_writel(cq_host, CQHCI_HALT, CQHCI_CTL);
+		ret = cqhci_wait_ctl(cq_host, CQHCI_HALT, CQHCI_HALT);
+		cqhci_writel(cq_host, cfg & ~CQHCI_ENABLE, CQHCI_CFG);
+		if (cq_host->ops->disable)
+			cq_host->ops->disable(cq_host);
+		cq_host->enabled = false;
+
+		return ret;
+	}
+
+	if (cq_host->ops->enable) {
+		ret = cq_host->ops->enable(cq_host);
+		if (ret)
+			return ret;
+	}
+
+	/* The configuration must not change while the engine is enabled */
+	cfg &= ~(CQHCI_ENABLE | CQHCI_DCMD | CQHCI_TASK_DESC_SZ);
+	if (cq_host->task_desc_len == 16)
+		cfg |= CQHCI_TASK_DESC_SZ;
+	cqhci_writel(cq_host, cfg, CQHCI_CFG);
+
+	flush_cache((ulong)cq_host->desc_base,
+		    ALIGN(CQHCI_NUM_SLOTS * cq_host->slot_sz,
+			  ARCH_DMA_MINALIGN));
+	cqhci_writel(cq_host, lower_32_bits((dma_addr_t)cq_host->desc_base),
+		     CQHCI_TDLBA);
+	cqhci_writel(cq_host, upper_32_bits((dma_addr_t)cq_host->desc_base),
+		     CQHCI_TDLBAU);
+	cqhci_writel(cq_host, cq_host->mmc->rca, CQHCI_SSC2);
+
+	/* Completions are polled, so no interrupt is signalled */
+	cqhci_writel(cq_host, CQHCI_IS_MASK, CQHCI_ISTE);
+	cqhci_writel(cq_host, 0, CQHCI_ISGE);
+	cqhci_writel(cq_host, cqhci_readl(cq_host, CQHCI_IS), CQHCI_IS);
+
+	cqhci_writel(cq_host, cfg | CQHCI_ENABLE, CQHCI_CFG);
+	if (cqhci_readl(cq_host, CQHCI_CTL) & CQHCI_HALT)
+		cqhci_writel(cq_host, 0, CQHCI_CTL);
+	cq_host->enabled = true;
+
+	return 0;
+}
+
+/* Fill the descriptors of @slot for @task */
+static void cqhci_prep_task(struct cqhci_host *cq_host, uint slot,
+			    struct mmc_cqe_task *task)
+{
+	struct mmc_data *data = &task->data;
+	bool read = data->flags & MMC_DATA_READ;
+	size_t len = data->blocks * data->blocksize;
+	dma_addr_t addr = (dma_addr_t)data->dest;
+	u8 *desc = cqhci_trans_desc(cq_host, slot);
+	uint seg_len;
+	u64 attr;
+
+	attr = CQHCI_VALID(1) | CQHCI_END(1) | CQHCI_INT(1) |
+	       CQHCI_ACT(CQHCI_ACT_TASK) | CQHCI_DATA_DIR(read) |
+	       CQHCI_BLK_COUNT(data->blocks) | CQHCI_BLK_ADDR(task->blk_addr);
+	put_unaligned_le64(attr, cqhci_task_desc(cq_host, slot));
+
+	while (len) {
+		seg_len = min_t(size_t, len, CQHCI_MAX_SEG_LEN);
+		len -= seg_len;
+		put_unaligned_le32(CQHCI_VALID(1) | CQHCI_END(!len) |
+				   CQHCI_ACT(CQHCI_ACT_TRAN) |
+				   CQHCI_DAT_LENGTH(seg_len), desc);
+		cqhci_set_addr(desc + 4, addr, cq_host->dma64);
+		desc += cq_host->trans_desc_len;
+		addr += seg_len;
+	}
+
+	flush_cache((ulong)cqhci_task_desc(cq_host, slot),
+		    ALIGN(cq_host->slot_sz, ARCH_DMA_MINALIGN));
+	flush_cache((ulong)cqhci_trans_desc(cq_host, slot),
+		    ALIGN(cq_host->max_segs * cq_host->trans_desc_len,
+			  ARCH_DMA_MINALIGN));
+	flush_cache((ulong)data->dest,
+		    ALIGN(data->blocks * data->blocksize, ARCH_DMA_MINALIGN));
+}
+
+static int cqhci_halt_and_clear(struct cqhci_host *cq_host)
+{
+	cqhci_writel(cq_host, CQHCI_HALT, CQHCI_CTL);
+	cqhci_wait_ctl(cq_host, CQHCI_HALT, CQHCI_HALT);
+	cqhci_writel(cq_host, CQHCI_HALT | CQHCI_CLEAR_ALL_TASKS, CQHCI_CTL);
+	cqhci_wait_ctl(cq_host, CQHCI_CLEAR_ALL_TASKS, 0);
+	cqhci_writel(cq_host, 0, CQHCI_CTL);
+
+	return -EIO;
+}
+
+int cqhci_request(struct cqhci_host *cq_host, struct mmc_cqe_task *tasks,
+		  uint count)
+{
+	struct mmc_cqe_task *slots[CQHCI_NUM_SLOTS];
+	uint depth = CQHCI_NUM_SLOTS;
+	uint next = 0, done = 0;
+	u32 busy = 0, ready, is;
+	ulong start;
+	uint slot;
+	int ret;
+
+	if (!cq_host->enabled)
+		return -EINVAL;
+
+	if (cq_host->mmc->cmdq_depth)
+		depth = min_t(uint, depth, cq_host->mmc->cmdq_depth);
+	for (slot = 0; slot < count; slot++) {
+		if (tasks[slot].data.blocks > MMC_CQE_MAX_BLOCKS)
+			return -EINVAL;
+	}
+
+	start = get_timer(0);
+	while (done < count) {
+		/* Keep the queue of the card full */
+		ready = 0;
+		for (slot = 0; slot < depth && next < count; slot++) {
+			if (busy & BIT(slot))
+				continue;
+			cqhci_prep_task(cq_host, slot, &tasks[next]);
+			slots[slot] = &tasks[next++];
+			ready |= BIT(slot);
+		}
+		if (ready) {
+			busy |= ready;
+			cqhci_writel(cq_host, ready, CQHCI_TDBR);
+			start = get_timer(0);
+		}
+
+		is = cqhci_readl(cq_host, CQHCI_IS);
+		if (is & CQHCI_IS_RED) {
+			log_debug("response error, TERRI %x\n",
+				  cqhci_readl(cq_host, CQHCI_TERRI));
+			cqhci_writel(cq_host, is, CQHCI_IS);
+			return cqhci_halt_and_clear(cq_host);
+		}
+		/* A data error does not complete the task, so do not wait */
+		if (cq_host->ops->error) {
+			ret = cq_host->ops->error(cq_host);
+			if (ret) {
+				log_debug("host error %d, pending %x\n", ret,
+					  busy);
+				cqhci_halt_and_clear(cq_host);
+				return ret;
+			}
+		}
+
+		ready = cqhci_readl(cq_host, CQHCI_TCN) & busy;
+		if (!ready) {
+			if (get_timer(start) > CQHCI_TIMEOUT_MS) {
+				log_debug("timeout, pending %x\n", busy);
+				return cqhci_halt_and_clear(cq_host);
+			}
+			continue;
+		}
+
+		cqhci_writel(cq_host, ready, CQHCI_TCN);
+		cqhci_writel(cq_host, CQHCI_IS_TCC, CQHCI_IS);
+		for (slot = 0; slot < depth; slot++) {
+			struct mmc_data *data;
+
+			if (!(ready & BIT(slot)))
+				continue;
+			data = &slots[slot]->data;
+			if (data->flags & MMC_DATA_READ)
+				invalidate_dcache_range((ulong)data->dest,
+					(ulong)data->dest +
+					ALIGN(data->blocks * data->blocksize,
+					      ARCH_DMA_MINALIGN));
+			done++;
+		}
+		busy &= ~ready;
+	}
+
+	return 0;
+}
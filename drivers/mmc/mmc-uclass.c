@@ -170,6 +170,37 @@ int mmc_deferred_probe(struct mmc *mmc)
 	return dm_mmc_deferred_probe(mmc->dev);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+int dm_mmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_enable)
+		return -ENOTSUPP;
+	return ops->cqe_enable(dev, enable);
+}
+
+int mmc_cqe_enable(struct mmc *mmc, bool enable)
+{
+	return dm_mmc_cqe_enable(mmc->dev, enable);
+}
+
+int dm_mmc_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+		       uint count)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_request)
+		return -ENOTSUPP;
+	return ops->cqe_request(dev, tasks, count);
+}
+
+int mmc_cqe_request(struct mmc *mmc, struct mmc_cqe_task *tasks, uint count)
+{
+	return dm_mmc_cqe_request(mmc->dev, tasks, count);
+}
+#endif
+
 int mmc_of_parse(struct udevice *dev, struct mmc_config *cfg)
 {
 	int val;
@@ -416,6 +447,11 @@ static int mmc_select_hwpart(struct udevice *bdev, int hwpart)
 	if (mmc->part_config == MMCPART_NOAVAILABLE)
 		return -EMEDIUMTYPE;
 
+	/* Blocks of this partition must not be written back to the next one */
+	ret = blkcache_flush(desc->if_type, desc->devnum);
+	if (ret)
+		return ret;
+
 	ret = mmc_switch_part(mmc, hwpart);
 	if (!ret)
 		blkcache_invalidate(desc->if_type, desc->devnum);
@@ -454,6 +490,7 @@ static int mmc_blk_remove(struct udevice *dev)
 
 static const struct blk_ops mmc_blk_ops = {
 	.read	= mmc_bread,
+	.read_sg	= mmc_bread_sg,
 #if CONFIG_IS_ENABLED(MMC_WRITE)
 	.write	= mmc_bwrite,
 	.erase	= mmc_berase,
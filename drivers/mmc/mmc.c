@@ -302,6 +302,42 @@ int mmc_set_blocklen(struct mmc *mmc, int len)
 	return err;
 }
 
+/**
+ * mmc_set_block_count() - Pre-define the length of a multiple-block transfer
+ *
+ * A transfer bounded by SET_BLOCK_COUNT (CMD23) ends by itself, which saves
+ * the STOP_TRANSMISSION and its busy wait of an open-ended one. The host
+ * sends CMD23 itself if it can, otherwise it is sent here.
+ *
+ * @mmc:	MMC device
+ * @data:	data of the upcoming READ/WRITE_MULTIPLE_BLOCK command
+ * @return true if the transfer is bounded, false if it must be stopped with
+ * CMD12
+ */
+bool mmc_set_block_count(struct mmc *mmc, struct mmc_data *data)
+{
+	struct mmc_cmd cmd;
+
+	if (!mmc->cmd23_support || !(mmc->host_caps & MMC_CAP_CMD23) ||
+	    mmc_host_is_spi(mmc) || data->blocks > 0xffff)
+		return false;
+
+	if (mmc->host_caps & MMC_CAP_AUTO_CMD23) {
+		data->flags |= MMC_DATA_AUTO_CMD23;
+		mmc_stats_add(mmc, auto_cmd23, 1);
+		return true;
+	}
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = data->blocks;
+	if (mmc_send_cmd(mmc, &cmd, NULL))
+		return false;
+	mmc_stats_add(mmc, set_block_count, 1);
+
+	return true;
+}
+
 #ifdef MMC_SUPPORTS_TUNING
 static const u8 tuning_blk_pattern_4bit[] = {
 	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
@@ -372,11 +408,13 @@ int mmc_send_tuning(struct mmc *mmc, u32 opcode, int *cmd_error)
 }
 #endif
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
-			   lbaint_t blkcnt)
+/* Read @data->blocks blocks from @start into the buffer(s) of @data */
+static int mmc_read_data(struct mmc *mmc, struct mmc_data *data,
+			 lbaint_t start)
 {
+	lbaint_t blkcnt = data->blocks;
 	struct mmc_cmd cmd;
-	struct mmc_data data;
+	bool stop = false;
 
 	if (blkcnt > 1)
 		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
@@ -390,15 +428,15 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 
 	cmd.resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	if (blkcnt > 1)
+		stop = !mmc_set_block_count(mmc, data);
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
+	if (mmc_send_cmd(mmc, &cmd, data))
 		return 0;
+	mmc_stats_add(mmc, read_cmds, 1);
+	mmc_stats_add(mmc, read_blocks, blkcnt);
 
-	if (blkcnt > 1) {
+	if (stop) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -408,11 +446,26 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 #endif
 			return 0;
 		}
+		mmc_stats_add(mmc, stop_transmission, 1);
 	}
 
 	return blkcnt;
 }
 
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_data data;
+
+	data.dest = dst;
+	data.blocks = blkcnt;
+	data.blocksize = mmc->read_bl_len;
+	data.flags = MMC_DATA_READ;
+	data.sg_count = 0;
+
+	return mmc_read_data(mmc, &data, start);
+}
+
 #if !CONFIG_IS_ENABLED(DM_MMC)
 static int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
 {
@@ -423,27 +476,109 @@ static int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
 }
 #endif
 
-#if CONFIG_IS_ENABLED(BLK)
-ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *dst)
-#else
-ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
-		void *dst)
-#endif
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+static bool mmc_can_cqe(struct mmc *mmc, struct blk_desc *block_dev,
+			lbaint_t blkcnt)
 {
-#if CONFIG_IS_ENABLED(BLK)
-	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	/* Command queueing cannot be enabled while RPMB is selected */
+	return mmc->cmdq_depth && (mmc->host_caps & MMC_CAP_CMDQ) &&
+	       block_dev->hwpart != MMC_PART_RPMB &&
+	       blkcnt >= CONFIG_MMC_CQE_THRESHOLD;
+}
+
+/* Switch command queueing on the card and the host engine together */
+static int mmc_cmdq_switch(struct mmc *mmc, bool enable)
+{
+	int err;
+
+	if (!enable) {
+		err = mmc_cqe_enable(mmc, false);
+		if (err)
+			return err;
+		return mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+				  EXT_CSD_CMDQ_MODE_EN, 0);
+	}
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 EXT_CSD_CMDQ_MODE_ENABLED);
+	if (err)
+		return err;
+
+	err = mmc_cqe_enable(mmc, true);
+	if (err)
+		mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN, 0);
+
+	return err;
+}
+
+/*
+ * Read through the command queue engine, in tasks of up to @b_max blocks
+ * which the card can prepare while the data of the previous ones is moved.
+ * Returns -ENOTSUPP if command queueing could not be enabled, in which case
+ * nothing was read.
+ */
+static int mmc_cqe_read(struct mmc *mmc, void *dst, lbaint_t start,
+			lbaint_t blkcnt, uint b_max)
+{
+	struct mmc_cqe_task *tasks;
+	lbaint_t cur, left = blkcnt;
+	uint count, i;
+	int err, ret;
+
+	b_max = min_t(uint, b_max, MMC_CQE_MAX_BLOCKS);
+	count = DIV_ROUND_UP(blkcnt, b_max);
+	tasks = calloc(count, sizeof(*tasks));
+	if (!tasks)
+		return -ENOTSUPP;
+
+	for (i = 0; i < count; i++) {
+		cur = min_t(lbaint_t, left, b_max);
+		if (mmc->high_capacity)
+			tasks[i].blk_addr = start;
+		else
+			tasks[i].blk_addr = start * mmc->read_bl_len;
+		tasks[i].data.dest = dst;
+		tasks[i].data.blocks = cur;
+		tasks[i].data.blocksize = mmc->read_bl_len;
+		tasks[i].data.flags = MMC_DATA_READ;
+		left -= cur;
+		start += cur;
+		dst += cur * mmc->read_bl_len;
+	}
+
+	err = mmc_cmdq_switch(mmc, true);
+	if (err) {
+		pr_debug("%s: Cannot enable command queueing (err=%d)\n",
+			 __func__, err);
+		free(tasks);
+		return -ENOTSUPP;
+	}
+
+	err = mmc_cqe_request(mmc, tasks, count);
+	ret = mmc_cmdq_switch(mmc, false);
+	free(tasks);
+	if (!err) {
+		mmc_stats_add(mmc, read_cmds, count);
+		mmc_stats_add(mmc, read_blocks, blkcnt);
+	}
+
+	return err ? err : ret;
+}
 #endif
-	int dev_num = block_dev->devnum;
+
+/* Get the device ready to read @blkcnt blocks from @start */
+static struct mmc *mmc_bread_prepare(struct blk_desc *block_dev,
+				     lbaint_t start, lbaint_t blkcnt)
+{
+	struct mmc *mmc;
 	int err;
-	lbaint_t cur, blocks_todo = blkcnt;
-	uint b_max;
 
 	if (blkcnt == 0)
-		return 0;
+		return NULL;
 
-	struct mmc *mmc = find_mmc_device(dev_num);
+	mmc = find_mmc_device(block_dev->devnum);
 	if (!mmc)
-		return 0;
+		return NULL;
 
 	if (CONFIG_IS_ENABLED(MMC_TINY))
 		err = mmc_switch_part(mmc, block_dev->hwpart);
@@ -451,23 +586,57 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
 
 	if (err < 0)
-		return 0;
+		return NULL;
 
 	if ((start + blkcnt) > block_dev->lba) {
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
 		pr_err("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
 		       start + blkcnt, block_dev->lba);
 #endif
-		return 0;
+		return NULL;
 	}
 
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
 		pr_debug("%s: Failed to set blocklen\n", __func__);
-		return 0;
+		return NULL;
 	}
 
+	return mmc;
+}
+
+#if CONFIG_IS_ENABLED(BLK)
+ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *dst)
+#else
+ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
+		void *dst)
+#endif
+{
+#if CONFIG_IS_ENABLED(BLK)
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+#endif
+	int err;
+	lbaint_t cur, blocks_todo = blkcnt;
+	struct mmc *mmc;
+	uint b_max;
+
+	mmc = mmc_bread_prepare(block_dev, start, blkcnt);
+	if (!mmc)
+		return 0;
+
 	b_max = mmc_get_b_max(mmc, dst, blkcnt);
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	if (mmc_can_cqe(mmc, block_dev, blkcnt)) {
+		err = mmc_cqe_read(mmc, dst, start, blkcnt, b_max);
+		if (!err)
+			return blkcnt;
+		if (err != -ENOTSUPP) {
+			pr_debug("%s: Failed to read blocks\n", __func__);
+			return 0;
+		}
+	}
+#endif
+
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
@@ -482,6 +651,94 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	return blkcnt;
 }
 
+#if CONFIG_IS_ENABLED(BLK)
+/* Only buffers on cache-line boundaries can be handed to the host for DMA */
+static bool mmc_sg_aligned(const struct blk_sg *sg, uint count)
+{
+	uint i;
+
+	for (i = 0; i < count; i++) {
+		if ((ulong)sg[i].buf & (ARCH_DMA_MINALIGN - 1))
+			return false;
+	}
+
+	return true;
+}
+
+ulong mmc_bread_sg(struct udevice *dev, lbaint_t start,
+		   const struct blk_sg *sg, uint count)
+{
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	lbaint_t blkcnt = 0, off = 0, cur;
+	struct mmc_data data;
+	struct blk_sg *segs;
+	uint i, n, b_max;
+	struct mmc *mmc;
+
+	for (i = 0; i < count; i++)
+		blkcnt += sg[i].blkcnt;
+
+	mmc = mmc_bread_prepare(block_dev, start, blkcnt);
+	if (!mmc)
+		return 0;
+
+	if (!mmc->cfg->max_segs || !mmc_sg_aligned(sg, count)) {
+		for (i = 0; i < count; i++) {
+			if (sg[i].blkcnt &&
+			    mmc_bread(dev, start, sg[i].blkcnt,
+				      sg[i].buf) != sg[i].blkcnt)
+				return 0;
+			start += sg[i].blkcnt;
+		}
+
+		return blkcnt;
+	}
+
+	segs = calloc(mmc->cfg->max_segs, sizeof(*segs));
+	if (!segs)
+		return 0;
+
+	data.sg = segs;
+	data.blocksize = mmc->read_bl_len;
+	b_max = mmc_get_b_max(mmc, sg[0].buf, blkcnt);
+
+	/* Cut the list into transfers of up to max_segs and b_max */
+	i = 0;
+	while (i < count) {
+		data.blocks = 0;
+		for (n = 0; i < count && n < mmc->cfg->max_segs &&
+		     data.blocks < b_max;) {
+			cur = min_t(lbaint_t, sg[i].blkcnt - off,
+				    b_max - data.blocks);
+			if (cur) {
+				segs[n].buf = sg[i].buf + off * data.blocksize;
+				segs[n++].blkcnt = cur;
+				data.blocks += cur;
+				off += cur;
+			}
+			if (off == sg[i].blkcnt) {
+				i++;
+				off = 0;
+			}
+		}
+		if (!n)
+			break;
+
+		data.flags = MMC_DATA_READ | MMC_DATA_SG;
+		data.sg_count = n;
+		if (mmc_read_data(mmc, &data, start) != data.blocks) {
+			pr_debug("%s: Failed to read blocks\n", __func__);
+			free(segs);
+			return 0;
+		}
+		start += data.blocks;
+	}
+	free(segs);
+
+	return blkcnt;
+}
+#endif
+
 static int mmc_go_idle(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
@@ -1324,6 +1581,8 @@ retry_scr:
 	if (mmc->scr[0] & SD_DATA_4BIT)
 		mmc->card_caps |= MMC_MODE_4BIT;
 
+	mmc->cmd23_support = mmc->scr[0] & SD_SCR_CMD23_SUPPORT;
+
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
 		return 0;
@@ -2236,6 +2495,9 @@ static int mmc_startup_v4(struct mmc *mmc)
 	if (IS_SD(mmc) || (mmc->version < MMC_VERSION_4))
 		return 0;
 
+	/* All devices with an EXT_CSD accept SET_BLOCK_COUNT */
+	mmc->cmd23_support = true;
+
 	/* check  ext_csd version and capacity */
 	err = mmc_send_ext_csd(mmc, ext_csd);
 	if (err)
@@ -2271,6 +2533,14 @@ static int mmc_startup_v4(struct mmc *mmc)
 	if (mmc->version >= MMC_VERSION_4_5)
 		mmc->gen_cmd6_time = ext_csd[EXT_CSD_GENERIC_CMD6_TIME];
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	mmc->cmdq_depth = 0;
+	if (mmc->version >= MMC_VERSION_5_1 &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & EXT_CSD_CMDQ_SUPPORTED))
+		mmc->cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+				   EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+#endif
+
 	/* The partition data may be non-zero but it is only
 	 * effective if PARTITION_SETTING_COMPLETED is set in
 	 * EXT_CSD, so ignore any data if this bit is not set,
@@ -2410,6 +2680,8 @@ static int mmc_startup(struct mmc *mmc)
 	struct mmc_cmd cmd;
 	struct blk_desc *bdesc;
 
+	mmc->cmd23_support = false;
+
 #ifdef CONFIG_MMC_SPI_CRC_ON
 	if (mmc_host_is_spi(mmc)) { /* enable CRC check for spi */
 		cmd.cmdidx = MMC_CMD_SPI_CRC_ON_OFF;
@@ -234,9 +234,15 @@ static int mmc_select_hwpartp(struct blk_desc *desc, int hwpart)
 	if (mmc->part_config == MMCPART_NOAVAILABLE)
 		return -EMEDIUMTYPE;
 
+	/* Blocks of this partition must not be written back to the next one */
+	ret = blkcache_flush(desc->if_type, desc->devnum);
+	if (ret)
+		return ret;
+
 	ret = mmc_switch_part(mmc, hwpart);
 	if (ret)
 		return ret;
+	blkcache_invalidate(desc->if_type, desc->devnum);
 
 	return 0;
 }
@@ -16,6 +16,13 @@ int mmc_send_status(struct mmc *mmc, unsigned int *status);
 int mmc_poll_for_busy(struct mmc *mmc, int timeout);
 
 int mmc_set_blocklen(struct mmc *mmc, int len);
+bool mmc_set_block_count(struct mmc *mmc, struct mmc_data *data);
+
+#if CONFIG_IS_ENABLED(MMC_STATS)
+#define mmc_stats_add(mmc, field, n)	((mmc)->stats.field += (n))
+#else
+#define mmc_stats_add(mmc, field, n)	do { } while (0)
+#endif
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 void mmc_adapter_card_type_ident(void);
 #endif
@@ -23,6 +30,8 @@ void mmc_adapter_card_type_ident(void);
 #if CONFIG_IS_ENABLED(BLK)
 ulong mmc_bread(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		void *dst);
+ulong mmc_bread_sg(struct udevice *dev, lbaint_t start,
+		   const struct blk_sg *sg, uint count);
 #else
 ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		void *dst);
@@ -5,18 +5,205 @@
  */
 
 #include <common.h>
+#include <blk.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <errno.h>
 #include <fdtdec.h>
 #include <log.h>
 #include <mmc.h>
+#include <os.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
+
+#define SANDBOX_EMMC_BLOCKS	(64 << 11)	/* 64MiB */
+/* Like a host whose DMA cannot cross a 32KiB boundary */
+#define SANDBOX_EMMC_B_MAX	64
+#define SANDBOX_EMMC_MAX_SEGS	16
+
+/* Timings of the eMMC model, in ns */
+#define SANDBOX_EMMC_T_HOST	5000	/* software issuing a command */
+#define SANDBOX_EMMC_T_CMD	2000	/* command and response */
+#define SANDBOX_EMMC_T_ACC	100000	/* from a read command to the data */
+#define SANDBOX_EMMC_T_BLK	10000	/* a block on an 8-bit 52MHz bus */
+#define SANDBOX_EMMC_T_PROG	200000	/* busy after writing */
+#define SANDBOX_EMMC_T_SWITCH	10000	/* busy after CMD6 */
+#define SANDBOX_EMMC_T_STOP	20000	/* busy after CMD12 */
 
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
 };
 
+/**
+ * struct sandbox_mmc_priv - State of an emulated eMMC
+ *
+ * Devices with the "sandbox,emmc" property emulate an eMMC 5.1 device with
+ * RAM-backed storage and a virtual clock; others emulate a simple SD card.
+ *
+ * @emmc: true to emulate an eMMC
+ * @buf: contents of the user area
+ * @ext_csd: EXT_CSD register
+ * @now: virtual time in ns
+ * @block_count: length of the next multiple-block transfer set by CMD23, or 0
+ * @open_ended: an open-ended multiple-block transfer waits for CMD12
+ * @cqe: command queue engine, if the node has "supports-cqe"
+ * @cq_regs: registers of the command queue engine
+ * @cq_done: time at which the task in each slot completes
+ * @cq_cmd_free: time at which the CMD line is free to queue a task
+ * @cq_prep_free: time at which the card can start preparing a task
+ * @cq_bus_free: time at which the data bus is free
+ * @cq_tasks: number of tasks run
+ * @cq_max_queued: largest number of tasks queued on the card at once
+ */
+struct sandbox_mmc_priv {
+	bool emmc;
+	u8 *buf;
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	u64 now;
+	uint block_count;
+	bool open_ended;
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	struct cqhci_host cqe;
+	u32 cq_regs[CQHCI_CRA / 4 + 1];
+	u64 cq_done[CQHCI_NUM_SLOTS];
+	u64 cq_cmd_free;
+	u64 cq_prep_free;
+	u64 cq_bus_free;
+	uint cq_tasks;
+	uint cq_max_queued;
+#endif
+};
+
+static int sandbox_emmc_xfer(struct sandbox_mmc_priv *priv, uint addr,
+			     bool multi, struct mmc_data *data)
+{
+	size_t size = data->blocks * data->blocksize;
+	uint block_count = priv->block_count;
+	const struct blk_sg *sg;
+	u8 *mem;
+	uint i;
+
+	if (data->blocksize != MMC_MAX_BLOCK_LEN ||
+	    addr + data->blocks > SANDBOX_EMMC_BLOCKS)
+		return -EINVAL;
+
+	if (data->flags & MMC_DATA_AUTO_CMD23) {
+		priv->now += SANDBOX_EMMC_T_CMD;
+		block_count = data->blocks;
+	}
+	priv->block_count = 0;
+	if (multi) {
+		/* A pre-defined transfer stops by itself */
+		if (block_count && block_count != data->blocks)
+			return -EIO;
+		priv->open_ended = !block_count;
+	}
+
+	mem = priv->buf + addr * MMC_MAX_BLOCK_LEN;
+	if (data->flags & MMC_DATA_SG) {
+		if (!(data->flags & MMC_DATA_READ))
+			return -EINVAL;
+		size = 0;
+		for (i = 0, sg = data->sg; i < data->sg_count; i++, sg++) {
+			memcpy(sg->buf, mem, sg->blkcnt * data->blocksize);
+			mem += sg->blkcnt * data->blocksize;
+			size += sg->blkcnt * data->blocksize;
+		}
+		if (size != data->blocks * data->blocksize)
+			return -EINVAL;
+		priv->now += SANDBOX_EMMC_T_ACC;
+	} else if (data->flags & MMC_DATA_READ) {
+		memcpy(data->dest, mem, size);
+		priv->now += SANDBOX_EMMC_T_ACC;
+	} else {
+		memcpy(mem, data->src, size);
+		priv->now += SANDBOX_EMMC_T_PROG;
+	}
+	priv->now += data->blocks * SANDBOX_EMMC_T_BLK;
+
+	return 0;
+}
+
+/* Emulate eMMC commands, for a high-capacity device in block addressing */
+static int sandbox_emmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
+				 struct mmc_data *data)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	uint csize = SANDBOX_EMMC_BLOCKS / 1024 - 1;
+	uint index;
+
+	priv->now += SANDBOX_EMMC_T_HOST + SANDBOX_EMMC_T_CMD;
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] = 0;
+		break;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS | MMC_VDD_165_195 |
+				   MMC_VDD_32_33 | MMC_VDD_33_34;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		memset(cmd->response, '\0', sizeof(cmd->response));
+		break;
+	case MMC_CMD_SEND_CSD:
+		cmd->response[0] = 4 << 26 | 0x32;	/* MMC v4, 25MHz */
+		cmd->response[1] = 9 << 16 | csize >> 16;
+		cmd->response[2] = (csize & 0xffff) << 16;
+		cmd->response[3] = 9 << 22;
+		break;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* There is no SD CMD8 */
+		if (!data)
+			return -ETIMEDOUT;
+		memcpy(data->dest, priv->ext_csd, MMC_MAX_BLOCK_LEN);
+		priv->now += SANDBOX_EMMC_T_BLK;
+		break;
+	case MMC_CMD_APP_CMD:
+		return -ETIMEDOUT;
+	case MMC_CMD_SWITCH:
+		index = (cmd->cmdarg >> 16) & 0xff;
+		priv->ext_csd[index] = (cmd->cmdarg >> 8) & 0xff;
+		priv->now += SANDBOX_EMMC_T_SWITCH;
+		break;
+	case MMC_CMD_SEND_STATUS:
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA;
+		break;
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		/* Only queued tasks can move data while queueing is on */
+		if (priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] &
+		    EXT_CSD_CMDQ_MODE_ENABLED)
+			return -EIO;
+		if (!data)
+			return -EINVAL;
+		return sandbox_emmc_xfer(priv, cmd->cmdarg,
+				cmd->cmdidx == MMC_CMD_READ_MULTIPLE_BLOCK ||
+				cmd->cmdidx == MMC_CMD_WRITE_MULTIPLE_BLOCK,
+				data);
+	case MMC_CMD_SET_BLOCK_COUNT:
+		priv->block_count = cmd->cmdarg & 0xffff;
+		break;
+	case MMC_CMD_STOP_TRANSMISSION:
+		/* Only an open-ended transfer can be stopped */
+		if (!priv->open_ended)
+			return -EIO;
+		priv->open_ended = false;
+		priv->now += SANDBOX_EMMC_T_STOP;
+		break;
+	case MMC_CMD_SET_RELATIVE_ADDR:
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SET_BLOCKLEN:
+		break;
+	default:
+		debug("%s: Unknown command %d\n", __func__, cmd->cmdidx);
+		break;
+	}
+
+	return 0;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
@@ -26,6 +213,11 @@ struct sandbox_mmc_plat {
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (priv->emmc)
+		return sandbox_emmc_send_cmd(dev, cmd, data);
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		memset(cmd->response, '\0', sizeof(cmd->response));
@@ -59,10 +251,11 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		break;
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
-		memset(data->dest, '\0', data->blocksize);
-		break;
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
-		strcpy(data->dest, "this is a test");
+		/* Only the first block holds anything */
+		memset(data->dest, '\0', data->blocks * data->blocksize);
+		if (!cmd->cmdarg)
+			strcpy(data->dest, "this is a test");
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
 		break;
@@ -100,19 +293,278 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+/*
+ * The command queue engine and the card behind it. Tasks are queued with
+ * CMD44/CMD45 one after the other, the card prepares them one at a time
+ * and their data then takes turns on the bus, so the card prepares a task
+ * while the data of the previous one is moved.
+ */
+static void sandbox_cqhci_queue(struct sandbox_mmc_priv *priv, uint slot)
+{
+	u32 cfg = priv->cq_regs[CQHCI_CFG / 4];
+	uint desc_len = cfg & CQHCI_TASK_DESC_SZ ? 16 : 8;
+	uint depth = (priv->ext_csd[EXT_CSD_CMDQ_DEPTH] &
+		      EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+	uint queued = hweight32(priv->cq_regs[CQHCI_TDBR / 4]);
+	struct mmc_data data;
+	u8 *desc, *link, *tran;
+	uint addr, len;
+	u64 attr, start;
+
+	desc = (u8 *)(uintptr_t)((u64)priv->cq_regs[CQHCI_TDLBAU / 4] << 32 |
+				 priv->cq_regs[CQHCI_TDLBA / 4]);
+	desc += slot * desc_len * 2;
+	link = desc + desc_len;
+	attr = get_unaligned_le64(desc);
+	addr = attr >> 32;
+	data.blocks = (attr >> 16) & 0xffff;
+	data.blocksize = MMC_MAX_BLOCK_LEN;
+	data.flags = attr & CQHCI_DATA_DIR(1) ? MMC_DATA_READ : MMC_DATA_WRITE;
+
+	if (!(attr & CQHCI_VALID(1)) ||
+	    (attr & CQHCI_ACT(7)) != CQHCI_ACT(CQHCI_ACT_TASK) ||
+	    !(priv->ext_csd[EXT_CSD_CMDQ_MODE_EN] &
+	      EXT_CSD_CMDQ_MODE_ENABLED) || queued >= depth ||
+	    (get_unaligned_le32(link) & CQHCI_ACT(7)) !=
+	     CQHCI_ACT(CQHCI_ACT_LINK) ||
+	    addr + data.blocks > SANDBOX_EMMC_BLOCKS) {
+		priv->cq_regs[CQHCI_TERRI / 4] = slot << 8 | BIT(15);
+		priv->cq_regs[CQHCI_IS / 4] |= CQHCI_IS_RED;
+		return;
+	}
+
+	/* Move the data now, the host only looks at it once completed */
+	tran = (u8 *)(uintptr_t)(desc_len == 16 ?
+				 get_unaligned_le64(link + 4) :
+				 get_unaligned_le32(link + 4));
+	for (;; tran += desc_len) {
+		attr = get_unaligned_le32(tran);
+		len = attr >> 16;
+		data.dest = (char *)(uintptr_t)(desc_len == 16 ?
+						get_unaligned_le64(tran + 4) :
+						get_unaligned_le32(tran + 4));
+		data.blocks = len / MMC_MAX_BLOCK_LEN;
+		if (data.flags & MMC_DATA_READ)
+			memcpy(data.dest, priv->buf + addr * MMC_MAX_BLOCK_LEN,
+			       len);
+		else
+			memcpy(priv->buf + addr * MMC_MAX_BLOCK_LEN, data.dest,
+			       len);
+		addr += data.blocks;
+		if (attr & CQHCI_END(1))
+			break;
+	}
+
+	data.blocks = (get_unaligned_le64(desc) >> 16) & 0xffff;
+	start = max(priv->now, priv->cq_cmd_free) + 2 * SANDBOX_EMMC_T_CMD;
+	priv->cq_cmd_free = start;
+	start = max(start, priv->cq_prep_free) + SANDBOX_EMMC_T_ACC;
+	priv->cq_prep_free = start;
+	start = max(start, priv->cq_bus_free) + SANDBOX_EMMC_T_CMD +
+		data.blocks * SANDBOX_EMMC_T_BLK;
+	if (data.flags & MMC_DATA_WRITE)
+		start += SANDBOX_EMMC_T_PROG;
+	priv->cq_bus_free = start;
+	priv->cq_done[slot] = start;
+
+	priv->cq_regs[CQHCI_TDBR / 4] |= BIT(slot);
+	priv->cq_tasks++;
+	priv->cq_max_queued = max(priv->cq_max_queued, queued + 1);
+}
+
+/* Report the tasks completed, waiting for the next one if none is */
+static void sandbox_cqhci_complete(struct sandbox_mmc_priv *priv)
+{
+	u32 pending = priv->cq_regs[CQHCI_TDBR / 4];
+	u64 next = U64_MAX;
+	u32 done = 0;
+	uint slot;
+
+	if (!pending)
+		return;
+
+	for (slot = 0; slot < CQHCI_NUM_SLOTS; slot++) {
+		if (!(pending & BIT(slot)))
+			continue;
+		if (priv->cq_done[slot] <= priv->now)
+			done |= BIT(slot);
+		next = min(next, priv->cq_done[slot]);
+	}
+	if (!done) {
+		priv->now = next;
+		for (slot = 0; slot < CQHCI_NUM_SLOTS; slot++) {
+			if ((pending & BIT(slot)) &&
+			    priv->cq_done[slot] <= priv->now)
+				done |= BIT(slot);
+		}
+	}
+
+	priv->cq_regs[CQHCI_TDBR / 4] &= ~done;
+	priv->cq_regs[CQHCI_TCN / 4] |= done;
+	if (priv->cq_regs[CQHCI_ISTE / 4] & CQHCI_IS_TCC)
+		priv->cq_regs[CQHCI_IS / 4] |= CQHCI_IS_TCC;
+}
+
+static u32 sandbox_cqhci_read_l(struct cqhci_host *cq_host, int reg)
+{
+	struct sandbox_mmc_priv *priv = cq_host->priv;
+
+	if (reg == CQHCI_TCN)
+		sandbox_cqhci_complete(priv);
+
+	return priv->cq_regs[reg / 4];
+}
+
+static void sandbox_cqhci_write_l(struct cqhci_host *cq_host, u32 val,
+				  int reg)
+{
+	struct sandbox_mmc_priv *priv = cq_host->priv;
+	u32 *regs = priv->cq_regs;
+	uint slot;
+
+	switch (reg) {
+	case CQHCI_CTL:
+		/* Halting and clearing take effect at once */
+		if (val & CQHCI_CLEAR_ALL_TASKS) {
+			regs[CQHCI_TDBR / 4] = 0;
+			regs[CQHCI_TCN / 4] = 0;
+		}
+		regs[CQHCI_CTL / 4] = val & CQHCI_HALT;
+		break;
+	case CQHCI_IS:
+	case CQHCI_TCN:
+		regs[reg / 4] &= ~val;
+		break;
+	case CQHCI_TDBR:
+		if (!(regs[CQHCI_CFG / 4] & CQHCI_ENABLE) ||
+		    (regs[CQHCI_CTL / 4] & CQHCI_HALT))
+			break;
+		val &= ~regs[CQHCI_TDBR / 4];
+		for (slot = 0; slot < CQHCI_NUM_SLOTS; slot++) {
+			if (val & BIT(slot))
+				sandbox_cqhci_queue(priv, slot);
+		}
+		break;
+	default:
+		regs[reg / 4] = val;
+		break;
+	}
+}
+
+static const struct cqhci_host_ops sandbox_cqhci_ops = {
+	.write_l	= sandbox_cqhci_write_l,
+	.read_l		= sandbox_cqhci_read_l,
+};
+
+static int sandbox_mmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->cqe.ops)
+		return -ENOTSUPP;
+
+	return cqhci_enable(&priv->cqe, enable);
+}
+
+static int sandbox_mmc_cqe_request(struct udevice *dev,
+				   struct mmc_cqe_task *tasks, uint count)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->cqe.ops)
+		return -ENOTSUPP;
+
+	return cqhci_request(&priv->cqe, tasks, count);
+}
+
+uint sandbox_mmc_get_cqe_tasks(struct udevice *dev, uint *max_queuedp)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	*max_queuedp = priv->cq_max_queued;
+
+	return priv->cq_tasks;
+}
+#endif
+
+u64 sandbox_mmc_get_time(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->now;
+}
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	.cqe_enable = sandbox_mmc_cqe_enable,
+	.cqe_request = sandbox_mmc_cqe_request,
+#endif
 };
 
+static int sandbox_emmc_probe(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	u8 *ext_csd = priv->ext_csd;
+
+	priv->buf = os_malloc(SANDBOX_EMMC_BLOCKS * MMC_MAX_BLOCK_LEN);
+	if (!priv->buf)
+		return -ENOMEM;
+
+	ext_csd[EXT_CSD_REV] = 8;	/* v5.1 */
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+				     EXT_CSD_CARD_TYPE_52;
+	put_unaligned_le32(SANDBOX_EMMC_BLOCKS, ext_csd + EXT_CSD_SEC_CNT);
+	ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_HC_WP_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_GENERIC_CMD6_TIME] = 1;
+	ext_csd[EXT_CSD_CMDQ_SUPPORT] = EXT_CSD_CMDQ_SUPPORTED;
+	ext_csd[EXT_CSD_CMDQ_DEPTH] = 15;	/* 16 tasks */
+
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	if (dev_read_bool(dev, "supports-cqe")) {
+		struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+		int ret;
+
+		priv->cqe.ops = &sandbox_cqhci_ops;
+		priv->cqe.priv = priv;
+		ret = cqhci_init(&priv->cqe, &plat->mmc, true);
+		if (ret)
+			return ret;
+	}
+#endif
+
+	return 0;
+}
+
 int sandbox_mmc_probe(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	int ret;
+
+	priv->emmc = dev_read_bool(dev, "sandbox,emmc");
+	if (priv->emmc) {
+		ret = sandbox_emmc_probe(dev);
+		if (ret)
+			return ret;
+	}
 
 	return mmc_init(&plat->mmc);
 }
 
+static int sandbox_mmc_remove(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	os_free(priv->buf);
+
+	return 0;
+}
+
 int sandbox_mmc_bind(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
@@ -124,6 +576,14 @@ int sandbox_mmc_bind(struct udevice *dev)
 	cfg->f_min = 1000000;
 	cfg->f_max = 52000000;
 	cfg->b_max = U32_MAX;
+	if (dev_read_bool(dev, "sandbox,emmc")) {
+		cfg->host_caps |= MMC_CAP_CMD23 | MMC_CAP_AUTO_CMD23;
+		cfg->b_max = SANDBOX_EMMC_B_MAX;
+		cfg->max_segs = SANDBOX_EMMC_MAX_SEGS;
+		if (CONFIG_IS_ENABLED(MMC_CQHCI) &&
+		    dev_read_bool(dev, "supports-cqe"))
+			cfg->host_caps |= MMC_CAP_CMDQ;
+	}
 
 	return mmc_bind(dev, &plat->mmc, cfg);
 }
@@ -148,5 +608,7 @@ U_BOOT_DRIVER(mmc_sandbox) = {
 	.bind		= sandbox_mmc_bind,
 	.unbind		= sandbox_mmc_unbind,
 	.probe		= sandbox_mmc_probe,
+	.remove		= sandbox_mmc_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 	.platdata_auto_alloc_size = sizeof(struct sandbox_mmc_plat),
 };
@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <dm/device.h>
 #include <linux/io.h>
@@ -16,12 +17,85 @@
 #define SDHCI_DWCMSHC_FMAX 180000000
 #define SDHCI_DWCMSHC_FMIN 400000
 
+/* Offsets of the vendor register areas */
+#define DWCMSHC_P_VENDOR_AREA1		0xe8
+#define DWCMSHC_P_VENDOR_AREA2		0xea
+#define DWCMSHC_AREA_MASK		GENMASK(11, 0)
+
+/* In vendor area 1 */
+#define DWCMSHC_EMMC_CONTROL		0x2c
+#define  DWCMSHC_CARD_IS_EMMC		BIT(0)
+
 struct sdhci_dwcmshc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
 	void __iomem *ioaddr;
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	struct cqhci_host cqe;
+#endif
+};
+
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+static int sdhci_dwcmshc_cqe_enable(struct cqhci_host *cq_host)
+{
+	struct sdhci_host *host = cq_host->priv;
+	u16 area1, ctrl;
+
+	/* The engine only sends eMMC commands if told the card is one */
+	area1 = sdhci_readw(host, DWCMSHC_P_VENDOR_AREA1) & DWCMSHC_AREA_MASK;
+	ctrl = sdhci_readw(host, area1 + DWCMSHC_EMMC_CONTROL);
+	sdhci_writew(host, ctrl | DWCMSHC_CARD_IS_EMMC,
+		     area1 + DWCMSHC_EMMC_CONTROL);
+	sdhci_cqe_enable(host);
+
+	return 0;
+}
+
+static void sdhci_dwcmshc_cqe_disable(struct cqhci_host *cq_host)
+{
+	sdhci_cqe_disable(cq_host->priv);
+}
+
+static int sdhci_dwcmshc_cqe_error(struct cqhci_host *cq_host)
+{
+	return sdhci_cqe_error(cq_host->priv);
+}
+
+static const struct cqhci_host_ops sdhci_dwcmshc_cqhci_ops = {
+	.enable		= sdhci_dwcmshc_cqe_enable,
+	.disable	= sdhci_dwcmshc_cqe_disable,
+	.error		= sdhci_dwcmshc_cqe_error,
 };
 
+/* The command queue engine registers sit in vendor area 2 */
+static int sdhci_dwcmshc_cqe_init(struct udevice *dev,
+				  struct sdhci_host *host)
+{
+	struct sdhci_dwcmshc_plat *plat = dev_get_platdata(dev);
+	struct cqhci_host *cq_host = &plat->cqe;
+	u16 area2;
+	int ret;
+
+	if (!dev_read_bool(dev, "supports-cqe"))
+		return 0;
+
+	area2 = sdhci_readw(host, DWCMSHC_P_VENDOR_AREA2) & DWCMSHC_AREA_MASK;
+	cq_host->mmio = plat->ioaddr + area2;
+	cq_host->ops = &sdhci_dwcmshc_cqhci_ops;
+	cq_host->priv = host;
+
+	/* DRAM is below 4GiB, so 32-bit descriptors are enough */
+	ret = cqhci_init(cq_host, &plat->mmc, false);
+	if (ret)
+		return ret;
+
+	host->cqe = cq_host;
+	plat->cfg.host_caps |= MMC_CAP_CMDQ;
+
+	return 0;
+}
+#endif
+
 static int sdhci_dwcmshc_bind(struct udevice *dev)
 {
 	struct sdhci_dwcmshc_plat *plat = dev_get_platdata(dev);
@@ -52,7 +126,8 @@ static int sdhci_dwcmshc_probe(struct udevice *dev)
 	host->name = dev->name;
 	host->ioaddr = plat->ioaddr;
 	host->quirks = SDHCI_QUIRK_NO_HISPD_BIT | SDHCI_QUIRK_BROKEN_VOLTAGE |
-		       SDHCI_QUIRK_32BIT_DMA_ADDR;// | SDHCI_QUIRK_WAIT_SEND_CMD;
+		       SDHCI_QUIRK_32BIT_DMA_ADDR |
+		       SDHCI_QUIRK_ADMA_128M_BOUNDARY;// | SDHCI_QUIRK_WAIT_SEND_CMD;
 	/* MMC_VDD_32_33 | MMC_VDD_33_34 | MMC_VDD_165_195 */
 	host->voltages = MMC_VDD_165_195;
 
@@ -63,6 +138,11 @@ static int sdhci_dwcmshc_probe(struct udevice *dev)
 
 	if (ret)
 		return ret;
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	ret = sdhci_dwcmshc_cqe_init(dev, host);
+	if (ret)
+		return ret;
+#endif
 	upriv->mmc = &plat->mmc;
 	host->mmc->priv = host;
 	return sdhci_probe(dev);
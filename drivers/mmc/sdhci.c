@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <cpu_func.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
@@ -20,6 +21,7 @@
 #include <linux/bitops.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/sizes.h>
 #include <phys2bus.h>
 
 static void sdhci_reset(struct sdhci_host *host, u8 mask)
@@ -63,7 +65,7 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 	char *offs;
 	for (i = 0; i < data->blocksize; i += 4) {
 		offs = data->dest + i;
-		if (data->flags == MMC_DATA_READ)
+		if (data->flags & MMC_DATA_READ)
 			*(u32 *)offs = sdhci_readl(host, SDHCI_BUFFER);
 		else
 			sdhci_writel(host, *(u32 *)offs, SDHCI_BUFFER);
@@ -72,20 +74,12 @@ static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 static void sdhci_adma_desc(struct sdhci_host *host, dma_addr_t dma_addr,
-			    u16 len, bool end)
+			    u16 len)
 {
 	struct sdhci_adma_desc *desc;
-	u8 attr;
 
-	desc = &host->adma_desc_table[host->desc_slot];
-
-	attr = ADMA_DESC_ATTR_VALID | ADMA_DESC_TRANSFER_DATA;
-	if (!end)
-		host->desc_slot++;
-	else
-		attr |= ADMA_DESC_ATTR_END;
-
-	desc->attr = attr;
+	desc = &host->adma_desc_table[host->desc_slot++];
+	desc->attr = ADMA_DESC_ATTR_VALID | ADMA_DESC_TRANSFER_DATA;
 	desc->len = len;
 	desc->reserved = 0;
 	desc->addr_lo = lower_32_bits(dma_addr);
@@ -94,26 +88,46 @@ static void sdhci_adma_desc(struct sdhci_host *host, dma_addr_t dma_addr,
 #endif
 }
 
+/* Describe a buffer, split where a descriptor cannot go on */
+static void sdhci_adma_add(struct sdhci_host *host, dma_addr_t dma_addr,
+			   uint len)
+{
+	uint seg;
+
+	while (len) {
+		seg = min_t(uint, len, ADMA_MAX_LEN);
+		if (host->quirks & SDHCI_QUIRK_ADMA_128M_BOUNDARY)
+			seg = min_t(uint, seg,
+				    SZ_128M - (dma_addr & (SZ_128M - 1)));
+		sdhci_adma_desc(host, dma_addr, seg);
+		dma_addr += seg;
+		len -= seg;
+	}
+}
+
 static void sdhci_prepare_adma_table(struct sdhci_host *host,
 				     struct mmc_data *data)
 {
-	uint trans_bytes = data->blocksize * data->blocks;
-	uint desc_count = DIV_ROUND_UP(trans_bytes, ADMA_MAX_LEN);
-	int i = desc_count;
-	dma_addr_t dma_addr = host->start_addr;
+	const struct blk_sg *sg;
+	uint i, len;
 
 	host->desc_slot = 0;
 
-	while (--i) {
-		sdhci_adma_desc(host, dma_addr, ADMA_MAX_LEN, false);
-		dma_addr += ADMA_MAX_LEN;
-		trans_bytes -= ADMA_MAX_LEN;
+	if (data->flags & MMC_DATA_SG) {
+		/* One chain for all the segments, mapped one by one */
+		for (i = 0, sg = data->sg; i < data->sg_count; i++, sg++) {
+			len = sg->blkcnt * data->blocksize;
+			sdhci_adma_add(host, dma_map_single(sg->buf, len,
+						mmc_get_dma_dir(data)), len);
+		}
+	} else {
+		sdhci_adma_add(host, host->start_addr,
+			       data->blocksize * data->blocks);
 	}
-
-	sdhci_adma_desc(host, dma_addr, trans_bytes, true);
+	host->adma_desc_table[host->desc_slot - 1].attr |= ADMA_DESC_ATTR_END;
 
 	flush_cache((dma_addr_t)host->adma_desc_table,
-		    ROUND(desc_count * sizeof(struct sdhci_adma_desc),
+		    ROUND(host->desc_slot * sizeof(struct sdhci_adma_desc),
 			  ARCH_DMA_MINALIGN));
 }
 #elif defined(CONFIG_MMC_SDHCI_SDMA)
@@ -128,7 +142,7 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 	unsigned char ctrl;
 	void *buf;
 
-	if (data->flags == MMC_DATA_READ)
+	if (data->flags & MMC_DATA_READ)
 		buf = data->dest;
 	else
 		buf = (void *)data->src;
@@ -146,13 +160,15 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 	     (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR &&
 	      ((unsigned long)buf & 0x7) != 0x0))) {
 		*is_aligned = 0;
-		if (data->flags != MMC_DATA_READ)
+		if (!(data->flags & MMC_DATA_READ))
 			memcpy(host->align_buffer, buf, trans_bytes);
 		buf = host->align_buffer;
 	}
 
-	host->start_addr = dma_map_single(buf, trans_bytes,
-					  mmc_get_dma_dir(data));
+	/* Segments of a scatter-gather transfer are mapped in the table */
+	if (!(data->flags & MMC_DATA_SG))
+		host->start_addr = dma_map_single(buf, trans_bytes,
+						  mmc_get_dma_dir(data));
 
 	if (host->flags & USE_SDMA) {
 		sdhci_writel(host, phys_to_bus((ulong)host->start_addr),
@@ -172,6 +188,24 @@ static void sdhci_prepare_dma(struct sdhci_host *host, struct mmc_data *data,
 			      int *is_aligned, int trans_bytes)
 {}
 #endif
+static void sdhci_unmap_data(struct sdhci_host *host, struct mmc_data *data)
+{
+	const struct blk_sg *sg;
+	uint i;
+
+	if (!(data->flags & MMC_DATA_SG)) {
+		dma_unmap_single(host->start_addr,
+				 data->blocks * data->blocksize,
+				 mmc_get_dma_dir(data));
+		return;
+	}
+
+	for (i = 0, sg = data->sg; i < data->sg_count; i++, sg++)
+		dma_unmap_single((dma_addr_t)(ulong)sg->buf,
+				 sg->blkcnt * data->blocksize,
+				 mmc_get_dma_dir(data));
+}
+
 static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 {
 	dma_addr_t start_addr = host->start_addr;
@@ -222,8 +256,7 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 		}
 	} while (!(stat & SDHCI_INT_DATA_END));
 
-	dma_unmap_single(host->start_addr, data->blocks * data->blocksize,
-			 mmc_get_dma_dir(data));
+	sdhci_unmap_data(host, data);
 
 	return 0;
 }
@@ -322,7 +355,13 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->blocks > 1)
 			mode |= SDHCI_TRNS_MULTI;
 
-		if (data->flags == MMC_DATA_READ)
+		/* The argument of CMD23 goes where SDMA keeps its address */
+		if (data->flags & MMC_DATA_AUTO_CMD23) {
+			mode |= SDHCI_TRNS_AUTO_CMD23;
+			sdhci_writel(host, data->blocks, SDHCI_ARGUMENT2);
+		}
+
+		if (data->flags & MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
 		if (host->flags & USE_DMA) {
@@ -374,7 +413,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
 	if (!ret) {
 		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				!is_aligned && (data->flags == MMC_DATA_READ))
+				!is_aligned && (data->flags & MMC_DATA_READ))
 			memcpy(data->dest, host->align_buffer, trans_bytes);
 		return 0;
 	}
@@ -721,6 +760,74 @@ static int sdhci_get_cd(struct udevice *dev)
 		return value;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+void sdhci_cqe_enable(struct sdhci_host *host)
+{
+	u8 ctrl;
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	if (host->cqe->dma64)
+		ctrl |= SDHCI_CTRL_ADMA64;
+	else
+		ctrl |= SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG, 512),
+		     SDHCI_BLOCK_SIZE);
+	sdhci_writeb(host, 0xe, SDHCI_TIMEOUT_CONTROL);
+	sdhci_writel(host, SDHCI_INT_CQE | SDHCI_INT_ERROR_MASK,
+		     SDHCI_INT_ENABLE);
+}
+
+void sdhci_cqe_disable(struct sdhci_host *host)
+{
+	sdhci_writel(host, SDHCI_INT_DATA_MASK | SDHCI_INT_CMD_MASK,
+		     SDHCI_INT_ENABLE);
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	sdhci_reset(host, SDHCI_RESET_CMD);
+	sdhci_reset(host, SDHCI_RESET_DATA);
+}
+
+int sdhci_cqe_error(struct sdhci_host *host)
+{
+	u32 stat;
+
+	stat = sdhci_readl(host, SDHCI_INT_STATUS) & SDHCI_INT_ERROR_MASK;
+	if (!stat)
+		return 0;
+	sdhci_writel(host, stat, SDHCI_INT_STATUS);
+
+	if (stat & (SDHCI_INT_TIMEOUT | SDHCI_INT_DATA_TIMEOUT))
+		return -ETIMEDOUT;
+
+	return -EIO;
+}
+
+static int sdhci_cqe_enable_ops(struct udevice *dev, bool enable)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	if (!host->cqe)
+		return -ENOTSUPP;
+
+	return cqhci_enable(host->cqe, enable);
+}
+
+static int sdhci_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+			     uint count)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	if (!host->cqe)
+		return -ENOTSUPP;
+
+	return cqhci_request(host->cqe, tasks, count);
+}
+#endif
+
 const struct dm_mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
@@ -729,6 +836,10 @@ const struct dm_mmc_ops sdhci_ops = {
 #ifdef MMC_SUPPORTS_TUNING
 	.execute_tuning	= sdhci_execute_tuning,
 #endif
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	.cqe_enable	= sdhci_cqe_enable_ops,
+	.cqe_request	= sdhci_cqe_request,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
@@ -779,6 +890,7 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 #else
 	host->flags |= USE_ADMA;
 #endif
+	cfg->max_segs = ADMA_MAX_SEGS;
 #endif
 	if (host->quirks & SDHCI_QUIRK_REG32_RW)
 		host->version =
@@ -845,11 +957,16 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 		cfg->voltages |= host->voltages;
 
 	cfg->host_caps |= MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT;
+	cfg->host_caps |= MMC_CAP_CMD23;
 
 	/* Since Host Controller Version3.0 */
 	if (SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300) {
 		if (!(caps & SDHCI_CAN_DO_8BIT))
 			cfg->host_caps &= ~MMC_MODE_8BIT;
+		/* SDMA needs the register that holds the CMD23 argument */
+		if (!(host->flags & USE_SDMA) &&
+		    !(host->quirks & SDHCI_QUIRK_BROKEN_AUTO_CMD23))
+			cfg->host_caps |= MMC_CAP_AUTO_CMD23;
 	}
 
 	if (host->quirks & SDHCI_QUIRK_BROKEN_HISPD_MODE) {
@@ -17,6 +17,7 @@
 #include <linux/delay.h>
 #include <nand.h>
 #include <clk.h>
+#include <watchdog.h>
 
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/rawnand.h>
@@ -675,6 +676,89 @@ static int ma35d1_nand_read_page_hwecc_oob_first(struct mtd_info *mtd, struct na
 	return 0;
 }
 
+/*
+ * Issue READ CACHE SEQUENTIAL or READ CACHE END and wait until the page is
+ * in the cache register
+ */
+static void ma35d1_nand_cache_command(struct ma35d1_nand_info *nand_info, int command)
+{
+	// Clear Ready/Busy 0 Rising edge detect flag
+	writel(0x400, nand_info->reg+REG_SMISR);
+	writel(command, nand_info->reg+REG_SMCMD);
+	while (!(readl(nand_info->reg+REG_SMISR) & READYBUSY)) ;
+}
+
+/*
+ * Move one page out of the cache register, handling erased pages the way
+ * ma35d1_nand_read_page_hwecc_oob_first() does
+ */
+static void ma35d1_nand_read_cache_page(struct mtd_info *mtd, struct nand_chip *chip, uint8_t *buf)
+{
+	struct ma35d1_nand_info *nand_info = nand_get_controller_data(chip);
+	char * ptr= (char *)(nand_info->reg+REG_SMRA0);
+
+	/* At first, read the OOB area */
+	ma35d1_nand_command(mtd, NAND_CMD_RNDOUT, mtd->writesize, -1);
+	ma35d1_nand_read_buf(mtd, chip->oob_poi, mtd->oobsize);
+
+	// Second, copy OOB data to SMRA for page read
+	memcpy ( (void*)ptr, (void*)chip->oob_poi, mtd->oobsize );
+
+	if ((*(ptr+2) != 0) && (*(ptr+3) != 0)) {
+		memset((void*)buf, 0xff, mtd->writesize);
+		return;
+	}
+
+	// Third, read data from the cache register
+	ma35d1_nand_command(mtd, NAND_CMD_RNDOUT, 0, -1);
+	ma35d1_nand_dma_transfer(mtd, buf, mtd->writesize, 0x0);
+
+	// Fouth, restore OOB data from SMRA
+	memcpy ( (void*)chip->oob_poi, (void*)ptr, mtd->oobsize );
+}
+
+/**
+ * ma35d1_nand_read_pages - read consecutive pages with READ CACHE SEQUENTIAL
+ * @mtd:        mtd info structure
+ * @chip:       nand chip info structure
+ * @buf:        buffer to store read data
+ * @page:       first page to read
+ * @numpages:   number of pages
+ *
+ * Only the first page of each block waits for the full array read: the
+ * chip loads the next page while the current one is moved out by DMA and
+ * corrected by the BCH engine. The sequence is restarted at each block
+ * boundary, which READ CACHE SEQUENTIAL is not required to cross.
+ */
+static int ma35d1_nand_read_pages(struct mtd_info *mtd, struct nand_chip *chip, uint8_t *buf, int page, int numpages)
+{
+	struct ma35d1_nand_info *nand_info = nand_get_controller_data(chip);
+	int ppb_mask = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
+	bool started = false;
+	bool last;
+	int i;
+
+	for (i = 0; i < numpages; i++, page++) {
+		last = (i == numpages - 1) || !((page + 1) & ppb_mask);
+
+		if (!started) {
+			ma35d1_nand_command(mtd, NAND_CMD_READ0, 0, page);
+			started = true;
+		}
+		ma35d1_nand_cache_command(nand_info, last ?
+					  NAND_CMD_READCACHEEND :
+					  NAND_CMD_READCACHESEQ);
+		ma35d1_nand_read_cache_page(mtd, chip, buf);
+		if (last)
+			started = false;
+
+		buf += mtd->writesize;
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
 /**
  * ma35d1_nand_read_oob_hwecc - [REPLACABLE] the most common OOB data read function
  * @mtd:        mtd info structure
@@ -735,6 +819,11 @@ int ma35d1_nand_init(struct ma35d1_nand_info *nand_info)
 	nand->ecc.read_oob  = ma35d1_nand_read_oob_hwecc;
 	nand->ecc.layout    = &ma35d1_nand_oob;
 
+#ifdef CONFIG_SYS_NAND_USE_FLASH_BBT
+	/* BBT and mirror live in the page data, the OOB is taken by parity */
+	nand->bbt_options |= NAND_BBT_USE_FLASH | NAND_BBT_NO_OOB;
+#endif
+
 	mtd->priv = nand;
 
 	// Enable SM_EN
@@ -777,6 +866,10 @@ int ma35d1_nand_init(struct ma35d1_nand_info *nand_info)
 		pr_warn("NAND Controller is not support this flash. (%d, %d)\n", mtd->writesize, mtd->oobsize);
 	}
 
+	/* Pipeline sequential reads where the chip can */
+	if (onfi_has_read_cache(nand))
+		nand->ecc.read_pages = ma35d1_nand_read_pages;
+
 	nand_info->m_i32SMRASize  = mtd->oobsize;
 	nand->ecc.steps = mtd->writesize / nand->ecc.size;
 	nand->ecc.bytes = ma35d1_nand_oob.eccbytes / nand->ecc.steps;
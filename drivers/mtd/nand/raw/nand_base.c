@@ -2274,6 +2274,194 @@ static uint8_t *nand_transfer_oob(struct nand_chip *chip, uint8_t *oob,
 	return NULL;
 }
 
+/**
+ * nand_read_pages_cache - [INTERN] read sequential pages with READ CACHE
+ * @mtd: mtd info structure
+ * @chip: nand chip info structure
+ * @buf: buffer to store read data
+ * @page: first page number to read
+ * @numpages: number of whole pages to read
+ *
+ * The chip loads the next page into its page register while the current one
+ * is clocked out of the cache register, hiding tR behind the bus transfer.
+ * Cache reads do not cross a block boundary, so the chain restarts there.
+ */
+static int nand_read_pages_cache(struct mtd_info *mtd, struct nand_chip *chip,
+				 uint8_t *buf, int page, int numpages)
+{
+	int ppb_mask = (1 << (chip->phys_erase_shift - chip->page_shift)) - 1;
+	unsigned int max_bitflips = 0;
+	bool started = false;
+	int i, ret;
+
+	for (i = 0; i < numpages; i++, page++, buf += mtd->writesize) {
+		bool last = i == numpages - 1 || !((page + 1) & ppb_mask);
+
+		if (!started) {
+			ret = nand_read_page_op(chip, page, 0, NULL, 0);
+			if (ret)
+				return ret;
+			started = true;
+		}
+
+		/* Move the page to the cache register, fetch the next one */
+		chip->cmdfunc(mtd, last ? NAND_CMD_READCACHEEND :
+			      NAND_CMD_READCACHESEQ, -1, -1);
+		if (last)
+			started = false;
+
+		ret = chip->ecc.read_page(mtd, chip, buf, 0, page);
+		if (ret < 0) {
+			if (started)
+				chip->cmdfunc(mtd, NAND_CMD_READCACHEEND,
+					      -1, -1);
+			return ret;
+		}
+		max_bitflips = max_t(unsigned int, max_bitflips, ret);
+	}
+
+	return max_bitflips;
+}
+
+/**
+ * nand_cmd_addr_cmd - [INTERN] send a two-cycle command with a full address
+ * @mtd: mtd info structure
+ * @chip: nand chip info structure
+ * @cmd1: first command cycle
+ * @column: column address
+ * @page: row address
+ * @cmd2: second command cycle
+ *
+ * For commands nand_command_lp() does not know how to finish.
+ */
+static void nand_cmd_addr_cmd(struct mtd_info *mtd, struct nand_chip *chip,
+			      int cmd1, int column, int page, int cmd2)
+{
+	if (chip->options & NAND_BUSWIDTH_16)
+		column >>= 1;
+
+	chip->cmd_ctrl(mtd, cmd1, NAND_NCE | NAND_CLE | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, column, NAND_NCE | NAND_ALE | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, column >> 8, NAND_NCE | NAND_ALE);
+	chip->cmd_ctrl(mtd, page, NAND_NCE | NAND_ALE);
+	chip->cmd_ctrl(mtd, page >> 8, NAND_NCE | NAND_ALE);
+	if (chip->options & NAND_ROW_ADDR_3)
+		chip->cmd_ctrl(mtd, page >> 16, NAND_NCE | NAND_ALE);
+	chip->cmd_ctrl(mtd, cmd2, NAND_NCE | NAND_CLE | NAND_CTRL_CHANGE);
+	chip->cmd_ctrl(mtd, NAND_CMD_NONE, NAND_NCE | NAND_CTRL_CHANGE);
+}
+
+/**
+ * nand_read_page_pair - [INTERN] read the same page of two planes at once
+ * @mtd: mtd info structure
+ * @chip: nand chip info structure
+ * @page0: page in the even block
+ * @buf0: buffer for @page0
+ * @page1: page in the odd block
+ * @buf1: buffer for @page1
+ *
+ * Both planes load their page register during one tR, then each plane is
+ * selected with CHANGE READ COLUMN ENHANCED and clocked out in turn.
+ */
+static int nand_read_page_pair(struct mtd_info *mtd, struct nand_chip *chip,
+			       int page0, uint8_t *buf0, int page1,
+			       uint8_t *buf1)
+{
+	unsigned int max_bitflips;
+	int ret;
+
+	nand_cmd_addr_cmd(mtd, chip, NAND_CMD_READ0, 0, page0,
+			  NAND_CMD_READMULTIPLANE);
+	ndelay(100);
+	nand_wait_ready(mtd);
+	nand_cmd_addr_cmd(mtd, chip, NAND_CMD_READ0, 0, page1,
+			  NAND_CMD_READSTART);
+	ndelay(100);
+	nand_wait_ready(mtd);
+
+	nand_cmd_addr_cmd(mtd, chip, NAND_CMD_RNDOUTENH, 0, page0,
+			  NAND_CMD_RNDOUTSTART);
+	ret = chip->ecc.read_page(mtd, chip, buf0, 0, page0);
+	if (ret < 0)
+		return ret;
+	max_bitflips = ret;
+
+	nand_cmd_addr_cmd(mtd, chip, NAND_CMD_RNDOUTENH, 0, page1,
+			  NAND_CMD_RNDOUTSTART);
+	ret = chip->ecc.read_page(mtd, chip, buf1, 0, page1);
+	if (ret < 0)
+		return ret;
+
+	return max_t(unsigned int, max_bitflips, ret);
+}
+
+/**
+ * nand_read_pages_multi_plane - [INTERN] read sequential pages two planes
+ *				 at a time
+ * @mtd: mtd info structure
+ * @chip: nand chip info structure
+ * @buf: buffer to store read data
+ * @page: first page number to read
+ * @numpages: number of whole pages to read
+ *
+ * Even and odd blocks sit in different planes. When the run covers a block
+ * pair, page N of the even block is read together with page N of the odd
+ * one; pages without a partner in the run are read on their own.
+ */
+static int nand_read_pages_multi_plane(struct mtd_info *mtd,
+				       struct nand_chip *chip, uint8_t *buf,
+				       int page, int numpages)
+{
+	int bshift = chip->phys_erase_shift - chip->page_shift;
+	int ppb = 1 << bshift;
+	unsigned int max_bitflips = 0;
+	int i = 0, j, n, p, ret;
+
+	while (i < numpages) {
+		p = page + i;
+		n = ppb - (p & (ppb - 1));
+
+		if (!((p >> bshift) & 1) && i + ppb + n <= numpages) {
+			/* The rest of this block and its twin in the next */
+			for (j = 0; j < n; j++) {
+				ret = nand_read_page_pair(mtd, chip, p + j,
+						buf + (i + j) * mtd->writesize,
+						p + j + ppb,
+						buf + (i + j + ppb) *
+						mtd->writesize);
+				if (ret < 0)
+					return ret;
+				max_bitflips = max_t(unsigned int,
+						     max_bitflips, ret);
+			}
+			/* Head of the odd block, before the pair started */
+			for (j = n; j < ppb; j++) {
+				ret = nand_read_page_op(chip, p + j, 0, NULL, 0);
+				if (!ret)
+					ret = chip->ecc.read_page(mtd, chip,
+						buf + (i + j) * mtd->writesize,
+						0, p + j);
+				if (ret < 0)
+					return ret;
+				max_bitflips = max_t(unsigned int,
+						     max_bitflips, ret);
+			}
+			i += ppb + n;
+		} else {
+			ret = nand_read_page_op(chip, p, 0, NULL, 0);
+			if (!ret)
+				ret = chip->ecc.read_page(mtd, chip,
+						buf + i * mtd->writesize, 0, p);
+			if (ret < 0)
+				return ret;
+			max_bitflips = max_t(unsigned int, max_bitflips, ret);
+			i++;
+		}
+	}
+
+	return max_bitflips;
+}
+
 /**
  * nand_setup_read_retry - [INTERN] Set the READ RETRY mode
  * @mtd: MTD device structure
@@ -2321,6 +2509,7 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 	unsigned int max_bitflips = 0;
 	int retry_mode = 0;
 	bool ecc_fail = false;
+	int numpages, seq_retry_end = -1;
 
 	chipnr = (int)(from >> chip->chip_shift);
 	chip->select_chip(mtd, chipnr);
@@ -2349,8 +2538,37 @@ static int nand_do_read_ops(struct mtd_info *mtd, loff_t from,
 		else
 			use_bufpoi = 0;
 
-		/* Is the current page in the buffer? */
-		if (realpage != chip->pagebuf || oob) {
+		/* Hand runs of whole pages to the controller in one go */
+		numpages = 0;
+		if (chip->ecc.read_pages && aligned && !use_bufpoi && !oob &&
+		    ops->mode != MTD_OPS_RAW && realpage >= seq_retry_end)
+			numpages = min_t(int, readlen >> chip->page_shift,
+					 chip->pagemask + 1 - page);
+
+		if (numpages > 1) {
+			ret = chip->ecc.read_pages(mtd, chip, buf, page,
+						   numpages);
+			if (ret < 0)
+				break;
+
+			if (mtd->ecc_stats.failed - ecc_failures) {
+				if (chip->read_retries > 1) {
+					/* Go over the pages again one by one */
+					mtd->ecc_stats.failed = ecc_failures;
+					seq_retry_end = realpage + numpages;
+					continue;
+				}
+				ecc_fail = true;
+			}
+			max_bitflips = max_t(unsigned int, max_bitflips, ret);
+
+			bytes = numpages << chip->page_shift;
+			buf += bytes;
+			/* The common code below moves on by one more page */
+			realpage += numpages - 1;
+			page = realpage & chip->pagemask;
+		} else if (realpage != chip->pagebuf || oob) {
+			/* The current page is not in the buffer */
 			bufpoi = use_bufpoi ? chip->buffers->databuf : buf;
 
 			if (use_bufpoi && aligned)
@@ -5204,6 +5422,20 @@ int nand_scan_tail(struct mtd_info *mtd)
 	if (!ecc->write_oob_raw)
 		ecc->write_oob_raw = ecc->write_oob;
 
+	/*
+	 * Pipeline sequential page reads if the controller opted in and the
+	 * chip supports it; this reader sends its own READ0 and is left out.
+	 */
+	if (!ecc->read_pages && nand_standard_page_accessors(ecc) &&
+	    ecc->read_page != nand_read_page_hwecc_oob_first) {
+		if ((chip->options & NAND_CACHE_READ) &&
+		    onfi_has_read_cache(chip))
+			ecc->read_pages = nand_read_pages_cache;
+		else if ((chip->options & NAND_MULTI_PLANE_READ) &&
+			 chip->cmd_ctrl && onfi_has_multi_plane_read(chip))
+			ecc->read_pages = nand_read_pages_multi_plane;
+	}
+
 	/*
 	 * The number of bytes available for a client to place data into
 	 * the out of band area.
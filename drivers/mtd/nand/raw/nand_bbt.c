@@ -91,6 +91,18 @@ static inline void bbt_mark_entry(struct nand_chip *chip, int block,
 {
 	uint8_t msk = (mark & BBT_ENTRY_MASK) << ((block & BBT_ENTRY_MASK) * 2);
 	chip->bbt[block >> BBT_ENTRY_SHIFT] |= msk;
+
+	if (mark != BBT_BLOCK_GOOD && chip->bbt_map) {
+		chip->bbt_map[BIT_WORD(block)] |= BIT_MASK(block);
+		/* The good block list is stale now */
+		kfree(chip->bbt_good);
+		chip->bbt_good = NULL;
+	}
+}
+
+static inline bool bbt_map_isbad(struct nand_chip *chip, int block)
+{
+	return chip->bbt_map[BIT_WORD(block)] & BIT_MASK(block);
 }
 
 static int check_pattern_no_oob(uint8_t *buf, struct nand_bbt_descr *td)
@@ -1090,6 +1102,14 @@ static int nand_scan_bbt(struct mtd_info *mtd, struct nand_bbt_descr *bd)
 	if (!this->bbt)
 		return -ENOMEM;
 
+	/* And a bitmap of the blocks which are not good, for quick checks */
+	len = BITS_TO_LONGS(mtd->size >> this->bbt_erase_shift) * sizeof(long);
+	this->bbt_map = kzalloc(len, GFP_KERNEL);
+	if (!this->bbt_map) {
+		res = -ENOMEM;
+		goto err;
+	}
+
 	/*
 	 * If no primary table decriptor is given, scan the device to build a
 	 * memory based bad block table.
@@ -1134,8 +1154,7 @@ static int nand_scan_bbt(struct mtd_info *mtd, struct nand_bbt_descr *bd)
 	return 0;
 
 err:
-	kfree(this->bbt);
-	this->bbt = NULL;
+	nand_free_bbt(mtd);
 	return res;
 }
 
@@ -1337,6 +1356,9 @@ int nand_isbad_bbt(struct mtd_info *mtd, loff_t offs, int allowbbt)
 	int block, res;
 
 	block = (int)(offs >> this->bbt_erase_shift);
+	if (!allowbbt && this->bbt_map)
+		return bbt_map_isbad(this, block);
+
 	res = bbt_get_entry(this, block);
 
 	pr_debug("nand_isbad_bbt(): bbt info for offs 0x%08x: (block %d) 0x%02x\n",
@@ -1353,6 +1375,106 @@ int nand_isbad_bbt(struct mtd_info *mtd, loff_t offs, int allowbbt)
 	return 1;
 }
 
+/* List the good blocks in ascending order */
+static int nand_build_good_bbt(struct mtd_info *mtd)
+{
+	struct nand_chip *this = mtd_to_nand(mtd);
+	int nblocks = mtd->size >> this->bbt_erase_shift;
+	int block, n = 0;
+
+	this->bbt_good = kmalloc(nblocks * sizeof(*this->bbt_good),
+				 GFP_KERNEL);
+	if (!this->bbt_good)
+		return -ENOMEM;
+
+	for (block = 0; block < nblocks; block++) {
+		if (!bbt_map_isbad(this, block))
+			this->bbt_good[n++] = block;
+	}
+	this->bbt_ngood = n;
+
+	return 0;
+}
+
+/**
+ * nand_skip_bad_bbt - [NAND Interface] Translate a skip-bad offset
+ * @mtd: MTD device structure
+ * @offs: offset in the device where the skip-bad area starts
+ * @skip: offset into the area, not counting bad blocks
+ * @phys: returns the offset in the device @skip lands on
+ *
+ * Blocks are counted as nand_read_skip_bad() does: the block holding @offs
+ * provides the bytes after @offs if it is good, later good blocks provide
+ * a whole block each. The good block list is searched instead of checking
+ * each block in turn.
+ *
+ * Return: 0, -ENODEV if there is no bad block table, -ERANGE if the area
+ * does not fit in the device, or -ENOMEM.
+ */
+int nand_skip_bad_bbt(struct mtd_info *mtd, loff_t offs, loff_t skip,
+		      loff_t *phys)
+{
+	struct nand_chip *this = mtd_to_nand(mtd);
+	int shift = this->bbt_erase_shift;
+	loff_t mask = (1ULL << shift) - 1;
+	loff_t first = 0;
+	int block, lo, hi, ret;
+
+	if (!this->bbt_map)
+		return -ENODEV;
+	if (offs < 0 || offs >= mtd->size || skip < 0)
+		return -ERANGE;
+	if (!this->bbt_good) {
+		ret = nand_build_good_bbt(mtd);
+		if (ret)
+			return ret;
+	}
+
+	block = (int)(offs >> shift);
+	if (!bbt_map_isbad(this, block))
+		first = mask + 1 - (offs & mask);
+	if (skip < first) {
+		*phys = offs + skip;
+		return 0;
+	}
+	skip -= first;
+
+	/* Find the first good block after the one holding @offs */
+	lo = 0;
+	hi = this->bbt_ngood;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (this->bbt_good[mid] <= block)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ((skip >> shift) >= this->bbt_ngood - lo)
+		return -ERANGE;
+
+	*phys = ((loff_t)this->bbt_good[lo + (skip >> shift)] << shift) +
+		(skip & mask);
+
+	return 0;
+}
+
+/**
+ * nand_free_bbt - [NAND Interface] Free the in-memory bad block tables
+ * @mtd: MTD device structure
+ */
+void nand_free_bbt(struct mtd_info *mtd)
+{
+	struct nand_chip *this = mtd_to_nand(mtd);
+
+	kfree(this->bbt);
+	kfree(this->bbt_map);
+	kfree(this->bbt_good);
+	this->bbt = NULL;
+	this->bbt_map = NULL;
+	this->bbt_good = NULL;
+}
+
 /**
  * nand_markbad_bbt - [NAND Interface] Mark a block bad in the BBT
  * @mtd: MTD device structure
@@ -91,10 +91,7 @@ int nand_erase_opts(struct mtd_info *mtd,
 		 * We don't need the bad block table anymore...
 		 * after scrub, there are no bad blocks left!
 		 */
-		if (chip->bbt) {
-			kfree(chip->bbt);
-		}
-		chip->bbt = NULL;
+		nand_free_bbt(mtd);
 		chip->options &= ~NAND_BBT_SCANNED;
 	}
 
@@ -412,8 +409,25 @@ static int check_skip_len(struct mtd_info *mtd, loff_t offset, size_t length,
 			  size_t *used)
 {
 	size_t len_excl_bad = 0;
+	loff_t last;
 	int ret = 0;
 
+	/*
+	 * Checking the first block loads the bad block table, which then
+	 * gives the end of the area without going through each block.
+	 */
+	if (length && offset < mtd->size) {
+		nand_block_isbad(mtd, offset & ~(loff_t)(mtd->erasesize - 1));
+		ret = nand_skip_bad_bbt(mtd, offset, length - 1, &last);
+		if (ret == -ERANGE)
+			return -1;
+		if (!ret) {
+			*used += last + 1 - offset;
+			return last + 1 - offset != length;
+		}
+		ret = 0;
+	}
+
 	while (len_excl_bad < length) {
 		size_t block_len, block_off;
 		loff_t block_start;
@@ -763,10 +777,13 @@ int nand_read_skip_bad(struct mtd_info *mtd, loff_t offset, size_t *length,
 			continue;
 		}
 
-		if (left_to_read < (mtd->erasesize - block_offset))
+		/* Read up to the next bad block in one go */
+		read_length = mtd->erasesize - block_offset;
+		while (read_length < left_to_read &&
+		       !nand_block_isbad(mtd, offset + read_length))
+			read_length += mtd->erasesize;
+		if (read_length > left_to_read)
 			read_length = left_to_read;
-		else
-			read_length = mtd->erasesize - block_offset;
 
 		rval = nand_read(mtd, offset, &read_length, p_buffer);
 		if (rval && rval != -EUCLEAN) {
@@ -0,0 +1,457 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox raw NAND simulator
+ *
+ * Models an ONFI SLC chip with two planes, each with a page and a cache
+ * register, behind the legacy cmd_ctrl() interface. A virtual clock counts
+ * bus cycles and array busy times (tR, tPROG, tBERS), so tests can check
+ * how much of the array time a read strategy hides.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <nand.h>
+#include <os.h>
+#include <asm/test.h>
+#include <dm/device-internal.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/rawnand.h>
+
+#define SB_NAND_PAGE_SIZE	2048
+#define SB_NAND_OOB_SIZE	64
+#define SB_NAND_RAW_SIZE	(SB_NAND_PAGE_SIZE + SB_NAND_OOB_SIZE)
+#define SB_NAND_PAGES_PER_BLOCK	64
+#define SB_NAND_BLOCKS		32
+#define SB_NAND_PAGES		(SB_NAND_PAGES_PER_BLOCK * SB_NAND_BLOCKS)
+#define SB_NAND_PLANES		2
+#define SB_NAND_DEV_ID		0x5a
+
+/* Timings in ns */
+#define SB_NAND_T_CYCLE		25	/* one command, address or data cycle */
+#define SB_NAND_T_R		25000
+#define SB_NAND_T_RCBSY		3000
+#define SB_NAND_T_DBSY		500
+#define SB_NAND_T_RST		5000
+#define SB_NAND_T_PROG		200000
+#define SB_NAND_T_BERS		2000000
+
+struct sandbox_nand_plane {
+	u8 page_reg[SB_NAND_RAW_SIZE];
+	u8 cache_reg[SB_NAND_RAW_SIZE];
+};
+
+/**
+ * struct sandbox_nand_priv - State of the simulated chip
+ *
+ * @chip: NAND chip registered with the core
+ * @array: contents of the flash, SB_NAND_RAW_SIZE bytes per page
+ * @onfi: parameter page returned by READ PARAMETER PAGE
+ * @plane: page and cache registers of each plane
+ * @cmd: command whose address or data cycles are in progress
+ * @addr: address cycles latched since @cmd
+ * @naddr: number of address cycles latched
+ * @addr_pending: @addr has not been decoded yet
+ * @col: column of the next data cycle
+ * @row: row decoded from @addr
+ * @out_plane: plane whose cache register is clocked out
+ * @prog_page: page the next PAGE PROGRAM writes to
+ * @queued_page: page of the first plane of a multi-plane read, or -1
+ * @seq_page: page in the page register during a cache read, or -1
+ * @now: virtual time in ns
+ * @busy_until: time at which R/B goes ready
+ * @array_until: time at which the array finishes loading @seq_page
+ */
+struct sandbox_nand_priv {
+	struct nand_chip chip;
+	u8 *array;
+	struct nand_onfi_params onfi;
+	struct sandbox_nand_plane plane[SB_NAND_PLANES];
+	int cmd;
+	u8 addr[5];
+	int naddr;
+	bool addr_pending;
+	int col;
+	int row;
+	int out_plane;
+	int prog_page;
+	int queued_page;
+	int seq_page;
+	u64 now;
+	u64 busy_until;
+	u64 array_until;
+};
+
+static const u8 sb_nand_id[] = { NAND_MFR_MICRON, SB_NAND_DEV_ID, 0, 0 };
+
+static inline int sb_nand_plane(int page)
+{
+	return (page / SB_NAND_PAGES_PER_BLOCK) % SB_NAND_PLANES;
+}
+
+static inline u8 *sb_nand_page(struct sandbox_nand_priv *priv, int page)
+{
+	return priv->array + (ulong)page * SB_NAND_RAW_SIZE;
+}
+
+/* CRC-16 of the ONFI parameter page: polynomial 0x8005, MSB first */
+static u16 sb_nand_onfi_crc(const u8 *p, int len)
+{
+	u16 crc = ONFI_CRC_BASE;
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0);
+	}
+
+	return crc;
+}
+
+static void sb_nand_init_onfi(struct sandbox_nand_priv *priv, bool read_cache)
+{
+	struct nand_onfi_params *p = &priv->onfi;
+	u16 opt_cmd = ONFI_OPT_CMD_RNDOUT_ENH;
+
+	if (read_cache)
+		opt_cmd |= ONFI_OPT_CMD_READ_CACHE;
+
+	memset(p, '\0', sizeof(*p));
+	memcpy(p->sig, "ONFI", 4);
+	p->revision = cpu_to_le16(1 << 2);		/* ONFI 2.0 */
+	p->features = cpu_to_le16(ONFI_FEATURE_MULTI_PLANE_READ);
+	p->opt_cmd = cpu_to_le16(opt_cmd);
+	memcpy(p->manufacturer, "SANDBOX     ", sizeof(p->manufacturer));
+	memcpy(p->model, "SANDBOX NAND        ", sizeof(p->model));
+	p->jedec_id = NAND_MFR_MICRON;
+	p->byte_per_page = cpu_to_le32(SB_NAND_PAGE_SIZE);
+	p->spare_bytes_per_page = cpu_to_le16(SB_NAND_OOB_SIZE);
+	p->pages_per_block = cpu_to_le32(SB_NAND_PAGES_PER_BLOCK);
+	p->blocks_per_lun = cpu_to_le32(SB_NAND_BLOCKS);
+	p->lun_count = 1;
+	p->addr_cycles = 0x22;
+	p->bits_per_cell = 1;
+	p->programs_per_page = 4;
+	p->ecc_bits = 1;
+	p->interleaved_bits = 1;
+	p->t_r = cpu_to_le16(SB_NAND_T_R / 1000);
+	p->crc = cpu_to_le16(sb_nand_onfi_crc((u8 *)p, 254));
+}
+
+static void sb_nand_load(struct sandbox_nand_priv *priv, int page)
+{
+	memcpy(priv->plane[sb_nand_plane(page)].page_reg,
+	       sb_nand_page(priv, page), SB_NAND_RAW_SIZE);
+}
+
+/* Move the page register of @plane to its cache register for data out */
+static void sb_nand_to_cache(struct sandbox_nand_priv *priv, int plane)
+{
+	struct sandbox_nand_plane *pl = &priv->plane[plane];
+
+	memcpy(pl->cache_reg, pl->page_reg, SB_NAND_RAW_SIZE);
+	priv->out_plane = plane;
+}
+
+/* Decode the address cycles of the current command */
+static void sb_nand_addr_done(struct sandbox_nand_priv *priv)
+{
+	u8 *a = priv->addr;
+
+	if (!priv->addr_pending)
+		return;
+	priv->addr_pending = false;
+
+	switch (priv->cmd) {
+	case NAND_CMD_READ0:
+	case NAND_CMD_RNDOUTENH:
+	case NAND_CMD_SEQIN:
+		priv->col = a[0] | a[1] << 8;
+		priv->row = (a[2] | a[3] << 8 | a[4] << 16) % SB_NAND_PAGES;
+		break;
+	case NAND_CMD_RNDOUT:
+	case NAND_CMD_RNDIN:
+		priv->col = a[0] | a[1] << 8;
+		break;
+	case NAND_CMD_ERASE1:
+		priv->row = (a[0] | a[1] << 8 | a[2] << 16) % SB_NAND_PAGES;
+		break;
+	default:
+		priv->col = 0;
+		break;
+	}
+
+	if (priv->cmd == NAND_CMD_SEQIN) {
+		priv->prog_page = priv->row;
+		memset(priv->plane[sb_nand_plane(priv->row)].cache_reg, 0xff,
+		       SB_NAND_RAW_SIZE);
+	}
+}
+
+/* READ CACHE SEQUENTIAL (@next) or READ CACHE END */
+static void sb_nand_read_cache(struct sandbox_nand_priv *priv, bool next)
+{
+	int page = priv->seq_page;
+	u64 t = max(priv->now, priv->array_until);
+
+	if (page < 0)
+		return;
+
+	sb_nand_to_cache(priv, sb_nand_plane(page));
+	priv->col = 0;
+	priv->busy_until = t + SB_NAND_T_RCBSY;
+	priv->seq_page = -1;
+	if (next && page + 1 < SB_NAND_PAGES) {
+		sb_nand_load(priv, page + 1);
+		priv->seq_page = page + 1;
+		priv->array_until = priv->busy_until + SB_NAND_T_R;
+	}
+}
+
+static void sb_nand_command(struct sandbox_nand_priv *priv, int cmd)
+{
+	int page, i;
+	u8 *dst;
+
+	sb_nand_addr_done(priv);
+
+	switch (cmd) {
+	case NAND_CMD_READSTART:
+		page = priv->row;
+		if (priv->queued_page >= 0 &&
+		    sb_nand_plane(priv->queued_page) != sb_nand_plane(page)) {
+			sb_nand_load(priv, priv->queued_page);
+			sb_nand_to_cache(priv, sb_nand_plane(priv->queued_page));
+		}
+		priv->queued_page = -1;
+		sb_nand_load(priv, page);
+		sb_nand_to_cache(priv, sb_nand_plane(page));
+		priv->seq_page = page;
+		priv->busy_until = priv->now + SB_NAND_T_R;
+		priv->array_until = priv->busy_until;
+		break;
+	case NAND_CMD_READMULTIPLANE:
+		priv->queued_page = priv->row;
+		priv->busy_until = priv->now + SB_NAND_T_DBSY;
+		break;
+	case NAND_CMD_READCACHESEQ:
+	case NAND_CMD_READCACHEEND:
+		sb_nand_read_cache(priv, cmd == NAND_CMD_READCACHESEQ);
+		priv->cmd = NAND_CMD_READ0;
+		break;
+	case NAND_CMD_RNDOUTSTART:
+		if (priv->cmd == NAND_CMD_RNDOUTENH)
+			priv->out_plane = sb_nand_plane(priv->row);
+		priv->cmd = NAND_CMD_READ0;
+		break;
+	case NAND_CMD_PAGEPROG:
+		page = priv->prog_page;
+		dst = sb_nand_page(priv, page);
+		for (i = 0; i < SB_NAND_RAW_SIZE; i++)
+			dst[i] &= priv->plane[sb_nand_plane(page)].cache_reg[i];
+		priv->seq_page = -1;
+		priv->busy_until = priv->now + SB_NAND_T_PROG;
+		break;
+	case NAND_CMD_ERASE2:
+		page = priv->row - priv->row % SB_NAND_PAGES_PER_BLOCK;
+		memset(sb_nand_page(priv, page), 0xff,
+		       SB_NAND_PAGES_PER_BLOCK * SB_NAND_RAW_SIZE);
+		priv->seq_page = -1;
+		priv->busy_until = priv->now + SB_NAND_T_BERS;
+		break;
+	case NAND_CMD_RESET:
+		priv->queued_page = -1;
+		priv->seq_page = -1;
+		priv->busy_until = max(priv->now, priv->busy_until) +
+				   SB_NAND_T_RST;
+		priv->cmd = cmd;
+		break;
+	default:
+		priv->cmd = cmd;
+		priv->naddr = 0;
+		priv->col = 0;
+		memset(priv->addr, '\0', sizeof(priv->addr));
+		break;
+	}
+}
+
+static void sb_nand_cmd_ctrl(struct mtd_info *mtd, int dat, unsigned int ctrl)
+{
+	struct sandbox_nand_priv *priv = nand_get_controller_data(
+							mtd_to_nand(mtd));
+
+	if (dat == NAND_CMD_NONE)
+		return;
+
+	priv->now += SB_NAND_T_CYCLE;
+	if (ctrl & NAND_CLE) {
+		sb_nand_command(priv, dat & 0xff);
+	} else if (ctrl & NAND_ALE) {
+		if (priv->naddr < ARRAY_SIZE(priv->addr))
+			priv->addr[priv->naddr++] = dat;
+		priv->addr_pending = true;
+	}
+}
+
+static int sb_nand_dev_ready(struct mtd_info *mtd)
+{
+	struct sandbox_nand_priv *priv = nand_get_controller_data(
+							mtd_to_nand(mtd));
+
+	/* The host waits for R/B, which takes as long as the chip is busy */
+	priv->now = max(priv->now, priv->busy_until);
+
+	return 1;
+}
+
+static u8 sb_nand_data_out(struct sandbox_nand_priv *priv)
+{
+	int col = priv->col++;
+
+	switch (priv->cmd) {
+	case NAND_CMD_READID:
+		if (priv->addr[0] == 0x20)
+			return col < 4 ? "ONFI"[col] : 0;
+		return col < sizeof(sb_nand_id) ? sb_nand_id[col] : 0;
+	case NAND_CMD_PARAM:
+		return ((u8 *)&priv->onfi)[col % sizeof(priv->onfi)];
+	case NAND_CMD_STATUS:
+		priv->now = max(priv->now, priv->busy_until);
+		priv->col = 0;
+		return NAND_STATUS_WP | NAND_STATUS_READY |
+		       NAND_STATUS_TRUE_READY;
+	default:
+		if (col >= SB_NAND_RAW_SIZE)
+			return 0xff;
+		return priv->plane[priv->out_plane].cache_reg[col];
+	}
+}
+
+static u8 sb_nand_read_byte(struct mtd_info *mtd)
+{
+	struct sandbox_nand_priv *priv = nand_get_controller_data(
+							mtd_to_nand(mtd));
+
+	sb_nand_addr_done(priv);
+	priv->now += SB_NAND_T_CYCLE;
+
+	return sb_nand_data_out(priv);
+}
+
+static void sb_nand_read_buf(struct mtd_info *mtd, u8 *buf, int len)
+{
+	struct sandbox_nand_priv *priv = nand_get_controller_data(
+							mtd_to_nand(mtd));
+	int i;
+
+	sb_nand_addr_done(priv);
+	priv->now += (u64)len * SB_NAND_T_CYCLE;
+	for (i = 0; i < len; i++)
+		buf[i] = sb_nand_data_out(priv);
+}
+
+static void sb_nand_write_buf(struct mtd_info *mtd, const u8 *buf, int len)
+{
+	struct sandbox_nand_priv *priv = nand_get_controller_data(
+							mtd_to_nand(mtd));
+	u8 *reg;
+	int i;
+
+	sb_nand_addr_done(priv);
+	reg = priv->plane[sb_nand_plane(priv->prog_page)].cache_reg;
+	priv->now += (u64)len * SB_NAND_T_CYCLE;
+	for (i = 0; i < len && priv->col < SB_NAND_RAW_SIZE; i++)
+		reg[priv->col++] = buf[i];
+}
+
+u64 sandbox_nand_get_time(struct udevice *dev)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(dev);
+
+	return priv->now;
+}
+
+static int sandbox_nand_probe(struct udevice *dev)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(dev);
+	struct nand_chip *chip = &priv->chip;
+	struct mtd_info *mtd = nand_to_mtd(chip);
+	int ret;
+
+	/* Host memory, like a backing file, to leave the malloc() pool alone */
+	priv->array = os_malloc((ulong)SB_NAND_PAGES * SB_NAND_RAW_SIZE);
+	if (!priv->array)
+		return -ENOMEM;
+	memset(priv->array, 0xff, (ulong)SB_NAND_PAGES * SB_NAND_RAW_SIZE);
+	sb_nand_init_onfi(priv, !dev_read_bool(dev, "sandbox,no-read-cache"));
+	priv->queued_page = -1;
+	priv->seq_page = -1;
+
+	nand_set_controller_data(chip, priv);
+	nand_set_flash_node(chip, dev_ofnode(dev));
+	chip->cmd_ctrl = sb_nand_cmd_ctrl;
+	chip->dev_ready = sb_nand_dev_ready;
+	chip->read_byte = sb_nand_read_byte;
+	chip->read_buf = sb_nand_read_buf;
+	chip->write_buf = sb_nand_write_buf;
+	chip->ecc.mode = NAND_ECC_SOFT;
+	chip->options |= NAND_CACHE_READ | NAND_MULTI_PLANE_READ;
+#ifdef CONFIG_SYS_NAND_USE_FLASH_BBT
+	chip->bbt_options |= NAND_BBT_USE_FLASH | NAND_BBT_NO_OOB;
+#endif
+
+	ret = nand_scan(mtd, 1);
+	if (ret) {
+		os_free(priv->array);
+		return ret;
+	}
+
+	return nand_register(dev->seq, mtd);
+}
+
+static int sandbox_nand_remove(struct udevice *dev)
+{
+	struct sandbox_nand_priv *priv = dev_get_priv(dev);
+	struct nand_chip *chip = &priv->chip;
+
+	del_mtd_device(nand_to_mtd(chip));
+	nand_free_bbt(nand_to_mtd(chip));
+	kfree(chip->buffers);
+	os_free(priv->array);
+
+	return 0;
+}
+
+static const struct udevice_id sandbox_nand_ids[] = {
+	{ .compatible = "sandbox,nand" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_nand) = {
+	.name = "sandbox_nand",
+	.id = UCLASS_MTD,
+	.of_match = sandbox_nand_ids,
+	.probe = sandbox_nand_probe,
+	.remove = sandbox_nand_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_nand_priv),
+};
+
+void board_nand_init(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	int ret;
+
+	if (uclass_get(UCLASS_MTD, &uc))
+		return;
+
+	uclass_foreach_dev(dev, uc) {
+		if (dev->driver != DM_GET_DRIVER(sandbox_nand))
+			continue;
+		ret = device_probe(dev);
+		if (ret)
+			pr_err("Failed to initialize sandbox NAND %s. (error %d)\n",
+			       dev->name, ret);
+	}
+}
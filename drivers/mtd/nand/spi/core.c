@@ -239,6 +239,55 @@ static int spinand_load_page_op(struct spinand_device *spinand,
 	return spi_mem_exec_op(spinand->slave, &op);
 }
 
+static int spinand_read_cache_random_op(struct spinand_device *spinand,
+					const struct nand_page_io_req *req)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	unsigned int row = nanddev_pos_to_row(nand, &req->pos);
+	struct spi_mem_op op = SPINAND_PAGE_READ_CACHE_RANDOM_OP(row);
+
+	return spi_mem_exec_op(spinand->slave, &op);
+}
+
+static int spinand_read_cache_last_op(struct spinand_device *spinand)
+{
+	struct spi_mem_op op = SPINAND_PAGE_READ_CACHE_LAST_OP;
+
+	return spi_mem_exec_op(spinand->slave, &op);
+}
+
+/*
+ * Run a read from cache, through the direct mapping if there is one.
+ * op->data.nbytes is trimmed to the amount actually read.
+ */
+static int spinand_exec_read_cache(struct spinand_device *spinand,
+				   struct spi_mem_op *op)
+{
+	int ret;
+
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	if (spinand->rdesc) {
+		ssize_t len;
+
+		len = spi_mem_dirmap_read(spinand->rdesc, op->addr.val,
+					  op->data.nbytes, op->data.buf.in);
+		if (len < 0)
+			return len;
+		if (!len)
+			return -EIO;
+
+		op->data.nbytes = len;
+		return 0;
+	}
+#endif
+
+	ret = spi_mem_adjust_op_size(spinand->slave, op);
+	if (ret)
+		return ret;
+
+	return spi_mem_exec_op(spinand->slave, op);
+}
+
 static int spinand_read_from_cache_op(struct spinand_device *spinand,
 				      const struct nand_page_io_req *req)
 {
@@ -281,11 +330,7 @@ static int spinand_read_from_cache_op(struct spinand_device *spinand,
 	while (nbytes) {
 		op.data.buf.in = buf;
 		op.data.nbytes = nbytes;
-		ret = spi_mem_adjust_op_size(spinand->slave, &op);
-		if (ret)
-			return ret;
-
-		ret = spi_mem_exec_op(spinand->slave, &op);
+		ret = spinand_exec_read_cache(spinand, &op);
 		if (ret)
 			return ret;
 
@@ -559,6 +604,155 @@ static int spinand_write_page(struct spinand_device *spinand,
 	return ret;
 }
 
+/*
+ * Add the result of reading one page to the totals of a read: bitflips
+ * and ECC failures are counted and the page is read, other errors stop
+ * the read.
+ */
+static int spinand_read_page_done(struct mtd_info *mtd,
+				  struct mtd_oob_ops *ops,
+				  const struct nand_page_io_req *req, int ret,
+				  unsigned int *max_bitflips, bool *ecc_failed)
+{
+	if (ret < 0 && ret != -EBADMSG)
+		return ret;
+
+	if (ret == -EBADMSG) {
+		*ecc_failed = true;
+		mtd->ecc_stats.failed++;
+	} else {
+		mtd->ecc_stats.corrected += ret;
+		*max_bitflips = max_t(unsigned int, *max_bitflips, ret);
+	}
+
+	ops->retlen += req->datalen;
+	ops->oobretlen += req->ooblen;
+
+	return 0;
+}
+
+/* Read a page already moved to the cache, @status being its ECC state */
+static int spinand_read_cached_page(struct spinand_device *spinand,
+				    const struct nand_page_io_req *req,
+				    u8 status, bool ecc_enabled)
+{
+	int ret;
+
+	ret = spinand_read_from_cache_op(spinand, req);
+	if (ret)
+		return ret;
+
+	if (!ecc_enabled)
+		return 0;
+
+	return spinand_check_ecc_status(spinand, status);
+}
+
+/*
+ * End a PAGE READ CACHE RANDOM sequence after an error, so that the chip is
+ * not left loading a page in the background when the next command comes
+ */
+static void spinand_read_cache_abort(struct spinand_device *spinand)
+{
+	u8 status;
+
+	if (!spinand_read_cache_last_op(spinand))
+		spinand_wait(spinand, &status);
+}
+
+/*
+ * Read pages with PAGE READ CACHE RANDOM, so that the chip loads a page
+ * while the host reads the previous one out of the cache. The pipeline
+ * runs within an eraseblock and is restarted with PAGE READ at the next
+ * one. A page loaded by PAGE READ is in the cache already; one loaded in
+ * the background needs PAGE READ CACHE LAST to get there.
+ */
+static int spinand_mtd_read_cache(struct mtd_info *mtd, loff_t from,
+				  struct mtd_oob_ops *ops, bool enable_ecc,
+				  unsigned int *max_bitflips, bool *ecc_failed)
+{
+	struct spinand_device *spinand = mtd_to_spinand(mtd);
+	struct nand_device *nand = mtd_to_nanddev(mtd);
+	struct nand_page_io_req prev;
+	struct nand_io_iter iter;
+	bool pending = false, cached = false;
+	u8 status = 0;
+	int ret = 0;
+
+	nanddev_io_for_each_page(nand, from, ops, &iter) {
+		if (pending && iter.req.pos.target == prev.pos.target &&
+		    iter.req.pos.lun == prev.pos.lun &&
+		    iter.req.pos.eraseblock == prev.pos.eraseblock) {
+			ret = spinand_read_cache_random_op(spinand, &iter.req);
+			if (!ret)
+				ret = spinand_wait(spinand, &status);
+			if (!ret)
+				ret = spinand_read_cached_page(spinand, &prev,
+							       status,
+							       enable_ecc);
+			ret = spinand_read_page_done(mtd, ops, &prev, ret,
+						     max_bitflips, ecc_failed);
+			if (ret) {
+				spinand_read_cache_abort(spinand);
+				return ret;
+			}
+
+			prev = iter.req;
+			cached = false;
+			continue;
+		}
+
+		if (pending) {
+			if (!cached) {
+				ret = spinand_read_cache_last_op(spinand);
+				if (!ret)
+					ret = spinand_wait(spinand, &status);
+			}
+			if (!ret)
+				ret = spinand_read_cached_page(spinand, &prev,
+							       status,
+							       enable_ecc);
+			ret = spinand_read_page_done(mtd, ops, &prev, ret,
+						     max_bitflips, ecc_failed);
+			if (ret)
+				return ret;
+		}
+
+		ret = spinand_select_target(spinand, iter.req.pos.target);
+		if (ret)
+			return ret;
+
+		ret = spinand_ecc_enable(spinand, enable_ecc);
+		if (ret)
+			return ret;
+
+		ret = spinand_load_page_op(spinand, &iter.req);
+		if (!ret)
+			ret = spinand_wait(spinand, &status);
+		if (ret < 0)
+			return ret;
+
+		prev = iter.req;
+		pending = true;
+		cached = true;
+	}
+
+	if (!pending)
+		return 0;
+
+	if (!cached) {
+		ret = spinand_read_cache_last_op(spinand);
+		if (!ret)
+			ret = spinand_wait(spinand, &status);
+	}
+	if (!ret)
+		ret = spinand_read_cached_page(spinand, &prev, status,
+					       enable_ecc);
+
+	return spinand_read_page_done(mtd, ops, &prev, ret, max_bitflips,
+				      ecc_failed);
+}
+
 static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 			    struct mtd_oob_ops *ops)
 {
@@ -577,6 +771,12 @@ static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 	mutex_lock(&spinand->lock);
 #endif
 
+	if (spinand->flags & SPINAND_HAS_READ_CACHE) {
+		ret = spinand_mtd_read_cache(mtd, from, ops, enable_ecc,
+					     &max_bitflips, &ecc_failed);
+		goto out;
+	}
+
 	nanddev_io_for_each_page(nand, from, ops, &iter) {
 		ret = spinand_select_target(spinand, iter.req.pos.target);
 		if (ret)
@@ -587,22 +787,13 @@ static int spinand_mtd_read(struct mtd_info *mtd, loff_t from,
 			break;
 
 		ret = spinand_read_page(spinand, &iter.req, enable_ecc);
-		if (ret < 0 && ret != -EBADMSG)
+		ret = spinand_read_page_done(mtd, ops, &iter.req, ret,
+					     &max_bitflips, &ecc_failed);
+		if (ret)
 			break;
-
-		if (ret == -EBADMSG) {
-			ecc_failed = true;
-			mtd->ecc_stats.failed++;
-			ret = 0;
-		} else {
-			mtd->ecc_stats.corrected += ret;
-			max_bitflips = max_t(unsigned int, max_bitflips, ret);
-		}
-
-		ops->retlen += iter.req.datalen;
-		ops->oobretlen += iter.req.ooblen;
 	}
 
+out:
 #ifndef __UBOOT__
 	mutex_unlock(&spinand->lock);
 #endif
@@ -1029,6 +1220,31 @@ static const struct mtd_ooblayout_ops spinand_noecc_ooblayout = {
 	.rfree = spinand_noecc_ooblayout_free,
 };
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+/*
+ * Map the cache, plane bits included, for reads. Reads go through
+ * spi_mem_exec_op() if the mapping cannot be created.
+ */
+static void spinand_create_read_dirmap(struct spinand_device *spinand)
+{
+	struct nand_device *nand = spinand_to_nand(spinand);
+	struct spi_mem_dirmap_info info = {
+		.op_tmpl = *spinand->op_templates.read_cache,
+		.offset = 0,
+		.length = nanddev_page_size(nand) +
+			  nanddev_per_page_oobsize(nand),
+	};
+
+	if (nand->memorg.planes_per_lun > 1)
+		info.length = nand->memorg.planes_per_lun <<
+			      fls(nand->memorg.pagesize);
+
+	spinand->rdesc = spi_mem_dirmap_create(spinand->slave, &info);
+	if (IS_ERR(spinand->rdesc))
+		spinand->rdesc = NULL;
+}
+#endif
+
 static int spinand_init(struct spinand_device *spinand)
 {
 	struct mtd_info *mtd = spinand_to_mtd(spinand);
@@ -1119,6 +1335,10 @@ static int spinand_init(struct spinand_device *spinand)
 
 	mtd->oobavail = ret;
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	spinand_create_read_dirmap(spinand);
+#endif
+
 	return 0;
 
 err_cleanup_nanddev:
@@ -1137,6 +1357,12 @@ static void spinand_cleanup(struct spinand_device *spinand)
 {
 	struct nand_device *nand = spinand_to_nand(spinand);
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	if (spinand->rdesc) {
+		spi_mem_dirmap_destroy(spinand->rdesc);
+		spinand->rdesc = NULL;
+	}
+#endif
 	nanddev_cleanup(nand);
 	spinand_manufacturer_cleanup(spinand);
 	kfree(spinand->databuf);
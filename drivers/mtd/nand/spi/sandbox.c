@@ -0,0 +1,407 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sandbox SPI NAND emulator
+ *
+ * Models a Micron MT29F2G01ABAGD on the sandbox SPI bus: PAGE READ, the
+ * PAGE READ CACHE RANDOM/LAST pipeline, program and erase. A virtual clock
+ * counts bus time and array busy times (tR, tRCBSY, tPROG, tBERS), so tests
+ * can check how much of the array time a read strategy hides.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <os.h>
+#include <spi.h>
+#include <asm/state.h>
+#include <asm/test.h>
+
+#define SB_SPINAND_PAGE_SIZE	2048
+#define SB_SPINAND_OOB_SIZE	128
+#define SB_SPINAND_RAW_SIZE	(SB_SPINAND_PAGE_SIZE + SB_SPINAND_OOB_SIZE)
+#define SB_SPINAND_PAGES_SHIFT	6
+#define SB_SPINAND_PAGES_PER_BLOCK	(1 << SB_SPINAND_PAGES_SHIFT)
+#define SB_SPINAND_BLOCK_SIZE	(SB_SPINAND_PAGES_PER_BLOCK * \
+				 SB_SPINAND_RAW_SIZE)
+#define SB_SPINAND_BLOCKS	2048
+#define SB_SPINAND_COL_MASK	0xfff	/* bit 12 selects the plane */
+
+/* Timings in ns */
+#define SB_SPINAND_T_BIT	10	/* one bus clock */
+#define SB_SPINAND_T_R		50000
+#define SB_SPINAND_T_RCBSY	5000
+#define SB_SPINAND_T_RST	5000
+#define SB_SPINAND_T_PROG	200000
+#define SB_SPINAND_T_BERS	2000000
+
+#define SB_SPINAND_REG_LOCK	0xa0
+#define SB_SPINAND_REG_CFG	0xb0
+#define SB_SPINAND_REG_STATUS	0xc0
+
+#define SB_SPINAND_OIP		BIT(0)
+#define SB_SPINAND_WEL		BIT(1)
+#define SB_SPINAND_P_FAIL	BIT(3)
+#define SB_SPINAND_CRBSY	BIT(7)
+
+enum sb_spinand_op {
+	SB_SPINAND_OP_NONE,
+	SB_SPINAND_OP_ID,
+	SB_SPINAND_OP_GET_FEATURE,
+	SB_SPINAND_OP_SET_FEATURE,
+	SB_SPINAND_OP_READ_CACHE,
+	SB_SPINAND_OP_LOAD,
+	SB_SPINAND_OP_LOAD_RANDOM,
+	SB_SPINAND_OP_ROW,	/* command with a row address, run at the end */
+	SB_SPINAND_OP_CMD,	/* command alone, run at the end */
+};
+
+struct sb_spinand_cmd {
+	u8 opcode;
+	u8 op;
+	u8 naddr;
+	u8 ndummy;
+	u8 width;		/* bus width of the data phase */
+};
+
+static const struct sb_spinand_cmd sb_spinand_cmds[] = {
+	{ 0x9f, SB_SPINAND_OP_ID, 0, 0, 1 },
+	{ 0x0f, SB_SPINAND_OP_GET_FEATURE, 1, 0, 1 },
+	{ 0x1f, SB_SPINAND_OP_SET_FEATURE, 1, 0, 1 },
+	{ 0x03, SB_SPINAND_OP_READ_CACHE, 2, 1, 1 },
+	{ 0x0b, SB_SPINAND_OP_READ_CACHE, 2, 1, 1 },
+	{ 0x3b, SB_SPINAND_OP_READ_CACHE, 2, 1, 2 },
+	{ 0xbb, SB_SPINAND_OP_READ_CACHE, 2, 1, 2 },
+	{ 0x6b, SB_SPINAND_OP_READ_CACHE, 2, 1, 4 },
+	{ 0xeb, SB_SPINAND_OP_READ_CACHE, 2, 2, 4 },
+	{ 0x02, SB_SPINAND_OP_LOAD, 2, 0, 1 },
+	{ 0x32, SB_SPINAND_OP_LOAD, 2, 0, 4 },
+	{ 0x84, SB_SPINAND_OP_LOAD_RANDOM, 2, 0, 1 },
+	{ 0x34, SB_SPINAND_OP_LOAD_RANDOM, 2, 0, 4 },
+	{ 0x13, SB_SPINAND_OP_ROW, 3, 0, 1 },	/* PAGE READ */
+	{ 0x31, SB_SPINAND_OP_ROW, 3, 0, 1 },	/* PAGE READ CACHE RANDOM */
+	{ 0x10, SB_SPINAND_OP_ROW, 3, 0, 1 },	/* PROGRAM EXECUTE */
+	{ 0xd8, SB_SPINAND_OP_ROW, 3, 0, 1 },	/* BLOCK ERASE */
+	{ 0x3f, SB_SPINAND_OP_CMD, 0, 0, 1 },	/* PAGE READ CACHE LAST */
+	{ 0x06, SB_SPINAND_OP_CMD, 0, 0, 1 },	/* WRITE ENABLE */
+	{ 0x04, SB_SPINAND_OP_CMD, 0, 0, 1 },	/* WRITE DISABLE */
+	{ 0xff, SB_SPINAND_OP_CMD, 0, 0, 1 },	/* RESET */
+};
+
+/* Micron sends a dummy byte before the manufacturer and device IDs */
+static const u8 sb_spinand_id[] = { 0x00, 0x2c, 0x24 };
+
+/**
+ * struct sandbox_spi_nand_priv - State of the emulated chip
+ *
+ * @blocks: contents of each block, NULL while the block is erased
+ * @cache: cache register
+ * @data_row: page in the data register, or -1
+ * @lock: block lock register
+ * @cfg: configuration register
+ * @status: status bits other than OIP and CRBSY
+ * @cmd: command of the transaction in progress, or NULL
+ * @pos: bytes clocked since the start of the transaction
+ * @addr: address bytes latched for @cmd
+ * @col: column of the next data byte
+ * @now: virtual time in ns
+ * @busy_until: time at which OIP clears
+ * @array_until: time at which the array finishes loading @data_row
+ */
+struct sandbox_spi_nand_priv {
+	u8 **blocks;
+	u8 cache[SB_SPINAND_RAW_SIZE];
+	int data_row;
+	u8 lock;
+	u8 cfg;
+	u8 status;
+	const struct sb_spinand_cmd *cmd;
+	uint pos;
+	u32 addr;
+	uint col;
+	u64 now;
+	u64 busy_until;
+	u64 array_until;
+};
+
+static u8 *sb_spinand_page(struct sandbox_spi_nand_priv *priv, int row)
+{
+	u8 *block = priv->blocks[row >> SB_SPINAND_PAGES_SHIFT];
+
+	if (!block)
+		return NULL;
+
+	return block + (row % SB_SPINAND_PAGES_PER_BLOCK) * SB_SPINAND_RAW_SIZE;
+}
+
+static void sb_spinand_load_cache(struct sandbox_spi_nand_priv *priv,
+				  int row)
+{
+	u8 *page = sb_spinand_page(priv, row);
+
+	if (page)
+		memcpy(priv->cache, page, SB_SPINAND_RAW_SIZE);
+	else
+		memset(priv->cache, 0xff, SB_SPINAND_RAW_SIZE);
+}
+
+static u8 sb_spinand_status(struct sandbox_spi_nand_priv *priv)
+{
+	u8 status = priv->status;
+
+	if (priv->now < priv->busy_until)
+		status |= SB_SPINAND_OIP;
+	if (priv->now < priv->array_until)
+		status |= SB_SPINAND_CRBSY;
+
+	return status;
+}
+
+static void sb_spinand_program(struct sandbox_spi_nand_priv *priv, int row)
+{
+	int block = row >> SB_SPINAND_PAGES_SHIFT;
+	u8 *page;
+	int i;
+
+	if (!(priv->status & SB_SPINAND_WEL)) {
+		priv->status |= SB_SPINAND_P_FAIL;
+		return;
+	}
+	if (!priv->blocks[block]) {
+		priv->blocks[block] = os_malloc(SB_SPINAND_BLOCK_SIZE);
+		if (!priv->blocks[block]) {
+			priv->status |= SB_SPINAND_P_FAIL;
+			return;
+		}
+		memset(priv->blocks[block], 0xff, SB_SPINAND_BLOCK_SIZE);
+	}
+
+	/* Programming can only clear bits */
+	page = sb_spinand_page(priv, row);
+	for (i = 0; i < SB_SPINAND_RAW_SIZE; i++)
+		page[i] &= priv->cache[i];
+	priv->status &= ~(SB_SPINAND_WEL | SB_SPINAND_P_FAIL);
+	priv->busy_until = priv->now + SB_SPINAND_T_PROG;
+}
+
+static void sb_spinand_erase(struct sandbox_spi_nand_priv *priv, int row)
+{
+	int block = row >> SB_SPINAND_PAGES_SHIFT;
+
+	if (!(priv->status & SB_SPINAND_WEL))
+		return;
+
+	os_free(priv->blocks[block]);
+	priv->blocks[block] = NULL;
+	priv->status &= ~SB_SPINAND_WEL;
+	priv->busy_until = priv->now + SB_SPINAND_T_BERS;
+}
+
+/* Run a command that takes effect once the chip select goes high */
+static void sb_spinand_exec(struct sandbox_spi_nand_priv *priv)
+{
+	int row = priv->addr % (SB_SPINAND_BLOCKS * SB_SPINAND_PAGES_PER_BLOCK);
+	u64 start;
+
+	switch (priv->cmd->opcode) {
+	case 0x13:
+		sb_spinand_load_cache(priv, row);
+		priv->data_row = row;
+		priv->busy_until = priv->now + SB_SPINAND_T_R;
+		priv->array_until = priv->busy_until;
+		break;
+	case 0x31:
+	case 0x3f:
+		/* Wait for the array, move its page to the cache */
+		if (priv->data_row < 0)
+			break;
+		start = max(priv->now, priv->array_until);
+		sb_spinand_load_cache(priv, priv->data_row);
+		priv->busy_until = start + SB_SPINAND_T_RCBSY;
+		priv->array_until = priv->busy_until;
+		if (priv->cmd->opcode == 0x31) {
+			priv->data_row = row;
+			priv->array_until += SB_SPINAND_T_R;
+		}
+		break;
+	case 0x10:
+		sb_spinand_program(priv, row);
+		break;
+	case 0xd8:
+		sb_spinand_erase(priv, row);
+		break;
+	case 0x06:
+		priv->status |= SB_SPINAND_WEL;
+		break;
+	case 0x04:
+		priv->status &= ~SB_SPINAND_WEL;
+		break;
+	case 0xff:
+		priv->status = 0;
+		priv->data_row = -1;
+		priv->busy_until = priv->now + SB_SPINAND_T_RST;
+		priv->array_until = 0;
+		break;
+	}
+}
+
+/* Handle one byte of the data phase, returning the byte sent back */
+static u8 sb_spinand_data(struct sandbox_spi_nand_priv *priv, u8 in,
+			  uint idx)
+{
+	const struct sb_spinand_cmd *cmd = priv->cmd;
+	u8 out = 0xff;
+
+	switch (cmd->op) {
+	case SB_SPINAND_OP_ID:
+		out = idx < sizeof(sb_spinand_id) ? sb_spinand_id[idx] : 0;
+		break;
+	case SB_SPINAND_OP_GET_FEATURE:
+		if (priv->addr == SB_SPINAND_REG_STATUS)
+			out = sb_spinand_status(priv);
+		else if (priv->addr == SB_SPINAND_REG_CFG)
+			out = priv->cfg;
+		else if (priv->addr == SB_SPINAND_REG_LOCK)
+			out = priv->lock;
+		else
+			out = 0;
+		break;
+	case SB_SPINAND_OP_SET_FEATURE:
+		if (!idx && priv->addr == SB_SPINAND_REG_CFG)
+			priv->cfg = in;
+		else if (!idx && priv->addr == SB_SPINAND_REG_LOCK)
+			priv->lock = in;
+		break;
+	case SB_SPINAND_OP_READ_CACHE:
+		if (priv->col < SB_SPINAND_RAW_SIZE)
+			out = priv->cache[priv->col];
+		priv->col++;
+		break;
+	case SB_SPINAND_OP_LOAD:
+	case SB_SPINAND_OP_LOAD_RANDOM:
+		if (priv->col < SB_SPINAND_RAW_SIZE)
+			priv->cache[priv->col] = in;
+		priv->col++;
+		break;
+	}
+
+	return out;
+}
+
+static int sandbox_spi_nand_xfer(struct udevice *dev, unsigned int bitlen,
+				 const void *dout, void *din,
+				 unsigned long flags)
+{
+	struct sandbox_spi_nand_priv *priv = dev_get_priv(dev);
+	const struct sb_spinand_cmd *cmd;
+	const u8 *tx = dout;
+	u8 *rx = din;
+	uint i, hdr;
+	u8 in, out;
+
+	if (flags & SPI_XFER_BEGIN) {
+		priv->cmd = NULL;
+		priv->pos = 0;
+		priv->addr = 0;
+	}
+
+	for (i = 0; i < bitlen / 8; i++, priv->pos++) {
+		in = tx ? tx[i] : 0;
+		out = 0xff;
+		cmd = priv->cmd;
+		if (!priv->pos) {
+			for (cmd = sb_spinand_cmds;
+			     cmd < sb_spinand_cmds + ARRAY_SIZE(sb_spinand_cmds);
+			     cmd++) {
+				if (cmd->opcode == in)
+					break;
+			}
+			if (cmd == sb_spinand_cmds + ARRAY_SIZE(sb_spinand_cmds))
+				cmd = NULL;
+			priv->cmd = cmd;
+			priv->now += 8 * SB_SPINAND_T_BIT;
+		} else if (!cmd) {
+			priv->now += 8 * SB_SPINAND_T_BIT;
+		} else if (priv->pos <= cmd->naddr) {
+			priv->addr = priv->addr << 8 | in;
+			if (priv->pos == cmd->naddr) {
+				priv->col = priv->addr & SB_SPINAND_COL_MASK;
+				/* PROGRAM LOAD starts from a blank cache */
+				if (cmd->op == SB_SPINAND_OP_LOAD)
+					memset(priv->cache, 0xff,
+					       SB_SPINAND_RAW_SIZE);
+			}
+			priv->now += 8 * SB_SPINAND_T_BIT;
+		} else {
+			hdr = 1 + cmd->naddr + cmd->ndummy;
+			if (priv->pos >= hdr) {
+				out = sb_spinand_data(priv, in, priv->pos - hdr);
+				priv->now += 8 * SB_SPINAND_T_BIT / cmd->width;
+			} else {
+				priv->now += 8 * SB_SPINAND_T_BIT;
+			}
+		}
+		if (rx)
+			rx[i] = out;
+	}
+
+	if ((flags & SPI_XFER_END) && priv->cmd) {
+		if (priv->cmd->op == SB_SPINAND_OP_ROW ||
+		    priv->cmd->op == SB_SPINAND_OP_CMD)
+			sb_spinand_exec(priv);
+		priv->cmd = NULL;
+	}
+
+	return 0;
+}
+
+u64 sandbox_spi_nand_get_time(struct udevice *dev)
+{
+	struct udevice *emul;
+	struct sandbox_spi_nand_priv *priv;
+
+	if (sandbox_spi_get_emul(state_get_current(), dev->parent, dev, &emul))
+		return 0;
+	priv = dev_get_priv(emul);
+
+	return priv ? priv->now : 0;
+}
+
+static int sandbox_spi_nand_probe(struct udevice *dev)
+{
+	struct sandbox_spi_nand_priv *priv = dev_get_priv(dev);
+
+	priv->blocks = os_malloc(SB_SPINAND_BLOCKS * sizeof(*priv->blocks));
+	if (!priv->blocks)
+		return -ENOMEM;
+	memset(priv->blocks, '\0', SB_SPINAND_BLOCKS * sizeof(*priv->blocks));
+	priv->data_row = -1;
+	/* All blocks are locked at power up */
+	priv->lock = 0x38;
+
+	return 0;
+}
+
+static int sandbox_spi_nand_remove(struct udevice *dev)
+{
+	struct sandbox_spi_nand_priv *priv = dev_get_priv(dev);
+	int i;
+
+	for (i = 0; i < SB_SPINAND_BLOCKS; i++)
+		os_free(priv->blocks[i]);
+	os_free(priv->blocks);
+
+	return 0;
+}
+
+static const struct dm_spi_emul_ops sandbox_spi_nand_ops = {
+	.xfer		= sandbox_spi_nand_xfer,
+};
+
+U_BOOT_DRIVER(sandbox_spi_nand_emul) = {
+	.name		= "sandbox_spi_nand_emul",
+	.id		= UCLASS_SPI_EMUL,
+	.probe		= sandbox_spi_nand_probe,
+	.remove		= sandbox_spi_nand_remove,
+	.priv_auto_alloc_size = sizeof(struct sandbox_spi_nand_priv),
+	.ops		= &sandbox_spi_nand_ops,
+};
@@ -523,18 +523,23 @@ static const struct dm_spi_emul_ops sandbox_sf_emul_ops = {
 int sandbox_sf_bind_emul(struct sandbox_state *state, int busnum, int cs,
 			 struct udevice *bus, ofnode node, const char *spec)
 {
+	const char *drv_name = "sandbox_sf_emul";
 	struct udevice *emul;
 	char name[20], *str;
 	struct driver *drv;
 	int ret;
 
+	/* SPI NAND chips have their own emulator */
+	if (ofnode_device_is_compatible(node, "spi-nand"))
+		drv_name = "sandbox_spi_nand_emul";
+
 	/* now the emulator */
 	strncpy(name, spec, sizeof(name) - 6);
 	name[sizeof(name) - 6] = '\0';
 	strcat(name, "-emul");
-	drv = lists_driver_lookup_name("sandbox_sf_emul");
+	drv = lists_driver_lookup_name(drv_name);
 	if (!drv) {
-		puts("Cannot find sandbox_sf_emul driver\n");
+		printf("Cannot find %s driver\n", drv_name);
 		return -ENOENT;
 	}
 	str = strdup(name);
@@ -143,8 +143,12 @@ int spi_flash_std_probe(struct udevice *dev)
 
 static int spi_flash_std_remove(struct udevice *dev)
 {
+	struct spi_flash *flash = dev_get_uclass_priv(dev);
+
 	if (CONFIG_IS_ENABLED(SPI_FLASH_MTD))
 		spi_flash_mtd_unregister();
+	if (CONFIG_IS_ENABLED(SPI_DIRMAP))
+		spi_nor_remove(flash);
 
 	return 0;
 }
@@ -73,26 +73,40 @@ static int spi_nor_write_reg(struct spi_nor *nor, u8 opcode, u8 *buf, int len)
 	return spi_nor_read_write_reg(nor, &op, buf);
 }
 
+/* Build the read operation for the current opcode and protocol */
+static void spi_nor_read_op(struct spi_nor *nor, struct spi_mem_op *op,
+			    loff_t from, size_t len, u_char *buf)
+{
+	*op = (struct spi_mem_op)
+		SPI_MEM_OP(SPI_MEM_OP_CMD(nor->read_opcode, 1),
+			   SPI_MEM_OP_ADDR(nor->addr_width, from, 1),
+			   SPI_MEM_OP_DUMMY(nor->read_dummy, 1),
+			   SPI_MEM_OP_DATA_IN(len, buf, 1));
+
+	/* get transfer protocols. */
+	op->cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
+	op->addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
+	op->dummy.buswidth = op->addr.buswidth;
+	op->data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
+
+	/* convert the dummy cycles to the number of bytes */
+	op->dummy.nbytes = (nor->read_dummy * op->dummy.buswidth) / 8;
+}
+
 static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
 				 u_char *buf)
 {
-	struct spi_mem_op op =
-			SPI_MEM_OP(SPI_MEM_OP_CMD(nor->read_opcode, 1),
-				   SPI_MEM_OP_ADDR(nor->addr_width, from, 1),
-				   SPI_MEM_OP_DUMMY(nor->read_dummy, 1),
-				   SPI_MEM_OP_DATA_IN(len, buf, 1));
+	struct spi_mem_op op;
 	size_t remaining = len;
 	int ret;
 
-	/* get transfer protocols. */
-	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
-	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
-	op.dummy.buswidth = op.addr.buswidth;
-	op.data.buswidth = spi_nor_get_protocol_data_nbits(nor->read_proto);
-
-	/* convert the dummy cycles to the number of bytes */
-	op.dummy.nbytes = (nor->read_dummy * op.dummy.buswidth) / 8;
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	/* The caller loops if the mapping returns less than asked for */
+	if (nor->rdesc)
+		return spi_mem_dirmap_read(nor->rdesc, from, len, buf);
+#endif
 
+	spi_nor_read_op(nor, &op, from, len, buf);
 	while (remaining) {
 		op.data.nbytes = remaining < UINT_MAX ? remaining : UINT_MAX;
 		ret = spi_mem_adjust_op_size(nor->spi, &op);
@@ -2514,6 +2528,31 @@ static int spi_nor_init(struct spi_nor *nor)
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+/*
+ * Map the whole device for reads. This is only an optimisation, so reads
+ * go through spi_mem_exec_op() if the mapping cannot be created.
+ */
+static void spi_nor_create_read_dirmap(struct spi_nor *nor)
+{
+	struct spi_mem_dirmap_info info = {
+		.offset = 0,
+		.length = nor->mtd.size,
+	};
+
+	if (nor->read != spi_nor_read_data)
+		return;
+
+	spi_nor_read_op(nor, &info.op_tmpl, 0, 0, NULL);
+	nor->rdesc = spi_mem_dirmap_create(nor->spi, &info);
+	if (IS_ERR(nor->rdesc)) {
+		dev_dbg(nor->dev, "no read mapping (err=%ld)\n",
+			PTR_ERR(nor->rdesc));
+		nor->rdesc = NULL;
+	}
+}
+#endif
+
 int spi_nor_scan(struct spi_nor *nor)
 {
 	struct spi_nor_flash_parameter params;
@@ -2669,6 +2708,10 @@ int spi_nor_scan(struct spi_nor *nor)
 	nor->erase_size = mtd->erasesize;
 	nor->sector_size = mtd->erasesize;
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	spi_nor_create_read_dirmap(nor);
+#endif
+
 #ifndef CONFIG_SPL_BUILD
 	printf("SF: Detected %s with page size ", nor->name);
 	print_size(nor->page_size, ", erase size ");
@@ -2679,3 +2722,13 @@ int spi_nor_scan(struct spi_nor *nor)
 
 	return 0;
 }
+
+void spi_nor_remove(struct spi_nor *nor)
+{
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	if (nor->rdesc) {
+		spi_mem_dirmap_destroy(nor->rdesc);
+		nor->rdesc = NULL;
+	}
+#endif
+}
@@ -151,7 +151,7 @@ static void tx_descs_init(struct dw_eth_dev *priv)
 	struct dmamacdescr *desc_p;
 	u32 idx;
 
-	for (idx = 0; idx < CONFIG_TX_DESCR_NUM; idx++) {
+	for (idx = 0; idx < priv->tx_descr_num; idx++) {
 		desc_p = &desc_table_p[idx];
 		desc_p->dmamac_addr = (ulong)&txbuffs[idx * CONFIG_ETH_BUFSIZE];
 		desc_p->dmamac_next = (ulong)&desc_table_p[idx + 1];
@@ -181,6 +181,8 @@ static void tx_descs_init(struct dw_eth_dev *priv)
 
 	writel((ulong)&desc_table_p[0], &dma_p->txdesclistaddr);
 	priv->tx_currdescnum = 0;
+	priv->tx_dirtydescnum = 0;
+	priv->tx_pending = 0;
 }
 
 static void rx_descs_init(struct dw_eth_dev *priv)
@@ -199,7 +201,7 @@ static void rx_descs_init(struct dw_eth_dev *priv)
 	 * GMAC data will be corrupted. */
 	flush_dcache_range((ulong)rxbuffs, (ulong)rxbuffs + RX_TOTAL_BUFSIZE);
 
-	for (idx = 0; idx < CONFIG_RX_DESCR_NUM; idx++) {
+	for (idx = 0; idx < priv->rx_descr_num; idx++) {
 		desc_p = &desc_table_p[idx];
 		desc_p->dmamac_addr = (ulong)&rxbuffs[idx * CONFIG_ETH_BUFSIZE];
 		desc_p->dmamac_next = (ulong)&desc_table_p[idx + 1];
@@ -361,6 +363,46 @@ int designware_eth_enable(struct dw_eth_dev *priv)
 
 #define ETH_ZLEN	60
 
+/*
+ * Take back the transmit descriptors of the frames the DMA has sent, oldest
+ * first. Sending does not wait for its frame: this is only done once the
+ * ring is full, and then waits until at least one descriptor is free.
+ */
+static int dw_tx_reclaim(struct dw_eth_dev *priv)
+{
+	struct dmamacdescr *desc_p;
+	ulong desc_start;
+	ulong start = get_timer(0);
+
+	while (priv->tx_pending == priv->tx_descr_num) {
+		desc_p = &priv->tx_mac_descrtable[priv->tx_dirtydescnum];
+		desc_start = (ulong)desc_p;
+		invalidate_dcache_range(desc_start, desc_start +
+					roundup(sizeof(*desc_p),
+						ARCH_DMA_MINALIGN));
+		if (desc_p->txrx_status & DESC_TXSTS_OWNBYDMA) {
+			if (get_timer(start) > DW_TX_TIMEOUT)
+				return -ETIMEDOUT;
+			continue;
+		}
+
+		/* Take all the frames sent since, in one go */
+		do {
+			if (++priv->tx_dirtydescnum >= priv->tx_descr_num)
+				priv->tx_dirtydescnum = 0;
+			priv->tx_pending--;
+			desc_p = &priv->tx_mac_descrtable[priv->tx_dirtydescnum];
+			desc_start = (ulong)desc_p;
+			invalidate_dcache_range(desc_start, desc_start +
+						roundup(sizeof(*desc_p),
+							ARCH_DMA_MINALIGN));
+		} while (priv->tx_pending &&
+			 !(desc_p->txrx_status & DESC_TXSTS_OWNBYDMA));
+	}
+
+	return 0;
+}
+
 static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 {
 	struct eth_dma_regs *dma_p = priv->dma_regs_p;
@@ -371,22 +413,22 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
 	ulong data_start = desc_p->dmamac_addr;
 	ulong data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
-	/*
-	 * Strictly we only need to invalidate the "txrx_status" field
-	 * for the following check, but on some platforms we cannot
-	 * invalidate only 4 bytes, so we flush the entire descriptor,
-	 * which is 16 bytes in total. This is safe because the
-	 * individual descriptors in the array are each aligned to
-	 * ARCH_DMA_MINALIGN and padded appropriately.
-	 */
-	invalidate_dcache_range(desc_start, desc_end);
-
-	/* Check if the descriptor is owned by CPU */
-	if (desc_p->txrx_status & DESC_TXSTS_OWNBYDMA) {
+	/* With every descriptor in flight, wait for the DMA to free one */
+	if (priv->tx_pending == priv->tx_descr_num && dw_tx_reclaim(priv)) {
 		printf("CPU not owner of tx frame\n");
 		return -EPERM;
 	}
 
+	/*
+	 * The descriptor is ours, but its status may have been written by
+	 * the DMA since we last looked. On some platforms we cannot
+	 * invalidate only the "txrx_status" field, so we invalidate the
+	 * entire descriptor, which is 16 bytes in total. This is safe
+	 * because the individual descriptors in the array are each aligned
+	 * to ARCH_DMA_MINALIGN and padded appropriately.
+	 */
+	invalidate_dcache_range(desc_start, desc_end);
+
 	memcpy((void *)data_start, packet, length);
 	if (length < ETH_ZLEN) {
 		memset(&((char *)data_start)[length], 0, ETH_ZLEN - length);
@@ -417,10 +459,11 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	flush_dcache_range(desc_start, desc_end);
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_TX_DESCR_NUM)
+	if (++desc_num >= priv->tx_descr_num)
 		desc_num = 0;
 
 	priv->tx_currdescnum = desc_num;
+	priv->tx_pending++;
 
 	/* Start the transmission */
 	writel(POLL_DATA, &dma_p->txpolldemand);
@@ -428,10 +471,11 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	return 0;
 }
 
-static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
+static int _dw_eth_recv_desc(struct dw_eth_dev *priv, u32 desc_num,
+			     uchar **packetp)
 {
-	u32 status, desc_num = priv->rx_currdescnum;
 	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	u32 status;
 	int length = -EAGAIN;
 	ulong desc_start = (ulong)desc_p;
 	ulong desc_end = desc_start +
@@ -459,6 +503,35 @@ static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
 	return length;
 }
 
+static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
+{
+	return _dw_eth_recv_desc(priv, priv->rx_currdescnum, packetp);
+}
+
+/*
+ * Look ahead in the ring for the frames which have come in, from the
+ * current descriptor on. They are handed back in order by _dw_free_pkt().
+ */
+static int _dw_eth_recv_batch(struct dw_eth_dev *priv, uchar **packets,
+			      int *lengths, int max)
+{
+	u32 desc_num = priv->rx_currdescnum;
+	int count, length;
+
+	/* Leave the DMA some descriptors while the batch is processed */
+	max = min_t(int, max, priv->rx_descr_num / 2);
+	for (count = 0; count < max; count++) {
+		length = _dw_eth_recv_desc(priv, desc_num, &packets[count]);
+		if (length == -EAGAIN)
+			break;
+		lengths[count] = length;
+		if (++desc_num >= priv->rx_descr_num)
+			desc_num = 0;
+	}
+
+	return count;
+}
+
 static int _dw_free_pkt(struct dw_eth_dev *priv)
 {
 	u32 desc_num = priv->rx_currdescnum;
@@ -477,7 +550,7 @@ static int _dw_free_pkt(struct dw_eth_dev *priv)
 	flush_dcache_range(desc_start, desc_end);
 
 	/* Test the wrap-around condition. */
-	if (++desc_num >= CONFIG_RX_DESCR_NUM)
+	if (++desc_num >= priv->rx_descr_num)
 		desc_num = 0;
 	priv->rx_currdescnum = desc_num;
 
@@ -586,6 +659,8 @@ int designware_initialize(ulong base_addr, u32 interface)
 	dev->priv = priv;
 
 	priv->dev = dev;
+	priv->tx_descr_num = CONFIG_DW_TX_DESCR_NUM;
+	priv->rx_descr_num = CONFIG_DW_RX_DESCR_NUM;
 	priv->mac_regs_p = (struct eth_mac_regs *)base_addr;
 	priv->dma_regs_p = (struct eth_dma_regs *)(base_addr +
 			DW_DMA_BASE_OFFSET);
@@ -638,6 +713,14 @@ int designware_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 	return _dw_eth_recv(priv, packetp);
 }
 
+int designware_eth_recv_batch(struct udevice *dev, int flags,
+			      uchar **packets, int *lengths, int max)
+{
+	struct dw_eth_dev *priv = dev_get_priv(dev);
+
+	return _dw_eth_recv_batch(priv, packets, lengths, max);
+}
+
 int designware_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct dw_eth_dev *priv = dev_get_priv(dev);
@@ -676,9 +759,25 @@ static int designware_eth_bind(struct udevice *dev)
 	return 0;
 }
 
+/* Use the ring sizes asked for, if they fit in the rings allocated */
+static u32 dw_descr_num(struct udevice *dev, const char *ring, u32 num,
+			u32 max)
+{
+	if (!num)
+		return max;
+	if (num < DW_MIN_DESCR_NUM || num > max) {
+		dev_warn(dev, "%s ring of %u descriptors not supported, using %u\n",
+			 ring, num, max);
+		return max;
+	}
+
+	return num;
+}
+
 int designware_eth_probe(struct udevice *dev)
 {
-	struct eth_pdata *pdata = dev_get_platdata(dev);
+	struct dw_eth_pdata *dw_pdata = dev_get_platdata(dev);
+	struct eth_pdata *pdata = &dw_pdata->eth_pdata;
 	struct dw_eth_dev *priv = dev_get_priv(dev);
 	u32 iobase = pdata->iobase;
 	ulong ioaddr;
@@ -757,6 +856,10 @@ int designware_eth_probe(struct udevice *dev)
 	priv->dma_regs_p = (struct eth_dma_regs *)(ioaddr + DW_DMA_BASE_OFFSET);
 	priv->interface = pdata->phy_interface;
 	priv->max_speed = pdata->max_speed;
+	priv->tx_descr_num = dw_descr_num(dev, "TX", dw_pdata->tx_descr_num,
+					  CONFIG_DW_TX_DESCR_NUM);
+	priv->rx_descr_num = dw_descr_num(dev, "RX", dw_pdata->rx_descr_num,
+					  CONFIG_DW_RX_DESCR_NUM);
 
 	ret = dw_mdio_init(dev->name, dev);
 	if (ret) {
@@ -805,6 +908,7 @@ const struct eth_ops designware_eth_ops = {
 	.start			= designware_eth_start,
 	.send			= designware_eth_send,
 	.recv			= designware_eth_recv,
+	.recv_batch		= designware_eth_recv_batch,
 	.free_pkt		= designware_eth_free_pkt,
 	.stop			= designware_eth_stop,
 	.write_hwaddr		= designware_eth_write_hwaddr,
@@ -834,6 +938,10 @@ int designware_eth_ofdata_to_platdata(struct udevice *dev)
 	}
 
 	pdata->max_speed = dev_read_u32_default(dev, "max-speed", 0);
+	dw_pdata->tx_descr_num = dev_read_u32_default(dev, "snps,tx-descr-num",
+						      0);
+	dw_pdata->rx_descr_num = dev_read_u32_default(dev, "snps,rx-descr-num",
+						      0);
 
 #if CONFIG_IS_ENABLED(DM_GPIO)
 	if (dev_read_bool(dev, "snps,reset-active-low"))
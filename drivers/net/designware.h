@@ -14,14 +14,16 @@
 #include <asm-generic/gpio.h>
 #endif
 
-#define CONFIG_TX_DESCR_NUM	16
-#define CONFIG_RX_DESCR_NUM	16
+/* Rings are allocated for the most descriptors; the DT may ask for fewer */
 #define CONFIG_ETH_BUFSIZE	2048
-#define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_TX_DESCR_NUM)
-#define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_RX_DESCR_NUM)
+#define TX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_DW_TX_DESCR_NUM)
+#define RX_TOTAL_BUFSIZE	(CONFIG_ETH_BUFSIZE * CONFIG_DW_RX_DESCR_NUM)
+#define DW_MIN_DESCR_NUM	4
 
 #define CONFIG_MACRESET_TIMEOUT	(3 * CONFIG_SYS_HZ)
 #define CONFIG_MDIO_TIMEOUT	(3 * CONFIG_SYS_HZ)
+/* Longest wait for a transmit descriptor when the ring is full */
+#define DW_TX_TIMEOUT		(CONFIG_SYS_HZ / 10)
 
 struct eth_mac_regs {
 	u32 conf;		/* 0x00 */
@@ -223,14 +225,18 @@ struct dmamacdescr {
 #endif
 
 struct dw_eth_dev {
-	struct dmamacdescr tx_mac_descrtable[CONFIG_TX_DESCR_NUM];
-	struct dmamacdescr rx_mac_descrtable[CONFIG_RX_DESCR_NUM];
+	struct dmamacdescr tx_mac_descrtable[CONFIG_DW_TX_DESCR_NUM];
+	struct dmamacdescr rx_mac_descrtable[CONFIG_DW_RX_DESCR_NUM];
 	char txbuffs[TX_TOTAL_BUFSIZE] __aligned(ARCH_DMA_MINALIGN);
 	char rxbuffs[RX_TOTAL_BUFSIZE] __aligned(ARCH_DMA_MINALIGN);
 
 	u32 interface;
 	u32 max_speed;
+	u32 tx_descr_num;	/* Descriptors in use in each ring */
+	u32 rx_descr_num;
 	u32 tx_currdescnum;
+	u32 tx_dirtydescnum;	/* Oldest frame which may not be sent yet */
+	u32 tx_pending;		/* Frames handed to the DMA, not reclaimed */
 	u32 rx_currdescnum;
 
 	struct eth_mac_regs *mac_regs_p;
@@ -258,12 +264,16 @@ extern const struct eth_ops designware_eth_ops;
 struct dw_eth_pdata {
 	struct eth_pdata eth_pdata;
 	u32 reset_delays[3];
+	u32 tx_descr_num;
+	u32 rx_descr_num;
 };
 
 int designware_eth_init(struct dw_eth_dev *priv, u8 *enetaddr);
 int designware_eth_enable(struct dw_eth_dev *priv);
 int designware_eth_send(struct udevice *dev, void *packet, int length);
 int designware_eth_recv(struct udevice *dev, int flags, uchar **packetp);
+int designware_eth_recv_batch(struct udevice *dev, int flags,
+			      uchar **packets, int *lengths, int max);
 int designware_eth_free_pkt(struct udevice *dev, uchar *packet,
 				   int length);
 int designware_eth_start(struct udevice *dev);
@@ -319,6 +319,27 @@ void sandbox_eth_set_priv(int index, void *priv)
 	dev_priv->priv = priv;
 }
 
+/*
+ * sandbox_eth_set_batch()
+ *
+ * index - interface to set the mode of
+ * batch - true to hand received packets over through recv_batch()
+ */
+void sandbox_eth_set_batch(int index, bool batch)
+{
+	struct udevice *dev;
+	struct eth_sandbox_priv *priv;
+	int ret;
+
+	ret = uclass_get_device(UCLASS_ETH, index, &dev);
+	if (ret)
+		return;
+
+	priv = dev_get_priv(dev);
+	priv->batch = batch;
+	priv->batched = 0;
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -366,6 +387,33 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 	return 0;
 }
 
+static int sb_eth_recv_batch(struct udevice *dev, int flags, uchar **packets,
+			     int *lengths, int max)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	int i, count;
+
+	if (!priv->batch)
+		return -ENOSYS;
+
+	if (skip_timeout) {
+		timer_test_add_offset(11000UL);
+		skip_timeout = false;
+	}
+
+	/* free_pkt() moves the queue up, so each takes the first one */
+	count = min(max, priv->recv_packets);
+	for (i = 0; i < count; i++) {
+		packets[i] = priv->recv_packet_buffer[i];
+		lengths[i] = priv->recv_packet_length[i];
+	}
+	priv->batched += count;
+	debug("eth_sandbox: received %d packets, %d waiting\n", count,
+	      priv->recv_packets - count);
+
+	return count;
+}
+
 static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -404,6 +452,7 @@ static const struct eth_ops sb_eth_ops = {
 	.start			= sb_eth_start,
 	.send			= sb_eth_send,
 	.recv			= sb_eth_recv,
+	.recv_batch		= sb_eth_recv_batch,
 	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
@@ -25,9 +25,11 @@
  */
 
 #include <malloc.h>
+#include <asm/cache.h>
 #include <asm/io.h>
 #include <clk.h>
 #include <common.h>
+#include <cpu_func.h>
 #include <dm.h>
 #include <errno.h>
 #include <fdtdec.h>
@@ -47,6 +49,7 @@
 #define	CTL	0x0
 #define	CLKDIV	0x4
 #define	SSCTL	0x8
+#define	PDMACTL	0x0C
 #define	FIFOCTL	0x10
 #define	STATUS	0x14
 #define	TX	0x20
@@ -70,6 +73,36 @@
 #define SPI_SS_HIGH     0x00000004
 #define SPI_QUAD_EN     0x400000
 #define SPI_DIR_2QM     0x100000
+#define TXPDMAEN        (0x01 << 0)
+#define RXPDMAEN        (0x01 << 1)
+#define PDMARST         (0x01 << 2)
+
+/* PDMA register offsets */
+#define PDMA_DSCT_CTL(ch)	(0x10 * (ch) + 0x0)
+#define PDMA_DSCT_SA(ch)	(0x10 * (ch) + 0x4)
+#define PDMA_DSCT_DA(ch)	(0x10 * (ch) + 0x8)
+#define PDMA_CHCTL		0x400
+#define PDMA_ABTSTS		0x420
+#define PDMA_TDSTS		0x424
+#define PDMA_REQSEL(ch)		(0x480 + ((ch) / 4) * 4)
+
+#define PDMA_OP_BASIC		(0x1 << 0)
+#define PDMA_TXTYPE_SINGLE	(0x1 << 2)
+#define PDMA_TBINTDIS		(0x1 << 7)
+#define PDMA_SAR_FIX		(0x3 << 8)
+#define PDMA_DAR_FIX		(0x3 << 10)
+#define PDMA_WIDTH_8		(0x0 << 12)
+#define PDMA_TXCNT(n)		(((n) - 1) << 16)
+#define PDMA_MAX_COUNT		16384
+#define PDMA_REQSEL_MASK	0x7f
+
+/* Channels of the PDMA controller used for the QSPI data phase */
+#define PDMA_CH_TX		0
+#define PDMA_CH_RX		1
+
+/* Data phases shorter than this are not worth setting up the PDMA for */
+#define QSPI_DMA_MIN_LEN	64
+#define QSPI_DMA_TIMEOUT_US	1000000
 
 #define QSPI_IFR_WIDTH_SINGLE_BIT_SPI   (0 << 0)
 #define QSPI_IFR_WIDTH_DUAL_OUTPUT      (1 << 0)
@@ -87,6 +120,10 @@ struct ma35d1_qspi {
 	ulong bus_clk_rate;
 	u32 mr;
 	struct reset_ctl rst;
+	void __iomem *pdma;
+	u32 pdma_tx_req;
+	u32 pdma_rx_req;
+	u8 dma_zero __aligned(ARCH_DMA_MINALIGN);
 };
 
 struct ma35d1_qspi_mode {
@@ -149,13 +186,94 @@ static bool ma35d1_qspi_supports_op(struct spi_slave *slave,
 	return true;
 }
 
-static int ma35d1_qspi_exec_op(struct spi_slave *slave,
-                                const struct spi_mem_op *op)
+static void ma35d1_qspi_pdma_setup(struct ma35d1_qspi *nq, int ch, u32 req,
+				   u32 ctl, ulong src, ulong dst, u32 count)
 {
-	struct ma35d1_qspi *nq = dev_get_priv(slave->dev->parent);
-	u32 i;
+	u32 reqsel = readl(nq->pdma + PDMA_REQSEL(ch));
+	int shift = (ch % 4) * 8;
+
+	reqsel &= ~(PDMA_REQSEL_MASK << shift);
+	writel(reqsel | (req << shift), nq->pdma + PDMA_REQSEL(ch));
+	writel(src, nq->pdma + PDMA_DSCT_SA(ch));
+	writel(dst, nq->pdma + PDMA_DSCT_DA(ch));
+	writel(ctl | PDMA_OP_BASIC | PDMA_TXTYPE_SINGLE | PDMA_TBINTDIS |
+	       PDMA_WIDTH_8 | PDMA_TXCNT(count), nq->pdma + PDMA_DSCT_CTL(ch));
+	writel(readl(nq->pdma + PDMA_CHCTL) | BIT(ch), nq->pdma + PDMA_CHCTL);
+}
+
+/*
+ * Move one data phase chunk with the PDMA. The TX channel always runs since
+ * the controller only clocks in a byte for each byte it sends; for reads it
+ * sends the same zero byte over and over.
+ */
+static int ma35d1_qspi_dma_xfer(struct ma35d1_qspi *nq, const u8 *tx, u8 *rx,
+				u32 len)
+{
+	u32 done = BIT(PDMA_CH_TX);
+	u32 ctl, val;
+	int ret;
+
+	if (rx) {
+		done |= BIT(PDMA_CH_RX);
+		invalidate_dcache_range((ulong)rx, (ulong)rx + len);
+		ma35d1_qspi_pdma_setup(nq, PDMA_CH_RX, nq->pdma_rx_req,
+				       PDMA_SAR_FIX, (ulong)nq->regs + RX,
+				       (ulong)rx, len);
+		tx = &nq->dma_zero;
+		ctl = PDMA_SAR_FIX | PDMA_DAR_FIX;
+	} else {
+		flush_dcache_range((ulong)tx, (ulong)tx + len);
+		ctl = PDMA_DAR_FIX;
+	}
+	ma35d1_qspi_pdma_setup(nq, PDMA_CH_TX, nq->pdma_tx_req, ctl, (ulong)tx,
+			       (ulong)nq->regs + TX, len);
+
+	ma35d1_qspi_write(rx ? TXPDMAEN | RXPDMAEN : TXPDMAEN, nq, PDMACTL);
+	ret = readl_poll_timeout(nq->pdma + PDMA_TDSTS, val,
+				 (val & done) == done, QSPI_DMA_TIMEOUT_US);
+	ma35d1_qspi_write(0, nq, PDMACTL);
+	writel(done, nq->pdma + PDMA_TDSTS);
+	if (ret) {
+		writel(done, nq->pdma + PDMA_ABTSTS);
+		writel(readl(nq->pdma + PDMA_CHCTL) & ~done,
+		       nq->pdma + PDMA_CHCTL);
+		ma35d1_qspi_write(PDMARST, nq, PDMACTL);
+		dev_err(nq->dev, "PDMA transfer timed out\n");
+		return ret;
+	}
+
+	if (rx)
+		invalidate_dcache_range((ulong)rx, (ulong)rx + len);
+
+	return 0;
+}
+
+/*
+ * Return how much of a data phase at @buf can go through the PDMA. Received
+ * data is invalidated in the cache, so reads use whole cache lines only and
+ * leave the tail to the FIFO loop.
+ */
+static u32 ma35d1_qspi_dma_len(struct ma35d1_qspi *nq, const void *buf,
+			       u32 len, bool rx)
+{
+	if (!nq->pdma || len < QSPI_DMA_MIN_LEN)
+		return 0;
+	if (rx) {
+		if (!IS_ALIGNED((ulong)buf, ARCH_DMA_MINALIGN))
+			return 0;
+		len = round_down(len, ARCH_DMA_MINALIGN);
+	}
+
+	return len;
+}
+
+static int ma35d1_qspi_xfer_op(struct ma35d1_qspi *nq,
+			       const struct spi_mem_op *op)
+{
+	u32 i, dma_len, chunk;
 	unsigned char *tx = (unsigned char *)op->data.buf.out;
 	unsigned char *rx = op->data.buf.in;
+	int ret = 0;
 
 	/* Activate SS */
 	ma35d1_qspi_write(ma35d1_qspi_read(nq, SSCTL) | SELECTSLAVE0, nq, SSCTL);
@@ -198,7 +316,14 @@ static int ma35d1_qspi_exec_op(struct spi_slave *slave,
 				ma35d1_qspi_write(ma35d1_qspi_read(nq, CTL) | SPI_QUAD_EN | SPI_DIR_2QM, nq, CTL);
 			}
 
-			for (i = 0; i < op->data.nbytes; i++) {
+			dma_len = ma35d1_qspi_dma_len(nq, tx, op->data.nbytes, false);
+			for (i = 0; i < dma_len && !ret; i += chunk) {
+				chunk = min_t(u32, dma_len - i, PDMA_MAX_COUNT);
+				ret = ma35d1_qspi_dma_xfer(nq, tx + i, NULL, chunk);
+			}
+			tx += dma_len;
+
+			for (i = dma_len; i < op->data.nbytes && !ret; i++) {
 				while ((ma35d1_qspi_read(nq, STATUS) & TXFULL)); //TXFULL
 				ma35d1_qspi_write(*tx++, nq, TX);
 			}
@@ -209,7 +334,14 @@ static int ma35d1_qspi_exec_op(struct spi_slave *slave,
 				ma35d1_qspi_write(ma35d1_qspi_read(nq, CTL) | SPI_QUAD_EN, nq, CTL);
 			}
 
-			for (i = 0; i < op->data.nbytes; i++) {
+			dma_len = ma35d1_qspi_dma_len(nq, rx, op->data.nbytes, true);
+			for (i = 0; i < dma_len && !ret; i += chunk) {
+				chunk = min_t(u32, dma_len - i, PDMA_MAX_COUNT);
+				ret = ma35d1_qspi_dma_xfer(nq, NULL, rx + i, chunk);
+			}
+			rx += dma_len;
+
+			for (i = dma_len; i < op->data.nbytes && !ret; i++) {
 				while ((ma35d1_qspi_read(nq, STATUS) & TXFULL)); //TXFULL
 				ma35d1_qspi_write(0, nq, TX);
 				while ((ma35d1_qspi_read(nq, STATUS) & RXEMPTY)); //RXEMPTY
@@ -226,9 +358,53 @@ static int ma35d1_qspi_exec_op(struct spi_slave *slave,
 	/* Deactiveate SS */
 	ma35d1_qspi_write(ma35d1_qspi_read(nq, SSCTL) & ~SELECTSLAVE0, nq, SSCTL);
 
+	return ret;
+}
+
+static int ma35d1_qspi_exec_op(struct spi_slave *slave,
+                                const struct spi_mem_op *op)
+{
+	struct ma35d1_qspi *nq = dev_get_priv(slave->dev->parent);
+
+	return ma35d1_qspi_xfer_op(nq, op);
+}
+
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+/*
+ * The QSPI has no memory-mapped window, so a mapping is the read template
+ * with its data phase moved by the PDMA. Without the PDMA there is nothing
+ * to gain over exec_op(), which spi-mem falls back to.
+ */
+static int ma35d1_qspi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	struct ma35d1_qspi *nq = dev_get_priv(desc->slave->dev->parent);
+
+	if (!nq->pdma || desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -ENOTSUPP;
+	if (!ma35d1_qspi_supports_op(desc->slave, &desc->info.op_tmpl))
+		return -ENOTSUPP;
+
 	return 0;
 }
 
+static ssize_t ma35d1_qspi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				       u64 offs, size_t len, void *buf)
+{
+	struct ma35d1_qspi *nq = dev_get_priv(desc->slave->dev->parent);
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret;
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.buf.in = buf;
+	op.data.nbytes = min_t(size_t, len, UINT_MAX);
+	ret = ma35d1_qspi_xfer_op(nq, &op);
+	if (ret)
+		return ret;
+
+	return op.data.nbytes;
+}
+#endif
+
 static int ma35d1_qspi_set_speed(struct udevice *bus, uint hz)
 {
 	struct ma35d1_qspi *nq = dev_get_priv(bus);
@@ -281,6 +457,8 @@ static int ma35d1_qspi_probe(struct udevice *dev)
 	int ret;
 	ulong clk_rate;
 
+	nq->dev = dev;
+
 	/* Map the registers */
 	ret = dev_read_resource_byname(dev, "qspi_base", &res);
 	if (ret) {
@@ -314,6 +492,22 @@ static int ma35d1_qspi_probe(struct udevice *dev)
 
 	ma35d1_qspi_init(nq);
 
+	/* The PDMA is optional; the FIFO loop handles everything without it */
+	ret = dev_read_resource_byname(dev, "pdma", &res);
+	if (!ret && !dev_read_u32_index(dev, "nuvoton,pdma-reqsel", 0,
+					&nq->pdma_tx_req) &&
+	    !dev_read_u32_index(dev, "nuvoton,pdma-reqsel", 1,
+				&nq->pdma_rx_req)) {
+		nq->pdma = devm_ioremap(dev, res.start, resource_size(&res));
+		if (IS_ERR(nq->pdma))
+			return PTR_ERR(nq->pdma);
+
+		/* The TX channel reads this from DRAM on every read */
+		nq->dma_zero = 0;
+		flush_dcache_range((ulong)&nq->dma_zero,
+				   (ulong)&nq->dma_zero + ARCH_DMA_MINALIGN);
+	}
+
 	return 0;
 }
 
@@ -330,6 +524,10 @@ static int ma35d1_qspi_release_bus(struct udevice *bus)
 static const struct spi_controller_mem_ops ma35d1_qspi_mem_ops = {
 	.supports_op = ma35d1_qspi_supports_op,
 	.exec_op = ma35d1_qspi_exec_op,
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	.dirmap_create = ma35d1_qspi_dirmap_create,
+	.dirmap_read = ma35d1_qspi_dirmap_read,
+#endif
 };
 
 static const struct dm_spi_ops ma35d1_qspi_ops = {
@@ -354,4 +552,5 @@ U_BOOT_DRIVER(ma35d1_qspi) = {
 	.ops            = &ma35d1_qspi_ops,
 	.priv_auto_alloc_size = sizeof(struct ma35d1_qspi),
 	.probe          = ma35d1_qspi_probe,
+	.flags          = DM_FLAG_ALLOC_PRIV_DMA,
 };
@@ -15,18 +15,32 @@
 #include <log.h>
 #include <malloc.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <os.h>
 
 #include <linux/errno.h>
 #include <asm/spi.h>
 #include <asm/state.h>
+#include <asm/test.h>
 #include <dm/device-internal.h>
 
 #ifndef CONFIG_SPI_IDLE_VAL
 # define CONFIG_SPI_IDLE_VAL 0xFF
 #endif
 
+/* Size of the window a direct mapping serves in one read */
+#define SANDBOX_SPI_DIRMAP_WINDOW	0x2000
+
+/**
+ * struct sandbox_spi_priv - Private data for the sandbox SPI bus
+ *
+ * @dirmap_reads: Number of reads served through a direct mapping
+ */
+struct sandbox_spi_priv {
+	uint dirmap_reads;
+};
+
 const char *sandbox_spi_parse_spec(const char *arg, unsigned long *bus,
 				   unsigned long *cs)
 {
@@ -133,12 +147,74 @@ static int sandbox_spi_get_mmap(struct udevice *dev, ulong *map_basep,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+/* Only reads are mapped; writes are left to the spi-mem fallback */
+static int sandbox_spi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	if (desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -ENOTSUPP;
+
+	return 0;
+}
+
+/*
+ * Run the read template as a single transaction, limited to the size of
+ * the mapped window, much as a controller would when fetching through it
+ */
+static ssize_t sandbox_spi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				       u64 offs, size_t len, void *buf)
+{
+	const struct spi_mem_op *tmpl = &desc->info.op_tmpl;
+	struct udevice *slave = desc->slave->dev;
+	struct sandbox_spi_priv *priv = dev_get_priv(slave->parent);
+	u64 addr = desc->info.offset + offs;
+	u8 op_buf[1 + 8 + 8];
+	uint pos = 0;
+	int i, ret;
+
+	if (tmpl->dummy.nbytes > 8)
+		return -EINVAL;
+
+	len = min_t(size_t, len, SANDBOX_SPI_DIRMAP_WINDOW);
+	op_buf[pos++] = tmpl->cmd.opcode;
+	for (i = tmpl->addr.nbytes - 1; i >= 0; i--)
+		op_buf[pos++] = addr >> (8 * i);
+	memset(op_buf + pos, 0xff, tmpl->dummy.nbytes);
+	pos += tmpl->dummy.nbytes;
+
+	ret = sandbox_spi_xfer(slave, pos * 8, op_buf, NULL, SPI_XFER_BEGIN);
+	if (ret)
+		return ret;
+	ret = sandbox_spi_xfer(slave, len * 8, NULL, buf, SPI_XFER_END);
+	if (ret)
+		return ret;
+	priv->dirmap_reads++;
+
+	return len;
+}
+
+static const struct spi_controller_mem_ops sandbox_spi_mem_ops = {
+	.dirmap_create	= sandbox_spi_dirmap_create,
+	.dirmap_read	= sandbox_spi_dirmap_read,
+};
+#endif
+
+uint sandbox_spi_get_dirmap_reads(struct udevice *bus)
+{
+	struct sandbox_spi_priv *priv = dev_get_priv(bus);
+
+	return priv->dirmap_reads;
+}
+
 static const struct dm_spi_ops sandbox_spi_ops = {
 	.xfer		= sandbox_spi_xfer,
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
 	.get_mmap	= sandbox_spi_get_mmap,
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	.mem_ops	= &sandbox_spi_mem_ops,
+#endif
 };
 
 static const struct udevice_id sandbox_spi_ids[] = {
@@ -151,4 +227,5 @@ U_BOOT_DRIVER(spi_sandbox) = {
 	.id	= UCLASS_SPI,
 	.of_match = sandbox_spi_ids,
 	.ops	= &sandbox_spi_ops,
+	.priv_auto_alloc_size = sizeof(struct sandbox_spi_priv),
 };
@@ -30,6 +30,7 @@
 #include <linux/stat.h>
 #include <linux/time.h>
 #include <asm/byteorder.h>
+#include <u-boot/crc.h>
 #include "ext4_common.h"
 
 struct ext2_data *ext4fs_root;
@@ -95,13 +96,19 @@ static inline void ext4fs_bg_free_blocks_dec
 		bg->free_blocks_high = cpu_to_le16(free_blocks >> 16);
 }
 
-static inline void ext4fs_bg_itable_unused_dec
-	(struct ext2_block_group *bg, const struct ext_filesystem *fs)
+/* Only the inodes of the group after @inode_no, now in use, are unused */
+static inline void ext4fs_bg_itable_unused_update
+	(struct ext2_block_group *bg, const struct ext_filesystem *fs,
+	 int inode_no)
 {
+	uint32_t inodes_per_grp = le32_to_cpu(fs->sb->inodes_per_group);
+	uint32_t after = inodes_per_grp - 1 - (inode_no - 1) % inodes_per_grp;
 	uint32_t free_inodes = le16_to_cpu(bg->bg_itable_unused);
 	if (fs->gdsize == 64)
 		free_inodes += le16_to_cpu(bg->bg_itable_unused_high) << 16;
-	free_inodes--;
+	if (free_inodes <= after)
+		return;
+	free_inodes = after;
 
 	bg->bg_itable_unused = cpu_to_le16(free_inodes & 0xffff);
 	if (fs->gdsize == 64)
@@ -416,6 +423,133 @@ void ext4fs_reset_inode_bmap(int inode_no, unsigned char *buffer, int index)
 		*ptr = *ptr & ~(operand);
 }
 
+static uint32_t ext4fs_crc32c_table[256];
+
+/* crc32c as ext4 uses it, with no final inversion */
+static uint32_t ext4fs_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	static int inited;
+
+	if (!inited) {
+		crc32c_init(ext4fs_crc32c_table, 0x82F63B78);
+		inited = 1;
+	}
+
+	return crc32c_cal(crc, buf, len, ext4fs_crc32c_table);
+}
+
+uint32_t ext4fs_csum_seed(const struct ext2_sblock *sb)
+{
+	if (le32_to_cpu(sb->feature_incompat) & EXT4_FEATURE_INCOMPAT_CSUM_SEED)
+		return le32_to_cpu(sb->checksum_seed);
+
+	return ext4fs_crc32c(~0, sb->unique_id, sizeof(sb->unique_id));
+}
+
+void ext4fs_sb_csum_set(struct ext2_sblock *sb)
+{
+	int len = offsetof(struct ext2_sblock, checksum);
+
+	if (!ext4fs_has_metadata_csum(sb))
+		return;
+
+	sb->checksum = cpu_to_le32(ext4fs_crc32c(~0, sb, len));
+}
+
+void ext4fs_bitmap_csum_set(uint32_t i)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *desc = ext4fs_get_group_descriptor(fs, i);
+	uint32_t crc;
+
+	if (!ext4fs_has_metadata_csum(fs->sb))
+		return;
+
+	crc = ext4fs_crc32c(fs->csum_seed, fs->blk_bmaps[i],
+			    le32_to_cpu(fs->sb->blocks_per_group) / 8);
+	desc->bg_block_id_csum = cpu_to_le16(crc & 0xffff);
+	if (fs->gdsize > offsetof(struct ext2_block_group,
+				  bg_block_id_csum_high))
+		desc->bg_block_id_csum_high = cpu_to_le16(crc >> 16);
+
+	crc = ext4fs_crc32c(fs->csum_seed, fs->inode_bmaps[i],
+			    le32_to_cpu(fs->sb->inodes_per_group) / 8);
+	desc->bg_inode_id_csum = cpu_to_le16(crc & 0xffff);
+	if (fs->gdsize > offsetof(struct ext2_block_group,
+				  bg_inode_id_csum_high))
+		desc->bg_inode_id_csum_high = cpu_to_le16(crc >> 16);
+}
+
+/* Seed of the checksums of an inode and its blocks */
+static uint32_t ext4fs_inode_csum_seed(int inodeno,
+				       const struct ext2_inode *inode)
+{
+	__le32 inum = cpu_to_le32(inodeno);
+	uint32_t crc;
+
+	crc = ext4fs_crc32c(get_fs()->csum_seed, &inum, sizeof(inum));
+	/* This is the generation of the inode */
+	return ext4fs_crc32c(crc, &inode->version, sizeof(inode->version));
+}
+
+void ext4fs_inode_csum_set(int inodeno, struct ext2_inode *inode)
+{
+	struct ext_filesystem *fs = get_fs();
+	/* i_extra_isize and i_checksum_hi follow in a large inode */
+	__le16 *extra = (__le16 *)(inode + 1);
+	int has_hi;
+	uint32_t crc;
+
+	if (!ext4fs_has_metadata_csum(fs->sb))
+		return;
+
+	has_hi = fs->inodesz > sizeof(*inode) &&
+		le16_to_cpu(extra[0]) >= 2 * sizeof(__le16);
+	inode->checksum_lo = 0;
+	if (has_hi)
+		extra[1] = 0;
+	crc = ext4fs_crc32c(ext4fs_inode_csum_seed(inodeno, inode), inode,
+			    fs->inodesz);
+	inode->checksum_lo = cpu_to_le16(crc & 0xffff);
+	if (has_hi)
+		extra[1] = cpu_to_le16(crc >> 16);
+}
+
+void ext4fs_extent_block_csum_set(int inodeno,
+				  const struct ext2_inode *inode,
+				  struct ext4_extent_header *eh)
+{
+	int len = sizeof(*eh) +
+		le16_to_cpu(eh->eh_max) * sizeof(struct ext4_extent);
+	struct ext4_extent_tail *et = (void *)eh + len;
+	uint32_t seed;
+
+	if (!ext4fs_has_metadata_csum(get_fs()->sb))
+		return;
+
+	seed = ext4fs_inode_csum_seed(inodeno, inode);
+	et->et_checksum = cpu_to_le32(ext4fs_crc32c(seed, eh, len));
+}
+
+void ext4fs_dir_block_csum_set(int inodeno, const struct ext2_inode *inode,
+			       char *block)
+{
+	struct ext_filesystem *fs = get_fs();
+	int len = fs->blksz - sizeof(struct ext4_dir_entry_tail);
+	struct ext4_dir_entry_tail *t = (void *)block + len;
+	uint32_t seed;
+
+	if (!ext4fs_has_metadata_csum(fs->sb))
+		return;
+	/* Leave a block with no room for the checksum as it is */
+	if (t->det_reserved_zero1 || le16_to_cpu(t->det_rec_len) != sizeof(*t) ||
+	    t->det_reserved_ft != EXT4_FT_DIR_CSUM)
+		return;
+
+	seed = ext4fs_inode_csum_seed(inodeno, inode);
+	t->det_checksum = cpu_to_le32(ext4fs_crc32c(seed, block, len));
+}
+
 uint16_t ext4fs_checksum_update(uint32_t i)
 {
 	struct ext2_block_group *desc;
@@ -424,7 +558,22 @@ uint16_t ext4fs_checksum_update(uint32_t i)
 	__le32 le32_i = cpu_to_le32(i);
 
 	desc = ext4fs_get_group_descriptor(fs, i);
-	if (le32_to_cpu(fs->sb->feature_ro_compat) & EXT4_FEATURE_RO_COMPAT_GDT_CSUM) {
+	if (ext4fs_has_metadata_csum(fs->sb)) {
+		int offset = offsetof(struct ext2_block_group, bg_checksum);
+		__le16 zero = 0;
+		uint32_t crc32;
+
+		crc32 = ext4fs_crc32c(fs->csum_seed, &le32_i, sizeof(le32_i));
+		crc32 = ext4fs_crc32c(crc32, desc, offset);
+		crc32 = ext4fs_crc32c(crc32, &zero, sizeof(zero));
+		offset += sizeof(desc->bg_checksum);
+		if (offset < fs->gdsize) {
+			crc32 = ext4fs_crc32c(crc32, (__u8 *)desc + offset,
+					      fs->gdsize - offset);
+		}
+		crc = crc32 & 0xffff;
+	} else if (le32_to_cpu(fs->sb->feature_ro_compat) &
+		   EXT4_FEATURE_RO_COMPAT_GDT_CSUM) {
 		int offset = offsetof(struct ext2_block_group, bg_checksum);
 
 		crc = ext2fs_crc16(~0, fs->sb->unique_id,
@@ -472,7 +621,8 @@ static int check_void_in_dentry(struct ext2_dirent *dir, char *filename)
 	return 0;
 }
 
-int ext4fs_update_parent_dentry(char *filename, int file_type)
+int ext4fs_update_parent_dentry(char *filename, int parent_inodeno,
+				int file_type)
 {
 	unsigned int *zero_buffer = NULL;
 	char *root_first_block_buffer = NULL;
@@ -492,6 +642,12 @@ int ext4fs_update_parent_dentry(char *filename, int file_type)
 	uint32_t new_size;
 	uint32_t new_blockcnt;
 	uint32_t directory_blocks;
+	/* With metadata_csum, the entries end before the checksum */
+	int dir_end = fs->blksz;
+	struct ext4_dir_entry_tail *tail;
+
+	if (ext4fs_has_metadata_csum(fs->sb))
+		dir_end -= sizeof(struct ext4_dir_entry_tail);
 
 	zero_buffer = zalloc(fs->blksz);
 	if (!zero_buffer) {
@@ -534,7 +690,7 @@ restart_read:
 		    sizeof(struct ext2_dirent), 4);
 
 		/* last entry of block */
-		if (fs->blksz - totalbytes == le16_to_cpu(dir->direntlen)) {
+		if (dir_end - totalbytes == le16_to_cpu(dir->direntlen)) {
 
 			/* check if new entry fits */
 			if ((used_len + new_entry_byte_reqd) <=
@@ -563,6 +719,16 @@ restart_read:
 					printf("no block left to assign\n");
 					goto fail;
 				}
+				if (dir_end != fs->blksz) {
+					tail = (void *)zero_buffer + dir_end;
+					tail->det_rec_len =
+						cpu_to_le16(sizeof(*tail));
+					tail->det_reserved_ft =
+						EXT4_FT_DIR_CSUM;
+					ext4fs_dir_block_csum_set
+						(parent_inodeno, g_parent_inode,
+						 (char *)zero_buffer);
+				}
 				put_ext4((uint64_t)new_blk_no * fs->blksz, zero_buffer, fs->blksz);
 				g_parent_inode->b.blocks.
 					dir_blocks[directory_blocks] =
@@ -576,6 +742,9 @@ restart_read:
 				new_blockcnt += fs->blksz >> LOG2_SECTOR_SIZE;
 				g_parent_inode->blockcnt = cpu_to_le32(new_blockcnt);
 
+				ext4fs_dir_block_csum_set(parent_inodeno,
+							  g_parent_inode,
+							  root_first_block_buffer);
 				if (ext4fs_put_metadata
 				    (root_first_block_buffer,
 				     first_block_no_of_root))
@@ -608,7 +777,7 @@ restart_read:
 	if (sizeof_void_space)
 		dir->direntlen = cpu_to_le16(sizeof_void_space);
 	else
-		dir->direntlen = cpu_to_le16(fs->blksz - totalbytes);
+		dir->direntlen = cpu_to_le16(dir_end - totalbytes);
 
 	dir->namelen = strlen(filename);
 	dir->filetype = file_type;
@@ -617,6 +786,8 @@ restart_read:
 	memcpy(temp_dir, filename, strlen(filename));
 
 	/* update or write  the 1st block of root inode */
+	ext4fs_dir_block_csum_set(parent_inodeno, g_parent_inode,
+				  root_first_block_buffer);
 	if (ext4fs_put_metadata(root_first_block_buffer,
 				first_block_no_of_root))
 		goto fail;
@@ -863,7 +1034,8 @@ fail:
 	return result_inode_no;
 }
 
-static int unlink_filename(char *filename, unsigned int blknr)
+static int unlink_filename(char *filename, int parent_inodeno,
+			   unsigned int blknr)
 {
 	int status;
 	int inodeno = 0;
@@ -925,6 +1097,8 @@ static int unlink_filename(char *filename, unsigned int blknr)
 			/* invalidate dir entry */
 			dir->inode = 0;
 		}
+		ext4fs_dir_block_csum_set(parent_inodeno, g_parent_inode,
+					  block_buffer);
 		if (ext4fs_put_metadata(block_buffer, blknr))
 			goto fail;
 		ret = inodeno;
@@ -935,7 +1109,7 @@ fail:
 	return ret;
 }
 
-int ext4fs_filename_unlink(char *filename)
+int ext4fs_filename_unlink(char *filename, int parent_inodeno)
 {
 	int blk_idx;
 	long int blknr = -1;
@@ -950,7 +1124,7 @@ int ext4fs_filename_unlink(char *filename)
 		blknr = read_allocated_block(g_parent_inode, blk_idx, NULL);
 		if (blknr <= 0)
 			break;
-		inodeno = unlink_filename(filename, blknr);
+		inodeno = unlink_filename(filename, parent_inodeno, blknr);
 		if (inodeno != -1)
 			return inodeno;
 	}
@@ -958,6 +1132,264 @@ int ext4fs_filename_unlink(char *filename)
 	return -1;
 }
 
+static inline void ext4fs_bg_set_free_blocks(struct ext2_block_group *bg,
+					     const struct ext_filesystem *fs,
+					     uint32_t free_blocks)
+{
+	bg->free_blocks = cpu_to_le16(free_blocks & 0xffff);
+	if (fs->gdsize == 64)
+		bg->free_blocks_high = cpu_to_le16(free_blocks >> 16);
+}
+
+/* First block of block group @group */
+static uint32_t ext4fs_group_first_block(unsigned int group)
+{
+	return le32_to_cpu(ext4fs_root->sblock.first_data_block) +
+		group * le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
+}
+
+/* Number of blocks in block group @group, the last one may be short */
+static uint32_t ext4fs_group_blocks(unsigned int group)
+{
+	uint32_t left = le32_to_cpu(ext4fs_root->sblock.total_blocks) -
+		ext4fs_group_first_block(group);
+
+	return min(left, le32_to_cpu(ext4fs_root->sblock.blocks_per_group));
+}
+
+static int ext4fs_test_root(unsigned int a, unsigned int b)
+{
+	while (a > b && !(a % b))
+		a /= b;
+
+	return a == b;
+}
+
+/* Whether block group @group holds a copy of the superblock */
+static int ext4fs_bg_has_super(unsigned int group)
+{
+	if (group <= 1 || !(le32_to_cpu(ext4fs_root->sblock.feature_ro_compat) &
+			    EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER))
+		return 1;
+	if (!(group & 1))
+		return 0;
+
+	return ext4fs_test_root(group, 3) || ext4fs_test_root(group, 5) ||
+		ext4fs_test_root(group, 7);
+}
+
+static void ext4fs_bmap_set(unsigned char *bmap, uint32_t bit, uint32_t count)
+{
+	for (; count && (bit & 7); bit++, count--)
+		bmap[bit >> 3] |= 1 << (bit & 7);
+	memset(bmap + (bit >> 3), 0xff, count >> 3);
+	for (bit += count & ~7, count &= 7; count; bit++, count--)
+		bmap[bit >> 3] |= 1 << (bit & 7);
+}
+
+static void ext4fs_bmap_clear(unsigned char *bmap, uint32_t bit,
+			      uint32_t count)
+{
+	for (; count && (bit & 7); bit++, count--)
+		bmap[bit >> 3] &= ~(1 << (bit & 7));
+	memset(bmap + (bit >> 3), 0, count >> 3);
+	for (bit += count & ~7, count &= 7; count; bit++, count--)
+		bmap[bit >> 3] &= ~(1 << (bit & 7));
+}
+
+/* Find the first bit from @bit on which is @set, or @size if none is */
+static uint32_t ext4fs_bmap_find(const unsigned char *bmap, uint32_t size,
+				 uint32_t bit, int set)
+{
+	unsigned char skip = set ? 0 : 0xff;
+
+	while (bit < size) {
+		if (!(bit & 7) && bmap[bit >> 3] == skip) {
+			bit += 8;
+			continue;
+		}
+		if (!(bmap[bit >> 3] & (1 << (bit & 7))) == !set)
+			return bit;
+		bit++;
+	}
+
+	return size;
+}
+
+/* Mark the blocks of [@start, @start + @count) which are in @group in use */
+static void ext4fs_mark_group_blocks(unsigned int group, uint64_t start,
+				     uint32_t count)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint64_t first = ext4fs_group_first_block(group);
+	uint64_t end = first + ext4fs_group_blocks(group);
+
+	if (start + count <= first || start >= end)
+		return;
+	if (start < first) {
+		count -= first - start;
+		start = first;
+	}
+	if (start + count > end)
+		count = end - start;
+	ext4fs_bmap_set(fs->blk_bmaps[group], start - first, count);
+}
+
+/*
+ * Set up the bitmap of block group @group, which was never written as the
+ * group has EXT4_BG_BLOCK_UNINIT. Its blocks are all free but for the
+ * backup superblock and descriptors, and the bitmaps and inode tables that
+ * are in it: with flex_bg, those of other groups may be.
+ */
+static int ext4fs_init_block_bitmap(unsigned int group)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_sblock *sblock = &ext4fs_root->sblock;
+	uint32_t itable_blocks;
+	unsigned int i;
+
+	if (le32_to_cpu(sblock->feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_META_BG)
+		return -EOPNOTSUPP;
+
+	itable_blocks = ext4fs_div_roundup(le32_to_cpu(sblock->inodes_per_group)
+					   * fs->inodesz, fs->blksz);
+	memset(fs->blk_bmaps[group], 0, fs->blksz);
+	if (ext4fs_bg_has_super(group))
+		ext4fs_bmap_set(fs->blk_bmaps[group], 0, 1 + fs->no_blk_pergdt +
+				le16_to_cpu(sblock->reserved_gdt_blocks));
+	for (i = 0; i < fs->no_blkgrp; i++) {
+		struct ext2_block_group *bgd =
+			ext4fs_get_group_descriptor(fs, i);
+
+		ext4fs_mark_group_blocks(group,
+					 ext4fs_bg_get_block_id(bgd, fs), 1);
+		ext4fs_mark_group_blocks(group,
+					 ext4fs_bg_get_inode_id(bgd, fs), 1);
+		ext4fs_mark_group_blocks(group,
+					 ext4fs_bg_get_inode_table_id(bgd, fs),
+					 itable_blocks);
+	}
+	/* Bits past the end of the last group are set */
+	i = ext4fs_group_blocks(group);
+	ext4fs_bmap_set(fs->blk_bmaps[group], i, fs->blksz * 8 - i);
+
+	return 0;
+}
+
+/* Save the bitmap of @group in the journal before it is changed */
+static int ext4fs_log_block_bitmap(unsigned int group)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext2_block_group *bgd = ext4fs_get_group_descriptor(fs, group);
+	uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
+	char *journal_buffer;
+	int ret = -EIO;
+
+	journal_buffer = zalloc(fs->blksz);
+	if (!journal_buffer)
+		return -ENOMEM;
+	if (ext4fs_devread(b_bitmap_blk * fs->sect_perblk, 0, fs->blksz,
+			   journal_buffer))
+		ret = ext4fs_log_journal(journal_buffer, b_bitmap_blk);
+	free(journal_buffer);
+
+	return ret;
+}
+
+uint32_t ext4fs_alloc_blocks(uint32_t goal, uint32_t *count)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t first_data_block =
+		le32_to_cpu(ext4fs_root->sblock.first_data_block);
+	uint32_t blk_per_grp =
+		le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
+	unsigned int group, i;
+	uint32_t bit, end, size;
+
+	if (goal < first_data_block ||
+	    goal >= le32_to_cpu(ext4fs_root->sblock.total_blocks))
+		goal = first_data_block;
+	group = (goal - first_data_block) / blk_per_grp;
+	bit = (goal - first_data_block) % blk_per_grp;
+
+	/* Go round all the groups, back to the start of the goal one */
+	for (i = 0; i <= fs->no_blkgrp; i++) {
+		struct ext2_block_group *bgd =
+			ext4fs_get_group_descriptor(fs, group);
+		uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
+		uint32_t free_blocks = ext4fs_bg_get_free_blocks(bgd, fs);
+
+		if (!free_blocks)
+			goto next;
+		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
+			if (ext4fs_init_block_bitmap(group))
+				goto next;
+			ext4fs_bg_set_flags(bgd,
+					    bg_flags & ~EXT4_BG_BLOCK_UNINIT);
+		}
+
+		size = ext4fs_group_blocks(group);
+		bit = ext4fs_bmap_find(fs->blk_bmaps[group], size, bit, 0);
+		if (bit < size) {
+			end = ext4fs_bmap_find(fs->blk_bmaps[group],
+					       min(size, bit + *count), bit, 1);
+			if (ext4fs_log_block_bitmap(group))
+				break;
+			ext4fs_bmap_set(fs->blk_bmaps[group], bit, end - bit);
+			ext4fs_bg_set_free_blocks(bgd, fs,
+						  free_blocks - (end - bit));
+			ext4fs_sb_set_free_blocks(fs->sb,
+				ext4fs_sb_get_free_blocks(fs->sb) - (end - bit));
+			*count = end - bit;
+
+			return ext4fs_group_first_block(group) + bit;
+		}
+next:
+		group = (group + 1) % fs->no_blkgrp;
+		bit = 0;
+	}
+
+	*count = 0;
+
+	return 0;
+}
+
+int ext4fs_free_blocks(uint32_t start, uint32_t count)
+{
+	struct ext_filesystem *fs = get_fs();
+	uint32_t first_data_block =
+		le32_to_cpu(ext4fs_root->sblock.first_data_block);
+	uint32_t blk_per_grp =
+		le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
+
+	if (start < first_data_block ||
+	    start + count > le32_to_cpu(ext4fs_root->sblock.total_blocks))
+		return -EINVAL;
+
+	while (count) {
+		unsigned int group = (start - first_data_block) / blk_per_grp;
+		uint32_t bit = (start - first_data_block) % blk_per_grp;
+		uint32_t n = min(count, blk_per_grp - bit);
+		struct ext2_block_group *bgd =
+			ext4fs_get_group_descriptor(fs, group);
+
+		if (ext4fs_log_block_bitmap(group))
+			return -EIO;
+		ext4fs_bmap_clear(fs->blk_bmaps[group], bit, n);
+		ext4fs_bg_set_free_blocks(bgd, fs,
+					  ext4fs_bg_get_free_blocks(bgd, fs) +
+					  n);
+		ext4fs_sb_set_free_blocks(fs->sb,
+					  ext4fs_sb_get_free_blocks(fs->sb) +
+					  n);
+		start += n;
+		count -= n;
+	}
+
+	return 0;
+}
+
 uint32_t ext4fs_get_new_blk_no(void)
 {
 	short i;
@@ -968,8 +1400,7 @@ uint32_t ext4fs_get_new_blk_no(void)
 	unsigned int blk_per_grp = le32_to_cpu(ext4fs_root->sblock.blocks_per_group);
 	struct ext_filesystem *fs = get_fs();
 	char *journal_buffer = zalloc(fs->blksz);
-	char *zero_buffer = zalloc(fs->blksz);
-	if (!journal_buffer || !zero_buffer)
+	if (!journal_buffer)
 		goto fail;
 
 	if (fs->first_pass_bbmap == 0) {
@@ -981,10 +1412,8 @@ uint32_t ext4fs_get_new_blk_no(void)
 				uint64_t b_bitmap_blk =
 					ext4fs_bg_get_block_id(bgd, fs);
 				if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-					memcpy(fs->blk_bmaps[i], zero_buffer,
-					       fs->blksz);
-					put_ext4(b_bitmap_blk * fs->blksz,
-						 fs->blk_bmaps[i], fs->blksz);
+					if (ext4fs_init_block_bitmap(i))
+						continue;
 					bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
 					ext4fs_bg_set_flags(bgd, bg_flags);
 				}
@@ -1045,9 +1474,12 @@ restart:
 		uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		if (bg_flags & EXT4_BG_BLOCK_UNINIT) {
-			memcpy(fs->blk_bmaps[bg_idx], zero_buffer, fs->blksz);
-			put_ext4(b_bitmap_blk * fs->blksz,
-				 zero_buffer, fs->blksz);
+			if (ext4fs_init_block_bitmap(bg_idx)) {
+				fs->curr_blkno = (bg_idx + 1) * blk_per_grp;
+				if (fs->blksz == 1024)
+					fs->curr_blkno += 1;
+				goto restart;
+			}
 			bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
 			ext4fs_bg_set_flags(bgd, bg_flags);
 		}
@@ -1077,12 +1509,10 @@ restart:
 	}
 success:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return fs->curr_blkno;
 fail:
 	free(journal_buffer);
-	free(zero_buffer);
 
 	return -1;
 }
@@ -1100,7 +1530,8 @@ int ext4fs_get_new_inode_no(void)
 	if (!journal_buffer || !zero_buffer)
 		goto fail;
 	int has_gdt_chksum = le32_to_cpu(fs->sb->feature_ro_compat) &
-		EXT4_FEATURE_RO_COMPAT_GDT_CSUM ? 1 : 0;
+		(EXT4_FEATURE_RO_COMPAT_GDT_CSUM |
+		 EXT4_FEATURE_RO_COMPAT_METADATA_CSUM) ? 1 : 0;
 
 	if (fs->first_pass_ibmap == 0) {
 		for (i = 0; i < fs->no_blkgrp; i++) {
@@ -1112,8 +1543,6 @@ int ext4fs_get_new_inode_no(void)
 				uint16_t bg_flags = ext4fs_bg_get_flags(bgd);
 				uint64_t i_bitmap_blk =
 					ext4fs_bg_get_inode_id(bgd, fs);
-				if (has_gdt_chksum)
-					bgd->bg_itable_unused = free_inodes;
 				if (bg_flags & EXT4_BG_INODE_UNINIT) {
 					put_ext4(i_bitmap_blk * fs->blksz,
 						 zero_buffer, fs->blksz);
@@ -1132,7 +1561,8 @@ int ext4fs_get_new_inode_no(void)
 				fs->first_pass_ibmap++;
 				ext4fs_bg_free_inodes_dec(bgd, fs);
 				if (has_gdt_chksum)
-					ext4fs_bg_itable_unused_dec(bgd, fs);
+					ext4fs_bg_itable_unused_update(bgd, fs,
+							fs->curr_inode_no);
 				ext4fs_sb_free_inodes_dec(fs->sb);
 				status = ext4fs_devread(i_bitmap_blk *
 							fs->sect_perblk,
@@ -1188,7 +1618,8 @@ restart:
 		}
 		ext4fs_bg_free_inodes_dec(bgd, fs);
 		if (has_gdt_chksum)
-			bgd->bg_itable_unused = bgd->free_inodes;
+			ext4fs_bg_itable_unused_update(bgd, fs,
+						       fs->curr_inode_no);
 		ext4fs_sb_free_inodes_dec(fs->sb);
 		goto success;
 	}
@@ -1995,6 +2426,123 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 	return blknr;
 }
 
+static int ext4fs_map_extent(struct ext2_inode *inode, lbaint_t fileblock,
+			     struct ext2_block_map *map,
+			     struct ext_block_cache *cache)
+{
+	struct ext_block_cache *c, cd;
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	int log2_blksz;
+	int i;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root) -
+		get_fs()->dev_desc->log2blksz;
+	if (cache) {
+		c = cache;
+	} else {
+		c = &cd;
+		ext_cache_init(c);
+	}
+	ext_block = ext4fs_get_extent_block(ext4fs_root, c,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		if (!cache)
+			ext_cache_fini(c);
+		return -EINVAL;
+	}
+
+	/* A hole, up to the next extent if it is in this leaf */
+	map->fileblock = fileblock;
+	map->count = 1;
+	map->blknr = 0;
+
+	extent = (struct ext4_extent *)(ext_block + 1);
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		lbaint_t start = le32_to_cpu(extent[i].ee_block);
+		lbaint_t len = le16_to_cpu(extent[i].ee_len);
+		bool unwritten = len > EXT_INIT_MAX_LEN;
+
+		if (unwritten)
+			len -= EXT_INIT_MAX_LEN;
+		if (start > fileblock) {
+			map->count = start - fileblock;
+			break;
+		}
+		if (fileblock < start + len) {
+			map->fileblock = start;
+			map->count = len;
+			if (!unwritten) {
+				map->blknr = le16_to_cpu(extent[i].ee_start_hi);
+				map->blknr = ((u64)map->blknr << 32) +
+					le32_to_cpu(extent[i].ee_start_lo);
+			}
+			break;
+		}
+	}
+
+	if (!cache)
+		ext_cache_fini(c);
+	return 0;
+}
+
+/**
+ * ext4fs_map_blocks() - map a run of blocks of a file to the disk
+ *
+ * Map the whole extent holding a block of a file, or for a file without
+ * extents, as many of the blocks wanted as are contiguous on the disk. The
+ * run is kept in the node, so that the blocks after the first one are
+ * mapped without walking the extent tree or the indirect blocks again.
+ *
+ * @node:	file to map
+ * @fileblock:	block in the file
+ * @count:	number of blocks wanted, returns the number of blocks mapped
+ *		from @fileblock on, which may be more than were wanted
+ * @cache:	cache for the blocks of the extent tree, or NULL
+ * Return:	block on the disk, 0 for a hole, negative on error
+ */
+long int ext4fs_map_blocks(struct ext2fs_node *node, lbaint_t fileblock,
+			   lbaint_t *count, struct ext_block_cache *cache)
+{
+	struct ext2_block_map *map = &node->map;
+	struct ext2_inode *inode = &node->inode;
+	long int blknr, next;
+	lbaint_t i;
+
+	if (fileblock < map->fileblock ||
+	    fileblock >= map->fileblock + map->count) {
+		if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
+			if (ext4fs_map_extent(inode, fileblock, map, cache))
+				return -EINVAL;
+		} else {
+			blknr = read_allocated_block(inode, fileblock, cache);
+			if (blknr < 0)
+				return blknr;
+			for (i = 1; i < *count; i++) {
+				next = read_allocated_block(inode,
+							    fileblock + i,
+							    cache);
+				if (next < 0)
+					return next;
+				if (blknr ? next != blknr + i : next)
+					break;
+			}
+			map->fileblock = fileblock;
+			map->count = i;
+			map->blknr = blknr;
+		}
+	}
+
+	*count = map->fileblock + map->count - fileblock;
+	if (!map->blknr)
+		return 0;
+
+	return map->blknr + fileblock - map->fileblock;
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -2042,141 +2590,222 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
-int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
-				struct ext2fs_node **fnode, int *ftype)
+/*
+ * Make a node for the file of @dirent in @diro, and find out its type from
+ * the entry or, if it does not tell, from the inode
+ */
+static struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *diro,
+					      struct ext2_dirent *dirent,
+					      int *type)
 {
-	unsigned int fpos = 0;
+	struct ext2fs_node *fdiro;
 	int status;
-	loff_t actread;
-	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
 
-#ifdef DEBUG
-	if (name != NULL)
-		printf("Iterate dir %s\n", name);
-#endif /* of DEBUG */
-	if (!diro->inode_read) {
-		status = ext4fs_read_inode(diro->data, diro->ino, &diro->inode);
-		if (status == 0)
-			return 0;
-	}
-	/* Search the file.  */
-	while (fpos < le32_to_cpu(diro->inode.size)) {
-		struct ext2_dirent dirent;
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
 
-		status = ext4fs_read_file(diro, fpos,
-					   sizeof(struct ext2_dirent),
-					   (char *)&dirent, &actread);
-		if (status < 0)
-			return 0;
+	fdiro->data = diro->data;
+	fdiro->ino = le32_to_cpu(dirent->inode);
+	*type = FILETYPE_UNKNOWN;
 
-		if (dirent.direntlen == 0) {
-			printf("Failed to iterate over directory %s\n", name);
-			return 0;
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY)
+			*type = FILETYPE_DIRECTORY;
+		else if (dirent->filetype == FILETYPE_SYMLINK)
+			*type = FILETYPE_SYMLINK;
+		else if (dirent->filetype == FILETYPE_REG)
+			*type = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(diro->data,
+					   le32_to_cpu(dirent->inode),
+					   &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return NULL;
 		}
+		fdiro->inode_read = 1;
+
+		if ((le16_to_cpu(fdiro->inode.mode) &
+		     FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY) {
+			*type = FILETYPE_DIRECTORY;
+		} else if ((le16_to_cpu(fdiro->inode.mode)
+			    & FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK) {
+			*type = FILETYPE_SYMLINK;
+		} else if ((le16_to_cpu(fdiro->inode.mode)
+			    & FILETYPE_INO_MASK) == FILETYPE_INO_REG) {
+			*type = FILETYPE_REG;
+		}
+	}
 
-		if (dirent.namelen != 0) {
-			char filename[dirent.namelen + 1];
-			struct ext2fs_node *fdiro;
-			int type = FILETYPE_UNKNOWN;
-
-			status = ext4fs_read_file(diro,
-						  fpos +
-						  sizeof(struct ext2_dirent),
-						  dirent.namelen, filename,
-						  &actread);
-			if (status < 0)
-				return 0;
+	return fdiro;
+}
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
-			if (!fdiro)
-				return 0;
+/*
+ * Look for @name in the entries of @diro from byte @fpos, which is block
+ * aligned, to byte @fend, or list them all if @name is NULL. The directory
+ * is read a block at a time into @buf.
+ *
+ * Returns 1 if found, 0 if not, -ve on error
+ */
+static int ext4fs_scan_dir(struct ext2fs_node *diro, loff_t fpos, loff_t fend,
+			   char *name, struct ext2fs_node **fnode, int *ftype,
+			   char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	int namelen = name ? strlen(name) : 0;
+	loff_t actread;
+	int status;
 
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
+	for (; fpos < fend; fpos += blksz) {
+		unsigned int off = 0;
 
-			filename[dirent.namelen] = '\0';
+		status = ext4fs_read_file(diro, fpos,
+					  min_t(loff_t, blksz, fend - fpos),
+					  buf, &actread);
+		if (status < 0)
+			return -EIO;
 
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
+		while (off < actread) {
+			struct ext2_dirent *dirent = (void *)(buf + off);
+			unsigned int direntlen;
+			struct ext2fs_node *fdiro;
+			int type;
+
+			if (off + sizeof(struct ext2_dirent) > actread)
+				direntlen = 0;
+			else
+				direntlen = le16_to_cpu(dirent->direntlen);
+			if (direntlen < sizeof(struct ext2_dirent) ||
+			    off + direntlen > actread ||
+			    sizeof(struct ext2_dirent) + dirent->namelen >
+			    direntlen) {
+				printf("Failed to iterate over directory %s\n",
+				       name);
+				return -EINVAL;
+			}
+			off += direntlen;
 
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
+			if (dirent->namelen == 0)
+				continue;
+#ifdef DEBUG
+			printf("iterate >%.*s<\n", dirent->namelen,
+			       (char *)(dirent + 1));
+#endif /* of DEBUG */
+			if (name) {
+				if (dirent->namelen != namelen ||
+				    memcmp(dirent + 1, name, namelen))
+					continue;
+				fdiro = ext4fs_dirent_node(diro, dirent, &type);
+				if (!fdiro)
+					return -ENOMEM;
+				*ftype = type;
+				*fnode = fdiro;
+				return 1;
+			}
+
+			fdiro = ext4fs_dirent_node(diro, dirent, &type);
+			if (!fdiro)
+				return -ENOMEM;
+			if (fdiro->inode_read == 0) {
 				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
+							   le32_to_cpu(
+							   dirent->inode),
 							   &fdiro->inode);
 				if (status == 0) {
 					free(fdiro);
-					return 0;
+					return -EIO;
 				}
 				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
 			}
-#ifdef DEBUG
-			printf("iterate >%s<\n", filename);
-#endif /* of DEBUG */
-			if ((name != NULL) && (fnode != NULL)
-			    && (ftype != NULL)) {
-				if (strcmp(filename, name) == 0) {
-					*ftype = type;
-					*fnode = fdiro;
-					return 1;
-				}
-			} else {
-				if (fdiro->inode_read == 0) {
-					status = ext4fs_read_inode(diro->data,
-								 le32_to_cpu(
-								 dirent.inode),
-								 &fdiro->inode);
-					if (status == 0) {
-						free(fdiro);
-						return 0;
-					}
-					fdiro->inode_read = 1;
-				}
-				switch (type) {
-				case FILETYPE_DIRECTORY:
-					printf("<DIR> ");
-					break;
-				case FILETYPE_SYMLINK:
-					printf("<SYM> ");
-					break;
-				case FILETYPE_REG:
-					printf("      ");
-					break;
-				default:
-					printf("< ? > ");
-					break;
-				}
-				printf("%10u %s\n",
-				       le32_to_cpu(fdiro->inode.size),
-					filename);
+			switch (type) {
+			case FILETYPE_DIRECTORY:
+				printf("<DIR> ");
+				break;
+			case FILETYPE_SYMLINK:
+				printf("<SYM> ");
+				break;
+			case FILETYPE_REG:
+				printf("      ");
+				break;
+			default:
+				printf("< ? > ");
+				break;
 			}
+			printf("%10u %.*s\n", le32_to_cpu(fdiro->inode.size),
+			       dirent->namelen, (char *)(dirent + 1));
 			free(fdiro);
 		}
-		fpos += le16_to_cpu(dirent.direntlen);
 	}
+
 	return 0;
 }
 
+struct ext4fs_dx_scan_priv {
+	char *name;
+	struct ext2fs_node **fnode;
+	int *ftype;
+	char *buf;
+};
+
+static int ext4fs_dx_scan_leaf(struct ext2fs_node *diro, lbaint_t block,
+			       void *priv)
+{
+	struct ext4fs_dx_scan_priv *scan = priv;
+	loff_t fpos = (loff_t)block * EXT2_BLOCK_SIZE(diro->data);
+
+	return ext4fs_scan_dir(diro, fpos, fpos + EXT2_BLOCK_SIZE(diro->data),
+			       scan->name, scan->fnode, scan->ftype, scan->buf);
+}
+
+int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
+				struct ext2fs_node **fnode, int *ftype)
+{
+	int status;
+	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
+	char *buf;
+
+#ifdef DEBUG
+	if (name != NULL)
+		printf("Iterate dir %s\n", name);
+#endif /* of DEBUG */
+	if (!diro->inode_read) {
+		status = ext4fs_read_inode(diro->data, diro->ino, &diro->inode);
+		if (status == 0)
+			return 0;
+	}
+	if ((name == NULL) || (fnode == NULL) || (ftype == NULL))
+		name = NULL;
+
+	buf = malloc(EXT2_BLOCK_SIZE(diro->data));
+	if (!buf)
+		return 0;
+
+	/* Only look in the leaves holding the hash of the name if indexed */
+	status = -EOPNOTSUPP;
+	if (name) {
+		struct ext4fs_dx_scan_priv scan = {
+			.name = name,
+			.fnode = fnode,
+			.ftype = ftype,
+			.buf = buf,
+		};
+
+		status = ext4fs_dx_lookup(diro, name, ext4fs_dx_scan_leaf,
+					  &scan);
+	}
+	/* Search the file.  */
+	if (status == -EOPNOTSUPP || status == -EINVAL)
+		status = ext4fs_scan_dir(diro, 0,
+					 le32_to_cpu(diro->inode.size), name,
+					 fnode, ftype, buf);
+	free(buf);
+
+	return status == 1;
+}
+
 static char *ext4fs_read_symlink(struct ext2fs_node *node)
 {
 	char *symlink;
@@ -2368,7 +2997,7 @@ int ext4fs_mount(unsigned part_length)
 	struct ext2_data *data;
 	int status;
 	struct ext_filesystem *fs = get_fs();
-	data = zalloc(SUPERBLOCK_SIZE);
+	data = zalloc(sizeof(*data));
 	if (!data)
 		return 0;
 
@@ -52,17 +52,89 @@ int ext4fs_read_inode(struct ext2_data *data, int ino,
 		      struct ext2_inode *inode);
 int ext4fs_read_file(struct ext2fs_node *node, loff_t pos, loff_t len,
 		     char *buf, loff_t *actread);
+long int ext4fs_map_blocks(struct ext2fs_node *node, lbaint_t fileblock,
+			   lbaint_t *count, struct ext_block_cache *cache);
 int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 			struct ext2fs_node **foundnode, int expecttype);
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
 
+/**
+ * ext4fs_dx_lookup() - Scan the leaves of a hash tree which may hold a name
+ *
+ * Walk the index of directory @dir down to the leaf block for the hash of
+ * @name and call @scan on it, then on the following leaves as long as their
+ * names may have the same hash.
+ *
+ * @dir:	Directory, with its inode read
+ * @name:	Name to look up
+ * @scan:	Called with each leaf block number in @dir, returns 1 if the
+ *		name was found, 0 if not or -ve on error
+ * @priv:	Passed to @scan
+ * @return return value of @scan if not 0, 0 if the name is not in @dir,
+ *	-EOPNOTSUPP if @dir has no index which can be used, -EINVAL if the
+ *	index is not sane, other -ve on error
+ */
+int ext4fs_dx_lookup(struct ext2fs_node *dir, const char *name,
+		     int (*scan)(struct ext2fs_node *dir, lbaint_t block,
+				 void *priv),
+		     void *priv);
+
 #if defined(CONFIG_EXT4_WRITE)
+static inline int ext4fs_has_metadata_csum(const struct ext2_sblock *sb)
+{
+	return le32_to_cpu(sb->feature_ro_compat) &
+		EXT4_FEATURE_RO_COMPAT_METADATA_CSUM;
+}
+
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 uint16_t ext4fs_checksum_update(unsigned int i);
+
+/*
+ * Metadata checksums, with metadata_csum. Each is a crc32c seeded with
+ * fs->csum_seed, from ext4fs_csum_seed(), and for an inode and its extent
+ * tree and directory blocks, with the number and generation of the inode.
+ * Without metadata_csum these do nothing.
+ */
+uint32_t ext4fs_csum_seed(const struct ext2_sblock *sb);
+void ext4fs_sb_csum_set(struct ext2_sblock *sb);
+/* Block and inode bitmaps of group @i, before ext4fs_checksum_update() */
+void ext4fs_bitmap_csum_set(uint32_t i);
+/* @inode is the whole on-disk inode, fs->inodesz bytes */
+void ext4fs_inode_csum_set(int inodeno, struct ext2_inode *inode);
+void ext4fs_extent_block_csum_set(int inodeno,
+				  const struct ext2_inode *inode,
+				  struct ext4_extent_header *eh);
+void ext4fs_dir_block_csum_set(int inodeno, const struct ext2_inode *inode,
+			       char *block);
+
 int ext4fs_get_parent_inode_num(const char *dirname, char *dname, int flags);
-int ext4fs_update_parent_dentry(char *filename, int file_type);
+int ext4fs_update_parent_dentry(char *filename, int parent_inodeno,
+				int file_type);
 uint32_t ext4fs_get_new_blk_no(void);
+
+/**
+ * ext4fs_alloc_blocks() - Allocate a run of contiguous blocks
+ *
+ * Look for the first free block from @goal on, going round to the start of
+ * the disk if needed, and take the run of free blocks from there, up to
+ * @count blocks long: mark them in the block bitmap and count them off the
+ * group and superblock. These are written by ext4fs_update().
+ *
+ * @goal:	Block to start looking from
+ * @count:	Most blocks wanted, returns the number allocated
+ * @return first block allocated, 0 if there is no free block left
+ */
+uint32_t ext4fs_alloc_blocks(uint32_t goal, uint32_t *count);
+
+/**
+ * ext4fs_free_blocks() - Release a run of blocks
+ *
+ * @start:	First block to release
+ * @count:	Number of blocks
+ * @return 0 if OK, -ve on error
+ */
+int ext4fs_free_blocks(uint32_t start, uint32_t count);
 int ext4fs_get_new_inode_no(void);
 void ext4fs_reset_block_bmap(long int blockno, unsigned char *buffer,
 					int index);
@@ -0,0 +1,483 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lookup in ext4 directories indexed by a hash tree (dir_index).
+ *
+ * The hash functions are taken from the Linux kernel, fs/ext4/hash.c:
+ * Copyright (C) 2002 by Theodore Ts'o
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <ext_common.h>
+#include <ext4fs.h>
+#include <log.h>
+#include <malloc.h>
+#include <asm/byteorder.h>
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY		0
+#define DX_HASH_HALF_MD4	1
+#define DX_HASH_TEA		2
+#define DX_HASH_LEGACY_UNSIGNED	3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED	5
+
+#define DX_HTREE_EOF		0x7fffffff
+#define DX_MAX_LEVELS		3
+
+/* The root of the tree is in block 0, behind the "." and ".." entries */
+struct dx_root_info {
+	__le32 reserved_zero;
+	__u8 hash_version;
+	__u8 info_length;	/* 8 */
+	__u8 indirect_levels;
+	__u8 unused_flags;
+};
+
+#define DX_ROOT_INFO_OFFSET	24
+
+/* Other index nodes start with an empty entry spanning the whole block */
+#define DX_NODE_OFFSET		8
+
+/* The first entry holds the limit and count instead of a hash */
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	struct dx_entry *at;
+};
+
+static inline u32 rol32(u32 word, unsigned int shift)
+{
+	return (word << shift) | (word >> (32 - shift));
+}
+
+#define DELTA 0x9E3779B9
+
+static void tea_transform(u32 buf[4], u32 const in[])
+{
+	u32 sum = 0;
+	u32 b0 = buf[0], b1 = buf[1];
+	u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = rol32(a, s))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+/* Basic cut-down MD4 transform, returns only 32 bits of result */
+static void half_md4_transform(u32 buf[4], u32 const in[8])
+{
+	u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+#undef MD4_ROUND
+#undef K1
+#undef K2
+#undef K3
+#undef F
+#undef G
+#undef H
+
+/* The old legacy hash */
+static u32 dx_hack_hash_unsigned(const char *name, int len)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	const unsigned char *ucp = (const unsigned char *)name;
+
+	while (len--) {
+		hash = hash1 + (hash0 ^ (((int)*ucp++) * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static u32 dx_hack_hash_signed(const char *name, int len)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	const signed char *scp = (const signed char *)name;
+
+	while (len--) {
+		hash = hash1 + (hash0 ^ (((int)*scp++) * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static void str2hashbuf_signed(const char *msg, int len, u32 *buf, int num)
+{
+	u32 pad, val;
+	int i;
+	const signed char *scp = (const signed char *)msg;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		val = ((int)scp[i]) + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+static void str2hashbuf_unsigned(const char *msg, int len, u32 *buf, int num)
+{
+	u32 pad, val;
+	int i;
+	const unsigned char *ucp = (const unsigned char *)msg;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		val = ((int)ucp[i]) + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/**
+ * ext4fs_dirhash() - Compute the hash of a file name
+ *
+ * @sblock:	Superblock, giving the hash seed
+ * @version:	Hash version, one of DX_HASH_...
+ * @name:	File name
+ * @len:	Length of @name
+ * @hash:	Returns the major hash, with the lowest bit clear
+ * @return 0 if OK, -EINVAL if @version is unknown
+ */
+static int ext4fs_dirhash(struct ext2_sblock *sblock, int version,
+			  const char *name, int len, u32 *hash)
+{
+	void (*str2hashbuf)(const char *, int, u32 *, int) =
+		str2hashbuf_signed;
+	u32 buf[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+	u32 in[8];
+	int i;
+
+	/* An all zero seed means the default one */
+	for (i = 0; i < 4; i++) {
+		if (sblock->hash_seed[i])
+			break;
+	}
+	if (i < 4) {
+		for (i = 0; i < 4; i++)
+			buf[i] = le32_to_cpu(sblock->hash_seed[i]);
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		*hash = dx_hack_hash_unsigned(name, len);
+		break;
+	case DX_HASH_LEGACY:
+		*hash = dx_hack_hash_signed(name, len);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		str2hashbuf = str2hashbuf_unsigned;
+		/* fall through */
+	case DX_HASH_HALF_MD4:
+		for (; len > 0; len -= 32, name += 32) {
+			str2hashbuf(name, len, in, 8);
+			half_md4_transform(buf, in);
+		}
+		*hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		str2hashbuf = str2hashbuf_unsigned;
+		/* fall through */
+	case DX_HASH_TEA:
+		for (; len > 0; len -= 16, name += 16) {
+			str2hashbuf(name, len, in, 4);
+			tea_transform(buf, in);
+		}
+		*hash = buf[0];
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	*hash &= ~1;
+	if (*hash == (DX_HTREE_EOF << 1))
+		*hash = (DX_HTREE_EOF - 1) << 1;
+
+	return 0;
+}
+
+static inline unsigned int dx_get_count(struct dx_entry *entries)
+{
+	return le16_to_cpu(((struct dx_countlimit *)entries)->count);
+}
+
+static inline unsigned int dx_get_limit(struct dx_entry *entries)
+{
+	return le16_to_cpu(((struct dx_countlimit *)entries)->limit);
+}
+
+static inline u32 dx_get_block(struct dx_entry *entry)
+{
+	return le32_to_cpu(entry->block) & 0x0fffffff;
+}
+
+/* Read block @block of @dir, returns 0 if OK, -EINVAL if it cannot be */
+static int dx_read_block(struct ext2fs_node *dir, u32 block, char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	loff_t actread;
+
+	if ((loff_t)block * blksz >= le32_to_cpu(dir->inode.size))
+		return -EINVAL;
+	if (ext4fs_read_file(dir, (loff_t)block * blksz, blksz, buf,
+			     &actread) < 0 || actread != blksz)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Point @frame at its entries, @offset bytes into the block, and check them */
+static int dx_set_entries(struct ext2fs_node *dir, struct dx_frame *frame,
+			  int offset)
+{
+	unsigned int count, limit;
+
+	frame->entries = (struct dx_entry *)(frame->buf + offset);
+	count = dx_get_count(frame->entries);
+	limit = dx_get_limit(frame->entries);
+	if (!count || count > limit ||
+	    offset + limit * sizeof(struct dx_entry) >
+	    EXT2_BLOCK_SIZE(dir->data))
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Read index node @block of @dir into @frame */
+static int dx_read_node(struct ext2fs_node *dir, u32 block,
+			struct dx_frame *frame)
+{
+	int ret;
+
+	ret = dx_read_block(dir, block, frame->buf);
+	if (ret)
+		return ret;
+
+	return dx_set_entries(dir, frame, DX_NODE_OFFSET);
+}
+
+/* Find the entry of @frame for the hash range holding @hash */
+static void dx_search(struct dx_frame *frame, u32 hash)
+{
+	struct dx_entry *p, *q, *m;
+
+	p = frame->entries + 1;
+	q = frame->entries + dx_get_count(frame->entries) - 1;
+	while (p <= q) {
+		m = p + (q - p) / 2;
+		if (le32_to_cpu(m->hash) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+	frame->at = p - 1;
+}
+
+/*
+ * Move @frames to the next leaf if it continues the run of names hashing
+ * to @hash, which happens when they did not all fit in one leaf
+ *
+ * Returns 1 if there is such a leaf, 0 if not, -EINVAL on error
+ */
+static int dx_next_leaf(struct ext2fs_node *dir, struct dx_frame *frames,
+			int levels, u32 hash)
+{
+	struct dx_frame *p = frames + levels;
+	int ret;
+
+	while (++p->at >= p->entries + dx_get_count(p->entries)) {
+		if (p == frames)
+			return 0;
+		p--;
+	}
+	if ((le32_to_cpu(p->at->hash) & ~1) != hash)
+		return 0;
+
+	while (p < frames + levels) {
+		ret = dx_read_node(dir, dx_get_block(p->at), p + 1);
+		if (ret)
+			return ret;
+		p++;
+		p->at = p->entries;
+	}
+
+	return 1;
+}
+
+int ext4fs_dx_lookup(struct ext2fs_node *dir, const char *name,
+		     int (*scan)(struct ext2fs_node *dir, lbaint_t block,
+				 void *priv),
+		     void *priv)
+{
+	struct ext2_sblock *sblock = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame frames[DX_MAX_LEVELS] = { };
+	struct dx_root_info *info;
+	int version, levels, max_levels;
+	int i, ret;
+	u32 hash;
+
+	if (!(le32_to_cpu(sblock->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL) ||
+	    le32_to_cpu(dir->inode.flags) & (EXT4_ENCRYPT_FL |
+					     EXT4_CASEFOLD_FL))
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < DX_MAX_LEVELS; i++) {
+		frames[i].buf = malloc(blksz);
+		if (!frames[i].buf) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	ret = dx_read_block(dir, 0, frames[0].buf);
+	if (ret)
+		goto out;
+	info = (struct dx_root_info *)(frames[0].buf + DX_ROOT_INFO_OFFSET);
+	version = info->hash_version;
+	if (version <= DX_HASH_TEA &&
+	    le32_to_cpu(sblock->flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		version += DX_HASH_LEGACY_UNSIGNED;
+	levels = info->indirect_levels;
+	max_levels = le32_to_cpu(sblock->feature_incompat) &
+		EXT4_FEATURE_INCOMPAT_LARGEDIR ? 3 : 2;
+	if (info->unused_flags & 1 || levels >= max_levels ||
+	    ext4fs_dirhash(sblock, version, name, strlen(name), &hash)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	ret = dx_set_entries(dir, &frames[0],
+			     DX_ROOT_INFO_OFFSET + info->info_length);
+	if (ret)
+		goto out;
+
+	/* Walk down to the leaf for the hash */
+	for (i = 0; ; i++) {
+		dx_search(&frames[i], hash);
+		if (i == levels)
+			break;
+		ret = dx_read_node(dir, dx_get_block(frames[i].at),
+				   &frames[i + 1]);
+		if (ret)
+			goto out;
+	}
+
+	do {
+		u32 block = dx_get_block(frames[levels].at);
+
+		if ((loff_t)block * blksz >= le32_to_cpu(dir->inode.size)) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = scan(dir, block, priv);
+		if (ret)
+			break;
+		ret = dx_next_leaf(dir, frames, levels, hash);
+	} while (ret > 0);
+
+out:
+	if (ret == -EINVAL)
+		debug("%s: bad hash tree index\n", __func__);
+	for (i = 0; i < DX_MAX_LEVELS; i++)
+		free(frames[i].buf);
+
+	return ret;
+}
@@ -660,7 +660,10 @@ void ext4fs_update_journal(void)
 		put_ext4((uint64_t) ((uint64_t)blknr * (uint64_t)fs->blksz),
 			 journal_ptr[i]->buf, fs->blksz);
 	}
+	/* The commit block goes after what it commits, and before the rest */
+	blkcache_barrier();
 	blknr = read_allocated_block(&inode_journal, jrnl_blk_idx++, NULL);
 	update_commit_block(blknr);
+	blkcache_barrier();
 	printf("update journal finished\n");
 }
@@ -75,12 +75,14 @@ static void ext4fs_update(void)
 	struct ext2_block_group *bgd = NULL;
 
 	/* update  super block */
+	ext4fs_sb_csum_set(fs->sb);
 	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 
 	/* update block bitmaps */
 	for (i = 0; i < fs->no_blkgrp; i++) {
 		bgd = ext4fs_get_group_descriptor(fs, i);
+		ext4fs_bitmap_csum_set(i);
 		bgd->bg_checksum = cpu_to_le16(ext4fs_checksum_update(i));
 		uint64_t b_bitmap_blk = ext4fs_bg_get_block_id(bgd, fs);
 		put_ext4(b_bitmap_blk * fs->blksz,
@@ -101,6 +103,8 @@ static void ext4fs_update(void)
 		 (fs->blksz * fs->no_blk_pergdt));
 
 	ext4fs_dump_metadata();
+	/* Only empty the journal once the metadata is in place */
+	blkcache_barrier();
 
 	gindex = 0;
 	gd_index = 0;
@@ -435,6 +439,58 @@ fail:
 	free(journal_buffer);
 }
 
+/*
+ * Release the blocks mapped by the extent node @eh, a run at a time, and
+ * the blocks of the tree below it
+ */
+static int delete_extent_node(struct ext4_extent_header *eh)
+{
+	struct ext_filesystem *fs = get_fs();
+	int entries = le16_to_cpu(eh->eh_entries);
+	int i;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC)
+		return -EINVAL;
+
+	if (!eh->eh_depth) {
+		struct ext4_extent *ext = (struct ext4_extent *)(eh + 1);
+
+		for (i = 0; i < entries; i++, ext++) {
+			uint32_t len = le16_to_cpu(ext->ee_len);
+
+			if (len > EXT_INIT_MAX_LEN)
+				len -= EXT_INIT_MAX_LEN;
+			if (ext4fs_free_blocks(le32_to_cpu(ext->ee_start_lo),
+					       len))
+				return -EIO;
+		}
+
+		return 0;
+	} else {
+		struct ext4_extent_idx *idx = (struct ext4_extent_idx *)(eh + 1);
+		char *block;
+		int ret = 0;
+
+		block = zalloc(fs->blksz);
+		if (!block)
+			return -ENOMEM;
+		for (i = 0; i < entries && !ret; i++, idx++) {
+			uint32_t blknr = le32_to_cpu(idx->ei_leaf_lo);
+
+			if (!ext4fs_devread((lbaint_t)blknr * fs->sect_perblk,
+					    0, fs->blksz, block))
+				ret = -EIO;
+			else
+				ret = delete_extent_node((void *)block);
+			if (!ret)
+				ret = ext4fs_free_blocks(blknr, 1);
+		}
+		free(block);
+
+		return ret;
+	}
+}
+
 static int ext4fs_delete_file(int inodeno)
 {
 	struct ext2_inode inode;
@@ -479,11 +535,13 @@ static int ext4fs_delete_file(int inodeno)
 	}
 
 	if (le32_to_cpu(inode.flags) & EXT4_EXTENTS_FL) {
-		/* FIXME delete extent index blocks, i.e. eh_depth >= 1 */
 		struct ext4_extent_header *eh =
 			(struct ext4_extent_header *)
 				inode.b.blocks.dir_blocks;
 		debug("del: dep=%d entries=%d\n", eh->eh_depth, eh->eh_entries);
+		if (no_blocks && delete_extent_node(eh))
+			goto fail;
+		no_blocks = 0;
 	} else {
 		delete_single_indirect_block(&inode);
 		delete_double_indirect_block(&inode);
@@ -612,6 +670,8 @@ int ext4fs_init(void)
 		return -ENOMEM;
 	if (!ext4_read_superblock((char *)fs->sb))
 		goto fail;
+	if (ext4fs_has_metadata_csum(fs->sb))
+		fs->csum_seed = ext4fs_csum_seed(fs->sb);
 
 	/* init journal */
 	if (ext4fs_init_journal())
@@ -724,6 +784,7 @@ void ext4fs_deinit(void)
 	new_feature_incompat = le32_to_cpu(fs->sb->feature_incompat);
 	new_feature_incompat &= ~EXT3_FEATURE_INCOMPAT_RECOVER;
 	fs->sb->feature_incompat = cpu_to_le32(new_feature_incompat);
+	ext4fs_sb_csum_set(fs->sb);
 	put_ext4((uint64_t)(SUPERBLOCK_SIZE),
 		 (struct ext2_sblock *)fs->sb, (uint32_t)SUPERBLOCK_SIZE);
 	free(fs->sb);
@@ -842,6 +903,196 @@ static int ext4fs_write_file(struct ext2_inode *file_inode,
 	return len;
 }
 
+/*
+ * Build the extent tree of inode @inodeno, @file_inode, over the @nr
+ * extents in @extents, in the inode if they fit, else in blocks allocated
+ * from @goal on, which are added to @tree_blocks
+ */
+static int ext4fs_build_extent_tree(int inodeno,
+				    struct ext2_inode *file_inode,
+				    struct ext4_extent *extents, int nr,
+				    uint32_t goal, unsigned int *tree_blocks)
+{
+	struct ext_filesystem *fs = get_fs();
+	struct ext4_extent_header *eh =
+		(struct ext4_extent_header *)file_inode->b.blocks.dir_blocks;
+	int per_inode = (sizeof(file_inode->b.blocks) - sizeof(*eh)) /
+		sizeof(struct ext4_extent);
+	int per_block = (fs->blksz - sizeof(*eh)) / sizeof(struct ext4_extent);
+	/* Index entries have the same size and start with the block too */
+	void *entries = extents;
+	struct ext4_extent_idx *index;
+	char *block;
+	int depth = 0;
+	int i, n;
+
+	block = zalloc(fs->blksz);
+	if (!block)
+		return -ENOMEM;
+
+	while (nr > per_inode) {
+		n = DIV_ROUND_UP(nr, per_block);
+		index = calloc(n, sizeof(*index));
+		if (!index)
+			goto fail;
+
+		for (i = 0; i < n; i++) {
+			struct ext4_extent_header *beh = (void *)block;
+			int count = min(per_block, nr - i * per_block);
+			void *first = entries + i * per_block *
+				sizeof(struct ext4_extent);
+			uint32_t one = 1;
+			uint32_t blknr = ext4fs_alloc_blocks(goal, &one);
+
+			if (!blknr) {
+				printf("no block left to assign\n");
+				free(index);
+				goto fail;
+			}
+			goal = blknr + 1;
+			(*tree_blocks)++;
+
+			memset(block, '\0', fs->blksz);
+			beh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+			beh->eh_entries = cpu_to_le16(count);
+			beh->eh_max = cpu_to_le16(per_block);
+			beh->eh_depth = cpu_to_le16(depth);
+			memcpy(beh + 1, first, count * sizeof(struct ext4_extent));
+			ext4fs_extent_block_csum_set(inodeno, file_inode, beh);
+			put_ext4((uint64_t)blknr * fs->blksz, block, fs->blksz);
+
+			index[i].ei_block = *(__le32 *)first;
+			index[i].ei_leaf_lo = cpu_to_le32(blknr);
+		}
+		if (entries != extents)
+			free(entries);
+		entries = index;
+		nr = n;
+		depth++;
+	}
+
+	memset(file_inode->b.blocks.dir_blocks, '\0',
+	       sizeof(file_inode->b.blocks));
+	eh->eh_magic = cpu_to_le16(EXT4_EXT_MAGIC);
+	eh->eh_entries = cpu_to_le16(nr);
+	eh->eh_max = cpu_to_le16(per_inode);
+	eh->eh_depth = cpu_to_le16(depth);
+	memcpy(eh + 1, entries, nr * sizeof(struct ext4_extent));
+	file_inode->flags |= cpu_to_le32(EXT4_EXTENTS_FL);
+
+	if (entries != extents)
+		free(entries);
+	free(block);
+
+	return 0;
+fail:
+	if (entries != extents)
+		free(entries);
+	free(block);
+
+	return -ENOSPC;
+}
+
+/*
+ * Allocate @count blocks for inode @inodeno, @file_inode, in runs, as long
+ * as the free space allows, from @goal on, and map them with an extent
+ * tree. The runs are returned in @extentsp, for the data to be written to
+ * them.
+ *
+ * Returns the number of extents, -ve on error
+ */
+static int ext4fs_allocate_extents(int inodeno, struct ext2_inode *file_inode,
+				   uint32_t goal, unsigned int count,
+				   struct ext4_extent **extentsp,
+				   unsigned int *total_no_of_block)
+{
+	struct ext4_extent *extents = NULL, *ext;
+	unsigned int tree_blocks = 0;
+	uint32_t fileblock = 0;
+	int nr = 0, max = 0;
+
+	while (count) {
+		uint32_t n = min(count, (unsigned int)EXT_INIT_MAX_LEN);
+		uint32_t blknr = ext4fs_alloc_blocks(goal, &n);
+
+		if (!blknr) {
+			printf("no block left to assign\n");
+			goto fail;
+		}
+		debug("EXT %u: %u blocks at %u\n", fileblock, n, blknr);
+
+		ext = nr ? &extents[nr - 1] : NULL;
+		if (ext && le32_to_cpu(ext->ee_start_lo) +
+		    le16_to_cpu(ext->ee_len) == blknr &&
+		    le16_to_cpu(ext->ee_len) + n <= EXT_INIT_MAX_LEN) {
+			ext->ee_len = cpu_to_le16(le16_to_cpu(ext->ee_len) + n);
+		} else {
+			if (nr == max) {
+				max = max ? max * 2 : 16;
+				ext = realloc(extents, max * sizeof(*ext));
+				if (!ext)
+					goto fail;
+				extents = ext;
+			}
+			ext = &extents[nr++];
+			ext->ee_block = cpu_to_le32(fileblock);
+			ext->ee_len = cpu_to_le16(n);
+			ext->ee_start_hi = 0;
+			ext->ee_start_lo = cpu_to_le32(blknr);
+		}
+		fileblock += n;
+		count -= n;
+		goal = blknr + n;
+	}
+
+	if (ext4fs_build_extent_tree(inodeno, file_inode, extents, nr, goal,
+				     &tree_blocks))
+		goto fail;
+	*total_no_of_block += tree_blocks;
+	*extentsp = extents;
+
+	return nr;
+fail:
+	free(extents);
+
+	return -ENOSPC;
+}
+
+/*
+ * Write @len bytes from @buf to the @nr runs of blocks in @extents, each
+ * in one go, the last partial block through a block padded with zeros
+ */
+static int ext4fs_write_extents(struct ext4_extent *extents, int nr,
+				const char *buf, uint64_t len)
+{
+	struct ext_filesystem *fs = get_fs();
+	char *tail;
+	int i;
+
+	for (i = 0; i < nr && len; i++) {
+		uint64_t start = (uint64_t)le32_to_cpu(extents[i].ee_start_lo) *
+			fs->blksz;
+		uint64_t size = min(len, (uint64_t)le16_to_cpu(extents[i].ee_len)
+				    * fs->blksz);
+		uint64_t full = size & ~(uint64_t)(fs->blksz - 1);
+
+		if (full)
+			put_ext4(start, buf, full);
+		if (size != full) {
+			tail = zalloc(fs->blksz);
+			if (!tail)
+				return -ENOMEM;
+			memcpy(tail, buf + full, size - full);
+			put_ext4(start + full, tail, fs->blksz);
+			free(tail);
+		}
+		buf += size;
+		len -= size;
+	}
+
+	return 0;
+}
+
 int ext4fs_write(const char *fname, const char *buffer,
 		 unsigned long sizebytes, int type)
 {
@@ -867,6 +1118,8 @@ int ext4fs_write(const char *fname, const char *buffer,
 	struct ext_filesystem *fs = get_fs();
 	ALLOC_CACHE_ALIGN_BUFFER(char, filename, 256);
 	bool store_link_in_inode = false;
+	struct ext4_extent *extents = NULL;
+	int nr_extents = -1;
 	memset(filename, 0x00, 256);
 
 	if (type != FILETYPE_REG && type != FILETYPE_SYMLINK)
@@ -881,8 +1134,14 @@ int ext4fs_write(const char *fname, const char *buffer,
 		return -1;
 	}
 
-	if (le32_to_cpu(fs->sb->feature_ro_compat) & EXT4_FEATURE_RO_COMPAT_METADATA_CSUM) {
-		printf("Unsupported feature metadata_csum found, not writing.\n");
+	/*
+	 * The journal of a file system with metadata_csum is not recovered,
+	 * so it must not be thrown away by writing
+	 */
+	if (ext4fs_has_metadata_csum(fs->sb) &&
+	    le32_to_cpu(fs->sb->feature_incompat) &
+	    EXT3_FEATURE_INCOMPAT_RECOVER) {
+		printf("Journal needs recovery, not writing.\n");
 		return -1;
 	}
 
@@ -898,7 +1157,7 @@ int ext4fs_write(const char *fname, const char *buffer,
 		goto fail;
 	}
 	/* check if the filename is already present in root */
-	existing_file_inodeno = ext4fs_filename_unlink(filename);
+	existing_file_inodeno = ext4fs_filename_unlink(filename, parent_inodeno);
 	if (existing_file_inodeno != -1) {
 		ret = ext4fs_delete_file(existing_file_inodeno);
 		fs->first_pass_bbmap = 0;
@@ -931,7 +1190,7 @@ int ext4fs_write(const char *fname, const char *buffer,
 		goto fail;
 	}
 
-	inodeno = ext4fs_update_parent_dentry(filename, type);
+	inodeno = ext4fs_update_parent_dentry(filename, parent_inodeno, type);
 	if (inodeno == -1)
 		goto fail;
 	/* prepare file inode */
@@ -957,9 +1216,22 @@ int ext4fs_write(const char *fname, const char *buffer,
 	file_inode->ctime = cpu_to_le32(timestamp);
 	file_inode->nlinks = cpu_to_le16(1);
 
-	/* Allocate data blocks */
-	ext4fs_allocate_blocks(file_inode, blocks_remaining,
-			       &blks_reqd_for_file);
+	/* Allocate data blocks, in runs if the file can map them by extents */
+	if (blocks_remaining && le32_to_cpu(fs->sb->feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_EXTENTS) {
+		uint32_t goal = le32_to_cpu(sblock->first_data_block) +
+			(inodeno - 1) / le32_to_cpu(sblock->inodes_per_group) *
+			le32_to_cpu(sblock->blocks_per_group);
+
+		nr_extents = ext4fs_allocate_extents(inodeno, file_inode, goal,
+						     blocks_remaining, &extents,
+						     &blks_reqd_for_file);
+		if (nr_extents < 0)
+			goto fail;
+	} else {
+		ext4fs_allocate_blocks(file_inode, blocks_remaining,
+				       &blks_reqd_for_file);
+	}
 	file_inode->blockcnt = cpu_to_le32((blks_reqd_for_file * fs->blksz) >>
 					   LOG2_SECTOR_SIZE);
 
@@ -979,10 +1251,17 @@ int ext4fs_write(const char *fname, const char *buffer,
 		goto fail;
 
 	memcpy(temp_ptr + blkoff, inode_buffer, fs->inodesz);
+	ext4fs_inode_csum_set(inodeno + 1,
+			      (struct ext2_inode *)(temp_ptr + blkoff));
 	if (ext4fs_put_metadata(temp_ptr, itable_blkno))
 		goto fail;
 	/* copy the file content into data blocks */
-	if (ext4fs_write_file(file_inode, 0, sizebytes, buffer) == -1) {
+	if (nr_extents >= 0)
+		ret = ext4fs_write_extents(extents, nr_extents, buffer,
+					   sizebytes);
+	else
+		ret = ext4fs_write_file(file_inode, 0, sizebytes, buffer);
+	if (ret < 0) {
 		printf("Error in copying content\n");
 		/* FIXME: Deallocate data blocks */
 		goto fail;
@@ -1001,7 +1280,10 @@ int ext4fs_write(const char *fname, const char *buffer,
 		if (ext4fs_log_journal(temp_ptr, parent_itable_blkno))
 			goto fail;
 
-		memcpy(temp_ptr + blkoff, g_parent_inode, fs->inodesz);
+		memcpy(temp_ptr + blkoff, g_parent_inode,
+		       sizeof(struct ext2_inode));
+		ext4fs_inode_csum_set(parent_inodeno + 1,
+				      (struct ext2_inode *)(temp_ptr + blkoff));
 		if (ext4fs_put_metadata(temp_ptr, parent_itable_blkno))
 			goto fail;
 	} else {
@@ -1009,7 +1291,10 @@ int ext4fs_write(const char *fname, const char *buffer,
 		 * If parent and child fall in same inode table block
 		 * both should be kept in 1 buffer
 		 */
-		memcpy(temp_ptr + blkoff, g_parent_inode, fs->inodesz);
+		memcpy(temp_ptr + blkoff, g_parent_inode,
+		       sizeof(struct ext2_inode));
+		ext4fs_inode_csum_set(parent_inodeno + 1,
+				      (struct ext2_inode *)(temp_ptr + blkoff));
 		gd_index--;
 		if (ext4fs_put_metadata(temp_ptr, itable_blkno))
 			goto fail;
@@ -1024,6 +1309,7 @@ int ext4fs_write(const char *fname, const char *buffer,
 	free(inode_buffer);
 	free(g_parent_inode);
 	free(temp_ptr);
+	free(extents);
 	g_parent_inode = NULL;
 
 	return 0;
@@ -1032,6 +1318,7 @@ fail:
 	free(inode_buffer);
 	free(g_parent_inode);
 	free(temp_ptr);
+	free(extents);
 	g_parent_inode = NULL;
 
 	return -1;
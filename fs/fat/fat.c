@@ -22,6 +22,12 @@
 #include <asm/cache.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
+#include <linux/math64.h>
+
+/* Windows of the FAT must hold whole pairs of FAT12 entries */
+#if CONFIG_FS_FAT_FATBUF_BLOCKS % 3
+#error "CONFIG_FS_FAT_FATBUF_BLOCKS must be a multiple of 3"
+#endif
 
 /*
  * Convert a string to lowercase.  Converts at most 'len' characters,
@@ -196,12 +202,12 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
+		__u32 getsize = mydata->fatbufblocks;
 		__u8 *bufptr = mydata->fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * mydata->fatbufblocks;
 
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		/* Cap length if fatlength is not a multiple of the window */
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
 
@@ -242,64 +248,150 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 }
 
 /*
- * Read at most 'size' bytes from the specified cluster into 'buffer'.
- * Return 0 on success, -1 otherwise.
+ * Cluster chain of the file read last, as runs of contiguous clusters. It
+ * is kept across reads, so that reading a large file in pieces does not
+ * walk its chain from the start for every piece, and it is extended only
+ * as far as the reads go.
  */
-static int
-get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
+struct fat_extent {
+	__u32 lclust;		/* First cluster in the file */
+	__u32 clust;		/* First cluster on the disk */
+	__u32 count;		/* Number of clusters */
+};
+
+static struct {
+	struct blk_desc *dev;	/* Device and partition of the file system */
+	lbaint_t part_start;
+	__u32 volume_id;
+	__u32 start;		/* First cluster of the file */
+	__u32 size;		/* Size of the file */
+	__u32 clusters;		/* Number of clusters in the file */
+	__u16 time, date;	/* Modification time of the file */
+	struct fat_extent *extents;
+	int count;		/* Number of extents mapped so far */
+	int max;		/* Number of extents allocated */
+} fat_extents;
+
+static void fat_extents_invalidate(void)
 {
-	__u32 idx = 0;
-	__u32 startsect;
-	int ret;
+	fat_extents.dev = NULL;
+	fat_extents.count = 0;
+}
 
-	if (clustnum > 0) {
-		startsect = clust_to_sect(mydata, clustnum);
-	} else {
-		startsect = mydata->rootdir_sect;
-	}
+static int fat_extents_add(__u32 lclust, __u32 clust)
+{
+	struct fat_extent *ext;
 
-	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
+	if (fat_extents.count == fat_extents.max) {
+		int max = fat_extents.max ? fat_extents.max * 2 : 16;
 
-	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+		ext = realloc(fat_extents.extents, max * sizeof(*ext));
+		if (!ext) {
+			debug("Error: allocating extents\n");
+			fat_extents_invalidate();
+			return -1;
+		}
+		fat_extents.extents = ext;
+		fat_extents.max = max;
+	}
 
-		debug("FAT: Misaligned buffer address (%p)\n", buffer);
+	ext = &fat_extents.extents[fat_extents.count++];
+	ext->lclust = lclust;
+	ext->clust = clust;
+	ext->count = 1;
 
-		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
-				debug("Error reading data (got %d)\n", ret);
-				return -1;
-			}
+	return 0;
+}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
-		}
-	} else {
-		idx = size / mydata->sect_size;
-		ret = disk_read(startsect, idx, buffer);
-		if (ret != idx) {
-			debug("Error reading data (got %d)\n", ret);
+/**
+ * fat_extents_map() - map a cluster of a file to the disk
+ *
+ * Find the run of contiguous clusters holding cluster @lclust of the file
+ * at @dentptr, walking its chain in the FAT further if needed.
+ *
+ * @mydata:	file system description
+ * @dentptr:	directory entry of the file
+ * @lclust:	cluster in the file, counted from zero
+ * @clust:	returns the cluster on the disk
+ * @count:	returns the number of contiguous clusters from @clust on
+ * Return:	-1 on error, otherwise 0
+ */
+static int fat_extents_map(fsdata *mydata, dir_entry *dentptr, __u32 lclust,
+			   __u32 *clust, __u32 *count)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	struct fat_extent *ext;
+	__u32 start = START(dentptr);
+	int lo, hi;
+
+	if (fat_extents.dev != cur_dev ||
+	    fat_extents.part_start != cur_part_info.start ||
+	    fat_extents.volume_id != mydata->volume_id ||
+	    fat_extents.start != start ||
+	    fat_extents.size != FAT2CPU32(dentptr->size) ||
+	    fat_extents.time != dentptr->time ||
+	    fat_extents.date != dentptr->date) {
+		if (CHECK_CLUST(start, mydata->fatsize)) {
+			printf("Invalid FAT entry\n");
 			return -1;
 		}
-		startsect += idx;
-		idx *= mydata->sect_size;
-		buffer += idx;
-		size -= idx;
+		fat_extents_invalidate();
+		if (fat_extents_add(0, start))
+			return -1;
+		fat_extents.dev = cur_dev;
+		fat_extents.part_start = cur_part_info.start;
+		fat_extents.volume_id = mydata->volume_id;
+		fat_extents.start = start;
+		fat_extents.size = FAT2CPU32(dentptr->size);
+		fat_extents.clusters = fat_extents.size / bytesperclust +
+				       !!(fat_extents.size % bytesperclust);
+		fat_extents.time = dentptr->time;
+		fat_extents.date = dentptr->date;
 	}
-	if (size) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
 
-		ret = disk_read(startsect, 1, tmpbuf);
-		if (ret != 1) {
-			debug("Error reading data (got %d)\n", ret);
+	/*
+	 * Follow the chain from the last cluster mapped, until the run
+	 * holding lclust is known to its end
+	 */
+	ext = &fat_extents.extents[fat_extents.count - 1];
+	while (lclust >= ext->lclust &&
+	       ext->lclust + ext->count < fat_extents.clusters) {
+		__u32 last = ext->clust + ext->count - 1;
+		__u32 next = get_fatent(mydata, last);
+
+		if (CHECK_CLUST(next, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", next);
+			printf("Invalid FAT entry\n");
 			return -1;
 		}
+		if (next == last + 1) {
+			ext->count++;
+			continue;
+		}
+		if (fat_extents_add(ext->lclust + ext->count, next))
+			return -1;
+		ext = &fat_extents.extents[fat_extents.count - 1];
+	}
+	if (lclust >= ext->lclust + ext->count) {
+		printf("Invalid FAT entry\n");
+		return -1;
+	}
 
-		memcpy(buffer, tmpbuf, size);
+	lo = 0;
+	hi = fat_extents.count - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+
+		if (fat_extents.extents[mid].lclust <= lclust)
+			lo = mid;
+		else
+			hi = mid - 1;
 	}
 
+	ext = &fat_extents.extents[lo];
+	*clust = ext->clust + lclust - ext->lclust;
+	*count = ext->count - (lclust - ext->lclust);
+
 	return 0;
 }
 
@@ -323,9 +415,8 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	__u8 *bounce = NULL;
+	int ret = -1;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -340,101 +431,69 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	while (pos < filesize) {
+		__u32 lclust, clust, count, off, sect, nsect;
+		loff_t span, actsize;
 
-	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
-	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
-
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -1;
-		}
-
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
-			printf("Error reading cluster\n");
-			free(tmp_buffer);
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
-		*gotsize += actsize;
-		if (!filesize)
-			return 0;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-	}
+		lclust = div_u64_rem(pos, bytesperclust, &off);
+		if (fat_extents_map(mydata, dentptr, lclust, &clust, &count))
+			goto out;
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
+		/*
+		 * Read from the sector holding pos to the end of the run of
+		 * contiguous clusters, or to the end of the read if it comes
+		 * first.
+		 */
+		sect = clust_to_sect(mydata, clust) + off / mydata->sect_size;
+		off %= mydata->sect_size;
+		span = (loff_t)count * bytesperclust -
+		       (pos - lclust * (loff_t)bytesperclust - off);
+		span = min(span, filesize - pos + off);
+
+		if (!off && span >= mydata->sect_size &&
+		    !((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1))) {
+			/* whole sectors go straight to the caller's buffer */
+			nsect = div_u64(span, mydata->sect_size);
+			if (disk_read(sect, nsect, buffer) < 0) {
+				printf("Error reading cluster\n");
+				goto out;
+			}
+			actsize = (loff_t)nsect * mydata->sect_size;
+		} else {
+			/*
+			 * A partial sector at either end, or a misaligned
+			 * buffer, which is then filled MAX_CLUSTSIZE bytes at
+			 * a time.
+			 */
+			if (!bounce) {
+				bounce = malloc_cache_aligned(MAX_CLUSTSIZE);
+				if (!bounce) {
+					debug("Error: allocating buffer\n");
+					goto out;
+				}
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
+			span = min(span, (loff_t)MAX_CLUSTSIZE);
+			nsect = 1;
+			if (!off && span >= mydata->sect_size)
+				nsect = DIV_ROUND_UP((__u32)span,
+						     mydata->sect_size);
+			if (disk_read(sect, nsect, bounce) < 0) {
+				printf("Error reading cluster\n");
+				goto out;
+			}
+			actsize = min(span, (loff_t)nsect * mydata->sect_size);
+			actsize -= off;
+			memcpy(buffer, bounce + off, actsize);
 		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
 		buffer += actsize;
-
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+		pos += actsize;
+	}
+	ret = 0;
+out:
+	free(bounce);
+	return ret;
 }
 
 /*
@@ -623,6 +682,11 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
+	memcpy(&mydata->volume_id, volinfo.volume_id,
+	       sizeof(mydata->volume_id));
+
+	if (!mydata->fatbufblocks)
+		mydata->fatbufblocks = CONFIG_FS_FAT_FATBUF_BLOCKS;
 	mydata->fatbufnum = -1;
 	mydata->fat_dirty = 0;
 	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
@@ -1139,7 +1203,7 @@ int file_fat_detectfs(void)
 
 int fat_exists(const char *filename)
 {
-	fsdata fsdata;
+	fsdata fsdata = { .fatbuf = NULL, };
 	fat_itr *itr;
 	int ret;
 
@@ -1159,7 +1223,7 @@ out:
 
 int fat_size(const char *filename, loff_t *size)
 {
-	fsdata fsdata;
+	fsdata fsdata = { .fatbuf = NULL, };
 	fat_itr *itr;
 	int ret;
 
@@ -1197,7 +1261,7 @@ out_free_itr:
 int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 		     loff_t maxsize, loff_t *actread)
 {
-	fsdata fsdata;
+	fsdata fsdata = { .fatbuf = NULL, };
 	fat_itr *itr;
 	int ret;
 
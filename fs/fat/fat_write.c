@@ -107,10 +107,10 @@ static void set_name(dir_entry *dirent, const char *filename)
  */
 static int flush_dirty_fat_buffer(fsdata *mydata)
 {
-	int getsize = FATBUFBLOCKS;
+	int getsize = mydata->fatbufblocks;
 	__u32 fatlength = mydata->fatlength;
 	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u32 startblock = mydata->fatbufnum * mydata->fatbufblocks;
 
 	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
 	      (int)mydata->fat_dirty);
@@ -118,12 +118,15 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
 		return 0;
 
-	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	/* Cap length if fatlength is not a multiple of the window */
 	if (startblock + getsize > fatlength)
 		getsize = fatlength - startblock;
 
 	startblock += mydata->fat_sect;
 
+	/* The FAT goes after the clusters, and before the directory entries */
+	blkcache_barrier();
+
 	/* Write FAT buf */
 	if (disk_write(startblock, getsize, bufptr) < 0) {
 		debug("error: writing FAT blocks\n");
@@ -138,6 +141,7 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 			return -1;
 		}
 	}
+	blkcache_barrier();
 	mydata->fat_dirty = 0;
 
 	return 0;
@@ -269,6 +273,9 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	__u32 bufnum, offset, off16;
 	__u16 val1, val2;
 
+	/* The cached chain of the file read last may change */
+	fat_extents_invalidate();
+
 	switch (mydata->fatsize) {
 	case 32:
 		bufnum = entry / FAT32BUFSIZE;
@@ -289,12 +296,12 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 
 	/* Read a new block of FAT entries into the cache. */
 	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
+		int getsize = mydata->fatbufblocks;
 		__u8 *bufptr = mydata->fatbuf;
 		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u32 startblock = bufnum * mydata->fatbufblocks;
 
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		/* Cap length if fatlength is not a multiple of the window */
 		if (startblock + getsize > fatlength)
 			getsize = fatlength - startblock;
 
@@ -1078,7 +1085,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 		      loff_t size, loff_t *actwrite)
 {
 	dir_entry *retdent;
-	fsdata datablock = { .fatbuf = NULL, };
+	fsdata datablock = { .fatbuf = NULL, .fatbufblocks = FATBUFBLOCKS, };
 	fsdata *mydata = &datablock;
 	fat_itr *itr = NULL;
 	int ret = -1;
@@ -1287,7 +1294,7 @@ static int delete_dentry(fat_itr *itr)
 
 int fat_unlink(const char *filename)
 {
-	fsdata fsdata = { .fatbuf = NULL, };
+	fsdata fsdata = { .fatbuf = NULL, .fatbufblocks = FATBUFBLOCKS, };
 	fat_itr *itr = NULL;
 	int n_entries, ret;
 	char *filename_copy, *dirname, *basename;
@@ -1359,7 +1366,7 @@ exit:
 int fat_mkdir(const char *new_dirname)
 {
 	dir_entry *retdent;
-	fsdata datablock = { .fatbuf = NULL, };
+	fsdata datablock = { .fatbuf = NULL, .fatbufblocks = FATBUFBLOCKS, };
 	fsdata *mydata = &datablock;
 	fat_itr *itr = NULL;
 	char *dirname_copy, *parent, *dirname;
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <common.h>
 #include <env.h>
+#include <fit_stream.h>
 #include <lmb.h>
 #include <log.h>
 #include <mapmem.h>
@@ -336,6 +337,14 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+/* Let the block cache keep the writes of the filesystem until fs_close() */
+static void fs_begin_writeback(void)
+{
+	if (fs_dev_desc)
+		blkcache_writeback_begin(fs_dev_desc->if_type,
+					 fs_dev_desc->devnum);
+}
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -373,6 +382,7 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			fs_begin_writeback();
 			return 0;
 		}
 	}
@@ -398,6 +408,7 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		if (!info->probe(fs_dev_desc, &fs_partition)) {
 			fs_type = info->fstype;
 			fs_dev_part = part;
+			fs_begin_writeback();
 			return 0;
 		}
 	}
@@ -411,6 +422,10 @@ void fs_close(void)
 
 	info->close();
 
+	/* Write back what the filesystem left in the block cache */
+	if (blkcache_writeback_end())
+		log_err("Cannot write back the block cache\n");
+
 	fs_type = FS_TYPE_ANY;
 }
 
@@ -515,7 +530,12 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	 * means read the whole file.
 	 */
 	buf = map_sysmem(addr, len);
+	fit_stream_begin(buf, len);
 	ret = info->read(filename, buf, offset, len, actread);
+	if (ret)
+		fit_stream_abort();
+	else
+		fit_stream_end(*actread);
 	unmap_sysmem(buf);
 
 	/* If we requested a specific number of bytes, check we got it */
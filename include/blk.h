@@ -19,6 +19,19 @@ typedef ulong lbaint_t;
 #define LBAF "%" LBAFlength "x"
 #define LBAFU "%" LBAFlength "u"
 
+/**
+ * struct blk_sg - A segment of a scatter-gather block request
+ *
+ * Consecutive segments hold consecutive blocks of the device.
+ *
+ * @buf:	buffer of the segment
+ * @blkcnt:	number of blocks in the segment
+ */
+struct blk_sg {
+	void *buf;
+	lbaint_t blkcnt;
+};
+
 /* Interface types: */
 enum if_type {
 	IF_TYPE_UNKNOWN = 0,
@@ -151,22 +164,135 @@ void blkcache_fill(int iftype, int dev,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer);
 
+/**
+ * blkcache_write() - attempt to keep written blocks in the cache
+ *
+ * With CONFIG_BLOCK_CACHE_WRITEBACK, small writes to the device of the
+ * current write-back session are only stored in the cache, to be written
+ * back to the device later. Otherwise the caller must call
+ * blkcache_invalidate() and write the blocks to the device itself.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks to write
+ * @param blksz - size in bytes of each block
+ * @param buffer - data to write
+ *
+ * @return - 1 if the blocks were cached, 0 if not, -ve on error
+ */
+int blkcache_write(int iftype, int dev,
+		   lbaint_t start, lbaint_t blkcnt,
+		   unsigned long blksz, const void *buffer);
+
+/**
+ * blkcache_barrier() - order writes kept in the cache
+ *
+ * Blocks written after this call reach the devices after those written
+ * before it. Filesystems call this where the order of their writes matters,
+ * for instance between a journal and its commit block.
+ */
+void blkcache_barrier(void);
+
+/**
+ * blkcache_flush() - write back the blocks of a device kept in the cache
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ *
+ * @return - 0 if OK, -ve on error
+ */
+int blkcache_flush(int iftype, int dev);
+
+/**
+ * blkcache_flush_range() - write back the blocks of a device if any of a
+ * range are kept in the cache and not written back yet
+ *
+ * Drivers which read the device without going through the cache call this
+ * first, so that they do not miss data kept in the cache.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param start - starting block number
+ * @param blkcnt - number of blocks
+ *
+ * @return - 0 if OK, -ve on error
+ */
+int blkcache_flush_range(int iftype, int dev, lbaint_t start, lbaint_t blkcnt);
+
+/**
+ * blkcache_writeback_begin() - start keeping small writes to a device
+ *
+ * Until blkcache_writeback_end(), small writes to the device may be kept in
+ * the cache. Filesystems call this when they are opened, so that writes
+ * made by other commands are never left in the cache.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ */
+void blkcache_writeback_begin(int iftype, int dev);
+
+/**
+ * blkcache_writeback_end() - write back the device of the session and end it
+ *
+ * @return - 0 if OK, -ve on error
+ */
+int blkcache_writeback_end(void);
+
+/**
+ * blkcache_flush_all() - write back all the blocks kept in the cache
+ *
+ * @return - 0 if OK, -ve on error
+ */
+int blkcache_flush_all(void);
+
 /**
  * blkcache_invalidate() - discard the cache for a set of blocks
- * because of a write or device (re)initialization.
+ * because of a write or device (re)initialization. Blocks which were
+ * not written back yet are written back first, and kept if that fails.
  *
  * @param iftype - IF_TYPE_x for type of device
  * @param dev - device index of particular type
  */
 void blkcache_invalidate(int iftype, int dev);
 
+/**
+ * blkcache_readahead() - number of blocks to read ahead after a miss
+ *
+ * When blkcache_read() misses on a read which follows on from the previous
+ * one of the device, the caller should read this many more blocks and pass
+ * them all to blkcache_fill(). The window grows while the device is read
+ * sequentially.
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ *
+ * @return - number of blocks to read ahead, 0 if none
+ */
+lbaint_t blkcache_readahead(int iftype, int dev);
+
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * The cache holds at most @entries times @blocks blocks, within the size
+ * set by blkcache_configure_size().
+ *
+ * @param blocks - maximum blocks per entry, i.e. of a read looked up
+ * @param entries - maximum entries in cache, 0 to only limit its size
+ *
+ * @return - 0 if OK, -EIO if the cache could not be written back
+ */
+int blkcache_configure(unsigned blocks, unsigned entries);
+
+/**
+ * blkcache_configure_size() - configure the memory and readahead of the cache
+ *
+ * @param size - maximum size in bytes of the cache, including its overhead
+ * @param readahead - maximum blocks to read ahead, 0 to disable readahead
+ *
+ * @return - 0 if OK, -EIO if the cache could not be written back
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+int blkcache_configure_size(ulong size, unsigned readahead);
 
 /*
  * statistics of the block cache
@@ -174,9 +300,18 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
-	unsigned entries; /* current entry count */
+	unsigned evictions; /* blocks dropped to make room */
+	unsigned readahead; /* blocks read ahead */
+	unsigned writes; /* writes kept in the cache */
+	unsigned writebacks; /* device writes of dirty blocks */
+	unsigned written; /* dirty blocks written back */
+	unsigned entries; /* current block count */
+	unsigned dirty; /* blocks not written back yet */
 	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned max_entries; /* 0 if only the size is limited */
+	ulong size; /* current size in bytes */
+	ulong max_size;
+	unsigned max_readahead;
 };
 
 /**
@@ -199,6 +334,43 @@ static inline void blkcache_fill(int iftype, int dev,
 				 lbaint_t start, lbaint_t blkcnt,
 				 unsigned long blksz, void const *buffer) {}
 
+static inline lbaint_t blkcache_readahead(int iftype, int dev)
+{
+	return 0;
+}
+
+static inline int blkcache_write(int iftype, int dev,
+				 lbaint_t start, lbaint_t blkcnt,
+				 unsigned long blksz, const void *buffer)
+{
+	return 0;
+}
+
+static inline void blkcache_barrier(void) {}
+
+static inline int blkcache_flush(int iftype, int dev)
+{
+	return 0;
+}
+
+static inline int blkcache_flush_range(int iftype, int dev, lbaint_t start,
+				       lbaint_t blkcnt)
+{
+	return 0;
+}
+
+static inline void blkcache_writeback_begin(int iftype, int dev) {}
+
+static inline int blkcache_writeback_end(void)
+{
+	return 0;
+}
+
+static inline int blkcache_flush_all(void)
+{
+	return 0;
+}
+
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
@@ -221,6 +393,22 @@ struct blk_ops {
 	unsigned long (*read)(struct udevice *dev, lbaint_t start,
 			      lbaint_t blkcnt, void *buffer);
 
+	/**
+	 * read_sg() - read from a block device into scattered buffers
+	 *
+	 * Optional. The device should move all the segments in as few
+	 * transfers as it can, ideally one DMA transaction.
+	 *
+	 * @dev:	Device to read from
+	 * @start:	Start block number to read (0=first)
+	 * @sg:		Segments to fill, in the order of the blocks
+	 * @count:	Number of segments
+	 * @return number of blocks read, or -ve error number (see the
+	 * IS_ERR_VALUE() macro
+	 */
+	unsigned long (*read_sg)(struct udevice *dev, lbaint_t start,
+				 const struct blk_sg *sg, uint count);
+
 	/**
 	 * write() - write to a block device
 	 *
@@ -281,6 +469,24 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_dread_sg() - Read consecutive blocks into scattered buffers
+ *
+ * Devices with a read_sg() operation can fill all the segments with a
+ * single transfer, e.g. a chain of DMA descriptors, which saves reading each
+ * of them separately or through a bounce buffer. Buffers should be aligned
+ * to ARCH_DMA_MINALIGN for that. Other devices read one segment at a time.
+ * The block cache is bypassed.
+ *
+ * @block_dev:	Block device to read from
+ * @start:	Start block number to read (0=first)
+ * @sg:		Segments to fill, in the order of the blocks
+ * @count:	Number of segments
+ * @return number of blocks read, or -ve error number
+ */
+unsigned long blk_dread_sg(struct blk_desc *block_dev, lbaint_t start,
+			   const struct blk_sg *sg, uint count);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -459,6 +665,22 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
+static inline ulong blk_dread_sg(struct blk_desc *block_dev, lbaint_t start,
+				 const struct blk_sg *sg, uint count)
+{
+	ulong blks_read, total = 0;
+
+	for (; count; count--, sg++) {
+		blks_read = blk_dread(block_dev, start, sg->blkcnt, sg->buf);
+		if (blks_read != sg->blkcnt)
+			return total + blks_read;
+		start += blks_read;
+		total += blks_read;
+	}
+
+	return total;
+}
+
 static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
@@ -118,6 +118,11 @@ typedef unsigned long ulong;
 # define be64_to_cpu(x)		(x)
 #endif
 
+/* Library code shared with U-Boot may provide overridable defaults */
+#ifndef __weak
+# define __weak			__attribute__((weak))
+#endif
+
 #else /* !USE_HOSTCC */
 
 /* Type for `void *' pointers. */
@@ -26,6 +26,9 @@
 
 #define CONFIG_HOST_MAX_DEVICES 4
 
+#define CONFIG_SYS_MAX_NAND_DEVICE	2
+#define CONFIG_SYS_NAND_ONFI_DETECTION
+
 /*
  * Size of malloc() pool, before and after relocation
  */
@@ -0,0 +1,193 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * eMMC Command Queue Host Controller Interface (CQHCI)
+ *
+ * Register and descriptor definitions follow JESD84-B51 section B and the
+ * Linux cqhci driver.
+ */
+
+#ifndef __CQHCI_H
+#define __CQHCI_H
+
+#include <asm/io.h>
+#include <linux/bitops.h>
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+struct mmc;
+struct mmc_cqe_task;
+
+/* registers */
+#define CQHCI_VER			0x00
+#define CQHCI_CAP			0x04
+#define CQHCI_CFG			0x08
+#define  CQHCI_DCMD			BIT(12)
+#define  CQHCI_TASK_DESC_SZ		BIT(8)
+#define  CQHCI_ENABLE			BIT(0)
+#define CQHCI_CTL			0x0c
+#define  CQHCI_CLEAR_ALL_TASKS		BIT(8)
+#define  CQHCI_HALT			BIT(0)
+#define CQHCI_IS			0x10
+#define CQHCI_ISTE			0x14
+#define CQHCI_ISGE			0x18
+#define  CQHCI_IS_HAC			BIT(0)
+#define  CQHCI_IS_TCC			BIT(1)
+#define  CQHCI_IS_RED			BIT(2)
+#define  CQHCI_IS_TCL			BIT(3)
+#define  CQHCI_IS_MASK			(CQHCI_IS_TCC | CQHCI_IS_RED)
+#define CQHCI_IC			0x1c
+#define CQHCI_TDLBA			0x20
+#define CQHCI_TDLBAU			0x24
+#define CQHCI_TDBR			0x28
+#define CQHCI_TCN			0x2c
+#define CQHCI_DQS			0x30
+#define CQHCI_DPT			0x34
+#define CQHCI_TCLR			0x38
+#define CQHCI_SSC1			0x40
+#define CQHCI_SSC2			0x44
+#define CQHCI_CRDCT			0x48
+#define CQHCI_RMEM			0x50
+#define CQHCI_TERRI			0x54
+#define CQHCI_CRI			0x58
+#define CQHCI_CRA			0x5c
+
+#define CQHCI_NUM_SLOTS			32
+
+/* descriptor attributes */
+#define CQHCI_VALID(x)			(((x) & 1) << 0)
+#define CQHCI_END(x)			(((x) & 1) << 1)
+#define CQHCI_INT(x)			(((x) & 1) << 2)
+#define CQHCI_ACT(x)			(((x) & 0x7) << 3)
+#define  CQHCI_ACT_TASK			0x5
+#define  CQHCI_ACT_TRAN			0x4
+#define  CQHCI_ACT_LINK			0x6
+
+/* data task descriptor fields */
+#define CQHCI_FORCED_PROG(x)		(((x) & 1) << 6)
+#define CQHCI_CONTEXT(x)		(((x) & 0xf) << 7)
+#define CQHCI_DATA_TAG(x)		(((x) & 1) << 11)
+#define CQHCI_DATA_DIR(x)		(((x) & 1) << 12)
+#define CQHCI_PRIORITY(x)		(((x) & 1) << 13)
+#define CQHCI_QBAR(x)			(((x) & 1) << 14)
+#define CQHCI_REL_WRITE(x)		(((x) & 1) << 15)
+#define CQHCI_BLK_COUNT(x)		(((u64)(x) & 0xffff) << 16)
+#define CQHCI_BLK_ADDR(x)		(((u64)(x) & 0xffffffff) << 32)
+
+/* transfer descriptor fields */
+#define CQHCI_DAT_LENGTH(x)		(((x) & 0xffff) << 16)
+
+/* Largest block-aligned length of a transfer descriptor */
+#define CQHCI_MAX_SEG_LEN		(0x10000 - 512)
+
+struct cqhci_host;
+
+/**
+ * struct cqhci_host_ops - Host controller hooks used by the CQHCI library
+ *
+ * @enable:	prepare the host controller to hand the bus to the engine
+ *		(optional)
+ * @disable:	give the bus back to the host controller (optional)
+ * @error:	check for, and clear, a command or data error which the host
+ *		controller saw while the engine ran; returns -ve if there was
+ *		one (optional)
+ * @write_l:	write a CQHCI register, if not memory-mapped at @mmio
+ * @read_l:	read a CQHCI register, if not memory-mapped at @mmio
+ */
+struct cqhci_host_ops {
+	int (*enable)(struct cqhci_host *cq_host);
+	void (*disable)(struct cqhci_host *cq_host);
+	int (*error)(struct cqhci_host *cq_host);
+	void (*write_l)(struct cqhci_host *cq_host, u32 val, int reg);
+	u32 (*read_l)(struct cqhci_host *cq_host, int reg);
+};
+
+/**
+ * struct cqhci_host - State of a command queue engine
+ *
+ * @mmio:		base of the CQHCI registers
+ * @ops:		host controller hooks
+ * @mmc:		MMC device the engine belongs to
+ * @priv:		host driver data
+ * @dma64:		use 64-bit addresses in descriptors
+ * @enabled:		the engine owns the bus
+ * @task_desc_len:	size of a task descriptor
+ * @link_desc_len:	size of the link descriptor after each task
+ * @trans_desc_len:	size of a transfer descriptor
+ * @slot_sz:		size of one entry of the task descriptor list
+ * @max_segs:		transfer descriptors available to each slot
+ * @desc_base:		task descriptor list
+ * @trans_desc_base:	transfer descriptors of all slots
+ */
+struct cqhci_host {
+	void __iomem *mmio;
+	const struct cqhci_host_ops *ops;
+	struct mmc *mmc;
+	void *priv;
+	bool dma64;
+	bool enabled;
+	uint task_desc_len;
+	uint link_desc_len;
+	uint trans_desc_len;
+	uint slot_sz;
+	uint max_segs;
+	u8 *desc_base;
+	u8 *trans_desc_base;
+};
+
+static inline void cqhci_writel(struct cqhci_host *cq_host, u32 val, int reg)
+{
+	if (unlikely(cq_host->ops->write_l))
+		cq_host->ops->write_l(cq_host, val, reg);
+	else
+		writel(val, cq_host->mmio + reg);
+}
+
+static inline u32 cqhci_readl(struct cqhci_host *cq_host, int reg)
+{
+	if (unlikely(cq_host->ops->read_l))
+		return cq_host->ops->read_l(cq_host, reg);
+	else
+		return readl(cq_host->mmio + reg);
+}
+
+/**
+ * cqhci_init() - Set up a command queue engine
+ *
+ * Allocates the task and transfer descriptor lists. @cq_host->mmio (or the
+ * register hooks) and @cq_host->ops must be set.
+ *
+ * @cq_host:	engine to set up
+ * @mmc:	MMC device served by the engine
+ * @dma64:	true to use 64-bit DMA addresses
+ * @return 0 if OK, -ENOMEM if the descriptors cannot be allocated
+ */
+int cqhci_init(struct cqhci_host *cq_host, struct mmc *mmc, bool dma64);
+
+/**
+ * cqhci_enable() - Hand the bus to the command queue engine, or take it back
+ *
+ * The card must have command queueing enabled in its EXT_CSD before the
+ * engine is enabled, and until after it is disabled.
+ *
+ * @cq_host:	engine to switch
+ * @enable:	true to enable it
+ * @return 0 if OK, -ve on error
+ */
+int cqhci_enable(struct cqhci_host *cq_host, bool enable);
+
+/**
+ * cqhci_request() - Run data tasks through the command queue engine
+ *
+ * Up to the queue depth of the card, tasks are kept queued on the card so
+ * that it can prepare one while the data of another is on the bus. Tasks
+ * may complete in any order. This returns once all of them are done.
+ *
+ * @cq_host:	engine to use, which must be enabled
+ * @tasks:	tasks to run
+ * @count:	number of tasks
+ * @return 0 if OK, -ve on error
+ */
+int cqhci_request(struct cqhci_host *cq_host, struct mmc_cqe_task *tasks,
+		  uint count);
+
+#endif /* __CQHCI_H */
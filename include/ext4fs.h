@@ -30,13 +30,21 @@
 
 struct disk_partition;
 
+#define EXT4_ENCRYPT_FL		0x00000800 /* Encrypted inode */
 #define EXT4_INDEX_FL		0x00001000 /* Inode uses hash tree index */
 #define EXT4_EXTENTS_FL		0x00080000 /* Inode uses extents */
+#define EXT4_CASEFOLD_FL	0x40000000 /* Casefolded directory */
 #define EXT4_EXT_MAGIC			0xf30a
+#define EXT4_FEATURE_COMPAT_DIR_INDEX	0x0020
+#define EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
 #define EXT4_FEATURE_RO_COMPAT_GDT_CSUM	0x0010
 #define EXT4_FEATURE_RO_COMPAT_METADATA_CSUM 0x0400
+#define EXT4_FEATURE_INCOMPAT_META_BG	0x0010
 #define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
 #define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
+#define EXT4_FEATURE_INCOMPAT_CSUM_SEED	0x2000
+#define EXT4_FEATURE_INCOMPAT_LARGEDIR	0x4000
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
 #define EXT4_INDIRECT_BLOCKS		12
 
 #define EXT4_BG_INODE_UNINIT		0x0001
@@ -60,6 +68,12 @@ struct ext4_extent {
 	__le32	ee_start_lo;	/* low 32 bits of physical block */
 };
 
+/*
+ * An ee_len above this is an unwritten extent, which reads as zeros, of
+ * ee_len - EXT_INIT_MAX_LEN blocks
+ */
+#define EXT_INIT_MAX_LEN	(1 << 15)
+
 /*
  * This is index on-disk structure.
  * It's used at all the levels except the bottom.
@@ -81,6 +95,28 @@ struct ext4_extent_header {
 	__le32	eh_generation;	/* generation of the tree */
 };
 
+/*
+ * With metadata_csum, this follows the eh_max entries of an extent tree
+ * block
+ */
+struct ext4_extent_tail {
+	__le32	et_checksum;	/* crc32c(uuid+inum+extent block) */
+};
+
+/*
+ * With metadata_csum, the last 12 bytes of a directory block hold this
+ * instead of an entry
+ */
+struct ext4_dir_entry_tail {
+	__le32	det_reserved_zero1;	/* Pretend to be unused */
+	__le16	det_rec_len;		/* 12 */
+	__u8	det_reserved_zero2;	/* Zero name length */
+	__u8	det_reserved_ft;	/* 0xDE, fake file type */
+	__le32	det_checksum;		/* crc32c(uuid+inum+dirblock) */
+};
+
+#define EXT4_FT_DIR_CSUM	0xde
+
 struct ext_filesystem {
 	/* Total Sector of partition */
 	uint64_t total_sect;
@@ -102,6 +138,8 @@ struct ext_filesystem {
 	struct ext2_sblock *sb;
 	/* Block group descritpor table */
 	char *gdtable;
+	/* Seed of the metadata checksums, with metadata_csum */
+	uint32_t csum_seed;
 
 	/* Block Bitmap Related */
 	unsigned char **blk_bmaps;
@@ -135,7 +173,7 @@ extern int gindex;
 
 int ext4fs_init(void);
 void ext4fs_deinit(void);
-int ext4fs_filename_unlink(char *filename);
+int ext4fs_filename_unlink(char *filename, int parent_inodeno);
 int ext4fs_write(const char *fname, const char *buffer,
 				 unsigned long sizebytes, int type);
 int ext4_write_file(const char *filename, void *buf, loff_t offset, loff_t len,
@@ -128,6 +128,13 @@ struct ext2_sblock {
 	__le32 raid_stripe_width;
 	uint8_t log2_groups_per_flex;
 	uint8_t checksum_type;
+	uint8_t encryption_level;
+	uint8_t reserved_pad;
+	__le64 kbytes_written;
+	__le32 reserved1[60];
+	__le32 checksum_seed;	/* crc32c(uuid) if csum_seed is set */
+	__le32 reserved2[98];
+	__le32 checksum;	/* crc32c(superblock) */
 };
 
 struct ext2_block_group {
@@ -185,7 +192,12 @@ struct ext2_inode {
 	__le32 acl;
 	__le32 size_high;	/* previously dir_acl, but never used */
 	__le32 fragment_addr;
-	__le32 osd2[3];
+	__le16 blockcnt_high;
+	__le16 acl_high;
+	__le16 uid_high;
+	__le16 gid_high;
+	__le16 checksum_lo;	/* crc32c(uuid+inum+inode) LE */
+	__le16 reserved;
 };
 
 /* The header of an ext2 directory entry. */
@@ -196,11 +208,19 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* A run of contiguous blocks of a file, see ext4fs_map_blocks() */
+struct ext2_block_map {
+	lbaint_t fileblock;	/* First block in the file */
+	lbaint_t count;		/* Number of blocks, 0 if none is mapped */
+	lbaint_t blknr;		/* First block on the disk, 0 for a hole */
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext2_block_map map;	/* Run of blocks mapped last */
 };
 
 /* Information about a "mounted" ext2 filesystem. */
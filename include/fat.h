@@ -25,8 +25,13 @@ struct disk_partition;
 #define DIRENTSPERCLUST	((mydata->clust_size * mydata->sect_size) / \
 			 sizeof(dir_entry))
 
+/*
+ * Sectors in the FAT window of the write path. Every change to the FAT
+ * rewrites the whole window, so it is kept small. Reads use a window of
+ * CONFIG_FS_FAT_FATBUF_BLOCKS sectors instead.
+ */
 #define FATBUFBLOCKS	6
-#define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+#define FATBUFSIZE	(mydata->sect_size * mydata->fatbufblocks)
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -173,10 +178,12 @@ typedef struct {
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufblocks;	/* Sectors in fatbuf, 0 for the default */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u32	volume_id;	/* Volume serial number */
 } fsdata;
 
 static inline u32 clust_to_sect(fsdata *fsdata, u32 clust)
@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Hashing of FIT sub-images while the FIT is being loaded
+ */
+
+#ifndef __FIT_STREAM_H
+#define __FIT_STREAM_H
+
+#include <linux/errno.h>
+#include <linux/kconfig.h>
+#include <linux/types.h>
+
+#if CONFIG_IS_ENABLED(FIT_STREAM_HASH) && !defined(USE_HOSTCC)
+
+/**
+ * fit_stream_begin() - start watching a load for a FIT image
+ *
+ * Any digest kept from an earlier load into the same memory is dropped.
+ * Nothing is hashed if the control FDT holds keys to verify FIT signatures.
+ *
+ * @buf:	Address the data is loaded to
+ * @max_size:	Size of the load window in bytes, 0 if not known
+ */
+void fit_stream_begin(void *buf, ulong max_size);
+
+/**
+ * fit_stream_data() - report that data has landed in memory
+ *
+ * This is cheap when no load is being watched or @buf is outside the load
+ * window, so it can be called for every transfer. Data that does not extend
+ * what has already arrived is not hashed. Digests of the images the data
+ * lands on are dropped.
+ *
+ * @buf:	Start of the new data
+ * @len:	Number of bytes
+ */
+void fit_stream_data(const void *buf, ulong len);
+
+/**
+ * fit_stream_end() - finish watching a load
+ *
+ * Everything in the first @size bytes of the window that has not been hashed
+ * yet is hashed now and the digests are kept for fit_stream_get_hash().
+ *
+ * @size:	Number of bytes loaded
+ */
+void fit_stream_end(ulong size);
+
+/**
+ * fit_stream_abort() - stop watching a load that failed
+ */
+void fit_stream_abort(void);
+
+/**
+ * fit_stream_get_hash() - get a digest computed while loading
+ *
+ * A digest can be used once; the caller is expected to compare it with the
+ * value in the FIT.
+ *
+ * @data:	Image data
+ * @size:	Image size in bytes
+ * @algo:	Hash algorithm name
+ * @value:	Returns the digest
+ * @value_len:	Returns the digest length
+ * @return 0 if found, -ENOENT if the image has to be hashed
+ */
+int fit_stream_get_hash(const void *data, ulong size, const char *algo,
+			uint8_t *value, int *value_len);
+
+#else
+
+static inline void fit_stream_begin(void *buf, ulong max_size) {}
+static inline void fit_stream_data(const void *buf, ulong len) {}
+static inline void fit_stream_end(ulong size) {}
+static inline void fit_stream_abort(void) {}
+
+static inline int fit_stream_get_hash(const void *data, ulong size,
+				      const char *algo, uint8_t *value,
+				      int *value_len)
+{
+	return -ENOENT;
+}
+
+#endif /* FIT_STREAM_HASH */
+
+#endif /* __FIT_STREAM_H */
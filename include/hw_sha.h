@@ -34,6 +34,28 @@ void hw_sha256(const uchar * in_addr, uint buflen,
 void hw_sha1(const uchar * in_addr, uint buflen,
 			uchar * out_addr, uint chunk_size);
 
+/**
+ * Computes SHA-224 hash value of input pbuf using h/w acceleration
+ *
+ * @param in_addr	A pointer to the input buffer
+ * @param buflen	Byte length of input buffer
+ * @param out_addr	A pointer to the output buffer, at least 28 bytes
+ * @param chunk_size	chunk size for sha224
+ */
+void hw_sha224(const uchar *in_addr, uint buflen, uchar *out_addr,
+	       uint chunk_size);
+
+/**
+ * Computes SHA-512 hash value of input pbuf using h/w acceleration
+ *
+ * @param in_addr	A pointer to the input buffer
+ * @param buflen	Byte length of input buffer
+ * @param out_addr	A pointer to the output buffer, at least 64 bytes
+ * @param chunk_size	chunk size for sha512
+ */
+void hw_sha512(const uchar *in_addr, uint buflen, uchar *out_addr,
+	       uint chunk_size);
+
 /*
  * Create the context for sha progressive hashing using h/w acceleration
  *
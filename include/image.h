@@ -385,6 +385,7 @@ typedef struct bootm_headers {
 	ulong		ep;		/* entry point of OS */
 
 	ulong		rd_start, rd_end;/* ramdisk start/end */
+	int		rd_worker;	/* load a FIT ramdisk on the worker core */
 
 	char		*ft_addr;	/* flat dev tree address */
 	ulong		ft_len;		/* length of flat device tree */
@@ -683,6 +684,26 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		   int arch, int image_type, int bootstage_id,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp);
 
+#if CONFIG_IS_ENABLED(CPU_WORKER) && IMAGE_ENABLE_FIT && !defined(USE_HOSTCC)
+/**
+ * fit_image_load_wait() - finish loading a ramdisk on the worker core
+ *
+ * While images->rd_worker is set, fit_image_load() leaves checking the SHA
+ * hashes of a ramdisk and copying it to its load address to the worker
+ * core, so that this can overlap with loading the OS. This waits for the
+ * worker and reports the result.
+ *
+ * @return 0 if OK or if nothing was left to the worker, -EACCES if a hash
+ *	does not match, other -ve on error
+ */
+int fit_image_load_wait(void);
+#else
+static inline int fit_image_load_wait(void)
+{
+	return 0;
+}
+#endif
+
 /**
  * image_source_script() - Execute a script
  *
@@ -100,6 +100,10 @@ void nand_wait_ready(struct mtd_info *mtd);
 
 /* Extended commands for large page devices */
 #define NAND_CMD_READSTART	0x30
+#define NAND_CMD_READCACHESEQ	0x31
+#define NAND_CMD_READCACHEEND	0x3f
+#define NAND_CMD_READMULTIPLANE	0x32
+#define NAND_CMD_RNDOUTENH	0x06
 #define NAND_CMD_RNDOUTSTART	0xE0
 #define NAND_CMD_CACHEDPROG	0x15
 
@@ -250,6 +254,18 @@ enum nand_ecc_algo {
  * kmap'ed, vmalloc'ed highmem buffers being passed from upper layers
  */
 #define NAND_USE_BOUNCE_BUFFER	0x00100000
+/*
+ * The controller passes READ CACHE SEQUENTIAL/END through ->cmdfunc() and
+ * its ecc.read_page() reads the page from the current column without
+ * issuing page commands of its own, so the core may pipeline sequential
+ * page reads through the cache register.
+ */
+#define NAND_CACHE_READ		0x00200000
+/*
+ * The controller uses ->cmd_ctrl() for raw command and address cycles, so
+ * the core may issue multi-plane reads on chips which support them.
+ */
+#define NAND_MULTI_PLANE_READ	0x00400000
 
 /* Options set by nand scan */
 /* bbt has already been read */
@@ -264,6 +280,7 @@ enum nand_ecc_algo {
 
 /* ONFI features */
 #define ONFI_FEATURE_16_BIT_BUS		(1 << 0)
+#define ONFI_FEATURE_MULTI_PLANE_READ	(1 << 6)
 #define ONFI_FEATURE_EXT_PARAM_PAGE	(1 << 7)
 
 /* ONFI timing mode, used in both asynchronous and synchronous mode */
@@ -284,9 +301,15 @@ enum nand_ecc_algo {
 /* ONFI subfeature parameters length */
 #define ONFI_SUBFEATURE_PARAM_LEN	4
 
+/* ONFI optional commands READ CACHE supported? */
+#define ONFI_OPT_CMD_READ_CACHE		(1 << 1)
+
 /* ONFI optional commands SET/GET FEATURES supported? */
 #define ONFI_OPT_CMD_SET_GET_FEATURES	(1 << 2)
 
+/* ONFI optional commands CHANGE READ COLUMN ENHANCED supported? */
+#define ONFI_OPT_CMD_RNDOUT_ENH		(1 << 6)
+
 struct nand_onfi_params {
 	/* rev info and features block */
 	/* 'O' 'N' 'F' 'I'  */
@@ -589,6 +612,10 @@ static const struct nand_ecc_caps __name = {			\
  *		any single ECC step, 0 if bitflips uncorrectable, -EIO hw error
  * @read_subpage:	function to read parts of the page covered by ECC;
  *			returns same as read_page()
+ * @read_pages:	optional function to read @numpages whole consecutive pages
+ *		of one chip into @buf, used for sequential reads. Pages that
+ *		fail ECC are counted in mtd->ecc_stats.failed; returns the
+ *		maximum number of bitflips in any page or -EIO on hw error
  * @write_subpage:	function to write parts of the page covered by ECC.
  * @write_page:	function to write a page according to the ECC generator
  *		requirements.
@@ -623,6 +650,8 @@ struct nand_ecc_ctrl {
 			uint8_t *buf, int oob_required, int page);
 	int (*read_subpage)(struct mtd_info *mtd, struct nand_chip *chip,
 			uint32_t offs, uint32_t len, uint8_t *buf, int page);
+	int (*read_pages)(struct mtd_info *mtd, struct nand_chip *chip,
+			uint8_t *buf, int page, int numpages);
 	int (*write_subpage)(struct mtd_info *mtd, struct nand_chip *chip,
 			uint32_t offset, uint32_t data_len,
 			const uint8_t *data_buf, int oob_required, int page);
@@ -874,6 +903,11 @@ nand_get_sdr_timings(const struct nand_data_interface *conf)
  *			  means the configuration should not be applied but
  *			  only checked.
  * @bbt:		[INTERN] bad block table pointer
+ * @bbt_map:		[INTERN] one bit per block, set for blocks which are not
+ *			good in @bbt
+ * @bbt_good:		[INTERN] numbers of the good blocks in ascending order,
+ *			used to translate skip-bad offsets; built on demand
+ * @bbt_ngood:		[INTERN] number of entries in @bbt_good
  * @bbt_td:		[REPLACEABLE] bad block table descriptor for flash
  *			lookup.
  * @bbt_md:		[REPLACEABLE] bad block table mirror descriptor
@@ -962,6 +996,9 @@ struct nand_chip {
 	struct nand_hw_control hwcontrol;
 
 	uint8_t *bbt;
+	unsigned long *bbt_map;
+	u32 *bbt_good;
+	unsigned int bbt_ngood;
 	struct nand_bbt_descr *bbt_td;
 	struct nand_bbt_descr *bbt_md;
 
@@ -1118,6 +1155,9 @@ int nand_default_bbt(struct mtd_info *mtd);
 int nand_markbad_bbt(struct mtd_info *mtd, loff_t offs);
 int nand_isreserved_bbt(struct mtd_info *mtd, loff_t offs);
 int nand_isbad_bbt(struct mtd_info *mtd, loff_t offs, int allowbbt);
+int nand_skip_bad_bbt(struct mtd_info *mtd, loff_t offs, loff_t skip,
+		      loff_t *phys);
+void nand_free_bbt(struct mtd_info *mtd);
 int nand_erase_nand(struct mtd_info *mtd, struct erase_info *instr,
 			   int allowbbt);
 int nand_do_read(struct mtd_info *mtd, loff_t from, size_t len,
@@ -1215,6 +1255,24 @@ static inline int onfi_get_sync_timing_mode(struct nand_chip *chip)
 		return ONFI_TIMING_MODE_UNKNOWN;
 	return le16_to_cpu(chip->onfi_params.src_sync_timing_mode);
 }
+
+/* return true if READ CACHE SEQUENTIAL and READ CACHE END are supported. */
+static inline bool onfi_has_read_cache(struct nand_chip *chip)
+{
+	return chip->onfi_version &&
+	       (le16_to_cpu(chip->onfi_params.opt_cmd) &
+		ONFI_OPT_CMD_READ_CACHE);
+}
+
+/* Two planes, read together and each selected with CHANGE READ COLUMN ENH. */
+static inline bool onfi_has_multi_plane_read(struct nand_chip *chip)
+{
+	return chip->onfi_version && chip->onfi_params.interleaved_bits == 1 &&
+	       (le16_to_cpu(chip->onfi_params.features) &
+		ONFI_FEATURE_MULTI_PLANE_READ) &&
+	       (le16_to_cpu(chip->onfi_params.opt_cmd) &
+		ONFI_OPT_CMD_RNDOUT_ENH);
+}
 #else
 static inline int onfi_feature(struct nand_chip *chip)
 {
@@ -1230,6 +1288,16 @@ static inline int onfi_get_sync_timing_mode(struct nand_chip *chip)
 {
 	return ONFI_TIMING_MODE_UNKNOWN;
 }
+
+static inline bool onfi_has_read_cache(struct nand_chip *chip)
+{
+	return false;
+}
+
+static inline bool onfi_has_multi_plane_read(struct nand_chip *chip)
+{
+	return false;
+}
 #endif
 
 int onfi_init_data_interface(struct nand_chip *chip,
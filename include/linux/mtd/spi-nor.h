@@ -255,6 +255,8 @@ enum spi_nor_option_flags {
  */
 struct flash_info;
 
+struct spi_mem_dirmap_desc;
+
 /*
  * TODO: Remove, once all users of spi_flash interface are moved to MTD
  *
@@ -286,6 +288,7 @@ struct flash_info;
  * @write_proto:	the SPI protocol for write operations
  * @reg_proto		the SPI protocol for read_reg/write_reg/erase operations
  * @cmd_buf:		used by the write_reg
+ * @rdesc:		direct mapping used by read(), if the SPI layer has one
  * @prepare:		[OPTIONAL] do some preparations for the
  *			read/write/erase/lock/unlock operations
  * @unprepare:		[OPTIONAL] do some post work after the
@@ -327,6 +330,9 @@ struct spi_nor {
 	bool			sst_write_second;
 	u32			flags;
 	u8			cmd_buf[SPI_NOR_MAX_CMD_SIZE];
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	struct spi_mem_dirmap_desc *rdesc;
+#endif
 
 	int (*prepare)(struct spi_nor *nor, enum spi_nor_ops ops);
 	void (*unprepare)(struct spi_nor *nor, enum spi_nor_ops ops);
@@ -437,4 +443,10 @@ struct spi_nor_hwcaps {
  */
 int spi_nor_scan(struct spi_nor *nor);
 
+/**
+ * spi_nor_remove() - release what spi_nor_scan() set up
+ * @nor:	the spi_nor structure
+ */
+void spi_nor_remove(struct spi_nor *nor);
+
 #endif
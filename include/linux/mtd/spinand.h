@@ -69,6 +69,18 @@
 		   SPI_MEM_OP_NO_DUMMY,					\
 		   SPI_MEM_OP_NO_DATA)
 
+#define SPINAND_PAGE_READ_CACHE_RANDOM_OP(addr)				\
+	SPI_MEM_OP(SPI_MEM_OP_CMD(0x31, 1),				\
+		   SPI_MEM_OP_ADDR(3, addr, 1),				\
+		   SPI_MEM_OP_NO_DUMMY,					\
+		   SPI_MEM_OP_NO_DATA)
+
+#define SPINAND_PAGE_READ_CACHE_LAST_OP					\
+	SPI_MEM_OP(SPI_MEM_OP_CMD(0x3f, 1),				\
+		   SPI_MEM_OP_NO_ADDR,					\
+		   SPI_MEM_OP_NO_DUMMY,					\
+		   SPI_MEM_OP_NO_DATA)
+
 #define SPINAND_PAGE_READ_FROM_CACHE_OP(fast, addr, ndummy, buf, len)	\
 	SPI_MEM_OP(SPI_MEM_OP_CMD(fast ? 0x0b : 0x03, 1),		\
 		   SPI_MEM_OP_ADDR(2, addr, 1),				\
@@ -246,6 +258,13 @@ struct spinand_ecc_info {
 };
 
 #define SPINAND_HAS_QE_BIT		BIT(0)
+/*
+ * The chip has PAGE READ CACHE RANDOM (31h) and PAGE READ CACHE LAST (3Fh):
+ * 31h moves the page loaded last into the cache and starts loading the next
+ * one while the host reads the cache. The status register then reports the
+ * ECC state of the page in the cache.
+ */
+#define SPINAND_HAS_READ_CACHE		BIT(1)
 
 /**
  * struct spinand_info - Structure used to describe SPI NAND chips
@@ -333,6 +352,8 @@ struct spinand_info {
  *		passed in spi_mem_op be DMA-able, so we can't based the bufs on
  *		the stack
  * @manufacturer: SPI NAND manufacturer information
+ * @rdesc: direct mapping of the cache used by read_cache, if the SPI layer
+ *	   has one
  * @priv: manufacturer private data
  */
 struct spinand_device {
@@ -363,6 +384,9 @@ struct spinand_device {
 	u8 *oobbuf;
 	u8 *scratchbuf;
 	const struct spinand_manufacturer *manufacturer;
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	struct spi_mem_dirmap_desc *rdesc;
+#endif
 	void *priv;
 };
 
@@ -74,6 +74,9 @@ struct bd_info;
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+#define MMC_CAP_CMDQ		BIT(17)	/* host has a command queue engine */
+#define MMC_CAP_CMD23		BIT(18)	/* host can send SET_BLOCK_COUNT */
+#define MMC_CAP_AUTO_CMD23	BIT(19)	/* host can send it on its own */
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -82,12 +85,17 @@ struct bd_info;
 
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_SCR_CMD23_SUPPORT	BIT(1)
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
 
 #define MMC_DATA_READ		1
 #define MMC_DATA_WRITE		2
+/* The host sends SET_BLOCK_COUNT before the command (MMC_CAP_AUTO_CMD23) */
+#define MMC_DATA_AUTO_CMD23	4
+/* The data is scattered over @sg (mmc_config.max_segs) */
+#define MMC_DATA_SG		8
 
 #define MMC_CMD_GO_IDLE_STATE		0
 #define MMC_CMD_SEND_OP_COND		1
@@ -212,6 +220,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -241,6 +250,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -302,6 +313,10 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 
 #define EXT_CSD_PARTITION_SETTING_COMPLETED	(1 << 0)
 
+#define EXT_CSD_CMDQ_MODE_ENABLED	BIT(0)
+#define EXT_CSD_CMDQ_DEPTH_MASK		GENMASK(4, 0)
+#define EXT_CSD_CMDQ_SUPPORTED		BIT(0)
+
 #define EXT_CSD_ENH_USR		(1 << 0)	/* user data area is enhanced */
 #define EXT_CSD_ENH_GP(x)	(1 << ((x)+1))	/* GP part (x+1) is enhanced */
 
@@ -398,16 +413,34 @@ struct mmc_cmd {
 	uint response[4];
 };
 
+struct blk_sg;
+
 struct mmc_data {
 	union {
 		char *dest;
 		const char *src; /* src buffers don't get written to */
+		const struct blk_sg *sg; /* with MMC_DATA_SG */
 	};
 	uint flags;
 	uint blocks;
 	uint blocksize;
+	uint sg_count;	/* segments in @sg */
+};
+
+/**
+ * struct mmc_cqe_task - A data transfer run by a command queue engine
+ *
+ * @blk_addr:	address on the card, in blocks or bytes as for CMD18
+ * @data:	memory buffer, direction and size of the transfer
+ */
+struct mmc_cqe_task {
+	uint blk_addr;
+	struct mmc_data data;
 };
 
+/* Largest transfer of a single command queue task, in blocks */
+#define MMC_CQE_MAX_BLOCKS	8192
+
 /* forward decl. */
 struct mmc;
 
@@ -505,6 +538,34 @@ struct dm_mmc_ops {
 	 * @return maximum number of blocks for this transfer
 	 */
 	int (*get_b_max)(struct udevice *dev, void *dst, lbaint_t blkcnt);
+
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	/**
+	 * cqe_enable() - Hand the bus to the command queue engine or back
+	 *
+	 * Only called for hosts with MMC_CAP_CMDQ, while command queueing
+	 * is enabled on the card.
+	 *
+	 * @dev:	Device to update
+	 * @enable:	true to run commands through the engine
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_enable)(struct udevice *dev, bool enable);
+
+	/**
+	 * cqe_request() - Run data tasks through the command queue engine
+	 *
+	 * Several tasks are kept queued on the card, which may complete
+	 * them in any order. This returns once all of them are done.
+	 *
+	 * @dev:	Device to use
+	 * @tasks:	Tasks to run, of at most MMC_CQE_MAX_BLOCKS each
+	 * @count:	Number of tasks
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_request)(struct udevice *dev, struct mmc_cqe_task *tasks,
+			   uint count);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -519,6 +580,9 @@ int dm_mmc_wait_dat0(struct udevice *dev, int state, int timeout_us);
 int dm_mmc_host_power_cycle(struct udevice *dev);
 int dm_mmc_deferred_probe(struct udevice *dev);
 int dm_mmc_get_b_max(struct udevice *dev, void *dst, lbaint_t blkcnt);
+int dm_mmc_cqe_enable(struct udevice *dev, bool enable);
+int dm_mmc_cqe_request(struct udevice *dev, struct mmc_cqe_task *tasks,
+		       uint count);
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
@@ -530,6 +594,8 @@ int mmc_set_enhanced_strobe(struct mmc *mmc);
 int mmc_host_power_cycle(struct mmc *mmc);
 int mmc_deferred_probe(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
+int mmc_cqe_enable(struct mmc *mmc, bool enable);
+int mmc_cqe_request(struct mmc *mmc, struct mmc_cqe_task *tasks, uint count);
 
 #else
 struct mmc_ops {
@@ -554,6 +620,7 @@ struct mmc_config {
 	uint f_min;
 	uint f_max;
 	uint b_max;
+	uint max_segs;	/* segments per scatter-gather transfer, 0 if none */
 	unsigned char part_type;
 };
 
@@ -622,6 +689,29 @@ static inline bool supports_uhs(uint caps)
  *
  * TODO struct mmc should be in mmc_private but it's hard to fix right now
  */
+/**
+ * struct mmc_stats - Statistics of the data transfers of an MMC device
+ *
+ * @read_cmds:		read commands sent
+ * @read_blocks:	blocks read
+ * @write_cmds:		write commands sent
+ * @write_blocks:	blocks written
+ * @set_block_count:	multiple-block transfers bounded by a CMD23 sent by
+ *			the core
+ * @auto_cmd23:		multiple-block transfers bounded by a CMD23 sent by
+ *			the host controller
+ * @stop_transmission:	open-ended multiple-block transfers, ended by CMD12
+ */
+struct mmc_stats {
+	ulong read_cmds;
+	ulong read_blocks;
+	ulong write_cmds;
+	ulong write_blocks;
+	ulong set_block_count;
+	ulong auto_cmd23;
+	ulong stop_transmission;
+};
+
 struct mmc {
 #if !CONFIG_IS_ENABLED(BLK)
 	struct list_head link;
@@ -651,6 +741,10 @@ struct mmc {
 	u8 part_config;
 	u8 gen_cmd6_time;	/* units: 10 ms */
 	u8 part_switch_time;	/* units: 10 ms */
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	u8 cmdq_depth;		/* 0 if the card has no command queue */
+#endif
+	bool cmd23_support;	/* card accepts SET_BLOCK_COUNT */
 	uint tran_speed;
 	uint legacy_speed; /* speed for the legacy mode provided by the card */
 	uint read_bl_len;
@@ -697,6 +791,9 @@ struct mmc {
 				  * accessing the boot partitions
 				  */
 	u32 quirks;
+#if CONFIG_IS_ENABLED(MMC_STATS)
+	struct mmc_stats stats;
+#endif
 };
 
 struct mmc_hwpart_conf {
@@ -140,6 +140,13 @@ enum eth_recv_flags {
  *	 indicate that the hardware receive FIFO is empty. If 0 is returned, the
  *	 network stack will not process the empty packet, but free_pkt() will be
  *	 called if supplied
+ * recv_batch: Like recv, but return up to "max" packets at once, in the order
+ *	       received, straight from the driver's buffers. Fill in "packets"
+ *	       and "lengths", and return the number of packets, 0 if there is
+ *	       none, or an error. A packet of length 0 is skipped, as with
+ *	       recv. The packets stay with the driver until free_pkt() has
+ *	       been called for each of them, in order. When supplied, this is
+ *	       used instead of recv, unless it returns -ENOSYS - optional
  * free_pkt: Give the driver an opportunity to manage its packet buffer memory
  *	     when the network stack is finished processing it. This will only be
  *	     called when no error was returned from recv - optional
@@ -160,6 +167,8 @@ struct eth_ops {
 	int (*start)(struct udevice *dev);
 	int (*send)(struct udevice *dev, void *packet, int length);
 	int (*recv)(struct udevice *dev, int flags, uchar **packetp);
+	int (*recv_batch)(struct udevice *dev, int flags, uchar **packets,
+			  int *lengths, int max);
 	int (*free_pkt)(struct udevice *dev, uchar *packet, int length);
 	void (*stop)(struct udevice *dev);
 	int (*mcast)(struct udevice *dev, const u8 *enetaddr, int join);
@@ -366,6 +375,7 @@ struct vlan_ethernet_hdr {
 #define PROT_NCSI	0x88f8		/* NC-SI control packets        */
 
 #define IPPROTO_ICMP	 1	/* Internet Control Message Protocol	*/
+#define IPPROTO_TCP	 6	/* Transmission Control Protocol	*/
 #define IPPROTO_UDP	17	/* User Datagram Protocol		*/
 
 /*
@@ -539,6 +549,7 @@ extern uchar		*net_tx_packet;		/* THE transmit packet */
 extern uchar		*net_rx_packets[PKTBUFSRX]; /* Receive packets */
 extern uchar		*net_rx_packet;		/* Current receive packet */
 extern int		net_rx_packet_len;	/* Current rx packet length */
+extern bool		net_rx_batch;	/* Processing a batch of packets */
 extern const u8		net_bcast_ethaddr[ARP_HLEN];	/* Ethernet broadcast address */
 extern const u8		net_null_ethaddr[ARP_HLEN];
 
@@ -551,7 +562,7 @@ extern int		net_restart_wrap;	/* Tried all network devices */
 
 enum proto_t {
 	BOOTP, RARP, ARP, TFTPGET, DHCP, PING, DNS, NFS, CDP, NETCONS, SNTP,
-	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL
+	TFTPSRV, TFTPPUT, LINKLOCAL, FASTBOOT, WOL, WGET
 };
 
 extern char	net_boot_file_name[1024];/* Boot File name */
@@ -699,6 +710,12 @@ int net_send_udp_packet(uchar *ether, struct in_addr dest, int dport,
 
 /* Processes a received packet */
 void net_process_received_packet(uchar *in_packet, int len);
+/*
+ * Processes @count received packets, in order, skipping empty ones. Handlers
+ * can tell from net_rx_batch that more packets may follow in the batch, and
+ * leave replies such as TCP ACKs until the end of it.
+ */
+void net_process_received_batch(uchar **packets, int *lengths, int count);
 
 #if defined(CONFIG_NETCONSOLE) && !defined(CONFIG_SPL_BUILD)
 void nc_start(void);
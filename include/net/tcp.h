@@ -0,0 +1,152 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Minimal TCP client, for loading files over the network
+ */
+
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include <net.h>
+
+/*
+ *	Internet Protocol (IP) + TCP header.
+ */
+struct ip_tcp_hdr {
+	u8		ip_hl_v;	/* header length and version	*/
+	u8		ip_tos;		/* type of service		*/
+	u16		ip_len;		/* total length			*/
+	u16		ip_id;		/* identification		*/
+	u16		ip_off;		/* fragment offset field	*/
+	u8		ip_ttl;		/* time to live			*/
+	u8		ip_p;		/* protocol			*/
+	u16		ip_sum;		/* checksum			*/
+	struct in_addr	ip_src;		/* Source IP address		*/
+	struct in_addr	ip_dst;		/* Destination IP address	*/
+	u16		tcp_src;	/* TCP source port		*/
+	u16		tcp_dst;	/* TCP destination port		*/
+	u32		tcp_seq;	/* Sequence number		*/
+	u32		tcp_ack;	/* Acknowledgement number	*/
+	u8		tcp_hlen;	/* Header length, in words << 4	*/
+	u8		tcp_flags;	/* Control flags		*/
+	u16		tcp_win;	/* Receive window		*/
+	u16		tcp_xsum;	/* Checksum			*/
+	u16		tcp_urg;	/* Urgent pointer		*/
+} __attribute__((packed));
+
+#define IP_TCP_HDR_SIZE		(sizeof(struct ip_tcp_hdr))
+#define TCP_HDR_SIZE		(IP_TCP_HDR_SIZE - IP_HDR_SIZE)
+
+#define TCP_FIN		0x01
+#define TCP_SYN		0x02
+#define TCP_RST		0x04
+#define TCP_PSH		0x08
+#define TCP_ACK		0x10
+
+/*
+ * Largest segment we receive, as sent in the MSS option of our SYN: what
+ * fits in the 1500-byte Ethernet MTU
+ */
+#define TCP_MSS		(1500 - IP_TCP_HDR_SIZE)
+
+/* What happened to the connection */
+enum tcp_event {
+	TCP_CONNECTED,		/* Handshake done, data can be sent */
+	TCP_CLOSED,		/* The remote has sent all its data */
+	TCP_FAILED,		/* Reset by the remote, or timed out */
+};
+
+/**
+ * tcp_rx_f - Called with the data of the connection, in order
+ *
+ * @data:	Data received
+ * @offset:	Offset of @data in the stream
+ * @len:	Number of bytes
+ */
+typedef void tcp_rx_f(const uchar *data, u32 offset, unsigned int len);
+
+/**
+ * tcp_event_f - Called when the state of the connection changes
+ *
+ * @event:	What happened
+ */
+typedef void tcp_event_f(enum tcp_event event);
+
+/**
+ * tcp_connect() - Open a connection
+ *
+ * Only one connection is handled at a time, so this drops any earlier one.
+ * The TCP code owns the net_loop() timeout handler until the connection is
+ * closed.
+ *
+ * @dest:	Address of the remote
+ * @dport:	Port of the remote
+ * @rx:		Called with the data received
+ * @event:	Called when the connection is up, closed or lost
+ * @return 0 if the SYN was sent, -ve on error
+ */
+int tcp_connect(struct in_addr dest, int dport, tcp_rx_f *rx,
+		tcp_event_f *event);
+
+/**
+ * tcp_write() - Send data on the connection
+ *
+ * The data is sent in one segment, which is sent again until acknowledged;
+ * only one can be outstanding.
+ *
+ * @data:	Data to send
+ * @len:	Number of bytes, at most TCP_MSS
+ * @return 0 if sent, -EBUSY if a segment is outstanding, -ve on error
+ */
+int tcp_write(const void *data, unsigned int len);
+
+/**
+ * tcp_close() - Close the connection
+ *
+ * Send a FIN and forget the connection: nothing more is received on it.
+ */
+void tcp_close(void);
+
+/**
+ * tcp_abort() - Drop the connection without telling the remote
+ *
+ * Called when net_loop() ends, so that segments still arriving for a load
+ * which was interrupted are not passed to its handlers by a later command.
+ */
+void tcp_abort(void);
+
+/**
+ * tcp_set_tcp_header() - Set up the IP and TCP headers of a segment
+ *
+ * The payload, if any, must already be in place after the headers. A SYN
+ * gets an MSS option, so must not carry data.
+ *
+ * @pkt:	Start of the IP header
+ * @dest:	Address of the remote
+ * @dport:	Port of the remote
+ * @sport:	Our port
+ * @payload_len: Number of bytes of data
+ * @action:	TCP flags
+ * @tcp_seq_num: Sequence number
+ * @tcp_ack_num: Acknowledgement number
+ * @return size of the IP and TCP headers
+ */
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 tcp_seq_num,
+		       u32 tcp_ack_num);
+
+/**
+ * tcp_receive() - Handle a TCP segment
+ *
+ * @tcp:	IP packet holding the segment
+ * @len:	Length of the IP packet
+ */
+void tcp_receive(struct ip_tcp_hdr *tcp, unsigned int len);
+
+/**
+ * tcp_rx_batch_end() - Called after a batch of packets has been handled
+ *
+ * Segments received in a batch are acknowledged together, at its end.
+ */
+void tcp_rx_batch_end(void);
+
+#endif /* __TCP_H__ */
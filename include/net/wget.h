@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Loading a file with an HTTP/1.1 GET request
+ */
+
+#ifndef __WGET_H__
+#define __WGET_H__
+
+/* Start a load, from net_loop() */
+void wget_start(void);
+
+#endif /* __WGET_H__ */
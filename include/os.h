@@ -141,6 +141,18 @@ void os_usleep(unsigned long usec);
  */
 uint64_t os_get_nsec(void);
 
+/**
+ * os_thread_create() - run a function in a new host thread
+ *
+ * The thread is detached; it ends when @func returns. Nothing that keeps
+ * U-Boot state (malloc(), the console, drivers) may be used from it.
+ *
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_create(void *(*func)(void *arg), void *arg);
+
 /**
  * Parse arguments and update sandbox state.
  *
@@ -20,6 +20,7 @@
  */
 
 #define SDHCI_DMA_ADDRESS	0x00
+#define SDHCI_ARGUMENT2		SDHCI_DMA_ADDRESS
 
 #define SDHCI_BLOCK_SIZE	0x04
 #define  SDHCI_MAKE_BLKSZ(dma, blksz) (((dma & 0x7) << 12) | (blksz & 0xFFF))
@@ -32,6 +33,7 @@
 #define  SDHCI_TRNS_DMA		BIT(0)
 #define  SDHCI_TRNS_BLK_CNT_EN	BIT(1)
 #define  SDHCI_TRNS_ACMD12	BIT(2)
+#define  SDHCI_TRNS_AUTO_CMD23	BIT(3)
 #define  SDHCI_TRNS_READ	BIT(4)
 #define  SDHCI_TRNS_MULTI	BIT(5)
 
@@ -121,6 +123,7 @@
 #define  SDHCI_INT_CARD_INSERT	BIT(6)
 #define  SDHCI_INT_CARD_REMOVE	BIT(7)
 #define  SDHCI_INT_CARD_INT	BIT(8)
+#define  SDHCI_INT_CQE		BIT(14)
 #define  SDHCI_INT_ERROR	BIT(15)
 #define  SDHCI_INT_TIMEOUT	BIT(16)
 #define  SDHCI_INT_CRC		BIT(17)
@@ -244,8 +247,12 @@
 #define SDHCI_QUIRK_BROKEN_HISPD_MODE	BIT(5)
 #define SDHCI_QUIRK_WAIT_SEND_CMD	(1 << 6)
 #define SDHCI_QUIRK_USE_WIDE8		(1 << 8)
+#define SDHCI_QUIRK_BROKEN_AUTO_CMD23	BIT(9)
+/* ADMA descriptors must not cross a 128MiB boundary */
+#define SDHCI_QUIRK_ADMA_128M_BOUNDARY	BIT(10)
 
 /* to make gcc happy */
+struct cqhci_host;
 struct sdhci_host;
 
 /*
@@ -278,8 +285,15 @@ struct sdhci_ops {
 #else
 #define ADMA_DESC_LEN	8
 #endif
-#define ADMA_TABLE_NO_ENTRIES (CONFIG_SYS_MMC_MAX_BLK_COUNT * \
-			       MMC_MAX_BLOCK_LEN) / ADMA_MAX_LEN
+/* Segments of a scatter-gather transfer */
+#define ADMA_MAX_SEGS	64
+/*
+ * Each segment may add a partial descriptor, and another one where it
+ * crosses a 128MiB boundary
+ */
+#define ADMA_TABLE_NO_ENTRIES \
+	(DIV_ROUND_UP(CONFIG_SYS_MMC_MAX_BLK_COUNT * MMC_MAX_BLOCK_LEN, \
+		      ADMA_MAX_LEN) + 2 * ADMA_MAX_SEGS)
 
 #define ADMA_TABLE_SZ (ADMA_TABLE_NO_ENTRIES * ADMA_DESC_LEN)
 
@@ -336,6 +350,9 @@ struct sdhci_host {
 	struct sdhci_adma_desc *adma_desc_table;
 	uint desc_slot;
 #endif
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+	struct cqhci_host *cqe;	/* command queue engine, if any */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -488,6 +505,39 @@ int add_sdhci(struct sdhci_host *host, u32 f_max, u32 f_min);
 #endif /* !CONFIG_BLK */
 
 void sdhci_set_uhs_timing(struct sdhci_host *host);
+
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+/**
+ * sdhci_cqe_enable() - Prepare the host for its command queue engine
+ *
+ * Selects ADMA2 and 512-byte blocks, as the engine expects, and enables the
+ * command queue interrupt status. Hosts call this from their CQHCI enable
+ * hook.
+ *
+ * @host:	SDHCI host structure
+ */
+void sdhci_cqe_enable(struct sdhci_host *host);
+
+/**
+ * sdhci_cqe_disable() - Restore the host after its command queue engine ran
+ *
+ * @host:	SDHCI host structure
+ */
+void sdhci_cqe_disable(struct sdhci_host *host);
+
+/**
+ * sdhci_cqe_error() - Check for an error while the command queue engine ran
+ *
+ * Clears any error interrupt status, so that hosts can use this as their
+ * CQHCI error hook.
+ *
+ * @host:	SDHCI host structure
+ * @return 0 if none, -ETIMEDOUT on a command or data timeout, -EIO on any
+ *	other error
+ */
+int sdhci_cqe_error(struct sdhci_host *host);
+#endif
+
 #ifdef CONFIG_DM_MMC
 /* Export the operations to drivers */
 int sdhci_probe(struct udevice *dev);
@@ -60,6 +60,26 @@ void sha1_update(sha1_context *ctx, const unsigned char *input,
  */
 void sha1_finish( sha1_context *ctx, unsigned char output[20] );
 
+/**
+ * \brief	   SHA-1 block function, may be replaced by the architecture
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   @blocks 64-byte blocks of input data
+ * \param blocks   number of blocks to process
+ */
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks);
+
+/**
+ * \brief	   Portable C SHA-1 block function
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   @blocks 64-byte blocks of input data
+ * \param blocks   number of blocks to process
+ */
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
 /**
  * \brief	   Output = SHA-1( input buffer )
  *
@@ -3,6 +3,7 @@
 
 #define SHA256_SUM_LEN	32
 #define SHA256_DER_LEN	19
+#define SHA224_SUM_LEN	28
 
 extern const uint8_t sha256_der_prefix[];
 
@@ -19,7 +20,22 @@ void sha256_starts(sha256_context * ctx);
 void sha256_update(sha256_context *ctx, const uint8_t *input, uint32_t length);
 void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 
+/*
+ * Process @blocks 64-byte blocks of @data. sha256_process() may be replaced by
+ * an architecture specific version; sha256_process_generic() is plain C.
+ */
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+void sha256_process_generic(sha256_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/* SHA-224 shares the SHA-256 context and sha256_update() */
+void sha224_starts(sha256_context *ctx);
+void sha224_finish(sha256_context *ctx, uint8_t digest[SHA224_SUM_LEN]);
+void sha224_csum_wd(const unsigned char *input, unsigned int ilen,
+		    unsigned char *output, unsigned int chunk_sz);
+
 #endif /* _SHA256_H */
@@ -0,0 +1,23 @@
+#ifndef _SHA512_H
+#define _SHA512_H
+
+#define SHA512_SUM_LEN		64
+#define SHA512_BLOCK_SIZE	128
+
+/* Reset watchdog each time we process this many bytes */
+#define CHUNKSZ_SHA512	(64 * 1024)
+
+typedef struct {
+	uint64_t total[2];
+	uint64_t state[8];
+	uint8_t buffer[SHA512_BLOCK_SIZE];
+} sha512_context;
+
+void sha512_starts(sha512_context *ctx);
+void sha512_update(sha512_context *ctx, const uint8_t *input, uint32_t length);
+void sha512_finish(sha512_context *ctx, uint8_t digest[SHA512_SUM_LEN]);
+
+void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
+		    unsigned char *output, unsigned int chunk_sz);
+
+#endif /* _SHA512_H */
@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Running self-contained jobs on a secondary CPU core
+ */
+
+#ifndef __WORKER_H
+#define __WORKER_H
+
+#include <hash.h>
+#include <linux/types.h>
+
+/**
+ * struct worker_job - a job for the worker core
+ *
+ * A job runs with nothing but its own data: it must not use malloc(),
+ * the console, the watchdog or any driver, since all of these belong to
+ * the CPU running U-Boot. The job and everything it points to must stay
+ * valid until worker_wait() returns.
+ *
+ * @run:	Function to run, returns 0 on success or -ve error
+ * @ret:	Return value of @run, valid once the job is done
+ * @done:	Set by the worker when the job is finished
+ */
+struct worker_job {
+	int (*run)(struct worker_job *job);
+	int ret;
+	u32 done;
+};
+
+/**
+ * struct worker_hash_job - hash one buffer
+ *
+ * @job:	Job to submit
+ * @algo:	Hash algorithm
+ * @buf:	Data to hash
+ * @len:	Number of bytes
+ * @value:	Returns the digest
+ * @value_len:	Size of the digest in bytes
+ */
+struct worker_hash_job {
+	struct worker_job job;
+	int algo;
+	const void *buf;
+	ulong len;
+	u8 value[HASH_MAX_DIGEST_SIZE];
+	int value_len;
+};
+
+/**
+ * struct worker_decomp_job - decompress one image
+ *
+ * @job:	Job to submit
+ * @comp:	Compression type (IH_COMP_...)
+ * @buf:	Compressed data
+ * @len:	Number of bytes of compressed data
+ * @load:	Destination for the uncompressed data
+ * @unc_len:	Space available at @load
+ * @load_len:	Returns the number of bytes written to @load
+ */
+struct worker_decomp_job {
+	struct worker_job job;
+	int comp;
+	const void *buf;
+	ulong len;
+	void *load;
+	ulong unc_len;
+	ulong load_len;
+};
+
+#if CONFIG_IS_ENABLED(CPU_WORKER) && !defined(USE_HOSTCC)
+
+/**
+ * worker_submit() - queue a job for the worker core
+ *
+ * The worker core is started on first use. If it cannot be started or the
+ * mailbox is full, the job is run straight away on the calling CPU, so a
+ * submitted job always completes.
+ *
+ * @job:	Job to run
+ */
+void worker_submit(struct worker_job *job);
+
+/**
+ * worker_wait() - wait for a job to finish
+ *
+ * @job:	Job submitted with worker_submit()
+ * @return return value of the job
+ */
+int worker_wait(struct worker_job *job);
+
+/**
+ * worker_stop() - finish all jobs and hand the worker core back
+ *
+ * This must be called before booting an OS, which expects the secondary
+ * cores to be powered off. A later worker_submit() starts the core again.
+ */
+void worker_stop(void);
+
+/**
+ * worker_hash_init() - set up a job to hash a buffer
+ *
+ * @hj:		Job to set up
+ * @algo_name:	Hash algorithm name, e.g. "sha256"
+ * @buf:	Data to hash
+ * @len:	Number of bytes
+ * @return 0 if OK, -EPROTONOSUPPORT if the algorithm cannot be used
+ */
+int worker_hash_init(struct worker_hash_job *hj, const char *algo_name,
+		     const void *buf, ulong len);
+
+/**
+ * worker_decomp_init() - set up a job to decompress an image
+ *
+ * Only decompressors that need no memory allocation can run on the worker;
+ * for other types the caller should decompress the image itself.
+ *
+ * @dj:		Job to set up
+ * @comp:	Compression type (IH_COMP_...)
+ * @load:	Destination for the uncompressed data
+ * @unc_len:	Space available at @load
+ * @buf:	Compressed data
+ * @len:	Number of bytes of compressed data
+ * @return 0 if OK, -ENOSYS if @comp cannot be used
+ */
+int worker_decomp_init(struct worker_decomp_job *dj, int comp, void *load,
+		       ulong unc_len, const void *buf, ulong len);
+
+/* Implemented by the architecture */
+
+/**
+ * worker_main() - run jobs until asked to stop
+ *
+ * This is called on the worker core once the architecture code has set it
+ * up. It returns when worker_stop() is called.
+ */
+void worker_main(void);
+
+/**
+ * worker_arch_start() - start the worker core running worker_main()
+ *
+ * @return 0 if OK, -ve on error
+ */
+int worker_arch_start(void);
+
+/**
+ * worker_arch_stop() - wait for the worker core to go away
+ *
+ * This is called once worker_main() has returned on the worker core.
+ */
+void worker_arch_stop(void);
+
+/**
+ * worker_arch_kick() - wake a CPU sitting in worker_arch_wait()
+ */
+void worker_arch_kick(void);
+
+/**
+ * worker_arch_wait() - wait for worker_arch_kick(), or some other reason
+ *
+ * This may return early, so the caller must check what it is waiting for.
+ */
+void worker_arch_wait(void);
+
+#else
+
+static inline void worker_stop(void) {}
+
+#endif /* CPU_WORKER */
+
+#endif /* __WORKER_H */
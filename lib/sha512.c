@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * FIPS-180-2 compliant SHA-512 implementation
+ *
+ * Based on lib/sha256.c
+ */
+
+#ifndef USE_HOSTCC
+#include <common.h>
+#include <linux/string.h>
+#else
+#include <string.h>
+#endif /* USE_HOSTCC */
+#include <watchdog.h>
+#include <u-boot/sha512.h>
+
+#define GET_UINT64_BE(n, b, i) {			\
+	(n) = ((uint64_t)(b)[(i)    ] << 56)		\
+	    | ((uint64_t)(b)[(i) + 1] << 48)		\
+	    | ((uint64_t)(b)[(i) + 2] << 40)		\
+	    | ((uint64_t)(b)[(i) + 3] << 32)		\
+	    | ((uint64_t)(b)[(i) + 4] << 24)		\
+	    | ((uint64_t)(b)[(i) + 5] << 16)		\
+	    | ((uint64_t)(b)[(i) + 6] <<  8)		\
+	    | ((uint64_t)(b)[(i) + 7]      );		\
+}
+
+#define PUT_UINT64_BE(n, b, i) {			\
+	(b)[(i)    ] = (uint8_t)((n) >> 56);		\
+	(b)[(i) + 1] = (uint8_t)((n) >> 48);		\
+	(b)[(i) + 2] = (uint8_t)((n) >> 40);		\
+	(b)[(i) + 3] = (uint8_t)((n) >> 32);		\
+	(b)[(i) + 4] = (uint8_t)((n) >> 24);		\
+	(b)[(i) + 5] = (uint8_t)((n) >> 16);		\
+	(b)[(i) + 6] = (uint8_t)((n) >>  8);		\
+	(b)[(i) + 7] = (uint8_t)((n)      );		\
+}
+
+static const uint64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+void sha512_starts(sha512_context *ctx)
+{
+	ctx->total[0] = 0;
+	ctx->total[1] = 0;
+
+	ctx->state[0] = 0x6a09e667f3bcc908ULL;
+	ctx->state[1] = 0xbb67ae8584caa73bULL;
+	ctx->state[2] = 0x3c6ef372fe94f82bULL;
+	ctx->state[3] = 0xa54ff53a5f1d36f1ULL;
+	ctx->state[4] = 0x510e527fade682d1ULL;
+	ctx->state[5] = 0x9b05688c2b3e6c1fULL;
+	ctx->state[6] = 0x1f83d9abfb41bd6bULL;
+	ctx->state[7] = 0x5be0cd19137e2179ULL;
+}
+
+#define ROTR(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+#define S0(x)	(ROTR(x, 1) ^ ROTR(x, 8) ^ ((x) >> 7))
+#define S1(x)	(ROTR(x, 19) ^ ROTR(x, 61) ^ ((x) >> 6))
+#define S2(x)	(ROTR(x, 28) ^ ROTR(x, 34) ^ ROTR(x, 39))
+#define S3(x)	(ROTR(x, 14) ^ ROTR(x, 18) ^ ROTR(x, 41))
+
+#define F0(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define F1(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+
+static void sha512_process(sha512_context *ctx,
+			   const uint8_t data[SHA512_BLOCK_SIZE])
+{
+	uint64_t temp1, temp2;
+	uint64_t W[80];
+	uint64_t A, B, C, D, E, F, G, H;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		GET_UINT64_BE(W[i], data, i * 8);
+
+	for (; i < 80; i++)
+		W[i] = S1(W[i - 2]) + W[i - 7] + S0(W[i - 15]) + W[i - 16];
+
+	A = ctx->state[0];
+	B = ctx->state[1];
+	C = ctx->state[2];
+	D = ctx->state[3];
+	E = ctx->state[4];
+	F = ctx->state[5];
+	G = ctx->state[6];
+	H = ctx->state[7];
+
+	for (i = 0; i < 80; i++) {
+		temp1 = H + S3(E) + F1(E, F, G) + sha512_k[i] + W[i];
+		temp2 = S2(A) + F0(A, B, C);
+		H = G;
+		G = F;
+		F = E;
+		E = D + temp1;
+		D = C;
+		C = B;
+		B = A;
+		A = temp1 + temp2;
+	}
+
+	ctx->state[0] += A;
+	ctx->state[1] += B;
+	ctx->state[2] += C;
+	ctx->state[3] += D;
+	ctx->state[4] += E;
+	ctx->state[5] += F;
+	ctx->state[6] += G;
+	ctx->state[7] += H;
+}
+
+void sha512_update(sha512_context *ctx, const uint8_t *input, uint32_t length)
+{
+	uint32_t left, fill;
+
+	if (!length)
+		return;
+
+	left = ctx->total[0] & (SHA512_BLOCK_SIZE - 1);
+	fill = SHA512_BLOCK_SIZE - left;
+
+	ctx->total[0] += length;
+	if (ctx->total[0] < length)
+		ctx->total[1]++;
+
+	if (left && length >= fill) {
+		memcpy(ctx->buffer + left, input, fill);
+		sha512_process(ctx, ctx->buffer);
+		length -= fill;
+		input += fill;
+		left = 0;
+	}
+
+	while (length >= SHA512_BLOCK_SIZE) {
+		sha512_process(ctx, input);
+		length -= SHA512_BLOCK_SIZE;
+		input += SHA512_BLOCK_SIZE;
+	}
+
+	if (length)
+		memcpy(ctx->buffer + left, input, length);
+}
+
+static const uint8_t sha512_padding[SHA512_BLOCK_SIZE] = {
+	0x80,
+};
+
+void sha512_finish(sha512_context *ctx, uint8_t digest[SHA512_SUM_LEN])
+{
+	uint32_t last, padn;
+	uint64_t high, low;
+	uint8_t msglen[16];
+	int i;
+
+	high = (ctx->total[0] >> 61) | (ctx->total[1] << 3);
+	low = ctx->total[0] << 3;
+
+	PUT_UINT64_BE(high, msglen, 0);
+	PUT_UINT64_BE(low, msglen, 8);
+
+	last = ctx->total[0] & (SHA512_BLOCK_SIZE - 1);
+	padn = (last < 112) ? (112 - last) : (240 - last);
+
+	sha512_update(ctx, sha512_padding, padn);
+	sha512_update(ctx, msglen, 16);
+
+	for (i = 0; i < 8; i++)
+		PUT_UINT64_BE(ctx->state[i], digest, i * 8);
+}
+
+/*
+ * Output = SHA-512( input buffer ). Trigger the watchdog every 'chunk_sz'
+ * bytes of input processed.
+ */
+void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
+		    unsigned char *output, unsigned int chunk_sz)
+{
+	sha512_context ctx;
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+	const unsigned char *end;
+	unsigned char *curr;
+	int chunk;
+#endif
+
+	sha512_starts(&ctx);
+
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+	curr = (unsigned char *)input;
+	end = input + ilen;
+	while (curr < end) {
+		chunk = end - curr;
+		if (chunk > chunk_sz)
+			chunk = chunk_sz;
+		sha512_update(&ctx, curr, chunk);
+		curr += chunk;
+		WATCHDOG_RESET();
+	}
+#else
+	sha512_update(&ctx, input, ilen);
+#endif
+
+	sha512_finish(&ctx, output);
+}
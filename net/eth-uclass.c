@@ -19,6 +19,9 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Most packets taken from a driver's recv_batch() at once */
+#define ETH_RX_BATCH	8
+
 /**
  * struct eth_device_priv - private structure for each Ethernet device
  *
@@ -363,6 +366,36 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+/*
+ * Take packets from a driver with recv_batch(), which hands them over
+ * straight from its receive ring. They are handed back once the whole batch
+ * has been processed.
+ */
+static int eth_rx_batch(struct udevice *current)
+{
+	struct eth_ops *ops = eth_get_ops(current);
+	uchar *packets[ETH_RX_BATCH];
+	int lengths[ETH_RX_BATCH];
+	int flags;
+	int ret;
+	int i, n;
+
+	/* Process up to 32 packets at one time */
+	flags = ETH_RECV_CHECK_DEVICE;
+	for (n = 0; n < 32; n += ret) {
+		ret = ops->recv_batch(current, flags, packets, lengths,
+				      ETH_RX_BATCH);
+		flags = 0;
+		if (ret <= 0)
+			break;
+		net_process_received_batch(packets, lengths, ret);
+		for (i = 0; ops->free_pkt && i < ret; i++)
+			ops->free_pkt(current, packets[i], lengths[i]);
+	}
+
+	return ret;
+}
+
 int eth_rx(void)
 {
 	struct udevice *current;
@@ -378,6 +411,12 @@ int eth_rx(void)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
+	if (eth_get_ops(current)->recv_batch) {
+		ret = eth_rx_batch(current);
+		if (ret != -ENOSYS)
+			goto out;
+	}
+
 	/* Process up to 32 packets at one time */
 	flags = ETH_RECV_CHECK_DEVICE;
 	for (i = 0; i < 32; i++) {
@@ -390,6 +429,7 @@ int eth_rx(void)
 		if (ret <= 0)
 			break;
 	}
+out:
 	if (ret == -EAGAIN)
 		ret = 0;
 	if (ret < 0) {
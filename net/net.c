@@ -94,11 +94,14 @@
 #include <env.h>
 #include <env_internal.h>
 #include <errno.h>
+#include <fit_stream.h>
 #include <image.h>
 #include <log.h>
 #include <net.h>
 #include <net/fastboot.h>
+#include <net/tcp.h>
 #include <net/tftp.h>
+#include <net/wget.h>
 #if defined(CONFIG_CMD_PCAP)
 #include <net/pcap.h>
 #endif
@@ -152,6 +155,8 @@ struct in_addr	net_server_ip;
 uchar *net_rx_packet;
 /* Current rx packet length */
 int		net_rx_packet_len;
+/* Set while the packets of a batch are being processed */
+bool		net_rx_batch;
 /* IP packet ID */
 static unsigned	net_ip_id;
 /* Ethernet bcast address */
@@ -371,6 +376,9 @@ static void net_clear_handlers(void)
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+#if defined(CONFIG_PROT_TCP)
+	tcp_abort();
+#endif
 }
 
 void net_init(void)
@@ -504,6 +512,11 @@ restart:
 			nfs_start();
 			break;
 #endif
+#if defined(CONFIG_CMD_WGET)
+		case WGET:
+			wget_start();
+			break;
+#endif
 #if defined(CONFIG_CMD_CDP)
 		case CDP:
 			cdp_start();
@@ -635,6 +648,7 @@ restart:
 
 		case NETLOOP_SUCCESS:
 			net_cleanup_loop();
+			fit_stream_end(net_boot_file_size);
 			if (net_boot_file_size > 0) {
 				printf("Bytes transferred = %d (%x hex)\n",
 				       net_boot_file_size, net_boot_file_size);
@@ -666,6 +680,8 @@ restart:
 	}
 
 done:
+	/* Stop watching a load that failed or was interrupted */
+	fit_stream_abort();
 #ifdef CONFIG_USB_KEYBOARD
 	net_busy_flag = 0;
 #endif
@@ -851,6 +867,14 @@ int net_send_ip_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 				   payload_len);
 		pkt_hdr_size = eth_hdr_size + IP_UDP_HDR_SIZE;
 		break;
+#if defined(CONFIG_PROT_TCP)
+	case IPPROTO_TCP:
+		pkt_hdr_size = eth_hdr_size +
+			tcp_set_tcp_header(pkt + eth_hdr_size, dest, dport,
+					   sport, payload_len, action,
+					   tcp_seq_num, tcp_ack_num);
+		break;
+#endif
 	default:
 		return -EINVAL;
 	}
@@ -872,7 +896,7 @@ int net_send_ip_packet(uchar *ether, struct in_addr dest, int dport, int sport,
 		arp_request();
 		return 1;	/* waiting */
 	} else {
-		debug_cond(DEBUG_DEV_PKT, "sending UDP to %pI4/%pM\n",
+		debug_cond(DEBUG_DEV_PKT, "sending IP to %pI4/%pM\n",
 			   &dest, ether);
 		net_send_packet(net_tx_packet, pkt_hdr_size + payload_len);
 		return 0;	/* transmitted */
@@ -1257,6 +1281,11 @@ void net_process_received_packet(uchar *in_packet, int len)
 		if (ip->ip_p == IPPROTO_ICMP) {
 			receive_icmp(ip, len, src_ip, et);
 			return;
+#if defined(CONFIG_PROT_TCP)
+		} else if (ip->ip_p == IPPROTO_TCP) {
+			tcp_receive((struct ip_tcp_hdr *)ip, len);
+			return;
+#endif
 		} else if (ip->ip_p != IPPROTO_UDP) {	/* Only UDP packets */
 			return;
 		}
@@ -1328,6 +1357,23 @@ void net_process_received_packet(uchar *in_packet, int len)
 	}
 }
 
+void net_process_received_batch(uchar **packets, int *lengths, int count)
+{
+	int i;
+
+	net_rx_batch = true;
+	for (i = 0; i < count; i++) {
+		/* Like recv(), a zero length means there is nothing to see */
+		if (lengths[i] > 0)
+			net_process_received_packet(packets[i], lengths[i]);
+	}
+	net_rx_batch = false;
+
+#if defined(CONFIG_PROT_TCP)
+	tcp_rx_batch_end();
+#endif
+}
+
 /**********************************************************************/
 
 static int net_check_prereq(enum proto_t protocol)
@@ -1360,6 +1406,9 @@ static int net_check_prereq(enum proto_t protocol)
 #endif
 #if defined(CONFIG_CMD_NFS)
 	case NFS:
+#endif
+#if defined(CONFIG_CMD_WGET)
+	case WGET:
 #endif
 		/* Fall through */
 	case TFTPGET:
@@ -28,6 +28,8 @@
 
 #include <common.h>
 #include <command.h>
+#include <env.h>
+#include <fit_stream.h>
 #include <flash.h>
 #include <image.h>
 #include <log.h>
@@ -49,12 +51,34 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Most READ requests outstanding at once */
+#define NFS_MAX_WINDOWSIZE	32
+
 static int fs_mounted;
 static unsigned long rpc_id;
 static int nfs_offset = -1;
 static int nfs_len;
 static ulong nfs_timeout = NFS_TIMEOUT;
 
+/*
+ * READ requests are pipelined: up to nfs_windowsize blocks of nfs_len bytes
+ * are asked for at once, from nfs_offset, the first block not received
+ * completely. Each block has a slot, which keeps the RPC id of its request
+ * so that replies can be matched whatever their order; a short read leaves
+ * the slot asking for the rest of its block.
+ */
+struct nfs_read_slot {
+	unsigned long id;	/* RPC id of the request last sent */
+	int offset;		/* What is still wanted of the block */
+	int len;
+	bool done;
+};
+
+static struct nfs_read_slot nfs_read_slots[NFS_MAX_WINDOWSIZE];
+static int nfs_windowsize;
+static int nfs_read_next;	/* Offset of the next block to ask for */
+static int nfs_read_end;	/* Size of the file, -1 until a read hits it */
+
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
 static int filefh3_length;	/* (variable) length of filefh when NFSv3 */
@@ -109,6 +133,7 @@ static inline int store_block(uchar *src, unsigned offset, unsigned len)
 		void *ptr = map_sysmem(image_load_addr + offset, len);
 
 		memcpy(ptr, src, len);
+		fit_stream_data(ptr, len);
 		unmap_sysmem(ptr);
 	}
 
@@ -175,7 +200,8 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static unsigned long rpc_req(int rpc_prog, int rpc_proc, uint32_t *data,
+			     int datalen)
 {
 	struct rpc_t rpc_pkt;
 	unsigned long id;
@@ -220,6 +246,8 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 
 	net_send_udp_packet(net_server_ethaddr, nfs_server_ip, sport,
 			    nfs_our_port, pktlen);
+
+	return id;
 }
 
 /**************************************************************************
@@ -361,7 +389,7 @@ static void nfs_lookup_req(char *fname)
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static unsigned long nfs_read_req(int offset, int readlen)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -388,7 +416,63 @@ static void nfs_read_req(int offset, int readlen)
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	return rpc_req(PROG_NFS, NFS_READ, data, len);
+}
+
+static struct nfs_read_slot *nfs_read_slot(int block)
+{
+	return &nfs_read_slots[block / nfs_len % nfs_windowsize];
+}
+
+/* Ask for new blocks until the window is full or the end of file is hit */
+static void nfs_read_fill(void)
+{
+	struct nfs_read_slot *slot;
+
+	while (nfs_read_next < nfs_offset + nfs_windowsize * nfs_len &&
+	       (nfs_read_end < 0 || nfs_read_next < nfs_read_end)) {
+		slot = nfs_read_slot(nfs_read_next);
+		slot->offset = nfs_read_next;
+		slot->len = nfs_len;
+		slot->done = false;
+		slot->id = nfs_read_req(slot->offset, slot->len);
+		nfs_read_next += nfs_len;
+	}
+}
+
+/* Send again the requests not answered yet, then fill the window */
+static void nfs_read_send(void)
+{
+	struct nfs_read_slot *slot;
+	int block;
+
+	for (block = nfs_offset; block < nfs_read_next; block += nfs_len) {
+		slot = nfs_read_slot(block);
+		if (!slot->done)
+			slot->id = nfs_read_req(slot->offset, slot->len);
+	}
+	nfs_read_fill();
+}
+
+/* Move nfs_offset over the blocks received completely */
+static void nfs_read_advance(void)
+{
+	int start = nfs_offset;
+
+	while (nfs_offset < nfs_read_next && nfs_read_slot(nfs_offset)->done) {
+		if ((nfs_offset != 0) && !((nfs_offset) %
+				(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
+			puts("\n\t ");
+		if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
+			putc('#');
+		nfs_offset += nfs_len;
+	}
+
+	/* Blocks stored out of order only count as landed now */
+	if (nfs_offset - start > nfs_len)
+		fit_stream_data(map_sysmem(image_load_addr, 0),
+				min((ulong)net_boot_file_size,
+				    (ulong)nfs_offset));
 }
 
 /**************************************************************************
@@ -421,7 +505,7 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		nfs_read_send();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
@@ -664,9 +748,13 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+static int nfs_read_reply(uchar *pkt, unsigned len,
+			  struct nfs_read_slot **slotp)
 {
 	struct rpc_t rpc_pkt;
+	struct nfs_read_slot *slot = NULL;
+	unsigned long id;
+	int block;
 	int rlen;
 	uchar *data_ptr;
 
@@ -674,10 +762,18 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 
 	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
 
-	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
-		return -NFS_RPC_ERR;
-	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
+	/* Find the request this answers; drop replies to ones sent again */
+	id = ntohl(rpc_pkt.u.reply.id);
+	for (block = nfs_offset; block < nfs_read_next; block += nfs_len) {
+		if (!nfs_read_slot(block)->done &&
+		    nfs_read_slot(block)->id == id) {
+			slot = nfs_read_slot(block);
+			break;
+		}
+	}
+	if (!slot)
 		return -NFS_RPC_DROP;
+	*slotp = slot;
 
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
@@ -690,12 +786,6 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
 		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
@@ -716,7 +806,7 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 	if (((uchar *)&(rpc_pkt.u.reply.data[0]) - (uchar *)(&rpc_pkt) + rlen) > len)
 			return -9999;
 
-	if (store_block(data_ptr, nfs_offset, rlen))
+	if (store_block(data_ptr, slot->offset, rlen))
 			return -9999;
 
 	return rlen;
@@ -742,6 +832,7 @@ static void nfs_timeout_handler(void)
 static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			unsigned src, unsigned len)
 {
+	struct nfs_read_slot *slot;
 	int rlen;
 	int reply;
 
@@ -816,6 +907,8 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			nfs_state = STATE_READ_REQ;
 			nfs_offset = 0;
 			nfs_len = NFS_READ_SIZE;
+			nfs_read_next = 0;
+			nfs_read_end = -1;
 			nfs_send();
 		}
 		break;
@@ -839,22 +932,35 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		break;
 
 	case STATE_READ_REQ:
-		rlen = nfs_read_reply(pkt, len);
+		rlen = nfs_read_reply(pkt, len, &slot);
 		if (rlen == -NFS_RPC_DROP)
 			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
+		if (rlen > 0 && rlen < slot->len) {
+			/* Short read: ask for the rest of the block */
+			slot->offset += rlen;
+			slot->len -= rlen;
+			slot->id = nfs_read_req(slot->offset, slot->len);
+		} else if (rlen >= 0) {
+			slot->done = true;
+			/* Nothing read: this is the end of the file */
+			if (!rlen && (nfs_read_end < 0 ||
+				      slot->offset < nfs_read_end))
+				nfs_read_end = slot->offset;
+			nfs_read_advance();
+			if (nfs_read_end < 0 || nfs_offset < nfs_read_end) {
+				nfs_read_fill();
+				break;
+			}
+			nfs_download_state = NETLOOP_SUCCESS;
+			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
+			debug("NFS READ error (%d)\n", rlen);
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		}
@@ -865,6 +971,9 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 void nfs_start(void)
 {
+	char *ep;
+	long window;
+
 	debug("%s\n", __func__);
 	nfs_download_state = NETLOOP_FAIL;
 
@@ -916,10 +1025,23 @@ void nfs_start(void)
 		print_size(net_boot_file_expected_size_in_blocks << 9, "");
 	}
 	printf("\nLoad address: 0x%lx\nLoading: *\b", image_load_addr);
+	fit_stream_begin(map_sysmem(image_load_addr, 0), 0);
 
 	net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
 	net_set_udp_handler(nfs_handler);
 
+	ep = env_get("nfswindowsize");
+	window = ep ? simple_strtol(ep, NULL, 10) : CONFIG_NFS_WINDOWSIZE;
+	/* 0 or less turns the window off */
+	if (window < 1) {
+		window = 1;
+	} else if (window > NFS_MAX_WINDOWSIZE) {
+		printf("NFS window size (%ld) out of range, set to %d\n",
+		       window, NFS_MAX_WINDOWSIZE);
+		window = NFS_MAX_WINDOWSIZE;
+	}
+	nfs_windowsize = window;
+
 	nfs_timeout_count = 0;
 	nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 
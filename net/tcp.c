@@ -0,0 +1,368 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Minimal TCP client
+ *
+ * One connection at a time, actively opened. Data is received in order
+ * only: without SACK, a segment that arrives after a gap is dropped and a
+ * duplicate ACK asks for the missing one. ACKs are delayed until every
+ * second segment, or the end of the batch the driver handed over, or
+ * TCP_DELACK_MS. What we send is small and goes one segment at a time,
+ * sent again until acknowledged.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <net.h>
+#include <time.h>
+#include <net/tcp.h>
+#include "net_rand.h"
+
+/* Milliseconds between runs of the timer */
+#define TCP_TICK_MS		10
+/* Longest an ACK is held back */
+#define TCP_DELACK_MS		20
+/* Retransmission timeout, doubled on each retry */
+#define TCP_RTO_MS		1000
+#define TCP_RETRIES		6
+/* Give up if nothing is heard from the remote for this long */
+#define TCP_IDLE_MS		30000
+
+#define TCP_OPT_MSS		2
+
+#define SEQ_LT(a, b)		((s32)((a) - (b)) < 0)
+#define SEQ_LEQ(a, b)		((s32)((a) - (b)) <= 0)
+
+enum tcp_state {
+	TCP_STATE_CLOSED,
+	TCP_STATE_SYN_SENT,
+	TCP_STATE_ESTABLISHED,
+	TCP_STATE_CLOSE_WAIT,	/* The remote has sent its FIN */
+};
+
+static enum tcp_state tcp_state;
+static struct in_addr tcp_remote_ip;
+static uchar tcp_remote_ethaddr[ARP_HLEN];
+static int tcp_remote_port;
+static int tcp_our_port;
+static tcp_rx_f *tcp_rx_handler;
+static tcp_event_f *tcp_event_handler;
+
+/* First unacknowledged and next sequence numbers we send */
+static u32 tcp_snd_una;
+static u32 tcp_snd_nxt;
+/* Initial and next sequence numbers of the remote */
+static u32 tcp_irs;
+static u32 tcp_rcv_nxt;
+
+/* The outstanding segment, sent again until acknowledged */
+static uchar tcp_tx_data[TCP_MSS];
+static unsigned int tcp_tx_len;
+static u8 tcp_tx_flags;
+static u32 tcp_tx_seq;
+static bool tcp_tx_pending;
+static ulong tcp_tx_time;
+static ulong tcp_rto;
+static int tcp_retries;
+
+/* Segments received but not acknowledged yet, and when the first came */
+static int tcp_ack_pending;
+static ulong tcp_ack_time;
+/* When we last heard from the remote */
+static ulong tcp_rx_time;
+
+/* Checksum of the segment after the IP header of @tcp, @len bytes long */
+static uint tcp_checksum(struct ip_tcp_hdr *tcp, unsigned int len)
+{
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		u8 zero;
+		u8 proto;
+		u16 len;
+	} __attribute__((packed)) pseudo;
+
+	net_copy_ip(&pseudo.src, &tcp->ip_src);
+	net_copy_ip(&pseudo.dst, &tcp->ip_dst);
+	pseudo.zero = 0;
+	pseudo.proto = IPPROTO_TCP;
+	pseudo.len = htons(len);
+
+	return add_ip_checksums(sizeof(pseudo),
+				compute_ip_checksum(&pseudo, sizeof(pseudo)),
+				compute_ip_checksum(&tcp->tcp_src, len));
+}
+
+int tcp_set_tcp_header(uchar *pkt, struct in_addr dest, int dport, int sport,
+		       int payload_len, u8 action, u32 tcp_seq_num,
+		       u32 tcp_ack_num)
+{
+	struct ip_tcp_hdr *tcp = (struct ip_tcp_hdr *)pkt;
+	int hdr_size = IP_TCP_HDR_SIZE;
+
+	if (action & TCP_SYN) {
+		uchar *opt = pkt + IP_TCP_HDR_SIZE;
+
+		opt[0] = TCP_OPT_MSS;
+		opt[1] = 4;
+		opt[2] = TCP_MSS >> 8;
+		opt[3] = TCP_MSS & 0xff;
+		hdr_size += 4;
+		payload_len = 0;
+	}
+
+	net_set_ip_header(pkt, dest, net_ip, hdr_size + payload_len,
+			  IPPROTO_TCP);
+
+	tcp->tcp_src = htons(sport);
+	tcp->tcp_dst = htons(dport);
+	tcp->tcp_seq = htonl(tcp_seq_num);
+	tcp->tcp_ack = htonl(tcp_ack_num);
+	tcp->tcp_hlen = (hdr_size - IP_HDR_SIZE) << 2;
+	tcp->tcp_flags = action;
+	tcp->tcp_win = htons(CONFIG_TCP_WINDOW_SIZE);
+	tcp->tcp_xsum = 0;
+	tcp->tcp_urg = 0;
+	tcp->tcp_xsum = tcp_checksum(tcp, hdr_size - IP_HDR_SIZE + payload_len);
+
+	return hdr_size;
+}
+
+static void tcp_send_segment(u8 flags, u32 seq, const void *data,
+			     unsigned int len)
+{
+	uchar *pkt = net_tx_packet + net_eth_hdr_size() + IP_TCP_HDR_SIZE;
+
+	if (len)
+		memcpy(pkt, data, len);
+	net_send_ip_packet(tcp_remote_ethaddr, tcp_remote_ip, tcp_remote_port,
+			   tcp_our_port, len, IPPROTO_TCP, flags, seq,
+			   (flags & TCP_ACK) ? tcp_rcv_nxt : 0);
+	/* Any segment with an ACK acknowledges all that came */
+	if (flags & TCP_ACK)
+		tcp_ack_pending = 0;
+}
+
+static void tcp_send_ack(void)
+{
+	tcp_send_segment(TCP_ACK, tcp_snd_nxt, NULL, 0);
+}
+
+static void tcp_transmit(void)
+{
+	tcp_send_segment(tcp_tx_flags, tcp_tx_seq, tcp_tx_data, tcp_tx_len);
+	tcp_tx_time = get_timer(0);
+}
+
+/* Send a segment which takes up sequence space, and keep it until acked */
+static int tcp_queue(u8 flags, const void *data, unsigned int len)
+{
+	if (tcp_tx_pending)
+		return -EBUSY;
+	if (len > TCP_MSS)
+		return -EINVAL;
+
+	memcpy(tcp_tx_data, data, len);
+	tcp_tx_len = len;
+	tcp_tx_flags = flags;
+	tcp_tx_seq = tcp_snd_nxt;
+	tcp_snd_nxt += len + !!(flags & (TCP_SYN | TCP_FIN));
+	tcp_tx_pending = true;
+	tcp_rto = TCP_RTO_MS;
+	tcp_retries = 0;
+	tcp_transmit();
+
+	return 0;
+}
+
+static void tcp_fail(const char *msg)
+{
+	printf("\nTCP: %s\n", msg);
+	tcp_state = TCP_STATE_CLOSED;
+	net_set_timeout_handler(0, NULL);
+	tcp_event_handler(TCP_FAILED);
+}
+
+static void tcp_timer(void)
+{
+	ulong now = get_timer(0);
+
+	net_set_timeout_handler(TCP_TICK_MS, tcp_timer);
+
+	if (tcp_tx_pending && now - tcp_tx_time >= tcp_rto) {
+		if (++tcp_retries > TCP_RETRIES) {
+			tcp_fail("Retry count exceeded");
+			return;
+		}
+		puts("T ");
+		tcp_rto *= 2;
+		tcp_transmit();
+	}
+	if (tcp_ack_pending && now - tcp_ack_time >= TCP_DELACK_MS)
+		tcp_send_ack();
+	if (now - tcp_rx_time >= TCP_IDLE_MS)
+		tcp_fail("Connection timed out");
+}
+
+int tcp_connect(struct in_addr dest, int dport, tcp_rx_f *rx,
+		tcp_event_f *event)
+{
+	u32 iss = (u32)get_ticks() ^ seed_mac();
+
+	tcp_remote_ip = dest;
+	memset(tcp_remote_ethaddr, 0, ARP_HLEN);
+	tcp_remote_port = dport;
+	tcp_our_port = 1024 + (iss >> 8) % 64512;
+	tcp_rx_handler = rx;
+	tcp_event_handler = event;
+
+	tcp_snd_una = iss;
+	tcp_snd_nxt = iss;
+	tcp_rcv_nxt = 0;
+	tcp_tx_pending = false;
+	tcp_ack_pending = 0;
+	tcp_rx_time = get_timer(0);
+	tcp_state = TCP_STATE_SYN_SENT;
+	net_set_timeout_handler(TCP_TICK_MS, tcp_timer);
+
+	return tcp_queue(TCP_SYN, NULL, 0);
+}
+
+int tcp_write(const void *data, unsigned int len)
+{
+	if (tcp_state != TCP_STATE_ESTABLISHED &&
+	    tcp_state != TCP_STATE_CLOSE_WAIT)
+		return -ENOTCONN;
+
+	return tcp_queue(TCP_ACK | TCP_PSH, data, len);
+}
+
+void tcp_close(void)
+{
+	if (tcp_state == TCP_STATE_CLOSED)
+		return;
+
+	if (tcp_state != TCP_STATE_SYN_SENT)
+		tcp_send_segment(TCP_FIN | TCP_ACK, tcp_snd_nxt, NULL, 0);
+	tcp_state = TCP_STATE_CLOSED;
+	net_set_timeout_handler(0, NULL);
+}
+
+void tcp_abort(void)
+{
+	tcp_state = TCP_STATE_CLOSED;
+	tcp_tx_pending = false;
+	tcp_ack_pending = 0;
+}
+
+void tcp_receive(struct ip_tcp_hdr *tcp, unsigned int len)
+{
+	unsigned int hlen, dlen;
+	uchar *data;
+	u32 seq, ack;
+	u8 flags;
+
+	if (tcp_state == TCP_STATE_CLOSED || len < IP_TCP_HDR_SIZE)
+		return;
+	if (net_read_ip(&tcp->ip_src).s_addr != tcp_remote_ip.s_addr ||
+	    ntohs(tcp->tcp_src) != tcp_remote_port ||
+	    ntohs(tcp->tcp_dst) != tcp_our_port)
+		return;
+
+	hlen = (tcp->tcp_hlen >> 4) * 4;
+	if (hlen < TCP_HDR_SIZE || IP_HDR_SIZE + hlen > len)
+		return;
+	if (tcp_checksum(tcp, len - IP_HDR_SIZE)) {
+		debug("TCP checksum bad\n");
+		return;
+	}
+
+	seq = ntohl(tcp->tcp_seq);
+	ack = ntohl(tcp->tcp_ack);
+	flags = tcp->tcp_flags;
+	data = (uchar *)tcp + IP_HDR_SIZE + hlen;
+	dlen = len - IP_HDR_SIZE - hlen;
+	tcp_rx_time = get_timer(0);
+
+	if (tcp_state == TCP_STATE_SYN_SENT) {
+		if (!(flags & TCP_ACK) || ack != tcp_snd_nxt)
+			return;
+		if (flags & TCP_RST) {
+			tcp_fail("Connection refused");
+			return;
+		}
+		if (!(flags & TCP_SYN))
+			return;
+		tcp_irs = seq;
+		tcp_rcv_nxt = seq + 1;
+		tcp_snd_una = ack;
+		tcp_tx_pending = false;
+		tcp_state = TCP_STATE_ESTABLISHED;
+		tcp_send_ack();
+		tcp_event_handler(TCP_CONNECTED);
+		return;
+	}
+
+	if (flags & TCP_RST) {
+		/* Only believe a reset within the window */
+		if (seq - tcp_rcv_nxt < CONFIG_TCP_WINDOW_SIZE)
+			tcp_fail("Connection reset");
+		return;
+	}
+	if (flags & TCP_SYN) {
+		/* The SYN-ACK again: our ACK of it was lost */
+		tcp_send_ack();
+		return;
+	}
+
+	if ((flags & TCP_ACK) && SEQ_LT(tcp_snd_una, ack) &&
+	    SEQ_LEQ(ack, tcp_snd_nxt)) {
+		tcp_snd_una = ack;
+		if (ack == tcp_snd_nxt)
+			tcp_tx_pending = false;
+	}
+
+	/* Drop what was received already and keep what follows */
+	if (SEQ_LT(seq, tcp_rcv_nxt)) {
+		u32 dup = tcp_rcv_nxt - seq;
+
+		if (dup >= dlen + !!(flags & TCP_FIN)) {
+			/* All old: our ACK may have been lost */
+			if (dlen || (flags & TCP_FIN))
+				tcp_send_ack();
+			return;
+		}
+		data += dup;
+		dlen -= dup;
+		seq = tcp_rcv_nxt;
+	}
+	if (seq != tcp_rcv_nxt) {
+		/* A segment is missing: ask for it with a duplicate ACK */
+		tcp_send_ack();
+		return;
+	}
+
+	if (dlen) {
+		tcp_rcv_nxt += dlen;
+		if (!tcp_ack_pending++)
+			tcp_ack_time = get_timer(0);
+		tcp_rx_handler(data, seq - tcp_irs - 1, dlen);
+		/* The handler may have closed the connection */
+		if (tcp_state == TCP_STATE_CLOSED)
+			return;
+		if (tcp_ack_pending >= 2 && !net_rx_batch)
+			tcp_send_ack();
+	}
+
+	if ((flags & TCP_FIN) && tcp_state == TCP_STATE_ESTABLISHED) {
+		tcp_rcv_nxt++;
+		tcp_state = TCP_STATE_CLOSE_WAIT;
+		tcp_send_ack();
+		tcp_event_handler(TCP_CLOSED);
+	}
+}
+
+void tcp_rx_batch_end(void)
+{
+	if (tcp_state != TCP_STATE_CLOSED && tcp_ack_pending >= 2)
+		tcp_send_ack();
+}
@@ -10,12 +10,14 @@
 #include <command.h>
 #include <efi_loader.h>
 #include <env.h>
+#include <fit_stream.h>
 #include <image.h>
 #include <lmb.h>
 #include <log.h>
 #include <mapmem.h>
 #include <net.h>
 #include <net/tftp.h>
+#include <linux/bitmap.h>
 #include "bootp.h"
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 #include <flash.h>
@@ -27,6 +29,8 @@ DECLARE_GLOBAL_DATA_PTR;
 #define WELL_KNOWN_PORT	69
 /* Millisecs to timeout for lost pkt */
 #define TIMEOUT		5000UL
+/* Millisecs of quiet before a window with blocks missing is asked again */
+#define TFTP_GAP_TIMEOUT	20UL
 #ifndef	CONFIG_NET_RETRY_COUNT
 /* # of timeouts before giving up */
 # define TIMEOUT_COUNT	10
@@ -80,7 +84,7 @@ static int	tftp_our_port;
 static int	timeout_count;
 /* packet sequence number */
 static ulong	tftp_cur_block;
-/* last packet sequence number received */
+/* last packet sequence number received, with all the ones before it */
 static ulong	tftp_prev_block;
 /* count of sequence number wraparounds */
 static ulong	tftp_block_wrap;
@@ -118,6 +122,8 @@ static int	tftp_put_final_block_sent;
 #define TFTP_BLOCK_SIZE		512
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
+/* largest window we track, a power of two dividing TFTP_SEQUENCE_SIZE */
+#define TFTP_MAX_WINDOWSIZE	256
 
 #define DEFAULT_NAME_LEN	(8 + 4 + 1)
 static char default_filename[DEFAULT_NAME_LEN];
@@ -139,6 +145,20 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 
+/*
+ * RFC 7440 window: the server sends up to tftp_windowsize blocks before
+ * waiting for an ACK. Blocks may arrive out of order within the window; the
+ * ones received ahead of tftp_prev_block + 1 are stored straight away and
+ * marked in tftp_window_map, indexed by sequence number.
+ */
+static unsigned short tftp_windowsize = 1;
+static unsigned short tftp_windowsize_option = CONFIG_TFTP_WINDOWSIZE;
+static DECLARE_BITMAP(tftp_window_map, TFTP_MAX_WINDOWSIZE);
+/* last block of the window we have asked for */
+static ulong	tftp_next_ack;
+/* sequence number of the last (short) block, -1 until it arrives */
+static long	tftp_last_block;
+
 static inline int store_block(int block, uchar *src, unsigned int len)
 {
 	ulong offset = block * tftp_block_size + tftp_block_wrap_offset;
@@ -183,6 +203,7 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 #endif
 		ptr = map_sysmem(store_addr, len);
 		memcpy(ptr, src, len);
+		fit_stream_data(ptr, len);
 		unmap_sysmem(ptr);
 	}
 
@@ -198,6 +219,8 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	bitmap_zero(tftp_window_map, TFTP_MAX_WINDOWSIZE);
+	tftp_last_block = -1;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -228,6 +251,7 @@ static int load_block(unsigned block, uchar *dst, unsigned len)
 
 static void tftp_send(void);
 static void tftp_timeout_handler(void);
+static void tftp_gap_handler(void);
 
 /**********************************************************************/
 
@@ -350,6 +374,10 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		/* and for more than one block in flight */
+		if (tftp_state == STATE_SEND_RRQ && tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_windowsize_option, 0);
 		len = pkt - xp;
 		break;
 
@@ -362,6 +390,9 @@ static void tftp_send(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(tftp_cur_block);
 		pkt = (uchar *)(s + 2);
+		/* the remote now sends the window after this block */
+		tftp_next_ack = (tftp_cur_block + tftp_windowsize) &
+			(TFTP_SEQUENCE_SIZE - 1);
 #ifdef CONFIG_CMD_TFTPPUT
 		if (tftp_put_active) {
 			int toload = tftp_block_size;
@@ -415,11 +446,35 @@ static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 }
 #endif
 
+/*
+ * Move tftp_prev_block over the blocks which have now all arrived in order,
+ * and return how many it moved by
+ */
+static int tftp_receive_advance(void)
+{
+	int count = 0;
+
+	while (test_bit((tftp_prev_block + 1) % TFTP_MAX_WINDOWSIZE,
+			tftp_window_map)) {
+		__clear_bit((tftp_prev_block + 1) % TFTP_MAX_WINDOWSIZE,
+			    tftp_window_map);
+		tftp_cur_block = (tftp_prev_block + 1) &
+			(TFTP_SEQUENCE_SIZE - 1);
+		update_block_number();
+		tftp_prev_block = tftp_cur_block;
+		count++;
+	}
+
+	return count;
+}
+
 static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			 unsigned src, unsigned len)
 {
 	__be16 proto;
 	__be16 *s;
+	ushort block;
+	ulong ahead;
 	int i;
 
 	if (dest != tftp_our_port) {
@@ -494,6 +549,17 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				/* the server may only lower it */
+				if (!tftp_windowsize ||
+				    tftp_windowsize > tftp_windowsize_option)
+					tftp_windowsize = 1;
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -516,9 +582,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		if (len < 2)
 			return;
 		len -= 2;
-		tftp_cur_block = ntohs(*(__be16 *)pkt);
-
-		update_block_number();
+		block = ntohs(*(__be16 *)pkt);
 
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
@@ -530,39 +594,64 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			tftp_remote_port = src;
 			new_transfer();
 
-			if (tftp_cur_block != 1) {	/* Assertion */
+			/* Assertion: block 1, or one overtaking it */
+			if (block < 1 || block > tftp_windowsize) {
 				puts("\nTFTP error: ");
-				printf("First block is not block 1 (%ld)\n",
-				       tftp_cur_block);
+				printf("First block is not block 1 (%d)\n",
+				       block);
 				puts("Starting again\n\n");
 				net_start_again();
 				break;
 			}
 		}
 
-		if (tftp_cur_block == tftp_prev_block) {
+		/* How far ahead of the next block in order this one is */
+		ahead = (block - tftp_prev_block - 1) &
+			(TFTP_SEQUENCE_SIZE - 1);
+		if (ahead >= tftp_windowsize ||
+		    test_bit(block % TFTP_MAX_WINDOWSIZE, tftp_window_map)) {
 			/* Same block again; ignore it. */
 			break;
 		}
 
-		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-		if (store_block(tftp_cur_block - 1, pkt + 2, len)) {
+		if (store_block(tftp_prev_block + ahead, pkt + 2, len)) {
 			eth_halt();
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
+		__set_bit(block % TFTP_MAX_WINDOWSIZE, tftp_window_map);
+		if (len < tftp_block_size)
+			tftp_last_block = block;
 
-		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
-		 */
-		tftp_send();
+		/* Blocks stored out of order only count as landed now */
+		if (tftp_receive_advance() > 1)
+			fit_stream_data(map_sysmem(tftp_load_addr, 0),
+					min((ulong)net_boot_file_size,
+					    tftp_prev_block * tftp_block_size +
+					    tftp_block_wrap_offset));
 
-		if (len < tftp_block_size)
+		if (tftp_last_block == tftp_prev_block) {
+			/* Acknowledge the last block, which ends the file */
+			tftp_send();
 			tftp_complete();
+		} else if (((tftp_prev_block - tftp_next_ack) &
+			    (TFTP_SEQUENCE_SIZE - 1)) < tftp_windowsize) {
+			/*
+			 *	Acknowledge the window just received, which
+			 *	will prompt the remote for the next one.
+			 */
+			tftp_send();
+		} else {
+			/*
+			 *	Should the rest of the window not come, the
+			 *	gap is reported once the line goes quiet.
+			 */
+			net_set_timeout_handler(TFTP_GAP_TIMEOUT,
+						tftp_gap_handler);
+		}
 		break;
 
 	case TFTP_ERROR:
@@ -603,6 +692,17 @@ static void tftp_timeout_handler(void)
 	}
 }
 
+/*
+ * The window has not all arrived: acknowledge what has, so that the remote
+ * sends the rest again
+ */
+static void tftp_gap_handler(void)
+{
+	debug("TFTP window gap after block %lu\n", tftp_prev_block);
+	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+	tftp_send();
+}
+
 /* Initialize tftp_load_addr and tftp_load_size from image_load_addr and lmb */
 static int tftp_init_load_addr(void)
 {
@@ -636,6 +736,21 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = env_get("tftpwindowsize");
+	if (ep != NULL) {
+		long window = simple_strtol(ep, NULL, 10);
+
+		/* 0 or less turns the window off */
+		if (window < 1) {
+			window = 1;
+		} else if (window > TFTP_MAX_WINDOWSIZE) {
+			printf("TFTP window size (%ld) out of range, set to %d\n",
+			       window, TFTP_MAX_WINDOWSIZE);
+			window = TFTP_MAX_WINDOWSIZE;
+		}
+		tftp_windowsize_option = window;
+	}
+
 	ep = env_get("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -657,8 +772,8 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (!net_parse_bootfile(&tftp_remote_ip, tftp_filename, MAX_LEN)) {
@@ -727,6 +842,8 @@ void tftp_start(enum proto_t protocol)
 		printf("Load address: 0x%lx\n", tftp_load_addr);
 		puts("Loading: *\b");
 		tftp_state = STATE_SEND_RRQ;
+		fit_stream_begin(map_sysmem(tftp_load_addr, 0),
+				 tftp_load_size);
 #ifdef CONFIG_CMD_BOOTEFI
 		efi_set_bootdev("Net", "", tftp_filename);
 #endif
@@ -754,11 +871,14 @@ void tftp_start(enum proto_t protocol)
 		tftp_our_port = simple_strtol(ep, NULL, 10);
 #endif
 	tftp_cur_block = 0;
+	/* block 1 comes first, alone unless a window is agreed */
+	tftp_next_ack = 1;
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 #ifdef CONFIG_TFTP_TSIZE
 	tftp_tsize = 0;
 	tftp_tsize_num_hash = 0;
@@ -789,8 +909,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = 1;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
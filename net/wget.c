@@ -0,0 +1,260 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Load a file with an HTTP/1.1 GET request, over the minimal TCP client
+ *
+ * The reply must be "200 OK" with a Content-Length; chunked transfer
+ * encoding is not understood. The body goes straight to the load address
+ * as it arrives.
+ */
+
+#include <common.h>
+#include <env.h>
+#include <fit_stream.h>
+#include <image.h>
+#include <lmb.h>
+#include <log.h>
+#include <mapmem.h>
+#include <net.h>
+#include <net/tcp.h>
+#include <net/wget.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define WGET_DEFAULT_PORT	80
+/* Largest reply header we accept */
+#define WGET_HDR_MAX		2048
+/* Print a hash mark for every this many bytes */
+#define WGET_HASH_BYTES		(64 << 10)
+
+static struct in_addr wget_server_ip;
+static char wget_path[1024];
+static char wget_hdr[WGET_HDR_MAX + 1];
+static unsigned int wget_hdr_len;
+/* Offset of the body in the stream, 0 until the header is complete */
+static u32 wget_body_start;
+static ulong wget_content_len;
+/* Room at the load address, 0 if not limited */
+static ulong wget_load_size;
+static ulong wget_next_hash;
+static ulong wget_time_start;
+
+static void wget_fail(const char *msg)
+{
+	printf("\nwget: %s\n", msg);
+	tcp_close();
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_complete(void)
+{
+	ulong time;
+
+	tcp_close();
+	time = get_timer(wget_time_start);
+	if (time > 0) {
+		puts("\n\t ");	/* Line up with "Loading: " */
+		print_size(net_boot_file_size / time * 1000, "/s");
+	}
+	puts("\ndone\n");
+	net_set_state(NETLOOP_SUCCESS);
+}
+
+/* Find the value of header field @name in the reply header, or NULL */
+static const char *wget_hdr_field(const char *name)
+{
+	int len = strlen(name);
+	const char *p = wget_hdr;
+
+	while ((p = strstr(p, "\r\n"))) {
+		p += 2;
+		if (!strncasecmp(p, name, len) && p[len] == ':') {
+			p += len + 1;
+			while (*p == ' ' || *p == '\t')
+				p++;
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+/* Check the reply header, which is complete and nul-terminated */
+static int wget_parse_header(void)
+{
+	const char *p;
+	ulong status;
+
+	if (strncmp(wget_hdr, "HTTP/1.", 7)) {
+		wget_fail("Bad reply");
+		return -EPROTO;
+	}
+	p = strchr(wget_hdr, ' ');
+	status = p ? simple_strtoul(p + 1, NULL, 10) : 0;
+	if (status != 200) {
+		p = p ? p + 1 : wget_hdr;
+		printf("\nwget: Server replied '%.*s'\n",
+		       (int)(strchr(p, '\r') - p), p);
+		tcp_close();
+		net_set_state(NETLOOP_FAIL);
+		return -ENOENT;
+	}
+
+	p = wget_hdr_field("Transfer-Encoding");
+	if (p && strncasecmp(p, "identity", 8)) {
+		wget_fail("Transfer-Encoding not supported");
+		return -EPROTONOSUPPORT;
+	}
+	p = wget_hdr_field("Content-Length");
+	if (!p) {
+		wget_fail("No Content-Length");
+		return -EPROTONOSUPPORT;
+	}
+	wget_content_len = simple_strtoul(p, NULL, 10);
+	debug("wget: Content-Length %lu\n", wget_content_len);
+	if (wget_load_size && wget_content_len > wget_load_size) {
+		wget_fail("trying to overwrite reserved memory...");
+		return -E2BIG;
+	}
+
+	return 0;
+}
+
+static void wget_rx(const uchar *data, u32 offset, unsigned int len)
+{
+	ulong pos;
+	void *ptr;
+
+	if (!wget_body_start) {
+		unsigned int n = min(len, WGET_HDR_MAX - wget_hdr_len);
+		char *end;
+
+		memcpy(wget_hdr + wget_hdr_len, data, n);
+		wget_hdr[wget_hdr_len + n] = '\0';
+		end = strstr(wget_hdr, "\r\n\r\n");
+		if (!end) {
+			wget_hdr_len += n;
+			if (wget_hdr_len == WGET_HDR_MAX)
+				wget_fail("Reply header too long");
+			return;
+		}
+		end[2] = '\0';
+		wget_body_start = end + 4 - wget_hdr;
+		n = wget_body_start - wget_hdr_len;
+		if (wget_parse_header())
+			return;
+		data += n;
+		offset += n;
+		len -= n;
+		if (!wget_content_len) {
+			wget_complete();
+			return;
+		}
+		if (!len)
+			return;
+	}
+
+	pos = offset - wget_body_start;
+	if (pos + len > wget_content_len)
+		len = pos < wget_content_len ? wget_content_len - pos : 0;
+	if (!len)
+		return;
+	if (wget_load_size && pos + len > wget_load_size) {
+		wget_fail("trying to overwrite reserved memory...");
+		return;
+	}
+
+	ptr = map_sysmem(image_load_addr + pos, len);
+	memcpy(ptr, data, len);
+	fit_stream_data(ptr, len);
+	unmap_sysmem(ptr);
+	net_boot_file_size = pos + len;
+
+	while (net_boot_file_size >= wget_next_hash) {
+		putc('#');
+		wget_next_hash += WGET_HASH_BYTES;
+	}
+	if (net_boot_file_size == wget_content_len)
+		wget_complete();
+}
+
+static void wget_event(enum tcp_event event)
+{
+	char req[sizeof(wget_path) + 128];
+	int len;
+
+	switch (event) {
+	case TCP_CONNECTED:
+		len = snprintf(req, sizeof(req),
+			       "GET %s%s HTTP/1.1\r\n"
+			       "Host: %pI4\r\n"
+			       "User-Agent: U-Boot\r\n"
+			       "Connection: close\r\n\r\n",
+			       *wget_path == '/' ? "" : "/", wget_path,
+			       &wget_server_ip);
+		if (len >= sizeof(req) || len > TCP_MSS ||
+		    tcp_write(req, len))
+			wget_fail("Request too long");
+		break;
+	case TCP_CLOSED:
+		/* The server closed before sending all of the body */
+		if (net_state == NETLOOP_CONTINUE)
+			wget_fail("Connection closed early");
+		break;
+	case TCP_FAILED:
+		net_set_state(NETLOOP_FAIL);
+		break;
+	}
+}
+
+/* Find how much room there is at the load address */
+static int wget_init_load_size(void)
+{
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+
+	wget_load_size = lmb_get_free_size(&lmb, image_load_addr);
+	if (!wget_load_size)
+		return -ENOMEM;
+#else
+	wget_load_size = 0;
+#endif
+	return 0;
+}
+
+void wget_start(void)
+{
+	int port;
+
+	wget_server_ip = net_server_ip;
+	if (!net_parse_bootfile(&wget_server_ip, wget_path,
+				sizeof(wget_path))) {
+		puts("*** ERROR: no file name to load\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	port = env_get_ulong("httpdstp", 10, WGET_DEFAULT_PORT);
+
+	printf("Using %s device\n", eth_get_name());
+	printf("HTTP from server %pI4; our IP address is %pI4\n",
+	       &wget_server_ip, &net_ip);
+	printf("Filename '%s'.\n", wget_path);
+	if (wget_init_load_size()) {
+		puts("\nwget: trying to overwrite reserved memory...\n");
+		net_set_state(NETLOOP_FAIL);
+		return;
+	}
+	printf("Load address: 0x%lx\nLoading: *\b", image_load_addr);
+
+	wget_hdr_len = 0;
+	wget_body_start = 0;
+	wget_content_len = 0;
+	wget_next_hash = WGET_HASH_BYTES;
+	net_boot_file_size = 0;
+	wget_time_start = get_timer(0);
+	fit_stream_begin(map_sysmem(image_load_addr, 0), wget_load_size);
+
+	if (tcp_connect(wget_server_ip, port, wget_rx, wget_event))
+		wget_fail("Cannot connect");
+}
@@ -5,6 +5,8 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
+#include <mmc.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/state.h>
@@ -163,3 +165,257 @@ static int dm_test_blk_get_from_parent(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_get_from_parent, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+#define TEST_BLKCACHE_START	100
+#define TEST_BLKCACHE_BLOCKS	64
+
+/* Read block @blknr through the cache and check it against @pattern */
+static int test_blkcache_read(struct unit_test_state *uts,
+			      struct blk_desc *desc, lbaint_t blknr,
+			      const char *pattern)
+{
+	char buf[512];
+
+	ut_asserteq(1, blk_dread(desc, blknr, 1, buf));
+	ut_asserteq_mem(pattern + (blknr - TEST_BLKCACHE_START) * 512, buf,
+			512);
+
+	return 0;
+}
+
+/* Test the hits, readahead and evictions of the block cache */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	char *pattern;
+	ulong node_size;
+	int i;
+
+	/* Use the eMMC emulator, which keeps what is written */
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc3", &dev));
+	ut_asserteq(3, blk_get_device_by_str("mmc", "3", &desc));
+	ut_asserteq(512, desc->blksz);
+
+	pattern = malloc(TEST_BLKCACHE_BLOCKS * 512);
+	ut_assertnonnull(pattern);
+	for (i = 0; i < TEST_BLKCACHE_BLOCKS * 512; i++)
+		pattern[i] = i / 512 + i;
+	ut_asserteq(TEST_BLKCACHE_BLOCKS,
+		    blk_dwrite(desc, TEST_BLKCACHE_START, TEST_BLKCACHE_BLOCKS,
+			       pattern));
+
+	/* Find out what a block costs, then make room for 32 of them */
+	blkcache_configure_size(0x10000, 0);
+	ut_assertok(test_blkcache_read(uts, desc, TEST_BLKCACHE_START,
+				       pattern));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.entries);
+	node_size = stats.size;
+	blkcache_configure_size(32 * node_size, 16);
+
+	/* A miss and a hit, without reading ahead */
+	for (i = 0; i < 2; i++)
+		ut_assertok(test_blkcache_read(uts, desc, TEST_BLKCACHE_START,
+					       pattern));
+
+	/* Sequential misses read ahead by 8, then 16 blocks */
+	for (i = 1; i < 27; i++)
+		ut_assertok(test_blkcache_read(uts, desc,
+					       TEST_BLKCACHE_START + i,
+					       pattern));
+	blkcache_stats(&stats);
+	ut_asserteq(1 + 8 + 16, stats.hits);
+	ut_asserteq(3, stats.misses);
+	ut_asserteq(8 + 16, stats.readahead);
+	ut_asserteq(0, stats.evictions);
+	ut_asserteq(27, stats.entries);
+	ut_asserteq(27 * node_size, stats.size);
+
+	/* The window stays at 16, so the oldest blocks are dropped */
+	ut_assertok(test_blkcache_read(uts, desc, TEST_BLKCACHE_START + 27,
+				       pattern));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(16, stats.readahead);
+	ut_asserteq(27 + 17 - 32, stats.evictions);
+	ut_asserteq(32, stats.entries);
+
+	ut_assertok(test_blkcache_read(uts, desc, TEST_BLKCACHE_START,
+				       pattern));
+	ut_assertok(test_blkcache_read(uts, desc, TEST_BLKCACHE_START + 43,
+				       pattern));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.hits);
+	ut_asserteq(1, stats.misses);
+	ut_asserteq(0, stats.readahead);
+
+	/* Writes which are not cached drop the blocks of the device */
+	ut_asserteq(16, blk_dwrite(desc, TEST_BLKCACHE_START, 16, pattern));
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.entries);
+	ut_asserteq(0, stats.size);
+
+	/* Four entries of two blocks hold eight blocks, whatever the size */
+	blkcache_configure(2, 4);
+	blkcache_configure_size(CONFIG_BLOCK_CACHE_SIZE, 0);
+	for (i = 0; i < 10; i++)
+		ut_assertok(test_blkcache_read(uts, desc,
+					       TEST_BLKCACHE_START + i * 2,
+					       pattern));
+	blkcache_stats(&stats);
+	ut_asserteq(10, stats.misses);
+	ut_asserteq(2, stats.evictions);
+	ut_asserteq(8, stats.entries);
+
+	blkcache_configure(8, 0);
+	blkcache_configure_size(CONFIG_BLOCK_CACHE_SIZE,
+				CONFIG_BLOCK_CACHE_READAHEAD);
+	free(pattern);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE_WRITEBACK) && CONFIG_IS_ENABLED(MMC_STATS)
+/* Test that small writes are kept, merged and written back in order */
+static int dm_test_blk_cache_writeback(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	struct blk_desc *desc;
+	struct udevice *dev;
+	struct blk_sg sg[2];
+	struct mmc *mmc;
+	char *pattern, *buf;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc3", &dev));
+	ut_asserteq(3, blk_get_device_by_str("mmc", "3", &desc));
+	mmc = mmc_get_mmc_dev(dev);
+
+	pattern = malloc(TEST_BLKCACHE_BLOCKS * 512);
+	ut_assertnonnull(pattern);
+	buf = malloc(TEST_BLKCACHE_BLOCKS * 512);
+	ut_assertnonnull(buf);
+	for (i = 0; i < TEST_BLKCACHE_BLOCKS * 512; i++)
+		pattern[i] = i / 512 + i;
+	blkcache_configure_size(CONFIG_BLOCK_CACHE_SIZE, 0);
+
+	/* Outside a session, writes go straight to the device */
+	memset(&mmc->stats, '\0', sizeof(mmc->stats));
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START, 1, pattern));
+	ut_asserteq(1, mmc->stats.write_cmds);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+	blkcache_writeback_begin(IF_TYPE_MMC, 3);
+
+	/* Single blocks written in any order stay in the cache */
+	memset(&mmc->stats, '\0', sizeof(mmc->stats));
+	for (i = 7; i >= 0; i--)
+		ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + i, 1,
+					  pattern + i * 512));
+	ut_asserteq(0, mmc->stats.write_cmds);
+	ut_asserteq(8, blk_dread(desc, TEST_BLKCACHE_START, 8, buf));
+	ut_asserteq_mem(pattern, buf, 8 * 512);
+	blkcache_stats(&stats);
+	ut_asserteq(8, stats.writes);
+	ut_asserteq(8, stats.dirty);
+	ut_asserteq(0, mmc->stats.read_cmds);
+
+	/* ...and go to the device as one write */
+	ut_assertok(blkcache_flush(IF_TYPE_MMC, 3));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.writebacks);
+	ut_asserteq(8, stats.written);
+	ut_asserteq(0, stats.dirty);
+	ut_asserteq(1, mmc->stats.write_cmds);
+	ut_asserteq(8, mmc->stats.write_blocks);
+
+	/*
+	 * Blocks written after a barrier are written back after those before
+	 * it, and rewriting a block from before the barrier writes those back
+	 */
+	memset(&mmc->stats, '\0', sizeof(mmc->stats));
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 9, 1,
+				  pattern + 9 * 512));
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 10, 1,
+				  pattern + 10 * 512));
+	blkcache_barrier();
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 11, 1,
+				  pattern + 11 * 512));
+	ut_assertok(blkcache_flush(IF_TYPE_MMC, 3));
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.writebacks);
+	ut_asserteq(3, stats.written);
+
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 12, 1,
+				  pattern + 12 * 512));
+	blkcache_barrier();
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 13, 1,
+				  pattern + 13 * 512));
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 12, 1,
+				  pattern + 12 * 512));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.writebacks);
+	ut_asserteq(2, stats.dirty);
+	ut_assertok(blkcache_flush(IF_TYPE_MMC, 3));
+	ut_asserteq(4, mmc->stats.write_cmds);
+
+	/* A read which the cache cannot serve writes back first */
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 20, 1,
+				  pattern + 20 * 512));
+	ut_asserteq(TEST_BLKCACHE_BLOCKS,
+		    blk_dread(desc, TEST_BLKCACHE_START, TEST_BLKCACHE_BLOCKS,
+			      buf));
+	ut_asserteq_mem(pattern, buf, 8 * 512);
+	ut_asserteq_mem(pattern + 9 * 512, buf + 9 * 512, 5 * 512);
+	ut_asserteq_mem(pattern + 20 * 512, buf + 20 * 512, 512);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+
+	/* So does a write which is not cached */
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 30, 1,
+				  pattern + 30 * 512));
+	ut_asserteq(16, blk_dwrite(desc, TEST_BLKCACHE_START + 40, 16,
+				   pattern + 40 * 512));
+	blkcache_stats(&stats);
+	ut_asserteq(1, stats.written);
+	ut_asserteq(0, stats.entries);
+
+	/* A scatter-gather read does not miss what is in the cache */
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 2, 1,
+				  pattern + 50 * 512));
+	sg[0].buf = buf;
+	sg[0].blkcnt = 2;
+	sg[1].buf = buf + 2 * 512;
+	sg[1].blkcnt = 2;
+	memset(buf, '\0', 4 * 512);
+	ut_asserteq(4, blk_dread_sg(desc, TEST_BLKCACHE_START, sg, 2));
+	ut_asserteq_mem(pattern + 50 * 512, buf + 2 * 512, 512);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+
+	/* Ending the session writes back, and later writes are not kept */
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 2, 1,
+				  pattern + 2 * 512));
+	memset(&mmc->stats, '\0', sizeof(mmc->stats));
+	ut_assertok(blkcache_writeback_end());
+	ut_asserteq(1, mmc->stats.write_cmds);
+	ut_asserteq(1, blk_dwrite(desc, TEST_BLKCACHE_START + 3, 1,
+				  pattern + 3 * 512));
+	ut_asserteq(2, mmc->stats.write_cmds);
+	blkcache_stats(&stats);
+	ut_asserteq(0, stats.dirty);
+
+	blkcache_configure_size(CONFIG_BLOCK_CACHE_SIZE,
+				CONFIG_BLOCK_CACHE_READAHEAD);
+	free(buf);
+	free(pattern);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_writeback, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
+#endif
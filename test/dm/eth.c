@@ -430,3 +430,48 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_eth_async_ping_reply, DM_TESTF_SCAN_FDT);
+
+/* Follow each reply with an empty frame, so that the two come in a batch */
+static int sb_with_empty_frame_handler(struct udevice *dev, void *packet,
+				       unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len) ||
+	    !sandbox_eth_ping_req_to_reply(dev, packet, len)) {
+		if (priv->recv_packets < PKTBUFSRX)
+			priv->recv_packet_length[priv->recv_packets++] = 0;
+	}
+
+	return 0;
+}
+
+static int dm_test_eth_batch(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	struct udevice *dev;
+
+	net_ping_ip = string_to_ip("1.1.2.2");
+
+	ut_assertok(uclass_get_device(UCLASS_ETH, 0, &dev));
+	priv = dev_get_priv(dev);
+	sandbox_eth_set_tx_handler(0, sb_with_empty_frame_handler);
+	sandbox_eth_set_batch(0, true);
+
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_loop(PING));
+	ut_asserteq_str("eth@10002000", env_get("ethact"));
+
+	/* The ARP and ping replies came through recv_batch() */
+	ut_asserteq(4, priv->batched);
+	ut_asserteq(0, priv->recv_packets);
+	/* The empty frame after the ping reply was skipped */
+	ut_assert(net_rx_packet_len > 0);
+
+	sandbox_eth_set_batch(0, false);
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	return 0;
+}
+
+DM_TEST(dm_test_eth_batch, DM_TESTF_SCAN_FDT);
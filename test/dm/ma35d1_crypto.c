@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the MA35D1 crypto driver's SHA engine, run against the sandbox
+ * register model
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <rand.h>
+#include <asm/test.h>
+#include <dm/test.h>
+#include <test/ut.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+
+/* A little over three staging buffers, so all the update paths are used */
+#define TEST_SHA_LEN	(3 * 4096 + 77)
+
+struct test_sha_algo {
+	const char *name;
+	void (*sw)(const unsigned char *input, unsigned int ilen,
+		   unsigned char *output, unsigned int chunk_sz);
+};
+
+static const struct test_sha_algo test_sha_algos[] = {
+	{ "sha1", sha1_csum_wd },
+	{ "sha224", sha224_csum_wd },
+	{ "sha256", sha256_csum_wd },
+#ifdef CONFIG_SHA512
+	{ "sha512", sha512_csum_wd },
+#endif
+};
+
+static u8 *test_sha_buf(int len)
+{
+	u8 *buf;
+	int i;
+
+	buf = malloc(len);
+	if (buf) {
+		for (i = 0; i < len; i++)
+			buf[i] = rand();
+	}
+
+	return buf;
+}
+
+/* Hash @len bytes of @buf with updates of random size */
+static int test_sha_prog(struct unit_test_state *uts, struct hash_algo *algo,
+			 const u8 *buf, int len, u8 *out)
+{
+	void *ctx;
+	int pos;
+
+	ut_assertok(algo->hash_init(algo, &ctx));
+	for (pos = 0; pos < len;) {
+		int chunk = min_t(int, rand() % 5000, len - pos);
+
+		ut_assertok(algo->hash_update(algo, ctx, buf + pos, chunk,
+					      pos + chunk == len));
+		pos += chunk;
+	}
+	ut_assertok(algo->hash_finish(algo, ctx, out, HASH_MAX_DIGEST_SIZE));
+
+	return 0;
+}
+
+static int dm_test_ma35d1_sha(struct unit_test_state *uts)
+{
+	static const int lens[] = { 1, 63, 64, 65, 128, 4096, 4097,
+				    TEST_SHA_LEN };
+	u8 ref[HASH_MAX_DIGEST_SIZE], out[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	struct udevice *dev;
+	uint transfers;
+	int i, j;
+	u8 *buf;
+
+	ut_assertok(uclass_get_device_by_driver(UCLASS_NOP,
+				DM_GET_DRIVER(crypto_ma35d1), &dev));
+	buf = test_sha_buf(TEST_SHA_LEN + 1);
+	ut_assertnonnull(buf);
+
+	for (i = 0; i < ARRAY_SIZE(test_sha_algos); i++) {
+		const struct test_sha_algo *t = &test_sha_algos[i];
+
+		ut_assertok(hash_lookup_algo(t->name, &algo));
+		for (j = 0; j < ARRAY_SIZE(lens); j++) {
+			/* odd offsets go through the staging buffer */
+			const u8 *data = buf + (j & 1);
+
+			t->sw(data, lens[j], ref, CHUNKSZ);
+			transfers = ma35d1_crypto_emul_sha_transfers();
+			ut_assertok(test_sha_prog(uts, algo, data, lens[j],
+						  out));
+			ut_assert(ma35d1_crypto_emul_sha_transfers() >
+				  transfers);
+			ut_asserteq_mem(ref, out, algo->digest_size);
+
+			memset(out, '\0', sizeof(out));
+			algo->hash_func_ws(data, lens[j], out,
+					   algo->chunk_size);
+			ut_asserteq_mem(ref, out, algo->digest_size);
+		}
+	}
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_ma35d1_sha, DM_TESTF_SCAN_FDT);
+
+/* The empty message is hashed in software; it must still be right */
+static int dm_test_ma35d1_sha_empty(struct unit_test_state *uts)
+{
+	u8 ref[HASH_MAX_DIGEST_SIZE], out[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	struct udevice *dev;
+	void *ctx;
+	int i;
+
+	ut_assertok(uclass_get_device_by_driver(UCLASS_NOP,
+				DM_GET_DRIVER(crypto_ma35d1), &dev));
+	for (i = 0; i < ARRAY_SIZE(test_sha_algos); i++) {
+		const struct test_sha_algo *t = &test_sha_algos[i];
+
+		ut_assertok(hash_lookup_algo(t->name, &algo));
+		t->sw(NULL, 0, ref, CHUNKSZ);
+		ut_assertok(algo->hash_init(algo, &ctx));
+		ut_assertok(algo->hash_finish(algo, ctx, out, sizeof(out)));
+		ut_asserteq_mem(ref, out, algo->digest_size);
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_ma35d1_sha_empty, DM_TESTF_SCAN_FDT);
+
+/* Several hashes may be in progress at once */
+static int dm_test_ma35d1_sha_interleave(struct unit_test_state *uts)
+{
+	u8 ref[2][HASH_MAX_DIGEST_SIZE], out[2][HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo[2];
+	struct udevice *dev;
+	void *ctx[2];
+	int i, pos;
+	u8 *buf;
+
+	ut_assertok(uclass_get_device_by_driver(UCLASS_NOP,
+				DM_GET_DRIVER(crypto_ma35d1), &dev));
+	buf = test_sha_buf(TEST_SHA_LEN);
+	ut_assertnonnull(buf);
+
+	ut_assertok(hash_lookup_algo("sha256", &algo[0]));
+	ut_assertok(hash_lookup_algo("sha1", &algo[1]));
+	sha256_csum_wd(buf, TEST_SHA_LEN, ref[0], CHUNKSZ_SHA256);
+	sha1_csum_wd(buf, TEST_SHA_LEN, ref[1], CHUNKSZ_SHA1);
+
+	for (i = 0; i < 2; i++)
+		ut_assertok(algo[i]->hash_init(algo[i], &ctx[i]));
+	for (pos = 0; pos < TEST_SHA_LEN;) {
+		int chunk = min_t(int, 1000, TEST_SHA_LEN - pos);
+
+		for (i = 0; i < 2; i++)
+			ut_assertok(algo[i]->hash_update(algo[i], ctx[i],
+							 buf + pos, chunk, 0));
+		pos += chunk;
+	}
+	for (i = 0; i < 2; i++) {
+		ut_assertok(algo[i]->hash_finish(algo[i], ctx[i], out[i],
+						 HASH_MAX_DIGEST_SIZE));
+		ut_asserteq_mem(ref[i], out[i], algo[i]->digest_size);
+	}
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_ma35d1_sha_interleave, DM_TESTF_SCAN_FDT);
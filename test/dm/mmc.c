@@ -5,8 +5,12 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
 #include <mmc.h>
 #include <part.h>
+#include <rand.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -42,3 +46,241 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_CQHCI) || CONFIG_IS_ENABLED(MMC_STATS)
+/* Read blocks from @start and return the virtual time taken in @timep */
+static int test_mmc_timed_read(struct unit_test_state *uts,
+			       struct udevice *dev, struct blk_desc *dev_desc,
+			       lbaint_t start, lbaint_t blkcnt, void *buf,
+			       u64 *timep)
+{
+	u64 begin = sandbox_mmc_get_time(dev);
+
+	memset(buf, '\0', blkcnt * dev_desc->blksz);
+	ut_asserteq(blkcnt, blk_dread(dev_desc, start, blkcnt, buf));
+	*timep = sandbox_mmc_get_time(dev) - begin;
+
+	return 0;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_CQHCI)
+#define TEST_CQE_BLOCKS		1024
+#define TEST_CQE_T_ACC		100000	/* access time of the emulator, in ns */
+
+/*
+ * Large reads from an eMMC go through the command queue engine, which must
+ * give the same data as plain multiple-block reads in less time
+ */
+static int dm_test_mmc_cqe(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	uint tasks, max_queued;
+	u64 t_legacy, t_cqe;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 *buf, *out;
+	size_t len;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc3", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_asserteq(16, mmc->cmdq_depth);
+	ut_assert(mmc->host_caps & MMC_CAP_CMDQ);
+	ut_asserteq(3, blk_get_device_by_str("mmc", "3", &dev_desc));
+	ut_asserteq(512, dev_desc->blksz);
+
+	len = TEST_CQE_BLOCKS * dev_desc->blksz;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	out = malloc(len);
+	ut_assertnonnull(out);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+	ut_asserteq(TEST_CQE_BLOCKS, blk_dwrite(dev_desc, 100, TEST_CQE_BLOCKS,
+						buf));
+
+	mmc->host_caps &= ~MMC_CAP_CMDQ;
+	ut_assertok(test_mmc_timed_read(uts, dev, dev_desc, 100, TEST_CQE_BLOCKS,
+					out, &t_legacy));
+	mmc->host_caps |= MMC_CAP_CMDQ;
+	ut_asserteq_mem(buf, out, len);
+	ut_asserteq(0, sandbox_mmc_get_cqe_tasks(dev, &max_queued));
+
+	ut_assertok(test_mmc_timed_read(uts, dev, dev_desc, 100, TEST_CQE_BLOCKS,
+					out, &t_cqe));
+	ut_asserteq_mem(buf, out, len);
+	tasks = sandbox_mmc_get_cqe_tasks(dev, &max_queued);
+	ut_assert(tasks > 1);
+	ut_assert(max_queued > 1 && max_queued <= mmc->cmdq_depth);
+
+	/* At least half the access time of each task is hidden */
+	ut_assert(t_cqe + tasks * TEST_CQE_T_ACC / 2 < t_legacy);
+
+	/* Short reads and legacy commands still work afterwards */
+	ut_assertok(test_mmc_timed_read(uts, dev, dev_desc, 103, 5, out, &t_cqe));
+	ut_asserteq_mem(buf + 3 * 512, out, 5 * 512);
+	ut_asserteq(tasks, sandbox_mmc_get_cqe_tasks(dev, &max_queued));
+
+	free(out);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cqe, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
+
+#if CONFIG_IS_ENABLED(MMC_STATS)
+#define TEST_CMD23_BLOCKS	512
+#define TEST_CMD23_XFERS	(TEST_CMD23_BLOCKS / 64)	/* b_max is 64 */
+
+/*
+ * Multiple-block transfers are pre-defined with CMD23, sent by the host if it
+ * can, and only stopped with CMD12 if neither the core nor the host can
+ */
+static int dm_test_mmc_cmd23(struct unit_test_state *uts)
+{
+	u64 t_open, t_cmd23, t_auto;
+	struct blk_desc *dev_desc;
+	struct mmc_stats *stats;
+	struct udevice *dev;
+	struct mmc *mmc;
+	u8 *buf, *out;
+	size_t len;
+	uint caps;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc3", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assert(mmc->cmd23_support);
+	ut_asserteq(3, blk_get_device_by_str("mmc", "3", &dev_desc));
+	stats = &mmc->stats;
+
+	len = TEST_CMD23_BLOCKS * dev_desc->blksz;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	out = malloc(len);
+	ut_assertnonnull(out);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+
+	/* Keep the reads off the command queue engine */
+	caps = mmc->host_caps;
+	mmc->host_caps &= ~(MMC_CAP_CMDQ | MMC_CAP_CMD23 | MMC_CAP_AUTO_CMD23);
+
+	memset(stats, '\0', sizeof(*stats));
+	ut_asserteq(TEST_CMD23_BLOCKS, blk_dwrite(dev_desc, 10,
+						  TEST_CMD23_BLOCKS, buf));
+	ut_asserteq(TEST_CMD23_XFERS, stats->write_cmds);
+	ut_asserteq(TEST_CMD23_BLOCKS, stats->write_blocks);
+	ut_asserteq(TEST_CMD23_XFERS, stats->stop_transmission);
+
+	memset(stats, '\0', sizeof(*stats));
+	ut_assertok(test_mmc_timed_read(uts, dev, dev_desc, 10,
+					TEST_CMD23_BLOCKS, out, &t_open));
+	ut_asserteq_mem(buf, out, len);
+	ut_asserteq(TEST_CMD23_XFERS, stats->read_cmds);
+	ut_asserteq(TEST_CMD23_BLOCKS, stats->read_blocks);
+	ut_asserteq(TEST_CMD23_XFERS, stats->stop_transmission);
+	ut_asserteq(0, stats->set_block_count);
+
+	mmc->host_caps |= MMC_CAP_CMD23;
+	memset(stats, '\0', sizeof(*stats));
+	ut_assertok(test_mmc_timed_read(uts, dev, dev_desc, 10,
+					TEST_CMD23_BLOCKS, out, &t_cmd23));
+	ut_asserteq_mem(buf, out, len);
+	ut_asserteq(TEST_CMD23_XFERS, stats->set_block_count);
+	ut_asserteq(0, stats->stop_transmission);
+
+	mmc->host_caps |= MMC_CAP_AUTO_CMD23;
+	memset(stats, '\0', sizeof(*stats));
+	ut_assertok(test_mmc_timed_read(uts, dev, dev_desc, 10,
+					TEST_CMD23_BLOCKS, out, &t_auto));
+	ut_asserteq_mem(buf, out, len);
+	ut_asserteq(TEST_CMD23_XFERS, stats->auto_cmd23);
+	ut_asserteq(0, stats->set_block_count);
+	ut_asserteq(0, stats->stop_transmission);
+
+	ut_assert(t_cmd23 < t_open);
+	ut_assert(t_auto < t_cmd23);
+
+	/* Writes are pre-defined too */
+	memset(stats, '\0', sizeof(*stats));
+	ut_asserteq(TEST_CMD23_BLOCKS, blk_dwrite(dev_desc, 20,
+						  TEST_CMD23_BLOCKS, buf));
+	ut_asserteq(TEST_CMD23_XFERS, stats->auto_cmd23);
+	ut_asserteq(0, stats->stop_transmission);
+	ut_asserteq(TEST_CMD23_BLOCKS, blk_dread(dev_desc, 20,
+						 TEST_CMD23_BLOCKS, out));
+	ut_asserteq_mem(buf, out, len);
+
+	mmc->host_caps = caps;
+	free(out);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cmd23, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Scattered reads go out in as few transfers as the host limits allow */
+static int dm_test_mmc_read_sg(struct unit_test_state *uts)
+{
+	static const uint seg_blocks[] = { 3, 100, 1, 0, 60 };
+	struct blk_sg sg[ARRAY_SIZE(seg_blocks)];
+	struct blk_desc *dev_desc;
+	struct mmc_stats *stats;
+	struct udevice *dev;
+	uint i, blkcnt = 0;
+	struct mmc *mmc;
+	u8 *buf, *pos;
+	size_t len;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "mmc3", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_asserteq(3, blk_get_device_by_str("mmc", "3", &dev_desc));
+	stats = &mmc->stats;
+
+	for (i = 0; i < ARRAY_SIZE(seg_blocks); i++)
+		blkcnt += seg_blocks[i];
+	len = blkcnt * dev_desc->blksz;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+	ut_asserteq(blkcnt, blk_dwrite(dev_desc, 40, blkcnt, buf));
+
+	for (i = 0; i < ARRAY_SIZE(seg_blocks); i++) {
+		sg[i].blkcnt = seg_blocks[i];
+		sg[i].buf = memalign(ARCH_DMA_MINALIGN,
+				     (seg_blocks[i] + 1) * dev_desc->blksz);
+		ut_assertnonnull(sg[i].buf);
+		memset(sg[i].buf, '\0', seg_blocks[i] * dev_desc->blksz);
+	}
+
+	/* 164 blocks with b_max of 64 */
+	memset(stats, '\0', sizeof(*stats));
+	ut_asserteq(blkcnt, blk_dread_sg(dev_desc, 40, sg, ARRAY_SIZE(sg)));
+	ut_asserteq(3, stats->read_cmds);
+	ut_asserteq(blkcnt, stats->read_blocks);
+	for (i = 0, pos = buf; i < ARRAY_SIZE(sg); i++) {
+		ut_asserteq_mem(pos, sg[i].buf, sg[i].blkcnt * dev_desc->blksz);
+		pos += sg[i].blkcnt * dev_desc->blksz;
+	}
+
+	/* A buffer not on a cache line makes each segment a read of its own */
+	sg[1].buf += 4;
+	memset(stats, '\0', sizeof(*stats));
+	ut_asserteq(blkcnt, blk_dread_sg(dev_desc, 40, sg, ARRAY_SIZE(sg)));
+	ut_asserteq(5, stats->read_cmds);
+	ut_asserteq_mem(buf + 3 * dev_desc->blksz, sg[1].buf,
+			sg[1].blkcnt * dev_desc->blksz);
+	sg[1].buf -= 4;
+
+	for (i = 0; i < ARRAY_SIZE(sg); i++)
+		free(sg[i].buf);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_read_sg, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for sequential reads in the raw NAND core, run against the sandbox
+ * NAND simulator
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <nand.h>
+#include <rand.h>
+#include <asm/test.h>
+#include <dm/test.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/rawnand.h>
+#include <test/ut.h>
+
+#define TEST_NAND_PAGES		200
+#define TEST_NAND_T_R		25000	/* tR of the simulator, in ns */
+
+/* Read @len bytes at @from and return the virtual time taken in @timep */
+static int test_nand_read(struct unit_test_state *uts, struct udevice *dev,
+			  struct mtd_info *mtd, loff_t from, size_t len,
+			  u8 *buf, u64 *timep)
+{
+	u64 start = sandbox_nand_get_time(dev);
+	size_t retlen;
+
+	memset(buf, '\0', len);
+	ut_assertok(mtd_read(mtd, from, len, &retlen, buf));
+	ut_asserteq(len, retlen);
+	*timep = sandbox_nand_get_time(dev) - start;
+
+	return 0;
+}
+
+/*
+ * Write a run of pages and read it back page by page and with the core's
+ * sequential reader, which must give the same data in less time
+ */
+static int test_nand_seq_read(struct unit_test_state *uts, const char *name,
+			      struct nand_chip **chipp)
+{
+	struct erase_info ei = {};
+	struct udevice *dev;
+	struct mtd_info *mtd;
+	struct nand_chip *chip;
+	void *read_pages;
+	u64 t_page, t_seq;
+	size_t len, retlen;
+	loff_t from;
+	u8 *buf, *out;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MTD, name, &dev));
+	mtd = get_nand_dev_by_index(dev->seq);
+	ut_assertnonnull(mtd);
+	chip = mtd_to_nand(mtd);
+	ut_assertnonnull(chip->ecc.read_pages);
+	*chipp = chip;
+
+	/* Start near the end of a block so that the readers cross blocks */
+	from = 60 * mtd->writesize;
+	len = TEST_NAND_PAGES * mtd->writesize;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	out = malloc(len);
+	ut_assertnonnull(out);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+
+	ei.mtd = mtd;
+	ei.len = roundup(from + len, mtd->erasesize);
+	ut_assertok(mtd_erase(mtd, &ei));
+	ut_assertok(mtd_write(mtd, from, len, &retlen, buf));
+	ut_asserteq(len, retlen);
+
+	read_pages = chip->ecc.read_pages;
+	chip->ecc.read_pages = NULL;
+	ut_assertok(test_nand_read(uts, dev, mtd, from, len, out, &t_page));
+	chip->ecc.read_pages = read_pages;
+	ut_asserteq_mem(buf, out, len);
+
+	ut_assertok(test_nand_read(uts, dev, mtd, from, len, out, &t_seq));
+	ut_asserteq_mem(buf, out, len);
+
+	/* At least a quarter of tR per page is hidden */
+	ut_assert(t_seq + TEST_NAND_PAGES * TEST_NAND_T_R / 4 < t_page);
+
+	free(out);
+	free(buf);
+
+	return 0;
+}
+
+/* Sequential reads use READ CACHE where the chip supports it */
+static int dm_test_nand_cache_read(struct unit_test_state *uts)
+{
+	struct nand_chip *chip;
+
+	ut_assertok(test_nand_seq_read(uts, "nand0", &chip));
+	ut_assert(onfi_has_read_cache(chip));
+
+	return 0;
+}
+DM_TEST(dm_test_nand_cache_read, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Without READ CACHE, pages of a block pair are read two planes at once */
+static int dm_test_nand_multi_plane_read(struct unit_test_state *uts)
+{
+	struct nand_chip *chip;
+
+	ut_assertok(test_nand_seq_read(uts, "nand1", &chip));
+	ut_assert(!onfi_has_read_cache(chip));
+	ut_assert(onfi_has_multi_plane_read(chip));
+
+	return 0;
+}
+DM_TEST(dm_test_nand_multi_plane_read, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* The bad block table and its mirror are kept on flash and used to skip */
+static int dm_test_nand_bbt(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	struct mtd_info *mtd;
+	struct nand_chip *chip;
+	size_t len, actual;
+	loff_t bad, phys;
+	u8 *buf, *out;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MTD, "nand0", &dev));
+	mtd = get_nand_dev_by_index(dev->seq);
+	ut_assertnonnull(mtd);
+	chip = mtd_to_nand(mtd);
+
+	/* The first check scans the chip and writes both tables */
+	ut_asserteq(0, mtd_block_isbad(mtd, 0));
+	ut_assertnonnull(chip->bbt_map);
+	ut_assert(chip->bbt_td->pages[0] != -1);
+	ut_assert(chip->bbt_md->pages[0] != -1);
+	ut_assert(chip->bbt_td->pages[0] != chip->bbt_md->pages[0]);
+
+	bad = 2 * mtd->erasesize;
+	ut_assertok(mtd_block_markbad(mtd, bad));
+	ut_asserteq(1, mtd_block_isbad(mtd, bad));
+
+	/* Without the copy in RAM, the table is read back from flash */
+	nand_free_bbt(mtd);
+	chip->options &= ~NAND_BBT_SCANNED;
+	ut_asserteq(1, mtd_block_isbad(mtd, bad));
+	ut_asserteq(0, mtd_block_isbad(mtd, bad - mtd->erasesize));
+	ut_asserteq(0, mtd_block_isbad(mtd, bad + mtd->erasesize));
+
+	/* Skip-bad offsets step over the bad block */
+	ut_assertok(nand_skip_bad_bbt(mtd, mtd->erasesize, mtd->erasesize,
+				      &phys));
+	ut_asserteq(3 * mtd->erasesize, phys);
+	ut_assertok(nand_skip_bad_bbt(mtd, mtd->erasesize + 100, 50, &phys));
+	ut_asserteq(mtd->erasesize + 150, phys);
+	ut_assertok(nand_skip_bad_bbt(mtd, bad + 100, 50, &phys));
+	ut_asserteq(3 * mtd->erasesize + 50, phys);
+	ut_asserteq(-ERANGE, nand_skip_bad_bbt(mtd, 0, mtd->size, &phys));
+
+	len = 3 * mtd->erasesize;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	out = malloc(len);
+	ut_assertnonnull(out);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+
+	ut_assertok(nand_write_skip_bad(mtd, mtd->erasesize, &len, &actual,
+					mtd->size, buf, 0));
+	ut_asserteq(4 * mtd->erasesize, actual);
+	ut_assertok(nand_read_skip_bad(mtd, mtd->erasesize, &len, &actual,
+				       mtd->size, out));
+	ut_asserteq(3 * mtd->erasesize, len);
+	ut_asserteq(4 * mtd->erasesize, actual);
+	ut_asserteq_mem(buf, out, len);
+
+	/* The area does not fit before the end of the device */
+	ut_asserteq(-EINVAL, nand_read_skip_bad(mtd, mtd->size - len, &len,
+						&actual, mtd->size, out));
+
+	free(out);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_nand_bbt, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
@@ -10,6 +10,7 @@
 #include <mapmem.h>
 #include <os.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <asm/state.h>
 #include <asm/test.h>
@@ -93,3 +94,63 @@ static int dm_test_spi_flash_func(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash_func, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Reads go through the direct mapping of the sandbox SPI bus */
+static int dm_test_spi_flash_dirmap(struct unit_test_state *uts)
+{
+	struct spi_mem_dirmap_info info = {};
+	struct spi_mem_dirmap_desc *desc;
+	struct spi_flash *flash;
+	struct udevice *dev;
+	int full_size = 0x200000;
+	int size = 0x10000;
+	uint reads;
+	u8 *src, *dst;
+
+	src = map_sysmem(0x20000, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	flash = dev_get_uclass_priv(dev);
+	ut_assertnonnull(flash->rdesc);
+	ut_asserteq(0, flash->rdesc->nodirmap);
+
+	/* The bus serves at most 8KB per mapped read */
+	dst = map_sysmem(0x20000 + full_size, full_size);
+	reads = sandbox_spi_get_dirmap_reads(dev->parent);
+	ut_assertok(spi_flash_read_dm(dev, 0x100, size, dst));
+	ut_asserteq_mem(src + 0x100, dst, size);
+	ut_asserteq(reads + size / 0x2000,
+		    sandbox_spi_get_dirmap_reads(dev->parent));
+
+	/* Offsets are relative to the mapping, which clips the length */
+	info.op_tmpl = flash->rdesc->info.op_tmpl;
+	info.offset = 0x1000;
+	info.length = 0x800;
+	desc = spi_mem_dirmap_create(flash->spi, &info);
+	ut_assertok_ptr(desc);
+	ut_asserteq(0x700, spi_mem_dirmap_read(desc, 0x100, size, dst));
+	ut_asserteq_mem(src + 0x1100, dst, 0x700);
+	ut_asserteq(-EINVAL, spi_mem_dirmap_read(desc, 0x800, 1, dst));
+	spi_mem_dirmap_destroy(desc);
+
+	/* The bus does not map writes, so they fall back to exec_op() */
+	info.op_tmpl = (struct spi_mem_op)
+		SPI_MEM_OP(SPI_MEM_OP_CMD(flash->program_opcode, 1),
+			   SPI_MEM_OP_ADDR(flash->addr_width, 0, 1),
+			   SPI_MEM_OP_NO_DUMMY,
+			   SPI_MEM_OP_DATA_OUT(0, NULL, 1));
+	desc = spi_mem_dirmap_create(flash->spi, &info);
+	ut_assertok_ptr(desc);
+	ut_asserteq(1, desc->nodirmap);
+	ut_asserteq(-EINVAL, spi_mem_dirmap_read(desc, 0, 1, dst));
+	spi_mem_dirmap_destroy(desc);
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_dirmap, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
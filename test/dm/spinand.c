@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the SPI NAND core, run against the sandbox SPI NAND emulator
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <malloc.h>
+#include <rand.h>
+#include <spi_flash.h>
+#include <asm/state.h>
+#include <asm/test.h>
+#include <dm/test.h>
+#include <linux/mtd/mtd.h>
+#include <linux/mtd/spinand.h>
+#include <test/ut.h>
+
+#define TEST_SPINAND_PAGES	130
+#define TEST_SPINAND_T_R	50000	/* tR of the emulator, in ns */
+#define TEST_SPINAND_CS		2
+
+/* Read @len bytes at @from and return the virtual time taken in @timep */
+static int test_spinand_read(struct unit_test_state *uts, struct udevice *dev,
+			     struct mtd_info *mtd, loff_t from, size_t len,
+			     u8 *buf, u64 *timep)
+{
+	u64 start = sandbox_spi_nand_get_time(dev);
+	size_t retlen;
+
+	memset(buf, '\0', len);
+	ut_assertok(mtd_read(mtd, from, len, &retlen, buf));
+	ut_asserteq(len, retlen);
+	*timep = sandbox_spi_nand_get_time(dev) - start;
+
+	return 0;
+}
+
+/*
+ * Write a run of pages and read it back page by page and with the cache
+ * read pipeline, which must give the same data in less time
+ */
+static int dm_test_spi_nand_cache_read(struct unit_test_state *uts)
+{
+	struct erase_info ei = {};
+	struct spinand_device *spinand;
+	struct udevice *dev;
+	struct mtd_info *mtd;
+	u64 t_page, t_cache;
+	size_t len, retlen;
+	loff_t from;
+	u8 *buf, *out;
+	int i;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MTD, "spi-nand@2", &dev));
+	mtd = dev_get_uclass_priv(dev);
+	ut_assertnonnull(mtd);
+	spinand = mtd_to_spinand(mtd);
+	ut_assert(spinand->flags & SPINAND_HAS_READ_CACHE);
+
+	/* Start near the end of a block so that the pipeline is restarted */
+	from = 60 * mtd->writesize;
+	len = TEST_SPINAND_PAGES * mtd->writesize;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	out = malloc(len);
+	ut_assertnonnull(out);
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+
+	ei.mtd = mtd;
+	ei.len = roundup(from + len, mtd->erasesize);
+	ut_assertok(mtd_erase(mtd, &ei));
+	ut_assertok(mtd_write(mtd, from, len, &retlen, buf));
+	ut_asserteq(len, retlen);
+
+	spinand->flags &= ~SPINAND_HAS_READ_CACHE;
+	ut_assertok(test_spinand_read(uts, dev, mtd, from, len, out, &t_page));
+	spinand->flags |= SPINAND_HAS_READ_CACHE;
+	ut_asserteq_mem(buf, out, len);
+
+	ut_assertok(test_spinand_read(uts, dev, mtd, from, len, out, &t_cache));
+	ut_asserteq_mem(buf, out, len);
+
+	/* At least a quarter of tR per page is hidden */
+	ut_assert(t_cache + TEST_SPINAND_PAGES * TEST_SPINAND_T_R / 4 < t_page);
+
+	/* A read of a single page goes through the pipeline too */
+	ut_assertok(mtd_read(mtd, from + 3 * mtd->writesize, mtd->writesize,
+			     &retlen, out));
+	ut_asserteq(mtd->writesize, retlen);
+	ut_asserteq_mem(buf + 3 * mtd->writesize, out, mtd->writesize);
+
+	free(out);
+	free(buf);
+
+	sandbox_sf_unbind_emul(state_get_current(), dev->parent->seq,
+			       TEST_SPINAND_CS);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_nand_cache_read, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
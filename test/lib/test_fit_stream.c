@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for hashing FIT images while they are loaded
+ */
+
+#include <common.h>
+#include <fit_stream.h>
+#include <image.h>
+#include <malloc.h>
+#include <rand.h>
+#include <linux/libfdt.h>
+#include <u-boot/sha256.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_FIT_DATA_SIZE	(64 << 10)
+#define TEST_FIT_SIZE		(TEST_FIT_DATA_SIZE + 1024)
+#define TEST_FIT_CHUNK		1000
+
+/* Build a FIT with one image of random data, hashed with SHA-256 */
+static int test_fit_make(struct unit_test_state *uts, void *fit)
+{
+	u8 value[SHA256_SUM_LEN];
+	u8 *data;
+	int i;
+
+	data = malloc(TEST_FIT_DATA_SIZE);
+	ut_assertnonnull(data);
+	for (i = 0; i < TEST_FIT_DATA_SIZE; i++)
+		data[i] = rand();
+	sha256_csum_wd(data, TEST_FIT_DATA_SIZE, value, CHUNKSZ_SHA256);
+
+	ut_assertok(fdt_create(fit, TEST_FIT_SIZE));
+	ut_assertok(fdt_finish_reservemap(fit));
+	ut_assertok(fdt_begin_node(fit, ""));
+	ut_assertok(fdt_begin_node(fit, "images"));
+	ut_assertok(fdt_begin_node(fit, "kernel"));
+	ut_assertok(fdt_property(fit, FIT_DATA_PROP, data,
+				 TEST_FIT_DATA_SIZE));
+	ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP, "kernel"));
+	ut_assertok(fdt_begin_node(fit, "hash-1"));
+	ut_assertok(fdt_property_string(fit, FIT_ALGO_PROP, "sha256"));
+	ut_assertok(fdt_property(fit, FIT_VALUE_PROP, value, sizeof(value)));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_end_node(fit));
+	ut_assertok(fdt_finish(fit));
+	free(data);
+
+	return 0;
+}
+
+/* Copy @fit to @dst in chunks, reporting them in reverse order if @rev */
+static void test_fit_load(void *dst, const void *fit, bool rev)
+{
+	ulong size = fdt_totalsize(fit);
+	ulong pos;
+
+	fit_stream_begin(dst, TEST_FIT_SIZE);
+	memcpy(dst, fit, size);
+	for (pos = 0; pos < size; pos += TEST_FIT_CHUNK) {
+		ulong off = rev ? (size - 1) / TEST_FIT_CHUNK * TEST_FIT_CHUNK
+				  - pos : pos;
+
+		fit_stream_data(dst + off, min(size - off,
+					       (ulong)TEST_FIT_CHUNK));
+	}
+	fit_stream_end(size);
+}
+
+static int test_fit_image(struct unit_test_state *uts, const void *fit,
+			  const void **datap, size_t *sizep)
+{
+	int image;
+
+	image = fdt_path_offset(fit, FIT_IMAGES_PATH "/kernel");
+	ut_assert(image >= 0);
+	ut_assertok(fit_image_get_data_and_size(fit, image, datap, sizep));
+
+	return image;
+}
+
+/* Digests are computed for the loaded images and can be used once */
+static int lib_test_fit_stream_hash(struct unit_test_state *uts)
+{
+	u8 ref[SHA256_SUM_LEN], value[HASH_MAX_DIGEST_SIZE];
+	const void *data;
+	void *fit, *dst;
+	size_t size;
+	int pass, len;
+
+	fit = malloc(TEST_FIT_SIZE);
+	dst = malloc(TEST_FIT_SIZE);
+	ut_assertnonnull(fit);
+	ut_assertnonnull(dst);
+	ut_assertok(test_fit_make(uts, fit));
+
+	/* In order, then out of order so that the tail is hashed at the end */
+	for (pass = 0; pass < 2; pass++) {
+		test_fit_load(dst, fit, pass);
+		test_fit_image(uts, dst, &data, &size);
+		sha256_csum_wd(data, size, ref, CHUNKSZ_SHA256);
+
+		ut_assertok(fit_stream_get_hash(data, size, "sha256", value,
+						&len));
+		ut_asserteq(SHA256_SUM_LEN, len);
+		ut_asserteq_mem(ref, value, len);
+		ut_asserteq(-ENOENT, fit_stream_get_hash(data, size, "sha256",
+							 value, &len));
+	}
+
+	/* A new load over the image drops the digest */
+	test_fit_load(dst, fit, false);
+	fit_stream_begin(dst + 100, 100);
+	fit_stream_abort();
+	ut_asserteq(-ENOENT, fit_stream_get_hash(data, size, "sha256", value,
+						 &len));
+
+	/* So does any other data reported over it, even outside a load */
+	test_fit_load(dst, fit, false);
+	fit_stream_data(data + size - 1, 1);
+	ut_asserteq(-ENOENT, fit_stream_get_hash(data, size, "sha256", value,
+						 &len));
+	free(dst);
+	free(fit);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_stream_hash, 0);
+
+/* fit_image_verify() uses the digest and still catches a bad image */
+static int lib_test_fit_stream_verify(struct unit_test_state *uts)
+{
+	u8 value[HASH_MAX_DIGEST_SIZE];
+	const void *data;
+	void *fit, *dst;
+	size_t size;
+	int image, len;
+
+	fit = malloc(TEST_FIT_SIZE);
+	dst = malloc(TEST_FIT_SIZE);
+	ut_assertnonnull(fit);
+	ut_assertnonnull(dst);
+	ut_assertok(test_fit_make(uts, fit));
+
+	test_fit_load(dst, fit, false);
+	image = test_fit_image(uts, dst, &data, &size);
+	ut_asserteq(1, fit_image_verify(dst, image));
+	ut_asserteq(-ENOENT, fit_stream_get_hash(data, size, "sha256", value,
+						 &len));
+
+	/* Corrupt the image data in the source */
+	test_fit_image(uts, fit, &data, &size);
+	((u8 *)data)[size / 2] ^= 1;
+	test_fit_load(dst, fit, false);
+	ut_asserteq(0, fit_image_verify(dst, image));
+	free(dst);
+	free(fit);
+
+	return 0;
+}
+LIB_TEST(lib_test_fit_stream_verify, 0);
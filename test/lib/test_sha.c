@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the SHA-1/SHA-224/SHA-256/SHA-512 implementations
+ *
+ * The block function used by sha1_update()/sha256_update() may be replaced
+ * by an architecture specific one (e.g. ARMv8 Crypto Extensions). Check it
+ * against the portable C version on random data and report the throughput
+ * of both.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <u-boot/sha512.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Largest random buffer, in 64-byte blocks */
+#define TEST_SHA_MAX_BLOCKS	64
+#define TEST_SHA_ROUNDS		32
+
+/* Size of the buffer hashed by the throughput test */
+#define TEST_SHA_PERF_SIZE	(4 << 20)
+
+static const char test_sha_abc[] = "abc";
+static const char test_sha_448[] =
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+static void rand_buf(u8 *buf, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = rand() & 0xff;
+}
+
+/* Print throughput of @bytes processed in @us microseconds */
+static void test_sha_show_rate(const char *name, ulong bytes, ulong us)
+{
+	if (!us)
+		us = 1;
+	printf("%-16s %lu KiB in %lu us, %lu KiB/s\n", name, bytes >> 10, us,
+	       (ulong)((u64)(bytes >> 10) * 1000000 / us));
+}
+
+#ifdef CONFIG_SHA1
+static const u8 test_sha1_abc[SHA1_SUM_LEN] = {
+	0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+	0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d,
+};
+
+static const u8 test_sha1_448[SHA1_SUM_LEN] = {
+	0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+	0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1,
+};
+
+static int lib_test_sha1_vectors(struct unit_test_state *uts)
+{
+	u8 out[SHA1_SUM_LEN];
+
+	sha1_csum((const u8 *)test_sha_abc, strlen(test_sha_abc), out);
+	ut_asserteq_mem(test_sha1_abc, out, SHA1_SUM_LEN);
+
+	sha1_csum((const u8 *)test_sha_448, strlen(test_sha_448), out);
+	ut_asserteq_mem(test_sha1_448, out, SHA1_SUM_LEN);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha1_vectors, 0);
+
+static int lib_test_sha1_blocks(struct unit_test_state *uts)
+{
+	sha1_context ctx, ref;
+	u8 *buf;
+	int i;
+
+	/* one spare byte so that unaligned input can be tried too */
+	buf = malloc(TEST_SHA_MAX_BLOCKS * 64 + 1);
+	ut_assertnonnull(buf);
+
+	for (i = 0; i < TEST_SHA_ROUNDS; i++) {
+		int blocks = 1 + rand() % TEST_SHA_MAX_BLOCKS;
+		u8 *data = buf + (i & 1);
+
+		rand_buf(data, blocks * 64);
+		sha1_starts(&ctx);
+		sha1_starts(&ref);
+		sha1_process(&ctx, data, blocks);
+		sha1_process_generic(&ref, data, blocks);
+		ut_asserteq_mem(ref.state, ctx.state, sizeof(ref.state));
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha1_blocks, 0);
+#endif
+
+#ifdef CONFIG_SHA256
+static const u8 test_sha256_abc[SHA256_SUM_LEN] = {
+	0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+};
+
+static const u8 test_sha256_448[SHA256_SUM_LEN] = {
+	0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+	0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+	0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+	0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+};
+
+static int lib_test_sha256_vectors(struct unit_test_state *uts)
+{
+	u8 out[SHA256_SUM_LEN];
+
+	sha256_csum_wd((const u8 *)test_sha_abc, strlen(test_sha_abc), out,
+		       CHUNKSZ_SHA256);
+	ut_asserteq_mem(test_sha256_abc, out, SHA256_SUM_LEN);
+
+	sha256_csum_wd((const u8 *)test_sha_448, strlen(test_sha_448), out,
+		       CHUNKSZ_SHA256);
+	ut_asserteq_mem(test_sha256_448, out, SHA256_SUM_LEN);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha256_vectors, 0);
+
+static int lib_test_sha256_blocks(struct unit_test_state *uts)
+{
+	sha256_context ctx, ref;
+	u8 *buf;
+	int i;
+
+	buf = malloc(TEST_SHA_MAX_BLOCKS * 64 + 1);
+	ut_assertnonnull(buf);
+
+	for (i = 0; i < TEST_SHA_ROUNDS; i++) {
+		int blocks = 1 + rand() % TEST_SHA_MAX_BLOCKS;
+		u8 *data = buf + (i & 1);
+
+		rand_buf(data, blocks * 64);
+		sha256_starts(&ctx);
+		sha256_starts(&ref);
+		sha256_process(&ctx, data, blocks);
+		sha256_process_generic(&ref, data, blocks);
+		ut_asserteq_mem(ref.state, ctx.state, sizeof(ref.state));
+	}
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha256_blocks, 0);
+
+/* Odd-sized updates must give the same digest as a single one */
+static int lib_test_sha256_split(struct unit_test_state *uts)
+{
+	u8 out[SHA256_SUM_LEN], ref[SHA256_SUM_LEN];
+	sha256_context ctx;
+	int len, pos;
+	u8 *buf;
+
+	len = TEST_SHA_MAX_BLOCKS * 64 + 37;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	rand_buf(buf, len);
+
+	sha256_csum_wd(buf, len, ref, CHUNKSZ_SHA256);
+
+	sha256_starts(&ctx);
+	for (pos = 0; pos < len;) {
+		int chunk = min_t(int, 1 + rand() % 300, len - pos);
+
+		sha256_update(&ctx, buf + pos, chunk);
+		pos += chunk;
+	}
+	sha256_finish(&ctx, out);
+	ut_asserteq_mem(ref, out, SHA256_SUM_LEN);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha256_split, 0);
+
+static const u8 test_sha224_abc[SHA224_SUM_LEN] = {
+	0x23, 0x09, 0x7d, 0x22, 0x34, 0x05, 0xd8, 0x22,
+	0x86, 0x42, 0xa4, 0x77, 0xbd, 0xa2, 0x55, 0xb3,
+	0x2a, 0xad, 0xbc, 0xe4, 0xbd, 0xa0, 0xb3, 0xf7,
+	0xe3, 0x6c, 0x9d, 0xa7,
+};
+
+static const u8 test_sha224_448[SHA224_SUM_LEN] = {
+	0x75, 0x38, 0x8b, 0x16, 0x51, 0x27, 0x76, 0xcc,
+	0x5d, 0xba, 0x5d, 0xa1, 0xfd, 0x89, 0x01, 0x50,
+	0xb0, 0xc6, 0x45, 0x5c, 0xb4, 0xf5, 0x8b, 0x19,
+	0x52, 0x52, 0x25, 0x25,
+};
+
+static int lib_test_sha224_vectors(struct unit_test_state *uts)
+{
+	u8 out[SHA224_SUM_LEN];
+
+	sha224_csum_wd((const u8 *)test_sha_abc, strlen(test_sha_abc), out,
+		       CHUNKSZ_SHA256);
+	ut_asserteq_mem(test_sha224_abc, out, SHA224_SUM_LEN);
+
+	sha224_csum_wd((const u8 *)test_sha_448, strlen(test_sha_448), out,
+		       CHUNKSZ_SHA256);
+	ut_asserteq_mem(test_sha224_448, out, SHA224_SUM_LEN);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha224_vectors, 0);
+#endif
+
+#ifdef CONFIG_SHA512
+static const u8 test_sha512_abc[SHA512_SUM_LEN] = {
+	0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba,
+	0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+	0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2,
+	0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+	0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8,
+	0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+	0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e,
+	0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f,
+};
+
+static const u8 test_sha512_448[SHA512_SUM_LEN] = {
+	0x20, 0x4a, 0x8f, 0xc6, 0xdd, 0xa8, 0x2f, 0x0a,
+	0x0c, 0xed, 0x7b, 0xeb, 0x8e, 0x08, 0xa4, 0x16,
+	0x57, 0xc1, 0x6e, 0xf4, 0x68, 0xb2, 0x28, 0xa8,
+	0x27, 0x9b, 0xe3, 0x31, 0xa7, 0x03, 0xc3, 0x35,
+	0x96, 0xfd, 0x15, 0xc1, 0x3b, 0x1b, 0x07, 0xf9,
+	0xaa, 0x1d, 0x3b, 0xea, 0x57, 0x78, 0x9c, 0xa0,
+	0x31, 0xad, 0x85, 0xc7, 0xa7, 0x1d, 0xd7, 0x03,
+	0x54, 0xec, 0x63, 0x12, 0x38, 0xca, 0x34, 0x45,
+};
+
+static int lib_test_sha512_vectors(struct unit_test_state *uts)
+{
+	u8 out[SHA512_SUM_LEN];
+
+	sha512_csum_wd((const u8 *)test_sha_abc, strlen(test_sha_abc), out,
+		       CHUNKSZ_SHA512);
+	ut_asserteq_mem(test_sha512_abc, out, SHA512_SUM_LEN);
+
+	sha512_csum_wd((const u8 *)test_sha_448, strlen(test_sha_448), out,
+		       CHUNKSZ_SHA512);
+	ut_asserteq_mem(test_sha512_448, out, SHA512_SUM_LEN);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha512_vectors, 0);
+
+/* Odd-sized updates must give the same digest as a single one */
+static int lib_test_sha512_split(struct unit_test_state *uts)
+{
+	u8 out[SHA512_SUM_LEN], ref[SHA512_SUM_LEN];
+	sha512_context ctx;
+	int len, pos;
+	u8 *buf;
+
+	len = TEST_SHA_MAX_BLOCKS * 128 + 37;
+	buf = malloc(len);
+	ut_assertnonnull(buf);
+	rand_buf(buf, len);
+
+	sha512_csum_wd(buf, len, ref, CHUNKSZ_SHA512);
+
+	sha512_starts(&ctx);
+	for (pos = 0; pos < len;) {
+		int chunk = min_t(int, 1 + rand() % 300, len - pos);
+
+		sha512_update(&ctx, buf + pos, chunk);
+		pos += chunk;
+	}
+	sha512_finish(&ctx, out);
+	ut_asserteq_mem(ref, out, SHA512_SUM_LEN);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha512_split, 0);
+#endif
+
+/* Throughput of the active and of the generic block functions */
+static int lib_test_sha_perf(struct unit_test_state *uts)
+{
+	const int blocks = TEST_SHA_PERF_SIZE / 64;
+	ulong start;
+	u8 *buf;
+
+	buf = malloc(TEST_SHA_PERF_SIZE);
+	ut_assertnonnull(buf);
+	rand_buf(buf, TEST_SHA_PERF_SIZE);
+
+#ifdef CONFIG_SHA1
+	{
+		sha1_context ctx;
+
+		sha1_starts(&ctx);
+		start = timer_get_us();
+		sha1_process(&ctx, buf, blocks);
+		test_sha_show_rate("sha1", TEST_SHA_PERF_SIZE,
+				   timer_get_us() - start);
+
+		sha1_starts(&ctx);
+		start = timer_get_us();
+		sha1_process_generic(&ctx, buf, blocks);
+		test_sha_show_rate("sha1 (C)", TEST_SHA_PERF_SIZE,
+				   timer_get_us() - start);
+	}
+#endif
+#ifdef CONFIG_SHA256
+	{
+		sha256_context ctx;
+
+		sha256_starts(&ctx);
+		start = timer_get_us();
+		sha256_process(&ctx, buf, blocks);
+		test_sha_show_rate("sha256", TEST_SHA_PERF_SIZE,
+				   timer_get_us() - start);
+
+		sha256_starts(&ctx);
+		start = timer_get_us();
+		sha256_process_generic(&ctx, buf, blocks);
+		test_sha_show_rate("sha256 (C)", TEST_SHA_PERF_SIZE,
+				   timer_get_us() - start);
+	}
+#endif
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_sha_perf, 0);
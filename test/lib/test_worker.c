@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the worker core API, run against the sandbox thread model
+ */
+
+#include <common.h>
+#include <image.h>
+#include <malloc.h>
+#include <os.h>
+#include <rand.h>
+#include <worker.h>
+#include <u-boot/sha1.h>
+#include <u-boot/sha256.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_WORKER_LEN		(100 << 10)
+#define TEST_WORKER_JOBS	20	/* more than the mailbox holds */
+#define TEST_WORKER_TIMEOUT_NS	1000000000ULL
+
+static u8 *test_worker_buf(void)
+{
+	u8 *buf;
+	int i;
+
+	buf = malloc(TEST_WORKER_LEN);
+	if (buf) {
+		for (i = 0; i < TEST_WORKER_LEN; i++)
+			buf[i] = rand();
+	}
+
+	return buf;
+}
+
+/* Hash jobs give the same digests as the software functions */
+static int lib_test_worker_hash(struct unit_test_state *uts)
+{
+	struct worker_hash_job *jobs;
+	u8 ref[SHA256_SUM_LEN];
+	u8 *buf;
+	int i;
+
+	buf = test_worker_buf();
+	ut_assertnonnull(buf);
+	jobs = calloc(TEST_WORKER_JOBS, sizeof(*jobs));
+	ut_assertnonnull(jobs);
+
+	for (i = 0; i < TEST_WORKER_JOBS; i++) {
+		ut_assertok(worker_hash_init(&jobs[i], i & 1 ? "sha1" : "sha256",
+					     buf + i, TEST_WORKER_LEN - i));
+		worker_submit(&jobs[i].job);
+	}
+	for (i = 0; i < TEST_WORKER_JOBS; i++) {
+		ut_assertok(worker_wait(&jobs[i].job));
+		if (i & 1) {
+			ut_asserteq(SHA1_SUM_LEN, jobs[i].value_len);
+			sha1_csum_wd(buf + i, TEST_WORKER_LEN - i, ref,
+				     CHUNKSZ_SHA1);
+		} else {
+			ut_asserteq(SHA256_SUM_LEN, jobs[i].value_len);
+			sha256_csum_wd(buf + i, TEST_WORKER_LEN - i, ref,
+				       CHUNKSZ_SHA256);
+		}
+		ut_asserteq_mem(ref, jobs[i].value, jobs[i].value_len);
+	}
+	ut_asserteq(-EPROTONOSUPPORT,
+		    worker_hash_init(&jobs[0], "crc32", buf, TEST_WORKER_LEN));
+	worker_stop();
+	free(jobs);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_worker_hash, 0);
+
+struct test_worker_flag_job {
+	struct worker_job job;
+	u32 flag;
+};
+
+/* Wait for the test to set the flag, which only works on another CPU */
+static int test_worker_wait_flag(struct worker_job *job)
+{
+	struct test_worker_flag_job *fj = container_of(job,
+					struct test_worker_flag_job, job);
+	u64 start = os_get_nsec();
+
+	while (!__atomic_load_n(&fj->flag, __ATOMIC_ACQUIRE)) {
+		if (os_get_nsec() - start > TEST_WORKER_TIMEOUT_NS)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+/* Jobs run alongside U-Boot, and the worker can be stopped and restarted */
+static int lib_test_worker_async(struct unit_test_state *uts)
+{
+	struct test_worker_flag_job fj;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		fj.job.run = test_worker_wait_flag;
+		fj.flag = 0;
+		worker_submit(&fj.job);
+		__atomic_store_n(&fj.flag, 1, __ATOMIC_RELEASE);
+		ut_assertok(worker_wait(&fj.job));
+		worker_stop();
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_worker_async, 0);
@@ -0,0 +1,78 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Benchmark the block cache on a directory listing of an ext4 image. Each
+# 'ls' starts with an empty cache, since the partition table is scanned
+# again, so this measures how well the cache serves one walk of a directory
+# and of its inodes.
+
+import os
+import re
+import time
+import pytest
+import u_boot_utils as util
+
+# The old cache held 32 reads of up to 8 blocks. ext4 reads its 1KiB blocks
+# two sectors at a time, so it used about 32KiB, with no readahead.
+OLD_SIZE = '0x8000 0'
+
+def blkcache_stats(cons):
+    """Get and reset the statistics of the block cache"""
+    output = cons.run_command('blkcache show')
+    return dict((key, int(val, 0)) for key, val in
+                re.findall(r'^([\w /]+): (\w+)\s*$', output, re.M))
+
+def timed_ls(cons, path):
+    """List @path, returning the output and the time taken in seconds"""
+    start = time.time()
+    output = cons.run_command('ls host 0 %s' % path)
+    return output, time.time() - start
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_block_cache')
+@pytest.mark.buildconfigspec('cmd_ext4')
+@pytest.mark.requiredtool('mkfs.ext4')
+def test_blkcache(u_boot_console):
+    cons = u_boot_console
+    build_dir = cons.config.build_dir
+    fs_dir = os.path.join(build_dir, 'blkcache')
+    fs_img = os.path.join(build_dir, 'blkcache.img')
+    new_size = '%s %s' % (
+        cons.config.buildconfig.get('config_block_cache_size'),
+        cons.config.buildconfig.get('config_block_cache_readahead'))
+
+    util.run_and_log(cons, ['rm', '-rf', fs_dir, fs_img])
+    os.makedirs(os.path.join(fs_dir, 'dir'))
+    for i in range(600):
+        name = os.path.join(fs_dir, 'dir', 'file_with_a_long_name_%d' % i)
+        with open(name, 'w') as fd:
+            fd.write('%d\n' % i)
+    util.run_and_log(cons, ['truncate', '-s', '16M', fs_img])
+    util.run_and_log(cons, ['mkfs.ext4', '-q', '-b', '1024', '-d', fs_dir,
+                            fs_img])
+
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+
+    results = {}
+    for name, size in (('old', OLD_SIZE), ('new', new_size)):
+        cons.run_command('blkcache size %s' % size)
+        blkcache_stats(cons)
+        output, elapsed = timed_ls(cons, '/dir')
+        stats = blkcache_stats(cons)
+        assert len(re.findall(r'file_with_a_long_name_\d+', output)) == 600
+        cons.log.info('%s cache: %.3fs, %d hits, %d misses, %d evictions, '
+                      '%d blocks read ahead' %
+                      (name, elapsed, stats['hits'], stats['misses'],
+                       stats['evictions'], stats['readahead blocks']))
+        results[name] = (output, stats)
+
+    cons.run_command('blkcache size %s' % new_size)
+
+    old_output, old = results['old']
+    new_output, new = results['new']
+    assert old_output == new_output
+    assert old['readahead blocks'] == 0
+    assert new['readahead blocks']
+
+    # Reading ahead through the inode table saves most of the device reads
+    assert new['misses'] * 2 < old['misses']
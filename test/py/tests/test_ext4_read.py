@@ -0,0 +1,89 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Read files from an ext4 image, with and without extents, whole and at
+# various offsets. One file is sparse, with runs of three blocks every five
+# blocks, which gives it a two-level extent tree; another one has an
+# unwritten extent over blocks holding stale data, which must read as
+# zeros.
+
+import os
+import random
+import re
+import zlib
+import pytest
+import u_boot_utils as util
+
+LOAD_ADDR = 0x1000000
+BLOCK_SIZE = 1024
+
+def check_load(cons, name, data, offset=0, length=0):
+    """Load @name and check what was read against @data"""
+    expect = data[offset:offset + length] if length else data[offset:]
+    output = cons.run_command('ext4load host 0 %x %s %x %x' %
+                              (LOAD_ADDR, name, length, offset))
+    assert '%d bytes read' % len(expect) in output
+    output = cons.run_command('crc32 %x %x' % (LOAD_ADDR, len(expect)))
+    assert re.search('==> %08x' % zlib.crc32(expect), output)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ext4')
+@pytest.mark.requiredtool('mkfs.ext4')
+@pytest.mark.requiredtool('debugfs')
+@pytest.mark.parametrize('extents', [True, False])
+def test_ext4_read(u_boot_console, extents):
+    cons = u_boot_console
+    build_dir = cons.config.build_dir
+    fs_dir = os.path.join(build_dir, 'ext4_read')
+    fs_img = os.path.join(build_dir, 'ext4_read.img')
+    rnd = random.Random(1)
+    pattern = bytes(rnd.getrandbits(8) for _ in range(1 << 16))
+
+    util.run_and_log(cons, ['rm', '-rf', fs_dir, fs_img])
+    os.makedirs(fs_dir)
+    big = (pattern * 48)[7:]
+    with open(os.path.join(fs_dir, 'big.bin'), 'wb') as fd:
+        fd.write(big)
+    sparse = bytearray(4 << 20)
+    for i in range(0, len(sparse), 5 * BLOCK_SIZE):
+        sparse[i:i + 3 * BLOCK_SIZE] = pattern[i % 4096:i % 4096 +
+                                               3 * BLOCK_SIZE]
+    sparse = bytes(sparse)
+    with open(os.path.join(fs_dir, 'sparse.bin'), 'wb') as fd:
+        for i in range(0, len(sparse), 5 * BLOCK_SIZE):
+            fd.seek(i)
+            fd.write(sparse[i:i + 3 * BLOCK_SIZE])
+        fd.truncate(len(sparse))
+
+    features = '^metadata_csum,^64bit' + ('' if extents else ',^extent')
+    util.run_and_log(cons, ['truncate', '-s', '32M', fs_img])
+    util.run_and_log(cons, ['mkfs.ext4', '-q', '-b', str(BLOCK_SIZE), '-O',
+                            features, '-d', fs_dir, fs_img])
+    prealloc = bytes(100 * BLOCK_SIZE)
+    if extents:
+        for cmd in ('write /dev/null prealloc.bin',
+                    'fallocate /prealloc.bin 0 99',
+                    'sif /prealloc.bin size %d' % len(prealloc)):
+            util.run_and_log(cons, ['debugfs', '-w', '-R', cmd, fs_img])
+        output = util.run_and_log(cons, ['debugfs', '-R',
+                                         'bmap /prealloc.bin 0', fs_img])
+        blknr = int(re.search(r'^(\d+) \(uninit\)', output, re.M).group(1))
+        with open(fs_img, 'r+b') as fd:
+            fd.seek(blknr * BLOCK_SIZE)
+            fd.write(b'\xff' * len(prealloc))
+
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+
+    check_load(cons, 'big.bin', big)
+    for offset, length in ((1, 1000), (1023, 1025), (12345, 300000),
+                           (len(big) - 1000, 0), (len(big) // 2, 1 << 20)):
+        check_load(cons, 'big.bin', big, offset, length)
+    check_load(cons, 'sparse.bin', sparse)
+    for offset, length in ((1, 1000), (3 * BLOCK_SIZE - 1, 2 * BLOCK_SIZE + 2),
+                           (4 * BLOCK_SIZE, BLOCK_SIZE), (777777, 100000),
+                           (len(sparse) - 5000, 0)):
+        check_load(cons, 'sparse.bin', sparse, offset, length)
+    if extents:
+        check_load(cons, 'prealloc.bin', prealloc)
+        check_load(cons, 'prealloc.bin', prealloc, 5000, 10000)
+    util.run_and_log(cons, ['rm', '-rf', fs_dir, fs_img])
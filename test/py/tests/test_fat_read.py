@@ -0,0 +1,228 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Read a badly fragmented file from a FAT32 image, in one piece and at
+# various offsets. The image is laid out here rather than with mkfs.vfat
+# and mtools, so that the cluster chain of the file is known: it is made
+# of short runs, in a shuffled order, with the clusters of another file in
+# between.
+
+import functools
+import os
+import random
+import re
+import time
+import struct
+import zlib
+import pytest
+import u_boot_utils as util
+
+SECTOR_SIZE = 512
+RESERVED = 32
+NUM_FATS = 2
+ROOT_CLUSTER = 2
+LOAD_ADDR = 0x1000000
+
+def fat_chain(fat, clusters):
+    """Link @clusters into a chain in @fat"""
+    for cur, nxt in zip(clusters, clusters[1:]):
+        fat[cur] = nxt
+    fat[clusters[-1]] = 0x0fffffff
+
+def dir_entry(name, start, size):
+    """Make a directory entry for the 8.3 file @name"""
+    base, ext = name.split('.')
+    return struct.pack('<11sBBBHHHHHHHI',
+                       ('%-8s%-3s' % (base, ext)).encode(), 0x20, 0, 0,
+                       0, 0, 0, start >> 16, 0, 0x21, start & 0xffff, size)
+
+def file_data(pattern, file_size, offset, length):
+    """Get the contents of BIG.BIN
+
+    Each cluster of the file is @pattern, with its number in the first four
+    bytes, so that a misplaced cluster is caught.
+
+    Returns:
+        The @length bytes at @offset, or the rest of the file if @length is 0
+    """
+    clust_size = len(pattern)
+    length = min(length or file_size, file_size - offset)
+    first = offset // clust_size
+    last = (offset + length - 1) // clust_size
+    data = b''.join(struct.pack('<I', i) + pattern[4:]
+                    for i in range(first, last + 1))
+    start = offset - first * clust_size
+    return data[start:start + length]
+
+def mk_fat32_fragmented(path, img_size, sects_per_clust, file_size, seed,
+                        max_run=16, max_gap=4):
+    """Make a FAT32 image holding BIG.BIN, in fragments, and FILL.BIN
+
+    The data of BIG.BIN comes in runs of 1 to @max_run clusters, which are
+    shuffled, with 1 to @max_gap clusters of FILL.BIN after each of them.
+
+    Returns:
+        A function giving the contents of BIG.BIN, like file_data()
+    """
+    rnd = random.Random(seed)
+    clust_size = SECTOR_SIZE * sects_per_clust
+    total_sect = img_size // SECTOR_SIZE
+    nclust = total_sect // sects_per_clust
+    fat_sect = (nclust * 4 + SECTOR_SIZE - 1) // SECTOR_SIZE
+    data_sect = RESERVED + NUM_FATS * fat_sect
+    nclust = (total_sect - data_sect) // sects_per_clust
+
+    # Lay out the runs of BIG.BIN on the disk, FILL.BIN takes the gaps
+    big_count = (file_size + clust_size - 1) // clust_size
+    runs, fill = [], []
+    clust = ROOT_CLUSTER + 1
+    left = big_count
+    while left:
+        run = min(rnd.randint(1, max_run), left)
+        runs.append(list(range(clust, clust + run)))
+        clust += run
+        left -= run
+        gap = rnd.randint(1, max_gap)
+        fill.extend(range(clust, clust + gap))
+        clust += gap
+    assert clust < nclust + 2, 'image too small'
+    rnd.shuffle(runs)
+    big = [c for run in runs for c in run]
+
+    fat = [0] * (nclust + 2)
+    fat[0] = 0x0ffffff8
+    fat[1] = 0x0fffffff
+    fat[ROOT_CLUSTER] = 0x0fffffff
+    fat_chain(fat, big)
+    fat_chain(fat, fill)
+    fat_data = struct.pack('<%dI' % len(fat), *fat)
+
+    pattern = bytes(rnd.getrandbits(8) for _ in range(clust_size))
+    data = functools.partial(file_data, pattern, file_size)
+
+    boot = struct.pack('<3s8sHBHBHHBHHHIIIHHIHH12s',
+                       b'\xeb\x58\x90', b'mkfs.py ', SECTOR_SIZE,
+                       sects_per_clust, RESERVED, NUM_FATS, 0, 0, 0xf8, 0,
+                       32, 64, 0, total_sect, fat_sect, 0, 0, ROOT_CLUSTER,
+                       1, 6, b'')
+    boot += struct.pack('<BBBI11s8s', 0x80, 0, 0x29, seed, b'FRAGMENTED ',
+                        b'FAT32   ')
+    boot = boot.ljust(510, b'\0') + b'\x55\xaa'
+    info = struct.pack('<I480xI', 0x41615252, 0x61417272)
+    info += struct.pack('<II12xI', 0xffffffff, 0xffffffff, 0xaa550000)
+    root = dir_entry('BIG.BIN', big[0], file_size)
+    root += dir_entry('FILL.BIN', fill[0], len(fill) * clust_size)
+
+    def clust_offset(clust):
+        return (data_sect + (clust - 2) * sects_per_clust) * SECTOR_SIZE
+
+    with open(path, 'wb') as fd:
+        fd.truncate(img_size)
+        fd.write(boot)
+        fd.write(info)
+        fd.seek(6 * SECTOR_SIZE)
+        fd.write(boot)
+        for i in range(NUM_FATS):
+            fd.seek((RESERVED + i * fat_sect) * SECTOR_SIZE)
+            fd.write(fat_data)
+        fd.seek(clust_offset(ROOT_CLUSTER))
+        fd.write(root)
+        lclust = 0
+        for run in runs:
+            fd.seek(clust_offset(run[0]))
+            fd.write(data(lclust * clust_size, len(run) * clust_size))
+            lclust += len(run)
+
+    return data
+
+def check_load(cons, data, offset=0, length=0, addr=LOAD_ADDR):
+    """Load BIG.BIN and check what was read against @data"""
+    expect = data(offset, length)
+    output = cons.run_command('fatload host 0 %x BIG.BIN %x %x' %
+                              (addr, length, offset))
+    assert '%d bytes read' % len(expect) in output
+    output = cons.run_command('crc32 %x %x' % (addr, len(expect)))
+    assert re.search('==> %08x' % zlib.crc32(expect), output)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fat')
+def test_fat_read_fragmented(u_boot_console):
+    cons = u_boot_console
+    fs_img = os.path.join(cons.config.build_dir, 'fat_read.img')
+    size = (6 << 20) + 1234
+    data = mk_fat32_fragmented(fs_img, 16 << 20, 1, size, 1)
+
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+
+    check_load(cons, data)
+    # Seek into the chain mapped above, then past it on a new mapping
+    for offset, length in ((1, 1000), (511, 513), (12345, 300000),
+                           (size - 1000, 0), (size // 2, 1 << 20),
+                           (512 * 9999, 512 * 7)):
+        check_load(cons, data, offset, length)
+    # A misaligned buffer is filled through a bounce buffer
+    for offset, length in ((0, 0), (512 * 3, 1 << 20), (777, 100000)):
+        check_load(cons, data, offset, length, LOAD_ADDR + 1)
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+    for offset, length in ((size - 4096, 0), (4096, 4096), (0, 0)):
+        check_load(cons, data, offset, length)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fat')
+@pytest.mark.buildconfigspec('fat_write')
+def test_fat_read_after_write(u_boot_console):
+    cons = u_boot_console
+    fs_img = os.path.join(cons.config.build_dir, 'fat_read.img')
+    size = 1 << 20
+    data = mk_fat32_fragmented(fs_img, 16 << 20, 1, size, 2)
+
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+    check_load(cons, data, 4096, 0)
+
+    # Move the second half of the file elsewhere, keeping its first cluster
+    # and size, so that only the FAT tells that the chain mapped above is
+    # stale
+    half = size // 2
+    cons.run_command('fatwrite host 0 %x BIG.BIN %x' % (LOAD_ADDR, half))
+    cons.run_command('mw.b %x a5 %x' % (LOAD_ADDR, half))
+    cons.run_command('fatwrite host 0 %x NEW.BIN %x' % (LOAD_ADDR, half))
+    cons.run_command('mw.b %x 5a %x' % (LOAD_ADDR, size))
+    cons.run_command('fatwrite host 0 %x BIG.BIN %x' % (LOAD_ADDR, size))
+    new = lambda offset, length: bytes([0x5a]) * min(length or size,
+                                                     size - offset)
+    check_load(cons, new, 4096, 0)
+    check_load(cons, new)
+    util.run_and_log(cons, ['rm', '-f', fs_img])
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fat')
+@pytest.mark.slow
+def test_fat_read_benchmark(u_boot_console):
+    """Time reading a fragmented 512MiB file in 64MiB pieces
+
+    The file has 4KiB clusters in runs of up to 64 of them.
+    """
+    cons = u_boot_console
+    fs_img = os.path.join(cons.config.build_dir, 'fat_read.img')
+    size = 512 << 20
+    piece = 64 << 20
+    data = mk_fat32_fragmented(fs_img, 600 << 20, 8, size, 3, max_run=64)
+
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+
+    elapsed = 0
+    for offset in range(0, size, piece):
+        start = time.time()
+        output = cons.run_command('fatload host 0 %x BIG.BIN %x %x' %
+                                  (LOAD_ADDR, piece, offset))
+        elapsed += time.time() - start
+        assert '%d bytes read' % piece in output
+        output = cons.run_command('crc32 %x %x' % (LOAD_ADDR, piece))
+        assert re.search('==> %08x' % zlib.crc32(data(offset, piece)),
+                         output)
+    cons.log.info('read %d MiB in %.3fs, %.1f MiB/s' %
+                  (size >> 20, elapsed, (size >> 20) / elapsed))
+    util.run_and_log(cons, ['rm', '-f', fs_img])
@@ -55,6 +55,7 @@ base_its = '''
                         os = "linux";
                         %(ramdisk_load)s
                         compression = "%(compression)s";
+                        %(ramdisk_hash)s
                 };
                 ramdisk@2 {
                         description = "snow";
@@ -351,6 +352,7 @@ def test_fit(u_boot_console):
             'ramdisk_size' : filesize(ramdisk),
             'ramdisk_load' : '',
             'ramdisk_config' : '',
+            'ramdisk_hash' : '',
 
             'loadables1' : loadables1,
             'loadables1_out' : loadables1_out,
@@ -417,6 +419,17 @@ def test_fit(u_boot_console):
             output = cons.run_command_list(cmd.splitlines())
             check_equal(ramdisk, ramdisk_out, 'Ramdisk not loaded')
 
+        # A hashed ramdisk, which is checked on the worker core if there is one
+        with cons.log.section('Kernel + FDT + Ramdisk with hash'):
+            params['ramdisk_hash'] = 'hash-1 { algo = "sha256"; };'
+            fit = make_fit(mkimage, params)
+            cons.restart_uboot()
+            output = cons.run_command_list(cmd.splitlines())
+            check_equal(ramdisk, ramdisk_out, 'Ramdisk not loaded')
+            if cons.config.buildconfig.get('config_cpu_worker', 'n') == 'y':
+                assert ("Verifying Hash Integrity of 'ramdisk@1' ... "
+                        'sha256+ OK' in ''.join(output))
+
         # Configuration with some Loadables
         with cons.log.section('Kernel + FDT + Ramdisk load + Loadables'):
             params['loadables_config'] = 'loadables = "kernel@2", "ramdisk@2";'
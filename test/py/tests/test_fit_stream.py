@@ -0,0 +1,89 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Check that a FIT loaded from a block device is hashed while it is read, so
+# that bootm does not need to hash it again
+
+import os
+import re
+import pytest
+import u_boot_utils as util
+
+its = '''
+/dts-v1/;
+
+/ {
+        description = "FIT stream hash test";
+        #address-cells = <1>;
+
+        images {
+                kernel {
+                        description = "kernel";
+                        data = /incbin/("%(kernel)s");
+                        type = "kernel";
+                        arch = "sandbox";
+                        os = "linux";
+                        compression = "none";
+                        load = <0x40000>;
+                        entry = <0x40000>;
+                        hash-1 {
+                                algo = "sha256";
+                        };
+                };
+        };
+        configurations {
+                default = "conf";
+                conf {
+                        kernel = "kernel";
+                };
+        };
+};
+'''
+
+def hash_time(cons):
+    """Get the time spent hashing so far, in microseconds"""
+    output = cons.run_command('bootstage report')
+    m = re.search(r'^\s*([\d,]+)\s+hash\s*$', output, re.M)
+    return int(m.group(1).replace(',', '')) if m else 0
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('fit_stream_hash')
+@pytest.mark.buildconfigspec('cmd_bootstage')
+@pytest.mark.requiredtool('dtc')
+@pytest.mark.requiredtool('mkfs.ext4')
+def test_fit_stream(u_boot_console):
+    cons = u_boot_console
+    build_dir = cons.config.build_dir
+    fs_dir = os.path.join(build_dir, 'fit_stream')
+    fs_img = os.path.join(build_dir, 'fit_stream.img')
+    its_file = os.path.join(build_dir, 'fit_stream.its')
+    kernel = os.path.join(build_dir, 'fit_stream_kernel.bin')
+    mkimage = os.path.join(build_dir, 'tools', 'mkimage')
+
+    with open(kernel, 'wb') as fd:
+        fd.write(os.urandom(4 << 20))
+    with open(its_file, 'w') as fd:
+        fd.write(its % {'kernel': kernel})
+    util.run_and_log(cons, ['rm', '-rf', fs_dir, fs_img])
+    os.mkdir(fs_dir)
+    util.run_and_log(cons, [mkimage, '-f', its_file,
+                            os.path.join(fs_dir, 'fit.itb')])
+    util.run_and_log(cons, ['truncate', '-s', '16M', fs_img])
+    util.run_and_log(cons, ['mkfs.ext4', '-q', '-d', fs_dir, fs_img])
+
+    cons.restart_uboot()
+    cons.run_command('host bind 0 %s' % fs_img)
+    output = cons.run_command('load host 0 1000000 fit.itb')
+    assert 'bytes read' in output
+    loaded = hash_time(cons)
+    assert loaded
+
+    # The digest computed while loading is used
+    output = cons.run_command('bootm start 1000000')
+    assert 'sha256+ OK' in output
+    assert hash_time(cons) == loaded
+
+    # A copy was not loaded, so it has to be hashed
+    cons.run_command('cp.b 1000000 2000000 $filesize')
+    output = cons.run_command('bootm start 2000000')
+    assert 'sha256+ OK' in output
+    assert hash_time(cons) > loaded
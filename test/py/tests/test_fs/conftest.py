@@ -14,6 +14,7 @@ supported_fs_ext = ['fat16', 'fat32']
 supported_fs_mkdir = ['fat16', 'fat32']
 supported_fs_unlink = ['fat16', 'fat32']
 supported_fs_symlink = ['ext4']
+supported_hash_htree = ['legacy', 'half_md4', 'tea']
 
 #
 # Filesystem test specific setup
@@ -90,6 +91,9 @@ def pytest_generate_tests(metafunc):
     if 'fs_obj_symlink' in metafunc.fixturenames:
         metafunc.parametrize('fs_obj_symlink', supported_fs_symlink,
             indirect=True, scope='module')
+    if 'fs_obj_htree' in metafunc.fixturenames:
+        metafunc.parametrize('fs_obj_htree', supported_hash_htree,
+            indirect=True, scope='module')
 
 #
 # Helper functions
@@ -601,3 +605,134 @@ def fs_obj_symlink(request, u_boot_config):
         call('rmdir %s' % mount_dir, shell=True)
         if fs_img:
             call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for hashed directory (htree) fs test
+#
+@pytest.fixture()
+def fs_obj_htree(request, u_boot_config):
+    """Set up an ext4 file system with directories indexed by a hash tree.
+
+    HTREE_DIR holds enough files with long names for its index to have
+    two levels, SUBDIR among them; SUBDIR holds HTREE_SMALL_COUNT files,
+    which take a single level.
+
+    Args:
+        request: Pytest request object, giving the hash algorithm.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for htree test, i.e. a pair of volume file name and a
+        list of the file names in HTREE_DIR.
+    """
+    hash_alg = request.param
+    fs_img = ''
+
+    if not u_boot_config.buildconfig.get('config_cmd_ext4', None):
+        pytest.skip('.config feature "CMD_EXT4" not enabled')
+
+    src_dir = u_boot_config.persistent_data_dir + '/htree'
+    big_dir = src_dir + '/' + HTREE_DIR
+    sub_dir = big_dir + '/SUBDIR'
+
+    try:
+        check_call('rm -rf %s' % src_dir, shell=True)
+        check_call('mkdir -p %s' % sub_dir, shell=True)
+
+        # Each file holds its own name
+        names = ['%s.%05d' % ('x' * (i % 100), i)
+                 for i in range(HTREE_COUNT)]
+        for name in names:
+            with open(big_dir + '/' + name, 'w') as fd:
+                fd.write(name)
+        for i in range(HTREE_SMALL_COUNT):
+            with open('%s/%d' % (sub_dir, i), 'w') as fd:
+                fd.write('%d' % i)
+
+        # mkfs.ext4 does not index directories, e2fsck -D does
+        fs_img = u_boot_config.persistent_data_dir + '/htree.img'
+        check_call('rm -f %s' % fs_img, shell=True)
+        check_call('truncate -s 64M %s' % fs_img, shell=True)
+        check_call('mkfs.ext4 -q -b 1024 -O ^metadata_csum -d %s %s'
+                   % (src_dir, fs_img), shell=True)
+        check_call('tune2fs -E hash_alg=%s %s' % (hash_alg, fs_img),
+                   shell=True)
+        call('e2fsck -f -y -D %s' % fs_img, shell=True)
+        out = check_output('debugfs -R "htree /%s" %s'
+                           % (HTREE_DIR, fs_img), shell=True).decode()
+        if not re.search('Indirect levels: 1', out):
+            raise CalledProcessError(1, 'debugfs')
+        out = check_output('debugfs -R "htree /%s/SUBDIR" %s'
+                           % (HTREE_DIR, fs_img), shell=True).decode()
+        if not re.search('Indirect levels: 0', out):
+            raise CalledProcessError(1, 'debugfs')
+    except CalledProcessError:
+        pytest.skip('Setup failed for hash algorithm: ' + hash_alg)
+        return
+    else:
+        yield [fs_img, names]
+    finally:
+        call('rm -rf %s' % src_dir, shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
+
+#
+# Fixture for extent fs test
+#
+@pytest.fixture(params=['^metadata_csum', 'metadata_csum'])
+def fs_obj_extent(request, u_boot_config):
+    """Set up an ext4 file system whose free space is fragmented.
+
+    FRAG_DIR is filled with small files and every other one is removed,
+    so that a large file written to the volume is mapped by hundreds of
+    extents. A file of random data is made on the host to be written.
+    The volume is made with and without metadata_csum.
+
+    Args:
+        request: Pytest request object.
+        u_boot_config: U-boot configuration.
+
+    Return:
+        A fixture for extent test, i.e. a triplet of volume file name,
+        host data file name and its MD5 hash.
+    """
+    fs_img = ''
+
+    check_ubconfig(u_boot_config, 'ext4')
+
+    src_dir = u_boot_config.persistent_data_dir + '/frag'
+    frag_dir = src_dir + '/' + FRAG_DIR
+    cmd_file = u_boot_config.persistent_data_dir + '/frag.cmd'
+    data_file = u_boot_config.persistent_data_dir + '/frag.bin'
+
+    try:
+        check_call('rm -rf %s' % src_dir, shell=True)
+        check_call('mkdir -p %s' % frag_dir, shell=True)
+        for i in range(FRAG_COUNT):
+            with open('%s/%d' % (frag_dir, i), 'wb') as fd:
+                fd.write(os.urandom(FRAG_SIZE))
+
+        fs_img = u_boot_config.persistent_data_dir + '/frag.img'
+        check_call('rm -f %s' % fs_img, shell=True)
+        check_call('truncate -s 16M %s' % fs_img, shell=True)
+        check_call('mkfs.ext4 -q -b 1024 -O %s -d %s %s'
+                   % (request.param, src_dir, fs_img), shell=True)
+        with open(cmd_file, 'w') as fd:
+            for i in range(1, FRAG_COUNT, 2):
+                fd.write('rm /%s/%d\n' % (FRAG_DIR, i))
+        check_call('debugfs -w -f %s %s' % (cmd_file, fs_img), shell=True)
+
+        # Twice the size of the holes, so the file ends past them
+        check_call('dd if=/dev/urandom of=%s bs=%d count=%d'
+                   % (data_file, FRAG_SIZE, FRAG_COUNT), shell=True)
+        out = check_output('md5sum %s' % data_file, shell=True).decode()
+        md5 = out.split()[0]
+    except CalledProcessError:
+        pytest.skip('Setup failed for filesystem: ext4')
+        return
+    else:
+        yield [fs_img, data_file, md5]
+    finally:
+        call('rm -rf %s %s %s' % (src_dir, cmd_file, data_file), shell=True)
+        if fs_img:
+            call('rm -f %s' % fs_img, shell=True)
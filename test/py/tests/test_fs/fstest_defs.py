@@ -12,5 +12,17 @@ MEDIUM_FILE='10MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# $HTREE_DIR is the name of the hash-indexed directory, with $HTREE_COUNT
+# files in it and $HTREE_SMALL_COUNT files in its SUBDIR
+HTREE_DIR='htree'
+HTREE_COUNT=3000
+HTREE_SMALL_COUNT=200
+
+# $FRAG_DIR holds $FRAG_COUNT files of $FRAG_SIZE bytes, every other one of
+# which is removed to leave the free space in small pieces
+FRAG_DIR='frag'
+FRAG_COUNT=1024
+FRAG_SIZE=4096
+
 ADDR=0x01000008
 LENGTH=0x00100000
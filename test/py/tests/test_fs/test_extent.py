@@ -0,0 +1,74 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:extent Test
+
+"""
+This test verifies writing ext4 files which are mapped by an extent tree,
+into fragmented free space, and releasing their blocks again.
+"""
+
+import hashlib
+import pytest
+import re
+from subprocess import check_output
+from fstest_defs import *
+from fstest_helpers import assert_fs_integrity
+
+def free_blocks(fs_img):
+    """Return the free block count in the superblock of @fs_img"""
+    out = check_output('dumpe2fs -h %s 2> /dev/null' % fs_img,
+                       shell=True).decode()
+    return int(re.search('Free blocks: +([0-9]+)', out).group(1))
+
+def check_load(u_boot_console, path, size, md5):
+    """Load @path and check that it holds @size bytes with hash @md5"""
+    output = u_boot_console.run_command_list([
+        'mw.b %x 00 100' % ADDR,
+        'ext4load host 0:0 %x %s' % (ADDR, path),
+        'md5sum %x %x' % (ADDR, size)])
+    assert '%d bytes read' % size in ''.join(output)
+    assert md5 in ''.join(output)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestExtent(object):
+    def test_extent1(self, u_boot_console, fs_obj_extent):
+        """
+        Test Case 1 - write a file into fragmented free space, overwrite it
+        with a smaller one and then with an empty one
+        """
+        fs_img, data_file, md5 = fs_obj_extent
+        size = FRAG_COUNT * FRAG_SIZE
+        with open(data_file, 'rb') as fd:
+            head = fd.read(3 * FRAG_SIZE)
+        free = free_blocks(fs_img)
+
+        with u_boot_console.log.section('Test Case 1 - extents'):
+            # Test Case 1a - Write the file, which needs an extent tree
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'host load hostfs - %x %s' % (ADDR, data_file),
+                'ext4write host 0:0 %x /big %x' % (ADDR, size)])
+            assert '%d bytes written' % size in ''.join(output)
+            out = check_output('debugfs -R "stat /big" %s 2> /dev/null'
+                               % fs_img, shell=True).decode()
+            assert 'ETB' in out
+            check_load(u_boot_console, '/big', size, md5)
+            assert_fs_integrity('ext4', fs_img)
+
+            # Test Case 1b - Overwrite it with its first few blocks
+            output = u_boot_console.run_command_list([
+                'host load hostfs - %x %s' % (ADDR, data_file),
+                'ext4write host 0:0 %x /big %x' % (ADDR, len(head))])
+            assert '%d bytes written' % len(head) in ''.join(output)
+            check_load(u_boot_console, '/big', len(head),
+                       hashlib.md5(head).hexdigest())
+            assert_fs_integrity('ext4', fs_img)
+
+            # Test Case 1c - Overwrite it with an empty file; ext4 has no
+            # unlink, so this is how its blocks are all given back
+            output = u_boot_console.run_command(
+                'ext4write host 0:0 %x /big 0' % ADDR)
+            assert '0 bytes written' in output
+            assert free_blocks(fs_img) == free
+            assert_fs_integrity('ext4', fs_img)
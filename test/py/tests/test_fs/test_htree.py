@@ -0,0 +1,68 @@
+# SPDX-License-Identifier:      GPL-2.0+
+#
+# U-Boot File System:htree Test
+
+"""
+This test verifies lookup of files in ext4 directories indexed by a hash
+tree, with each hash algorithm.
+"""
+
+import pytest
+import re
+import zlib
+from fstest_defs import *
+
+def load(u_boot_console, path):
+    """Load @path, returning the output of the command and its exit code"""
+    return u_boot_console.run_command(
+        'ext4load host 0:0 %x %s; echo ret=$?' % (ADDR, path))
+
+def check_load(u_boot_console, path, content):
+    """Load @path and check that it holds @content"""
+    output = load(u_boot_console, path)
+    assert '%d bytes read' % len(content) in output
+    assert 'ret=0' in output
+    output = u_boot_console.run_command(
+        'crc32 %x %x' % (ADDR, len(content)))
+    assert '==> %08x' % zlib.crc32(content.encode()) in output
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.slow
+class TestHtree(object):
+    def test_htree1(self, u_boot_console, fs_obj_htree):
+        """
+        Test Case 1 - load files from the two level index
+        """
+        fs_img, names = fs_obj_htree
+        with u_boot_console.log.section('Test Case 1 - load files'):
+            u_boot_console.run_command('host bind 0 %s' % fs_img)
+            for name in names[::97] + names[-3:]:
+                check_load(u_boot_console, '/%s/%s' % (HTREE_DIR, name),
+                           name)
+
+    def test_htree2(self, u_boot_console, fs_obj_htree):
+        """
+        Test Case 2 - look up names which are not in the directory
+        """
+        fs_img, names = fs_obj_htree
+        with u_boot_console.log.section('Test Case 2 - missing files'):
+            u_boot_console.run_command('host bind 0 %s' % fs_img)
+            for name in ('nothere', names[5] + 'x', names[5][:-1], '.0'):
+                output = load(u_boot_console, '/%s/%s' % (HTREE_DIR, name))
+                assert 'ret=1' in output
+
+    def test_htree3(self, u_boot_console, fs_obj_htree):
+        """
+        Test Case 3 - follow a path through an index to a directory
+        with a single level index, and list it
+        """
+        fs_img, names = fs_obj_htree
+        with u_boot_console.log.section('Test Case 3 - subdirectory'):
+            u_boot_console.run_command('host bind 0 %s' % fs_img)
+            for i in (0, 7, HTREE_SMALL_COUNT - 1):
+                check_load(u_boot_console,
+                           '/%s/SUBDIR/%d' % (HTREE_DIR, i), '%d' % i)
+            output = u_boot_console.run_command(
+                'ext4ls host 0:0 /%s/SUBDIR' % HTREE_DIR)
+            assert len(re.findall(r'^ +\d+ \d+\r*$', output, re.M)) == \
+                HTREE_SMALL_COUNT
@@ -0,0 +1,210 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Check pipelined NFS reads against a local NFSv3 stand-in, reached through
+# the sandbox raw ethernet driver on the loopback interface. The stand-in
+# answers portmap, mount and NFS calls on one port, and can send READ
+# replies out of order, drop one, and return short reads, to exercise the
+# read window.
+
+import hashlib
+import os
+import socket
+import struct
+import threading
+import time
+import pytest
+
+PROG_PORTMAP = 100000
+PROG_NFS = 100003
+PROG_MOUNT = 100005
+
+NFS3PROC_LOOKUP = 3
+NFS3PROC_READ = 6
+
+ACCEPT_SUCCESS = 0
+ACCEPT_PROG_MISMATCH = 2
+
+NFS3ERR_NOENT = 2
+
+RPC_PORT = 111
+EXPORT = '/export'
+ADDR = 0x01000000
+
+class NfsServer(threading.Thread):
+    """A minimal NFSv3 server for reading files from one export
+
+    Args:
+        files: Dictionary of file names to contents
+        reorder: Send READ replies in pairs swapped
+        drop: Leave out the reply to a READ at this offset the first time
+        maxread: Most bytes returned by one READ
+    """
+    def __init__(self, files, reorder=False, drop=None, maxread=None):
+        super().__init__(daemon=True)
+        self.names = list(files)
+        self.files = files
+        self.reorder = reorder
+        self.drop = drop
+        self.maxread = maxread
+        self.held = None
+        self.error = None
+        self.reads = 0
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        try:
+            self.sock.bind(('127.0.0.1', RPC_PORT))
+        except OSError:
+            self.sock.close()
+            pytest.skip('Port %d is in use, e.g. by rpcbind' % RPC_PORT)
+        self.sock.settimeout(0.05)
+        self.running = True
+
+    def stop(self):
+        self.running = False
+        self.join()
+        self.sock.close()
+
+    def run(self):
+        while self.running:
+            try:
+                pkt, peer = self.sock.recvfrom(2048)
+            except socket.timeout:
+                self.flush()
+                continue
+            try:
+                self.handle(pkt, peer)
+            except Exception as e:
+                self.error = e
+
+    def flush(self):
+        if self.held:
+            self.sock.sendto(*self.held)
+            self.held = None
+
+    def reply(self, peer, xid, body, stat=ACCEPT_SUCCESS, read=False):
+        pkt = struct.pack('!IIIIII', xid, 1, 0, 0, 0, stat) + body
+        if read and self.reorder and not self.held:
+            self.held = (pkt, peer)
+            return
+        self.sock.sendto(pkt, peer)
+        self.flush()
+
+    def handle(self, pkt, peer):
+        xid, mtype, rpcvers, prog, vers, proc = struct.unpack('!6I', pkt[:24])
+        pos = 24
+        for auth in range(2):   # credential and verifier
+            alen = struct.unpack('!I', pkt[pos + 4:pos + 8])[0]
+            pos += 8 + (alen + 3) // 4 * 4
+        args = pkt[pos:]
+        if prog == PROG_PORTMAP:
+            self.reply(peer, xid, struct.pack('!I', RPC_PORT))
+        elif prog == PROG_MOUNT:
+            if proc == 1:       # MNT, answered the version 1 way
+                self.reply(peer, xid, struct.pack('!I', 0) + b'\0' * 32)
+            else:               # UMNTALL
+                self.reply(peer, xid, b'')
+        elif prog == PROG_NFS and vers != 3:
+            self.reply(peer, xid, struct.pack('!II', 3, 3),
+                       stat=ACCEPT_PROG_MISMATCH)
+        elif proc == NFS3PROC_LOOKUP:
+            fhlen = struct.unpack('!I', args[:4])[0]
+            pos = 4 + fhlen
+            nlen = struct.unpack('!I', args[pos:pos + 4])[0]
+            name = args[pos + 4:pos + 4 + nlen].decode()
+            if name not in self.files:
+                self.reply(peer, xid, struct.pack('!II', NFS3ERR_NOENT, 0))
+                return
+            fh = struct.pack('!I', self.names.index(name)) + b'\0' * 28
+            self.reply(peer, xid, struct.pack('!II', 0, len(fh)) + fh +
+                       struct.pack('!II', 0, 0))
+        elif proc == NFS3PROC_READ:
+            fhlen = struct.unpack('!I', args[:4])[0]
+            fh = args[4:4 + fhlen]
+            offset, count = struct.unpack('!QI', args[4 + fhlen:16 + fhlen])
+            data = self.files[self.names[struct.unpack('!I', fh[:4])[0]]]
+            if self.maxread:
+                count = min(count, self.maxread)
+            chunk = data[offset:offset + count]
+            self.reads += 1
+            if offset == self.drop:
+                self.drop = None
+                return
+            eof = offset + len(chunk) >= len(data)
+            self.reply(peer, xid, struct.pack('!IIIII', 0, 0, len(chunk),
+                                              eof, len(chunk)) +
+                       chunk + b'\0' * (-len(chunk) % 4), read=True)
+
+def nfs_setup(cons):
+    if os.geteuid():
+        pytest.skip('Raw ethernet on loopback needs root')
+    cons.run_command_list([
+        'setenv ethact host_lo',
+        'setenv ipaddr 127.0.0.1',
+        'setenv netmask 255.0.0.0',
+        'setenv serverip 127.0.0.1',
+        'setenv gatewayip',
+        'setenv autoload no'])
+
+def nfs_load(cons, name, data, window):
+    """Load a file over NFS and check it, returning the rate in MB/s"""
+    cons.run_command('setenv nfswindowsize %d' % window)
+    start = time.time()
+    output = cons.run_command('nfs %x %s/%s' % (ADDR, EXPORT, name))
+    elapsed = time.time() - start
+    assert 'Bytes transferred = %d' % len(data) in output
+    output = cons.run_command('md5sum %x %x' % (ADDR, len(data)))
+    assert hashlib.md5(data).hexdigest() in output
+    rate = len(data) / elapsed / 1e6
+    cons.log.info('%d bytes, windowsize %d: %.2f MB/s' %
+                  (len(data), window, rate))
+    return rate
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_nfs')
+def test_net_nfs_window(u_boot_console):
+    """Test that NFS loads are correct with and without a read window"""
+    cons = u_boot_console
+    data = os.urandom((2 << 20) + 333)
+    nfs_setup(cons)
+    server = NfsServer({'window.bin': data})
+    server.start()
+    try:
+        nfs_load(cons, 'window.bin', data, 1)
+        nfs_load(cons, 'window.bin', data, 16)
+        assert not server.error
+    finally:
+        server.stop()
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_nfs')
+def test_net_nfs_window_reorder(u_boot_console):
+    """Test windowed NFS loads with replies out of order and one lost"""
+    cons = u_boot_console
+    data = os.urandom((1 << 20) + 4096)
+    nfs_setup(cons)
+    server = NfsServer({'reorder.bin': data}, reorder=True,
+                       drop=100 * 1024)
+    server.start()
+    try:
+        nfs_load(cons, 'reorder.bin', data, 8)
+        assert not server.error
+        # Only the lost block was asked for again
+        blocks = (len(data) + 1023) // 1024
+        assert server.reads <= blocks + 8 + 1
+    finally:
+        server.stop()
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_nfs')
+def test_net_nfs_window_short(u_boot_console):
+    """Test windowed NFS loads when the server returns short reads"""
+    cons = u_boot_console
+    data = os.urandom((1 << 20) + 100)
+    nfs_setup(cons)
+    server = NfsServer({'short.bin': data}, reorder=True, maxread=700)
+    server.start()
+    try:
+        nfs_load(cons, 'short.bin', data, 8)
+        assert not server.error
+    finally:
+        server.stop()
@@ -0,0 +1,205 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Check TFTP windowsize (RFC 7440) transfers against a local TFTP stand-in,
+# reached through the sandbox raw ethernet driver on the loopback interface.
+# The stand-in can send the blocks of a window out of order, and drop one,
+# to exercise the receive side.
+
+import hashlib
+import os
+import socket
+import struct
+import threading
+import time
+import pytest
+
+TFTP_RRQ = 1
+TFTP_DATA = 3
+TFTP_ACK = 4
+TFTP_ERROR = 5
+TFTP_OACK = 6
+
+ADDR = 0x01000000
+
+class TftpServer(threading.Thread):
+    """A minimal TFTP server for read requests, with windowsize
+
+    Args:
+        files: Dictionary of file names to contents
+        reorder: Send the blocks of each window in pairs swapped
+        drop: Leave out this block number the first time it is sent
+    """
+    def __init__(self, files, reorder=False, drop=None):
+        super().__init__(daemon=True)
+        self.files = files
+        self.reorder = reorder
+        self.drop = drop
+        self.error = None
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind(('127.0.0.1', 69))
+        self.sock.settimeout(0.2)
+        self.running = True
+
+    def stop(self):
+        self.running = False
+        self.join()
+        self.sock.close()
+
+    def run(self):
+        while self.running:
+            try:
+                pkt, peer = self.sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+            if struct.unpack('!H', pkt[:2])[0] != TFTP_RRQ:
+                continue
+            try:
+                self.send_file(pkt[2:], peer)
+            except Exception as e:
+                self.error = e
+
+    def send_file(self, req, peer):
+        fields = req.split(b'\0')
+        name = fields[0].decode()
+        opts = dict((fields[i].decode().lower(), fields[i + 1].decode())
+                    for i in range(2, len(fields) - 1, 2))
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.bind(('127.0.0.1', 0))
+        sock.settimeout(1)
+        data = self.files.get(name)
+        if data is None:
+            sock.sendto(struct.pack('!HH', TFTP_ERROR, 1) +
+                        b'File not found\0', peer)
+            sock.close()
+            return
+
+        blksize = min(int(opts.get('blksize', 512)), 1468)
+        window = int(opts.get('windowsize', 1))
+        oack = b''
+        if 'blksize' in opts:
+            oack += b'blksize\0%d\0' % blksize
+        if 'windowsize' in opts:
+            oack += b'windowsize\0%d\0' % window
+        if 'tsize' in opts:
+            oack += b'tsize\0%d\0' % len(data)
+        last = len(data) // blksize + 1
+        if oack:
+            self.send_until_ack(sock, peer,
+                                [struct.pack('!H', TFTP_OACK) + oack], 0)
+        base = 1
+        dropped = False
+        while base <= last:
+            blocks = []
+            for n in range(base, min(base + window, last + 1)):
+                if n == self.drop and not dropped:
+                    dropped = True
+                    continue
+                blocks.append((n, struct.pack('!HH', TFTP_DATA, n & 0xffff) +
+                               data[(n - 1) * blksize:n * blksize]))
+            if self.reorder:
+                for i in range(0, len(blocks) - 1, 2):
+                    blocks[i], blocks[i + 1] = blocks[i + 1], blocks[i]
+            acked = self.send_until_ack(sock, peer,
+                                        [pkt for n, pkt in blocks],
+                                        base - 1,
+                                        min(base + window, last + 1) - 1)
+            base = acked + 1
+        sock.close()
+
+    def send_until_ack(self, sock, peer, pkts, first, end=None):
+        """Send a window and return the block number acknowledged for it"""
+        end = first if end is None else end
+        for retry in range(10):
+            for pkt in pkts:
+                sock.sendto(pkt, peer)
+            while True:
+                try:
+                    ack, src = sock.recvfrom(2048)
+                except socket.timeout:
+                    break
+                op, seq = struct.unpack('!HH', ack[:4])
+                if op != TFTP_ACK:
+                    continue
+                # Find the block in the window this ACK is for
+                for n in range(first, end + 1):
+                    if n & 0xffff == seq:
+                        return n
+        raise Exception('No ACK from client')
+
+def tftp_setup(cons):
+    if os.geteuid():
+        pytest.skip('Raw ethernet on loopback needs root')
+    cons.run_command_list([
+        'setenv ethact host_lo',
+        'setenv ipaddr 127.0.0.1',
+        'setenv netmask 255.0.0.0',
+        'setenv serverip 127.0.0.1',
+        'setenv gatewayip',
+        'setenv autoload no'])
+
+def tftp_load(cons, name, data, window, blksize=1468):
+    """Load a file over TFTP and check it, returning the rate in MB/s"""
+    cons.run_command('setenv tftpblocksize %d' % blksize)
+    cons.run_command('setenv tftpwindowsize %d' % window)
+    start = time.time()
+    output = cons.run_command('tftpboot %x %s' % (ADDR, name))
+    elapsed = time.time() - start
+    assert 'Bytes transferred = %d' % len(data) in output
+    output = cons.run_command('md5sum %x %x' % (ADDR, len(data)))
+    assert hashlib.md5(data).hexdigest() in output
+    rate = len(data) / elapsed / 1e6
+    cons.log.info('%d bytes, blksize %d, windowsize %d: %.2f MB/s' %
+                  (len(data), blksize, window, rate))
+    return rate
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_net')
+@pytest.mark.buildconfigspec('net_tftp_vars')
+def test_net_tftp_window(u_boot_console):
+    """Test that windowed TFTP loads are correct, and faster than lock-step"""
+    cons = u_boot_console
+    data = os.urandom(16 << 20)
+    tftp_setup(cons)
+    server = TftpServer({'window.bin': data})
+    server.start()
+    try:
+        rate1 = tftp_load(cons, 'window.bin', data, 1)
+        rate16 = tftp_load(cons, 'window.bin', data, 16)
+        assert not server.error
+        assert rate16 > rate1
+    finally:
+        server.stop()
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_net')
+@pytest.mark.buildconfigspec('net_tftp_vars')
+def test_net_tftp_window_reorder(u_boot_console):
+    """Test windowed TFTP loads with blocks out of order and one lost"""
+    cons = u_boot_console
+    data = os.urandom(4 << 20)
+    tftp_setup(cons)
+    server = TftpServer({'reorder.bin': data}, reorder=True, drop=100)
+    server.start()
+    try:
+        tftp_load(cons, 'reorder.bin', data, 16)
+        assert not server.error
+    finally:
+        server.stop()
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_net')
+@pytest.mark.buildconfigspec('net_tftp_vars')
+@pytest.mark.slow
+def test_net_tftp_window_wrap(u_boot_console):
+    """Test a windowed TFTP load past the 16-bit block number wrap"""
+    cons = u_boot_console
+    data = os.urandom((33 << 20) + 100)
+    tftp_setup(cons)
+    server = TftpServer({'wrap.bin': data}, reorder=True)
+    server.start()
+    try:
+        tftp_load(cons, 'wrap.bin', data, 16, blksize=512)
+        assert not server.error
+    finally:
+        server.stop()
@@ -0,0 +1,109 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Check HTTP loads with the wget command against a local web server.
+#
+# The sandbox raw ethernet driver cannot carry TCP on the loopback interface,
+# so a veth pair is set up and U-Boot is restarted to pick it up: U-Boot uses
+# one end and the server listens on the other. This needs root.
+
+import hashlib
+import http.server
+import os
+import subprocess
+import threading
+import time
+import pytest
+
+VETH = 'ubveth0'
+VETH_PEER = 'ubveth1'
+SERVER_IP = '10.99.0.1'
+UBOOT_IP = '10.99.0.2'
+PORT = 8080
+
+ADDR = 0x01000000
+
+class Handler(http.server.SimpleHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    files = {}
+
+    def do_GET(self):
+        data = self.files.get(self.path)
+        if data is None:
+            self.send_error(404)
+            return
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, format, *args):
+        pass
+
+def ip(*args):
+    subprocess.run(('ip',) + args, check=True)
+
+@pytest.fixture
+def wget_env(u_boot_console):
+    """Set up the veth pair and a web server, and restart U-Boot"""
+    if os.geteuid():
+        pytest.skip('Raw ethernet on a veth pair needs root')
+    cons = u_boot_console
+    ip('link', 'add', VETH, 'type', 'veth', 'peer', 'name', VETH_PEER)
+    server = None
+    try:
+        ip('addr', 'add', SERVER_IP + '/24', 'dev', VETH_PEER)
+        ip('link', 'set', VETH, 'up')
+        ip('link', 'set', VETH_PEER, 'up')
+        server = http.server.HTTPServer((SERVER_IP, PORT), Handler)
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        cons.restart_uboot()
+        cons.run_command_list([
+            'setenv ethact host_' + VETH,
+            'setenv ipaddr ' + UBOOT_IP,
+            'setenv netmask 255.255.255.0',
+            'setenv serverip ' + SERVER_IP,
+            'setenv gatewayip',
+            'setenv httpdstp %d' % PORT])
+        yield cons
+    finally:
+        if server:
+            server.shutdown()
+            server.server_close()
+        ip('link', 'del', VETH)
+        cons.restart_uboot()
+
+def wget_load(cons, path, data):
+    """Load a file over HTTP and check it, returning the rate in MB/s"""
+    start = time.time()
+    output = cons.run_command('wget %x %s' % (ADDR, path))
+    elapsed = time.time() - start
+    assert 'Bytes transferred = %d' % len(data) in output
+    output = cons.run_command('md5sum %x %x' % (ADDR, len(data)))
+    assert hashlib.md5(data).hexdigest() in output
+    rate = len(data) / elapsed / 1e6
+    cons.log.info('%d bytes: %.2f MB/s' % (len(data), rate))
+    return rate
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_wget')
+def test_net_wget(wget_env):
+    """Test that files load correctly over HTTP"""
+    cons = wget_env
+    big = os.urandom(16 << 20)
+    # Odd-sized, to end on a short segment
+    small = os.urandom(3001)
+    Handler.files = {'/big.bin': big, '/small.bin': small}
+    wget_load(cons, '/big.bin', big)
+    wget_load(cons, 'small.bin', small)
+    wget_load(cons, '%s:/small.bin' % SERVER_IP, small)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_wget')
+def test_net_wget_missing(wget_env):
+    """Test that a file the server does not have is reported"""
+    cons = wget_env
+    Handler.files = {}
+    output = cons.run_command('wget %x /missing.bin' % ADDR)
+    assert "Server replied '404" in output
+    assert 'Bytes transferred' not in output